@@ -21,6 +21,17 @@ public class AdkCommunicator implements Runnable
 {
 	public static final int PERIOD_MS = 5;
 	public static final float ADC_TO_VOLTAGE = 0.0208f; // R1=0.98kO, R2=3.2kO?, V = ADC/(2^12)*5V/(R1/(R1+R2)).
+	public static final float MOTOR_POWER_FULL_SCALE = 255.0f; // Power of a motor sent as the max pulse.
+	
+	// Motor commands frame, see MotorProtocol.h in the Arduino sketch.
+	private static final int MOTOR_FRAME_SYNC = 0xA5;
+	private static final int MOTOR_FRAME_SIZE = 12;
+	private static final int MOTOR_COMMAND_MAX = 1000; // Max pulse - min pulse [us].
+	private static final int[] CRC_NIBBLE_TABLE =
+	{
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+	};
 	private static final String ACTION_USB_PERMISSION = "com.google.android.DemoKit.action.USB_PERMISSION";
 	
 	public AdkCommunicator(AdbListener adbListener, Context context)
@@ -28,7 +39,7 @@ public class AdkCommunicator implements Runnable
 		this.adbListener = adbListener;
 		this.context = context;
 		
-		txBuffer = new byte[4];
+		txBuffer = new byte[MOTOR_FRAME_SIZE];
 	}
 	
 	public void start(boolean continuousMode) throws Exception
@@ -78,11 +89,20 @@ public class AdkCommunicator implements Runnable
 	
 	public void setPowers(MotorsPowers powers)
 	{
-		// Prepare the data to send.
-		txBuffer[0] = (byte) powers.nw;
-		txBuffer[1] = (byte) powers.ne;
-		txBuffer[2] = (byte) powers.se;
-		txBuffer[3] = (byte) powers.sw;
+		// Prepare the frame to send: sync byte, sequence number, the pulse of
+		// each motor (1 us resolution), and the CRC.
+		txBuffer[0] = (byte) MOTOR_FRAME_SYNC;
+		txBuffer[1] = (byte) txSequence;
+		txSequence++;
+		
+		putMotorCommand(2, powers.nw);
+		putMotorCommand(4, powers.ne);
+		putMotorCommand(6, powers.se);
+		putMotorCommand(8, powers.sw);
+		
+		int crc = computeCrc(txBuffer, 1, MOTOR_FRAME_SIZE - 3);
+		txBuffer[MOTOR_FRAME_SIZE - 2] = (byte) (crc & 0xff);
+		txBuffer[MOTOR_FRAME_SIZE - 1] = (byte) (crc >> 8);
 
 		// Send to the ADK.
 		if (outputStream != null)
@@ -98,6 +118,29 @@ public class AdkCommunicator implements Runnable
 		}
 	}
 	
+	private void putMotorCommand(int offset, float power)
+	{
+		int command = Math.round(power / MOTOR_POWER_FULL_SCALE * MOTOR_COMMAND_MAX);
+		command = Math.max(0, Math.min(MOTOR_COMMAND_MAX, command));
+		
+		txBuffer[offset] = (byte) (command & 0xff);
+		txBuffer[offset + 1] = (byte) (command >> 8);
+	}
+	
+	// CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF).
+	private static int computeCrc(byte[] data, int offset, int size)
+	{
+		int crc = 0xffff;
+		
+		for(int i=offset; i<offset+size; i++)
+		{
+			crc = ((crc << 4) & 0xffff) ^ CRC_NIBBLE_TABLE[(crc >> 12) ^ ((data[i] >> 4) & 0x0f)];
+			crc = ((crc << 4) & 0xffff) ^ CRC_NIBBLE_TABLE[(crc >> 12) ^ (data[i] & 0x0f)];
+		}
+		
+		return crc;
+	}
+	
 	private final BroadcastReceiver usbReceiver = new BroadcastReceiver()
 	{ 
 	    public void onReceive(Context context, Intent intent)
@@ -225,6 +268,7 @@ public class AdkCommunicator implements Runnable
 	}
 	
 	private byte[] txBuffer;
+	private int txSequence;
 	private Context context;
 	private AdbListener adbListener;
 	private UsbManager usbManager;
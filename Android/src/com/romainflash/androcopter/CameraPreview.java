@@ -23,6 +23,7 @@ public class CameraPreview extends SurfaceView implements Callback
 	public static final int VIDEO_SD_WIDTH = 176; // [px].
 	public static final int VIDEO_SD_HEIGHT = 144; // [px].
 	public static final long MIN_FRAME_SPACING = 100000000; // [ns] -> 0.1s.
+	public static final int DEFAULT_JPEG_QUALITY = 80; // [%].
 	
 	private SurfaceHolder mHolder;
 	private Camera mCamera;
@@ -33,6 +34,8 @@ public class CameraPreview extends SurfaceView implements Callback
     private Camera.PictureCallback pictureReceiver;
     private long lastPictureTxTime;
     private byte previewCallbackBuffer[];
+    private volatile int jpegQuality = DEFAULT_JPEG_QUALITY;
+    private volatile long frameSpacing = MIN_FRAME_SPACING;
 
 	public CameraPreview(Context context, AttributeSet as)
 	{
@@ -139,7 +142,7 @@ public class CameraPreview extends SurfaceView implements Callback
 		{
 			long currentTime = System.nanoTime();
 			
-			if(frameRequested && (currentTime-lastPictureTxTime>MIN_FRAME_SPACING))
+			if(frameRequested && (currentTime-lastPictureTxTime>frameSpacing))
 			{
 				lastPictureTxTime = currentTime;
 
@@ -153,7 +156,7 @@ public class CameraPreview extends SurfaceView implements Callback
 
 					// Convert from bitmap to jpeg.
 					ByteArrayOutputStream baos = new ByteArrayOutputStream();
-					bitmap.compress(Bitmap.CompressFormat.JPEG, 80, baos);
+					bitmap.compress(Bitmap.CompressFormat.JPEG, jpegQuality, baos);
 					
 					// Send the frame to the computer.
 					tcp.sendMessage(baos.toByteArray(), TcpClient.TYPE_VIDEO_FRAME);
@@ -178,12 +181,12 @@ public class CameraPreview extends SurfaceView implements Callback
     	{
     		// Send the picture to the computer.
     		Log.d("AndroCopter", "Start sending picture.");
-			tcp.sendMessage(data, TcpClient.TYPE_PHOTO);
+			tcp.sendLargeMessage(data, TcpClient.TYPE_PHOTO);
 			
 			// Resume the preview.
 			mCamera.startPreview();
 			
-			Log.d("AndroCopter", "Finished sending picture.");
+			Log.d("AndroCopter", "Picture queued, it is sent in chunks.");
         }
     }
     
@@ -227,6 +230,28 @@ public class CameraPreview extends SurfaceView implements Callback
     	return frameRequested;
     }
     
+    // Set the JPEG quality of the streamed frames (1-100). Lowered by the
+    // computer when the link is congested.
+    public void setJpegQuality(int quality)
+    {
+    	if(quality < 1)
+    		quality = 1;
+    	else if(quality > 100)
+    		quality = 100;
+    	
+    	jpegQuality = quality;
+    }
+    
+    // Set the maximum rate of the streamed frames [fps]. It can not be higher
+    // than the rate given by MIN_FRAME_SPACING.
+    public void setFrameRate(int framesPerSecond)
+    {
+    	if(framesPerSecond <= 0)
+    		return;
+    	
+    	frameSpacing = Math.max(MIN_FRAME_SPACING, 1000000000L / framesPerSecond);
+    }
+    
     public void takePicture(TcpClient tcp)
 	{
     	this.tcp = tcp;
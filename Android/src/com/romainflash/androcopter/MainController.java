@@ -13,6 +13,7 @@ import com.romainflash.androcopter.TcpClient.TcpMessageReceiver;
 public class MainController implements TcpMessageReceiver, AdbListener
 {
 	public static final int STATE_SEND_DIVIDER = 20;
+	public static final int STATE_BACKLOG_SIZE = 600; // Latest states kept for the PC after a disconnection (60 s).
 	public static final double MAX_MOTOR_POWER = 255.0; // 255.0 normally, less for testing.
 	public static final float MAX_TIME_WITHOUT_PC_RX = 1.0f; // Maximum time [s] without any message from the PC, before emergency stop.
 	public static final float MAX_TIME_WITHOUT_ADK_RX = 1.0f; // Maximum time [s] without any message from the ADK, setting the temperature to 0 (error).
@@ -39,6 +40,15 @@ public class MainController implements TcpMessageReceiver, AdbListener
 		
 		stateSendDividerCounter = 0;
 		
+		stateBacklog = new String[STATE_BACKLOG_SIZE];
+		stateBacklogTimes = new long[STATE_BACKLOG_SIZE];
+		stateBacklogCount = 0;
+		
+		// Text states until the PC asks for the compact ones.
+		telemetryEncoder = new TelemetryEncoder();
+		stateValues = new double[TelemetryEncoder.CHANNELS_COUNT];
+		compactTelemetry = false;
+		
 		timeWithoutPcRx = 0.0f;
 		timeWithoutAdkRx = 0.0f;
 		
@@ -218,6 +228,8 @@ public class MainController implements TcpMessageReceiver, AdbListener
 					tempPowerSW -= yawForce; //
 					
 					// Saturate the values, because the motors input are 0-255.
+					// They are not rounded, the ADK receives them with a finer
+					// resolution.
 					motorsPowers.nw = motorSaturation(tempPowerNW);
 					motorsPowers.ne = motorSaturation(tempPowerNE);
 					motorsPowers.se = motorSaturation(tempPowerSE);
@@ -279,8 +291,43 @@ public class MainController implements TcpMessageReceiver, AdbListener
 											  " " + (regulatorEnabled?1:0) +
 											  " " + currentAltitude + " " + altitudeTarget + " " + altitudeForce;
 						
+						// Keep it, even if it is not sent, in case the PC
+						// asks for it after a reconnection.
+						addToStateBacklog(currentTime/1000000 % INT_MAX, currStateStr);
+						
+						if(compactTelemetry)
+						{
+							stateValues[0] = currentTime/1000000 % INT_MAX;
+							stateValues[1] = currentYaw;
+							stateValues[2] = yawAngleTarget;
+							stateValues[3] = yawForce;
+							stateValues[4] = currentPitch;
+							stateValues[5] = pitchAngleTarget;
+							stateValues[6] = pitchForce;
+							stateValues[7] = currentRoll;
+							stateValues[8] = rollAngleTarget;
+							stateValues[9] = rollForce;
+							stateValues[10] = batteryVoltage;
+							stateValues[11] = 0;
+							stateValues[12] = regulatorEnabled?1:0;
+							stateValues[13] = currentAltitude;
+							stateValues[14] = altitudeTarget;
+							stateValues[15] = altitudeForce;
+							
+							// The previous state has not been written yet, and
+							// will be replaced by this one: the PC can't use
+							// it as reference.
+							if(client.isPriorityMessagePending())
+								telemetryEncoder.requestKeyframe();
+							
+							client.sendMessageNowOrSkip(telemetryEncoder.encode(stateValues, false),
+											   TcpClient.TYPE_COMPACT_STATE);
+						}
+						else
+						{
 							client.sendMessageNowOrSkip(currStateStr.getBytes(),
 											   TcpClient.TYPE_CURRENT_STATE);
+						}
 					}
 				}
 			}
@@ -294,20 +341,25 @@ public class MainController implements TcpMessageReceiver, AdbListener
 		private boolean again;
 	}
 	
-	private int motorSaturation(double val)
+	private float motorSaturation(double val)
 	{
 		if(val > MAX_MOTOR_POWER)
-			return (int)MAX_MOTOR_POWER;
+			return (float)MAX_MOTOR_POWER;
 		else if(val < 0.0)
-			return 0;
+			return 0.0f;
 		else
-			return (int)val;
+			return (float)val;
 	}
 
 	public void onConnectionEstablished()
 	{
 		// Reset the orientation.
 		posRotSensors.setCurrentStateAsZero();
+		
+		// The PC asks for the compact states at each connection, and its
+		// decoder starts from a keyframe.
+		compactTelemetry = false;
+		telemetryEncoder.requestKeyframe();
 	}
 
 	public void onConnectionLost()
@@ -327,8 +379,41 @@ public class MainController implements TcpMessageReceiver, AdbListener
 		{
 			// Do nothing, this is just to reset the timer.
 		}
+		else if(message.startsWith("ping "))
+		{
+			// Echo the ping with the current phone time, so the computer can
+			// measure the round-trip time of the link.
+			String pong = message.replace("ping ", "") + " " +
+						  (System.nanoTime()/1000000 % INT_MAX);
+			client.sendMessage(pong.getBytes(), TcpClient.TYPE_PONG);
+		}
 		else if(message.equals("emergency_stop"))
 			emergencyStop();
+		else if(message.startsWith("chunk_resume "))
+		{
+			// The PC lost the end of a large message: send it again.
+			String[] values = message.replace("chunk_resume ", "").split("\\s");
+			
+			if(values.length == 2)
+				client.resumeTransfer(Integer.parseInt(values[0]), Integer.parseInt(values[1]));
+		}
+		else if(message.startsWith("chunk_done "))
+			client.finishTransfer(Integer.parseInt(message.replace("chunk_done ", "").trim()));
+		else if(message.equals("telemetry_format compact"))
+			compactTelemetry = true;
+		else if(message.equals("telemetry_format text"))
+			compactTelemetry = false;
+		else if(message.equals("telemetry_keyframe"))
+		{
+			// The PC missed a compact state, and can't decode the next ones.
+			telemetryEncoder.requestKeyframe();
+		}
+		else if(message.startsWith("telemetry_backlog "))
+		{
+			// Send the states the PC missed, newer than the given time.
+			long sinceTime = Long.parseLong(message.replace("telemetry_backlog ", "").trim());
+			client.sendMessage(getStateBacklog(sinceTime).getBytes(), TcpClient.TYPE_TELEMETRY_BACKLOG);
+		}
 		else if(message.startsWith("command "))
 		{
 			String[] values = message.replace("command ", "").split("\\s");
@@ -407,7 +492,7 @@ public class MainController implements TcpMessageReceiver, AdbListener
 			}
 
 			// Send the log.
-			client.sendMessage(sb.toString().getBytes(), TcpClient.TYPE_LOG);
+			client.sendLargeMessage(sb.toString().getBytes(), TcpClient.TYPE_LOG);
 			client.sendMessage("Logging finished.".getBytes(), TcpClient.TYPE_TEXT);
 			
 			// Stop logging.
@@ -433,6 +518,10 @@ public class MainController implements TcpMessageReceiver, AdbListener
 				camera.setFrameSize(activity, true);
 				camera.startStreaming(client);
 			}
+			else if(newStateString.startsWith("quality "))
+				camera.setJpegQuality(Integer.parseInt(newStateString.replace("quality ", "")));
+			else if(newStateString.startsWith("rate "))
+				camera.setFrameRate(Integer.parseInt(newStateString.replace("rate ", "")));
 		}
 		else if(message.equals("take_picture"))
 			camera.takePicture(client);
@@ -451,6 +540,30 @@ public class MainController implements TcpMessageReceiver, AdbListener
 		}
 	}
 	
+	private synchronized void addToStateBacklog(long time, String state)
+	{
+		int index = (int)(stateBacklogCount % STATE_BACKLOG_SIZE);
+		stateBacklog[index] = state;
+		stateBacklogTimes[index] = time;
+		stateBacklogCount++;
+	}
+	
+	private synchronized String getStateBacklog(long sinceTime)
+	{
+		StringBuilder sb = new StringBuilder();
+		long first = Math.max(0, stateBacklogCount - STATE_BACKLOG_SIZE);
+		
+		for(long i=first; i<stateBacklogCount; i++)
+		{
+			int index = (int)(i % STATE_BACKLOG_SIZE);
+			
+			if(stateBacklogTimes[index] > sinceTime)
+				sb.append(stateBacklog[index]).append('\n');
+		}
+		
+		return sb.toString();
+	}
+	
 	private void emergencyStop()
 	{
 		// TODO
@@ -470,9 +583,9 @@ public class MainController implements TcpMessageReceiver, AdbListener
 	
 	public class MotorsPowers
 	{
-		public int nw, ne, se, sw; // 0-1023 (10 bits values).
+		public float nw, ne, se, sw; // 0-255, sent with a 1 us resolution (1000 steps).
 		
-		public int getMean()
+		public float getMean()
 		{
 			return (nw+ne+se+sw) / 4;
 		}
@@ -501,6 +614,12 @@ public class MainController implements TcpMessageReceiver, AdbListener
 	private ArrayList<LogPoint> log;
 	private HeliState heliState;
 	private int stateSendDividerCounter;
+	private String[] stateBacklog;
+	private long[] stateBacklogTimes;
+	private long stateBacklogCount;
+	private TelemetryEncoder telemetryEncoder;
+	private double[] stateValues;
+	private volatile boolean compactTelemetry;
 	private ControllerThread controllerThread;
 	private long previousTime;
 }
@@ -27,7 +27,7 @@ public class QuadcopterActivity extends Activity
         
         // In the "server IP" field, insert the last used IP address.
         SharedPreferences settings = getSharedPreferences(PREFS_NAME, 0);
-        String lastIP = settings.getString(PREFS_ID_LAST_IP, "192.168.0.8");
+        String lastIP = settings.getString(PREFS_ID_LAST_IP, ""); // Empty: discover the ground station.
         serverIpEditText.setText(lastIP);
 
         // Create the main controller.
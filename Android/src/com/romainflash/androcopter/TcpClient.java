@@ -4,8 +4,18 @@ import java.io.BufferedReader;
 import java.io.IOException;
 import java.io.InputStreamReader;
 import java.io.OutputStream;
+import java.net.DatagramPacket;
+import java.net.DatagramSocket;
+import java.net.InetAddress;
+import java.net.InetSocketAddress;
 import java.net.Socket;
+import java.net.SocketTimeoutException;
 import java.net.UnknownHostException;
+import java.nio.ByteBuffer;
+import java.security.SecureRandom;
+import java.util.LinkedList;
+import java.util.concurrent.atomic.AtomicReference;
+import java.util.concurrent.locks.ReentrantLock;
 
 import android.os.SystemClock;
 import android.util.Log;
@@ -13,6 +23,9 @@ import android.util.Log;
 public class TcpClient
 {
 	public static final int SERVER_PORT = 7444;
+	public static final int DISCOVERY_PORT = 7445; // Must match the ground station.
+	public static final int DISCOVERY_PROTOCOL_VERSION = 1;
+	public static final int DISCOVERY_TIMEOUT = 250; // In [ms].
 	public static final int MAX_SILENCE_PERIOD = 2000; // In [ms].
 	public static final long RECONNECT_DELAY = 100; // In [ms].
 	public static final int TX_BUFFER_SIZE = 10000;
@@ -22,6 +35,15 @@ public class TcpClient
 	public static final int TYPE_LOG = 2;
 	public static final int TYPE_CURRENT_STATE = 3;
 	public static final int TYPE_PHOTO = 4;
+	public static final int TYPE_PONG = 5;
+	public static final int TYPE_SESSION = 6;
+	public static final int TYPE_TELEMETRY_BACKLOG = 7;
+	public static final int TYPE_CHUNK = 8;
+	public static final int TYPE_COMPACT_STATE = 9;
+	
+	public static final int CHUNK_PAYLOAD_SIZE = 16384; // In [bytes].
+	public static final int CHUNK_HEADER_SIZE = 13; // Stream id, type, total size, offset.
+	public static final int MAX_UNFINISHED_TRANSFERS = 4;
 	
 	TcpClient(TcpMessageReceiver receiver)
 	{
@@ -29,7 +51,14 @@ public class TcpClient
 		
 		txHeaderBuffer = new byte[5];
 		
-		currentlySending = false;
+		// Identifies this run of the app, so the ground station can resume
+		// the session after a reconnection.
+		sessionToken = Long.toHexString(new SecureRandom().nextLong());
+		
+		pendingPriorityMessage = new AtomicReference<PendingMessage>();
+		
+		transfers = new LinkedList<Transfer>();
+		nextTransferId = 1;
 	}
 	
 	void start(String serverIp)
@@ -40,12 +69,22 @@ public class TcpClient
 			
 		connectThread = new ConnectThread(serverIp);
 		connectThread.start();
+		
+		// Start sending the large messages.
+		if(chunkSender == null || !chunkSender.isAlive())
+		{
+			chunkSender = new ChunkSender();
+			chunkSender.start();
+		}
 	}
 	
 	void stop()
 	{
 		if(connectThread != null)
 			connectThread.requestStop();
+		
+		if(chunkSender != null)
+			chunkSender.requestStop();
 	}
 	
 	private class ConnectThread extends Thread
@@ -53,6 +92,7 @@ public class TcpClient
 		public ConnectThread(String serverIp)
 		{
 			this.serverIp = serverIp;
+			sendLock = new ReentrantLock();
 		}
 		
 		public void run()
@@ -65,11 +105,39 @@ public class TcpClient
 				// Setup a UDP server socket.
 				if(socket == null || socket.isClosed())
 				{
+					Socket newSocket;
+					
 					try
 					{
-						socket = new Socket(serverIp, SERVER_PORT);
-						socket.setSoTimeout(0); // Inifinite time for reading.
-						socket.setTcpNoDelay(true);
+						// Without an address, ask the ground station on the LAN.
+						if(serverIp.trim().isEmpty())
+						{
+							InetSocketAddress server = discoverServer();
+							
+							if(server == null)
+								throw new UnknownHostException();
+							
+							newSocket = new Socket(server.getAddress(), server.getPort());
+						}
+						else
+							newSocket = new Socket(serverIp, SERVER_PORT);
+						
+						newSocket.setSoTimeout(0); // Inifinite time for reading.
+						newSocket.setTcpNoDelay(true);
+						
+						// The session token must be the first message, so
+						// no other message is sent before it.
+						sendLock.lock();
+						
+						try
+						{
+							socket = newSocket;
+							sendMessage(sessionToken.getBytes(), TYPE_SESSION);
+						}
+						finally
+						{
+							sendLock.unlock();
+						}
 						
 						tcpReceiver.onConnectionEstablished();
 						previouslyConnected = true;
@@ -137,31 +205,164 @@ public class TcpClient
 			}
 		}
 		
-		public synchronized void requestStop()
+		// Broadcasts a discovery query, and waits for the answer of a ground
+		// station.
+		// Query: "ANDROCOPTER_DISCOVER <version>\n".
+		// Answer: "ANDROCOPTER_GROUND <version> <tcp port> <capabilities> <name>\n".
+		// Returns the address of the first compatible station, or null.
+		private InetSocketAddress discoverServer()
 		{
-			again = false;
+			DatagramSocket udpSocket = null;
 			
-	    	if(socket != null)
-	    	{
-	    		try
+			try
+			{
+				udpSocket = new DatagramSocket();
+				udpSocket.setBroadcast(true);
+				udpSocket.setSoTimeout(DISCOVERY_TIMEOUT);
+				
+				byte[] query = ("ANDROCOPTER_DISCOVER " + DISCOVERY_PROTOCOL_VERSION + "\n").getBytes("US-ASCII");
+				udpSocket.send(new DatagramPacket(query, query.length,
+												  InetAddress.getByName("255.255.255.255"),
+												  DISCOVERY_PORT));
+				
+				byte[] answerBuffer = new byte[512];
+				
+				while(again)
 				{
-					socket.close();
-					socket = null;
+					DatagramPacket answer = new DatagramPacket(answerBuffer, answerBuffer.length);
+					udpSocket.receive(answer); // Throws when the timeout is elapsed.
+					
+					String[] words = new String(answer.getData(), 0, answer.getLength(), "US-ASCII").trim().split(" ");
+					
+					if(words.length < 4 || !words[0].equals("ANDROCOPTER_GROUND") ||
+					   !words[1].equals(Integer.toString(DISCOVERY_PROTOCOL_VERSION)))
+						continue; // Other message, or incompatible station.
+					
+					int port = Integer.parseInt(words[2]);
+					Log.i("AndroCopter", "Ground station found at " + answer.getAddress().getHostAddress() + ":" + port + ".");
+					return new InetSocketAddress(answer.getAddress(), port);
 				}
-	    		catch (IOException e)
+			}
+			catch (SocketTimeoutException e)
+			{
+				Log.w("AndroCopter", "No ground station found on the network.");
+			}
+			catch (NumberFormatException e)
+			{
+				Log.w("AndroCopter", "Invalid answer of a ground station.");
+			}
+			catch (IOException e)
+			{
+				Log.w("AndroCopter", "Can't send the discovery query.");
+			}
+			finally
+			{
+				if(udpSocket != null)
+					udpSocket.close();
+			}
+			
+			return null;
+		}
+		
+		public void requestStop()
+		{
+			again = false;
+			
+			sendLock.lock();
+			
+			try
+			{
+				if(socket != null)
 				{
-					e.printStackTrace();
+					try
+					{
+						socket.close();
+						socket = null;
+					}
+					catch (IOException e)
+					{
+						e.printStackTrace();
+					}
 				}
-	    	}
+			}
+			finally
+			{
+				sendLock.unlock();
+			}
+		}
+		
+		// Writes a message, waiting for the message being written, if any
+		// (e.g. a chunk).
+		public void sendMessage(byte[] message, int type)
+		{
+			sendLock.lock();
+			
+			try
+			{
+				if(socket == null || !socket.isConnected())
+					return;
+				
+				writeMessage(message, type);
+			}
+			finally
+			{
+				sendLock.unlock();
+			}
+			
+			// Write the priority message queued meanwhile, if any, before
+			// the next chunk of a large message.
+			writePendingMessage();
 		}
 		
-		public synchronized void sendMessage(byte[] message, int type)
+		// Writes a message if no other one is being written, without
+		// waiting. Returns false otherwise.
+		public boolean trySendMessage(byte[] message, int type)
 		{
-			if(socket == null || !socket.isConnected())
-				return;
+			if(!sendLock.tryLock())
+				return false;
 			
-			currentlySending = true;
+			try
+			{
+				// This message is newer than the pending one.
+				pendingPriorityMessage.set(null);
+				
+				if(socket != null && socket.isConnected())
+					writeMessage(message, type);
+			}
+			finally
+			{
+				sendLock.unlock();
+			}
 			
+			return true;
+		}
+		
+		// Writes the pending priority message, unless another message is
+		// being written: its writer will write it after, as the pending
+		// message is checked again after each unlock.
+		public void writePendingMessage()
+		{
+			while(pendingPriorityMessage.get() != null)
+			{
+				if(!sendLock.tryLock())
+					return;
+				
+				try
+				{
+					PendingMessage pending = pendingPriorityMessage.getAndSet(null);
+					
+					if(pending != null && socket != null && socket.isConnected())
+						writeMessage(pending.message, pending.type);
+				}
+				finally
+				{
+					sendLock.unlock();
+				}
+			}
+		}
+		
+		private void writeMessage(byte[] message, int type)
+		{
 			int messageSize = message.length;
 			int messageWithTypeSize = messageSize + 1;
 			
@@ -178,8 +379,6 @@ public class TcpClient
 
 			sendRawBytes(txHeaderBuffer); // Send the message header.
 			sendRawBytes(message); // Send the actual content of the message.
-			
-			currentlySending = false;
 		}
 		
 		public boolean isConnected()
@@ -187,7 +386,7 @@ public class TcpClient
 			if(socket == null)
 				return false;
 			else
-				return socket.isConnected();
+				return socket.isConnected() && !socket.isClosed();
 		}
 		
 		private void sendRawBytes(byte[] bytes)
@@ -208,6 +407,7 @@ public class TcpClient
 		private volatile boolean again, previouslyConnected;
 		private Socket socket;
 		private String serverIp;
+		private ReentrantLock sendLock; // Held while writing to the socket.
 	}
 	
 	public interface TcpMessageReceiver
@@ -225,8 +425,171 @@ public class TcpClient
 	
 	public void sendMessageNowOrSkip(byte[] message, int type)
 	{
-		if(!currentlySending && (connectThread != null))
-			connectThread.sendMessage(message, type);
+		if(connectThread == null)
+			return;
+		
+		// If another message is being written (e.g. a chunk), this one is
+		// written just after it, so the caller never waits. A newer one
+		// replaces it. The writer may have finished meanwhile, so try to
+		// write it again.
+		if(!connectThread.trySendMessage(message, type))
+		{
+			pendingPriorityMessage.set(new PendingMessage(message, type));
+			connectThread.writePendingMessage();
+		}
+	}
+	
+	// Returns true if a message given to sendMessageNowOrSkip() is still
+	// waiting to be written: the next one will replace it.
+	public boolean isPriorityMessagePending()
+	{
+		return pendingPriorityMessage.get() != null;
+	}
+	
+	// Sends a large message (photo, log...) in chunks, so the other messages
+	// are not held back during the whole transfer. The PC acknowledges the
+	// complete transfers (finishTransfer()), and can ask to resend the end of
+	// a transfer (resumeTransfer()), e.g. after a reconnection.
+	public void sendLargeMessage(byte[] message, int type)
+	{
+		synchronized(transfers)
+		{
+			// Forget the oldest transfer, if the PC never acknowledged it.
+			if(transfers.size() >= MAX_UNFINISHED_TRANSFERS)
+				transfers.removeFirst();
+			
+			transfers.add(new Transfer(nextTransferId++, type, message));
+			transfers.notifyAll();
+		}
+	}
+	
+	public void resumeTransfer(int transferId, int offset)
+	{
+		synchronized(transfers)
+		{
+			for(Transfer transfer : transfers)
+			{
+				if(transfer.id == transferId && offset <= transfer.data.length)
+					transfer.nextOffset = offset;
+			}
+			
+			transfers.notifyAll();
+		}
+	}
+	
+	public void finishTransfer(int transferId)
+	{
+		synchronized(transfers)
+		{
+			for(Transfer transfer : transfers)
+			{
+				if(transfer.id == transferId)
+				{
+					transfers.remove(transfer);
+					break;
+				}
+			}
+		}
+	}
+	
+	private class ChunkSender extends Thread
+	{
+		public void run()
+		{
+			again = true;
+			
+			while(again)
+			{
+				// Wait for the connection, the chunks would be lost.
+				if(!isConnected())
+				{
+					SystemClock.sleep(RECONNECT_DELAY);
+					continue;
+				}
+				
+				// Take the next chunk of the oldest unfinished transfer.
+				byte[] chunk = null;
+				
+				synchronized(transfers)
+				{
+					for(Transfer transfer : transfers)
+					{
+						if(transfer.nextOffset < transfer.data.length)
+						{
+							chunk = transfer.makeNextChunk();
+							break;
+						}
+					}
+					
+					if(chunk == null)
+					{
+						try
+						{
+							transfers.wait();
+						}
+						catch(InterruptedException e)
+						{
+							// Nothing to do, "again" tells if we should stop.
+						}
+						
+						continue;
+					}
+				}
+				
+				sendMessage(chunk, TYPE_CHUNK);
+			}
+		}
+		
+		public void requestStop()
+		{
+			again = false;
+			interrupt();
+		}
+		
+		private volatile boolean again;
+	}
+	
+	private class Transfer
+	{
+		public Transfer(int id, int type, byte[] data)
+		{
+			this.id = id;
+			this.type = type;
+			this.data = data;
+			nextOffset = 0;
+		}
+		
+		// Header (big-endian): transfer id, type of the message, total size,
+		// offset of the chunk. Then the piece of the message.
+		public byte[] makeNextChunk()
+		{
+			int size = Math.min(CHUNK_PAYLOAD_SIZE, data.length - nextOffset);
+			ByteBuffer chunk = ByteBuffer.allocate(CHUNK_HEADER_SIZE + size);
+			chunk.putInt(id);
+			chunk.put((byte)type);
+			chunk.putInt(data.length);
+			chunk.putInt(nextOffset);
+			chunk.put(data, nextOffset, size);
+			
+			nextOffset += size;
+			
+			return chunk.array();
+		}
+		
+		public int id, type, nextOffset;
+		public byte[] data;
+	}
+	
+	private class PendingMessage
+	{
+		public PendingMessage(byte[] message, int type)
+		{
+			this.message = message;
+			this.type = type;
+		}
+		
+		public byte[] message;
+		public int type;
 	}
 	
 	public boolean isConnected()
@@ -238,7 +601,11 @@ public class TcpClient
 	}
 
 	private byte[] txHeaderBuffer;
+	private String sessionToken;
 	private TcpMessageReceiver tcpReceiver;
 	private ConnectThread connectThread;
-	private volatile boolean currentlySending;
+	private AtomicReference<PendingMessage> pendingPriorityMessage;
+	private LinkedList<Transfer> transfers;
+	private int nextTransferId;
+	private ChunkSender chunkSender;
 }
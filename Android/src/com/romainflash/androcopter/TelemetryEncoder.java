@@ -0,0 +1,129 @@
+package com.romainflash.androcopter;
+
+import java.util.Arrays;
+
+// Encodes the states sent to the PC as compact binary frames
+// (TYPE_COMPACT_STATE), instead of text. Must match telemetrycodec.cpp on the
+// PC side.
+//
+// A frame is a header (flags, sequence number), then a varint per channel:
+// the value converted to fixed-point (see CHANNEL_SCALES), or for the
+// frames between the keyframes, its difference with the previous frame.
+// Most channels move slowly between two states, so most differences fit in a
+// single byte.
+public class TelemetryEncoder
+{
+	public static final int CHANNELS_COUNT = 18; // The two last ones (position) are optional.
+	public static final int MANDATORY_CHANNELS_COUNT = 16;
+	public static final int MAX_FRAME_SIZE = 2 + CHANNELS_COUNT*10;
+	public static final int KEYFRAME_INTERVAL = 50;
+	public static final int FLAG_KEYFRAME = 0x01;
+	public static final int FLAG_POSITION = 0x02;
+	
+	// Fixed-point scale of each channel, in the order of the CURRENT_STATE
+	// message.
+	public static final double[] CHANNEL_SCALES =
+	{
+		1.0, // Phone time [ms].
+		100.0, 100.0, 100.0, // Yaw, target and regulator output [1/100 deg].
+		100.0, 100.0, 100.0, // Pitch.
+		100.0, 100.0, 100.0, // Roll.
+		1000.0, // Battery voltage [mV].
+		10.0, // Temperature [1/10 deg C].
+		1.0, // Regulators state.
+		100.0, 100.0, 100.0, // Altitude, target and regulator output [cm].
+		100.0, 100.0 // Position estimates [cm].
+	};
+	
+	public TelemetryEncoder()
+	{
+		reference = new long[CHANNELS_COUNT];
+		buffer = new byte[MAX_FRAME_SIZE];
+		sequence = 0;
+		framesSinceKeyframe = 0;
+		keyframeRequested = true;
+	}
+	
+	// Makes the next frame a keyframe, e.g. for a new connection, or because
+	// the PC will not receive the previous frame. Can be called from any
+	// thread.
+	public void requestKeyframe()
+	{
+		keyframeRequested = true;
+	}
+	
+	// Encodes a state. The position estimates are only sent if hasPosition
+	// is true.
+	public byte[] encode(double[] values, boolean hasPosition)
+	{
+		boolean keyframe = keyframeRequested || framesSinceKeyframe >= KEYFRAME_INTERVAL;
+		int channelsCount = hasPosition ? CHANNELS_COUNT : MANDATORY_CHANNELS_COUNT;
+		
+		// Cleared before encoding, so a request made meanwhile is kept for
+		// the next frame.
+		if(keyframe)
+		{
+			keyframeRequested = false;
+			framesSinceKeyframe = 0;
+			
+			// A keyframe without the position resets its reference, as the
+			// PC does.
+			if(!hasPosition)
+			{
+				for(int i=MANDATORY_CHANNELS_COUNT; i<CHANNELS_COUNT; i++)
+					reference[i] = 0;
+			}
+		}
+		
+		sequence = (sequence + 1) & 0xff;
+		buffer[0] = (byte)((keyframe ? FLAG_KEYFRAME : 0) | (hasPosition ? FLAG_POSITION : 0));
+		buffer[1] = (byte)sequence;
+		int size = 2;
+		
+		for(int i=0; i<channelsCount; i++)
+		{
+			long quantized = quantize(values[i], i);
+			size = writeVarint(keyframe ? quantized : quantized - reference[i], size);
+			reference[i] = quantized;
+		}
+		
+		framesSinceKeyframe++;
+		
+		return Arrays.copyOf(buffer, size);
+	}
+	
+	private static long quantize(double value, int channel)
+	{
+		double scaled = value * CHANNEL_SCALES[channel];
+		
+		if(Double.isNaN(scaled))
+			return 0;
+		else
+			return (long)Math.floor(Math.max(-MAX_QUANTIZED_VALUE, Math.min(MAX_QUANTIZED_VALUE, scaled)) + 0.5);
+	}
+	
+	// Writes a zigzag-encoded varint (7 bits per byte, least significant
+	// first), and returns the new size of the frame.
+	private int writeVarint(long value, int size)
+	{
+		long zigzag = (value << 1) ^ (value >> 63);
+		
+		while((zigzag & ~0x7fL) != 0)
+		{
+			buffer[size++] = (byte)((zigzag & 0x7f) | 0x80);
+			zigzag >>>= 7;
+		}
+		
+		buffer[size++] = (byte)zigzag;
+		
+		return size;
+	}
+	
+	private static final double MAX_QUANTIZED_VALUE = 1e15;
+	
+	private long[] reference;
+	private byte[] buffer;
+	private int sequence;
+	private int framesSinceKeyframe;
+	private volatile boolean keyframeRequested;
+}
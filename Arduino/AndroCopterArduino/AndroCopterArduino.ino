@@ -6,13 +6,14 @@
 // at http://developer.android.com/tools/adk/index.html
 
 #include <Wire.h>
-#include <Servo.h>
 
 #include <Max3421e.h>
 #include <Usb.h>
 #include <AndroidAccessory.h>
 
 const int BATTERY_LEVEL_PIN = A0;
+// The PWM pins are the outputs of the timers generating the pulses (see
+// ArduinoHal::startPulseTimer()), they can not be changed alone.
 const int NW_PWM_PIN = 3;
 const int NW_GND_PIN = 4;
 const int NE_PWM_PIN = 6;
@@ -22,16 +23,11 @@ const int SE_GND_PIN = 9;
 const int SW_PWM_PIN = 11;
 const int SW_GND_PIN = 12;
 
-const int PULSE_MIN = 1000; // Min time of a pulse sent to an ESC [us].
-const int PULSE_MAX = 2000; // Max time of a pulse sent to an ESC[us].
-const unsigned long MAX_TIME_WITHOUT_RECEPTION = 500; // If no data is received during this time, stop all motors [ms].
-const unsigned long PULSES_PERIOD = 2222; // Period of the main loop (450 Hz) [us].
-const unsigned int BATT_VOLT_TX_PERIOD = 500; // Sending period of the battery voltage [ms].
+#include "FlightHal.h"
+#include "FlightLoop.h"
+#include "PulseStage.h"
 
-Servo nwMotor, neMotor, seMotor, swMotor;
-int nwPower, nePower, sePower, swPower; // Impulses duration.
-unsigned long currentTimeMs, lastRxTimeMs, lastTxTimeMs, lastPulseTimeUs, currentPulseTimeUs;
-uint8_t rxBuffer[4];
+const uint16_t TIMER_TICKS_PER_US = 2; // 16 MHz clock, divided by 8.
 
 AndroidAccessory acc("Romain Baud",
 		     "AndroCopterADK",
@@ -40,6 +36,88 @@ AndroidAccessory acc("Romain Baud",
 		     "randroprog.blogspot.com",
 		     "0000000012345678");
 
+// Output stage called by the timer interrupt.
+PulseStage *pulseStage = 0;
+
+// Access to the hardware of the ADK board, for the flight loop.
+class ArduinoHal : public FlightHal
+{
+public:
+  uint32_t getTimeMs() { return millis(); }
+  uint32_t getTimeUs() { return micros(); }
+
+  // The pulses are generated by the timers 1, 3 and 4 in fast PWM mode, with
+  // a period of PULSES_PERIOD: the output pin of a channel is set at the
+  // start of the period, and cleared when the counter reaches the compare
+  // register (OCRnx). The compare registers are double-buffered by the
+  // hardware, and applied at the start of the next period, so a pulse is
+  // never cut. The overflow interrupt of the timer 1 calls the output stage.
+  void startPulseTimer(PulseStage &stage)
+  {
+    pulseStage = &stage;
+
+    pulseRegisters[NW_MOTOR] = &OCR3C; // Pin 3.
+    pulseRegisters[NE_MOTOR] = &OCR4A; // Pin 6.
+    pulseRegisters[SE_MOTOR] = &OCR4C; // Pin 8.
+    pulseRegisters[SW_MOTOR] = &OCR1A; // Pin 11.
+
+    pinMode(NW_PWM_PIN, OUTPUT);
+    pinMode(NE_PWM_PIN, OUTPUT);
+    pinMode(SE_PWM_PIN, OUTPUT);
+    pinMode(SW_PWM_PIN, OUTPUT);
+
+    // Halt the prescaler while configuring, so the timers start together.
+    GTCCR = (1 << TSM) | (1 << PSRSYNC);
+
+    const uint16_t top = PULSES_PERIOD * TIMER_TICKS_PER_US - 1;
+
+    // Fast PWM with ICRn as TOP (mode 14), non-inverting outputs, clock/8.
+    TCCR1A = (1 << COM1A1) | (1 << WGM11);
+    TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS11);
+    TCCR3A = (1 << COM3C1) | (1 << WGM31);
+    TCCR3B = (1 << WGM33) | (1 << WGM32) | (1 << CS31);
+    TCCR4A = (1 << COM4A1) | (1 << COM4C1) | (1 << WGM41);
+    TCCR4B = (1 << WGM43) | (1 << WGM42) | (1 << CS41);
+    ICR1 = top;
+    ICR3 = top;
+    ICR4 = top;
+    TCNT1 = 0;
+    TCNT3 = 0;
+    TCNT4 = 0;
+
+    for(int i=0; i<MOTORS_COUNT; i++)
+      *pulseRegisters[i] = PULSE_MIN * TIMER_TICKS_PER_US;
+
+    TIMSK1 = (1 << TOIE1);
+    GTCCR = 0; // Start the timers.
+  }
+
+  void writeMotorPulse(int motor, int pulseUs)
+  {
+    // Called from the interrupt, so the 16 bits register access can not be
+    // interrupted.
+    *pulseRegisters[motor] = pulseUs * TIMER_TICKS_PER_US;
+  }
+
+  bool isPhoneConnected() { return acc.isConnected(); }
+  int readPhone(uint8_t *buffer, int size) { return acc.read(buffer, size, 4); }
+  void writePhone(const uint8_t *buffer, int size) { acc.write((uint8_t*)buffer, size); }
+  uint16_t readBatteryLevel() { return analogRead(BATTERY_LEVEL_PIN); }
+
+private:
+  volatile uint16_t *pulseRegisters[MOTORS_COUNT];
+};
+
+ArduinoHal hal;
+FlightLoop flightLoop(hal);
+
+// Start of a period of the pulses.
+ISR(TIMER1_OVF_vect)
+{
+  if(pulseStage != 0)
+    pulseStage->onPeriod();
+}
+
 void setup()
 {
   // Setup the serial communication with the computer (debug).
@@ -49,22 +127,7 @@ void setup()
   // Start the Android accessory object.
   acc.powerOn();
   
-  // Variables init.
-  currentTimeMs = millis();
-  lastRxTimeMs = currentTimeMs;
-  lastTxTimeMs = currentTimeMs;
-  lastPulseTimeUs = micros();
-  
-  nwPower = PULSE_MIN;
-  nePower = PULSE_MIN;
-  sePower = PULSE_MIN;
-  swPower = PULSE_MIN;
-  
-  // Associate the Servo objects to the pins.
-  nwMotor.attach(NW_PWM_PIN);
-  neMotor.attach(NE_PWM_PIN);
-  seMotor.attach(SE_PWM_PIN);
-  swMotor.attach(SW_PWM_PIN);
+  flightLoop.begin();
   
   // Set the GND pins for each ESC.
   pinMode(NW_GND_PIN, OUTPUT); digitalWrite(NW_GND_PIN, LOW);
@@ -75,61 +138,7 @@ void setup()
 
 void loop()
 {
-  currentTimeMs = millis();
-  
-  // Check if the phone is connected.
-  if (acc.isConnected()) // Yes, try to read it.
-  {
-    int len = acc.read(rxBuffer, sizeof(rxBuffer), 4);
-
-    if(len == 4)
-    {
-      // Update the motor signals.
-      // The received powers for the motors (data[]) are between 0 and 255, so
-	  // a transformation to the ESC range (1000-2000 us) is performed.
-      nwPower = map(rxBuffer[0], 0, 255, PULSE_MIN, PULSE_MAX);
-      nePower = map(rxBuffer[1], 0, 255, PULSE_MIN, PULSE_MAX);
-      sePower = map(rxBuffer[2], 0, 255, PULSE_MIN, PULSE_MAX);
-      swPower = map(rxBuffer[3], 0, 255, PULSE_MIN, PULSE_MAX);
-    
-      lastRxTimeMs = currentTimeMs;
-    }
-  }
-  else // Phone disconnected: emergency stop!
-  {
-    nwPower = PULSE_MIN;
-    nePower = PULSE_MIN;
-    sePower = PULSE_MIN;
-    swPower = PULSE_MIN;
-  }
-  
-  // If the phone does not send updates for some time, this mean
-  // something could have go wrong (maybe the app crashed...), and
-  // all motors must be stopped.
-  if(currentTimeMs - lastRxTimeMs > MAX_TIME_WITHOUT_RECEPTION)
-  {
-    nwPower = PULSE_MIN;
-    nePower = PULSE_MIN;
-    sePower = PULSE_MIN;
-    swPower = PULSE_MIN;
-  }
-  
-  // Send a pulse to each ESC.
-  nwMotor.writeMicroseconds(nwPower);
-  neMotor.writeMicroseconds(nePower);
-  seMotor.writeMicroseconds(sePower);
-  swMotor.writeMicroseconds(swPower);
-  
-  // Sometimes, send the battery level to the phone.
-  if(currentTimeMs - lastTxTimeMs >= BATT_VOLT_TX_PERIOD)
-  {
-    lastTxTimeMs = currentTimeMs;
-    uint16_t batteryLevel = analogRead(BATTERY_LEVEL_PIN);
-    acc.write((uint8_t*)&batteryLevel, 2);
-  }
-  
-  // Delay to get a 450 Hz main loop.
-  currentPulseTimeUs = micros();
-  delayMicroseconds(PULSES_PERIOD - (currentPulseTimeUs - lastPulseTimeUs));
-  lastPulseTimeUs = currentPulseTimeUs;
-}
+  // Receive the motor powers, and update the pulses sent to the ESCs (see
+  // FlightLoop). The pulses are timed by the timers, the loop does not wait.
+  flightLoop.step();
+}
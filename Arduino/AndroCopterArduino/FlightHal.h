@@ -0,0 +1,48 @@
+// Hardware abstraction of the AndroCopter Arduino flight loop.
+// Romain Baud, 2026.
+
+// The flight loop (FlightLoop) only accesses the hardware through this
+// interface, so it can run on the ADK board (ArduinoHal, in the sketch), or
+// on a computer against a simulated hardware (AndroCopterHost).
+
+#ifndef FLIGHT_HAL_H
+#define FLIGHT_HAL_H
+
+#include <stdint.h>
+
+class PulseStage;
+
+class FlightHal
+{
+public:
+  virtual ~FlightHal() {}
+
+  // Time since the start [ms]. Wraps around after 49 days, as millis().
+  virtual uint32_t getTimeMs() = 0;
+
+  // Time since the start [us]. Wraps around after 71 minutes, as micros().
+  virtual uint32_t getTimeUs() = 0;
+
+  // Returns true if the phone is connected.
+  virtual bool isPhoneConnected() = 0;
+
+  // Reads the data sent by the phone, without waiting if there is none.
+  // Returns the number of bytes read.
+  virtual int readPhone(uint8_t *buffer, int size) = 0;
+
+  // Sends data to the phone.
+  virtual void writePhone(const uint8_t *buffer, int size) = 0;
+
+  // Starts the timers generating the ESC pulses. At the start of each
+  // PULSES_PERIOD, the timer interrupt calls stage.onPeriod().
+  virtual void startPulseTimer(PulseStage &stage) = 0;
+
+  // Sets the pulse of an ESC (see Motor), from the next period [us]. Only
+  // called by the timer interrupt.
+  virtual void writeMotorPulse(int motor, int pulseUs) = 0;
+
+  // Reads the battery voltage (raw analog value, 0-1023).
+  virtual uint16_t readBatteryLevel() = 0;
+};
+
+#endif
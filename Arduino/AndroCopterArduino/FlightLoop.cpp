@@ -0,0 +1,72 @@
+#include "FlightLoop.h"
+
+FlightLoop::FlightLoop(FlightHal &hal) : hal(hal), pulseStage(hal)
+{
+}
+
+void FlightLoop::begin()
+{
+  uint32_t currentTimeMs = hal.getTimeMs();
+  lastRxTimeMs = currentTimeMs;
+  lastTxTimeMs = currentTimeMs;
+
+  stopMotors();
+  pulseStage.setPulses(powers);
+  hal.startPulseTimer(pulseStage);
+}
+
+void FlightLoop::step()
+{
+  uint32_t currentTimeMs = hal.getTimeMs();
+
+  // Check if the phone is connected.
+  if(hal.isPhoneConnected()) // Yes, try to read it.
+  {
+    int len = hal.readPhone(rxBuffer, sizeof(rxBuffer));
+
+    // Decode the received frames. Only the last complete one is used; a
+    // frame split between two reads is completed at the next iteration.
+    for(int i=0; i<len; i++)
+    {
+      if(decoder.push(rxBuffer[i]))
+      {
+        // Update the motor signals. The commands are already in the ESC
+        // range, relative to PULSE_MIN.
+        for(int m=0; m<MOTORS_COUNT; m++)
+          powers[m] = PULSE_MIN + decoder.getCommand(m);
+
+        lastRxTimeMs = currentTimeMs;
+      }
+    }
+  }
+  else // Phone disconnected: emergency stop!
+    stopMotors();
+
+  // If the phone does not send updates for some time, this mean
+  // something could have go wrong (maybe the app crashed...), and
+  // all motors must be stopped.
+  if(currentTimeMs - lastRxTimeMs > MAX_TIME_WITHOUT_RECEPTION)
+    stopMotors();
+
+  // Update the pulses sent to the ESCs.
+  pulseStage.setPulses(powers);
+
+  // Sometimes, send the battery level to the phone.
+  if(currentTimeMs - lastTxTimeMs >= BATT_VOLT_TX_PERIOD)
+  {
+    lastTxTimeMs = currentTimeMs;
+    uint16_t batteryLevel = hal.readBatteryLevel();
+    hal.writePhone((const uint8_t*)&batteryLevel, 2);
+  }
+}
+
+int FlightLoop::getMotorPower(int motor) const
+{
+  return powers[motor];
+}
+
+void FlightLoop::stopMotors()
+{
+  for(int i=0; i<MOTORS_COUNT; i++)
+    powers[i] = PULSE_MIN;
+}
@@ -0,0 +1,50 @@
+// Flight loop of the AndroCopter Arduino board, independent of the hardware.
+// Romain Baud, 2026.
+
+// The loop receives the motor commands from the phone (see MotorProtocol),
+// gives the pulses to send to the ESCs to the output stage (see PulseStage),
+// stops the motors if the phone is silent for too long, and sometimes sends
+// the battery level to the phone. It only handles these I/O, as fast as it
+// can: the pulses are timed by the output stage.
+
+#ifndef FLIGHT_LOOP_H
+#define FLIGHT_LOOP_H
+
+#include "FlightHal.h"
+#include "MotorProtocol.h"
+#include "PulseStage.h"
+
+const uint32_t MAX_TIME_WITHOUT_RECEPTION = 500; // If no data is received during this time, stop all motors [ms].
+const uint32_t BATT_VOLT_TX_PERIOD = 500; // Sending period of the battery voltage [ms].
+const int RX_BUFFER_SIZE = 64; // Max size of a read from the phone (USB packet) [bytes].
+
+class FlightLoop
+{
+public:
+  FlightLoop(FlightHal &hal);
+
+  // Initializes the loop, with the motors stopped, and starts the pulses.
+  void begin();
+
+  // Runs one iteration of the loop.
+  void step();
+
+  // Returns the pulse given to the output stage for a motor [us].
+  int getMotorPower(int motor) const;
+
+  // Returns the decoder of the received commands, for its counters.
+  const MotorFrameDecoder& getDecoder() const { return decoder; }
+
+private:
+  // Stops all the motors.
+  void stopMotors();
+
+  FlightHal &hal;
+  int powers[MOTORS_COUNT]; // Impulses duration.
+  uint32_t lastRxTimeMs, lastTxTimeMs;
+  uint8_t rxBuffer[RX_BUFFER_SIZE];
+  MotorFrameDecoder decoder;
+  PulseStage pulseStage;
+};
+
+#endif
@@ -0,0 +1,81 @@
+// Protocol of the motor commands sent by the phone to the ADK board.
+// Romain Baud, 2026.
+
+// Each command is a frame of MOTOR_FRAME_SIZE bytes:
+// - MOTOR_FRAME_SYNC.
+// - sequence number, incremented by the phone for each frame.
+// - for each motor (see Motor), the pulse to send minus PULSE_MIN, between 0
+//   and MOTOR_COMMAND_MAX [us] (16 bits, little-endian).
+// - CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) of the previous
+//   bytes, sync byte excluded (16 bits, little-endian).
+//
+// The decoder receives the bytes as they come, without allocating memory.
+// If bytes are lost, or if a frame is corrupted, its CRC is wrong: the
+// decoder then looks for the next sync byte in the received bytes, so it
+// resynchronizes within a frame.
+
+#ifndef MOTOR_PROTOCOL_H
+#define MOTOR_PROTOCOL_H
+
+#include <stdint.h>
+
+// Motors, in the order of the commands sent by the phone.
+enum Motor
+{
+  NW_MOTOR = 0,
+  NE_MOTOR,
+  SE_MOTOR,
+  SW_MOTOR,
+  MOTORS_COUNT
+};
+
+const int PULSE_MIN = 1000; // Min time of a pulse sent to an ESC [us].
+const int PULSE_MAX = 2000; // Max time of a pulse sent to an ESC[us].
+
+const uint8_t MOTOR_FRAME_SYNC = 0xA5; // First byte of a frame.
+const int MOTOR_FRAME_SIZE = 2 + 2 * MOTORS_COUNT + 2; // Size of a frame [bytes].
+const uint16_t MOTOR_COMMAND_MAX = PULSE_MAX - PULSE_MIN; // Max command of a motor [us].
+
+// Computes the CRC of a frame.
+uint16_t computeMotorFrameCrc(const uint8_t *data, int size);
+
+// Creates the frame of a motor command. The commands are saturated to
+// MOTOR_COMMAND_MAX.
+void encodeMotorFrame(uint8_t sequence, const uint16_t *commands, uint8_t *frame);
+
+class MotorFrameDecoder
+{
+public:
+  MotorFrameDecoder();
+
+  // Adds a received byte.
+  // Returns true if it completes a valid frame, available with
+  // getCommand() and getSequence() until the next call.
+  bool push(uint8_t byte);
+
+  // Command of a motor of the last valid frame (see Motor) [us].
+  uint16_t getCommand(int motor) const { return commands[motor]; }
+
+  // Sequence number of the last valid frame.
+  uint8_t getSequence() const { return sequence; }
+
+  // Counters, since the start.
+  uint32_t getFramesCount() const { return framesCount; } // Valid frames.
+  uint32_t getBadFramesCount() const { return badFramesCount; } // Wrong CRC or command.
+  uint32_t getSkippedBytesCount() const { return skippedBytesCount; } // Bytes outside of a frame.
+  uint32_t getLostFramesCount() const { return lostFramesCount; } // Gaps in the sequence numbers.
+
+private:
+  // Drops the first byte of the buffer, and everything until the next sync
+  // byte.
+  void resynchronize();
+
+  uint8_t buffer[MOTOR_FRAME_SIZE];
+  int bufferSize;
+  uint16_t commands[MOTORS_COUNT];
+  uint8_t sequence;
+  bool hasSequence;
+  uint32_t framesCount, badFramesCount, skippedBytesCount, lostFramesCount;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "PulseStage.h"
+
+// Number of periods without update after which the motors are stopped.
+static const uint16_t MAX_STALLED_PERIODS = MAX_LOOP_STALL * 1000 / PULSES_PERIOD;
+
+PulseStage::PulseStage(FlightHal &hal) : hal(hal)
+{
+  for(int b=0; b<2; b++)
+  {
+    for(int i=0; i<MOTORS_COUNT; i++)
+      buffers[b][i] = PULSE_MIN;
+  }
+
+  readBuffer = 0;
+  updated = false;
+  stalledPeriods = 0;
+}
+
+void PulseStage::setPulses(const int *pulses)
+{
+  // Fill the buffer not read by the interrupt, then swap. Both are
+  // volatile, so the compiler keeps the writes in this order.
+  uint8_t writeBuffer = 1 - readBuffer;
+
+  for(int i=0; i<MOTORS_COUNT; i++)
+    buffers[writeBuffer][i] = pulses[i];
+
+  readBuffer = writeBuffer;
+  updated = true;
+}
+
+void PulseStage::onPeriod()
+{
+  if(updated)
+  {
+    updated = false;
+    stalledPeriods = 0;
+  }
+  else if(stalledPeriods < MAX_STALLED_PERIODS)
+    stalledPeriods++;
+
+  bool stalled = (stalledPeriods >= MAX_STALLED_PERIODS);
+
+  for(int i=0; i<MOTORS_COUNT; i++)
+    hal.writeMotorPulse(i, stalled ? PULSE_MIN : buffers[readBuffer][i]);
+}
@@ -0,0 +1,47 @@
+// Output stage of the ESC pulses, driven by a hardware timer.
+// Romain Baud, 2026.
+
+// The pulses are generated by hardware timers (see ArduinoHal), so their
+// period does not depend on the main loop. At the start of each period, the
+// timer interrupt calls onPeriod(), which gives the latest pulses to the
+// timers; they are applied from the next period.
+//
+// The main loop and the interrupt exchange the pulses through two buffers:
+// the main loop fills the one not read by the interrupt, then swaps them.
+// The interrupt can not be preempted by the main loop, so it always reads a
+// complete set of pulses.
+//
+// If the main loop does not update the pulses for MAX_LOOP_STALL (USB
+// library stuck...), the interrupt stops the motors by itself.
+
+#ifndef PULSE_STAGE_H
+#define PULSE_STAGE_H
+
+#include "FlightHal.h"
+#include "MotorProtocol.h"
+
+const uint32_t PULSES_PERIOD = 2222; // Period of the pulses sent to the ESCs (450 Hz) [us].
+const uint32_t MAX_LOOP_STALL = 500; // If the main loop does not update the pulses during this time, stop all motors [ms].
+
+class PulseStage
+{
+public:
+  PulseStage(FlightHal &hal);
+
+  // Sets the pulses to send to the ESCs (see Motor), from the next period.
+  // Only called by the main loop.
+  void setPulses(const int *pulses);
+
+  // Gives the latest pulses to the hardware. Only called by the timer
+  // interrupt, at the start of each period.
+  void onPeriod();
+
+private:
+  FlightHal &hal;
+  volatile int buffers[2][MOTORS_COUNT]; // Impulses duration [us].
+  volatile uint8_t readBuffer; // Buffer read by the interrupt.
+  volatile bool updated; // Set by the main loop, cleared by the interrupt.
+  uint16_t stalledPeriods; // Only used by the interrupt.
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "MockHal.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DurationStats::add(uint64_t duration)
+{
+  if(histogram.empty())
+    histogram.resize(HISTOGRAM_SIZE);
+
+  histogram[duration < HISTOGRAM_SIZE ? duration : HISTOGRAM_SIZE - 1]++;
+  count++;
+  sum += duration;
+  sumSquares += (double)duration * duration;
+
+  if(duration < min)
+    min = duration;
+  if(duration > max)
+    max = duration;
+}
+
+double DurationStats::getMean() const
+{
+  return count > 0 ? sum / count : 0.0;
+}
+
+double DurationStats::getStdDev() const
+{
+  if(count == 0)
+    return 0.0;
+
+  double mean = getMean();
+  return std::sqrt(std::max(0.0, sumSquares / count - mean * mean));
+}
+
+uint64_t DurationStats::getPercentile(double fraction) const
+{
+  uint64_t rank = (uint64_t)std::ceil(fraction * count);
+  uint64_t cumulated = 0;
+
+  for(uint64_t i=0; i<histogram.size(); i++)
+  {
+    cumulated += histogram[i];
+
+    if(cumulated >= rank && cumulated > 0)
+      return i;
+  }
+
+  return 0;
+}
+
+MockHal::MockHal(unsigned int seed) : random(seed)
+{
+  nowUs = 0;
+  nextPacketTimeUs = PHONE_TX_PERIOD_US;
+  outageEndTimeUs = 0;
+  connected = true;
+  silent = false;
+  txSequence = 0;
+
+  pulseStage = 0;
+  nextPeriodUs = 0;
+  inInterrupt = false;
+
+  for(int i=0; i<MOTORS_COUNT; i++)
+    writtenPulses[i] = PULSE_MIN;
+
+  lastPeriodUs = 0;
+  lastIterationUs = 0;
+  pendingLatencyArrivalUs = 0;
+  pendingLatencyPulse = 0;
+  latencyPending = false;
+  outageStartTimeUs = 0;
+  outageDisconnect = false;
+  failsafePending = false;
+  outagesCount = 0;
+  missedFailsafesCount = 0;
+  lateInterruptsCount = 0;
+}
+
+uint32_t MockHal::getTimeMs()
+{
+  // Called once per iteration of the flight loop.
+  if(lastIterationUs != 0)
+    loopIteration.add(nowUs - lastIterationUs);
+  lastIterationUs = nowUs;
+
+  spend(2, 4);
+  return (uint32_t)(nowUs / 1000);
+}
+
+uint32_t MockHal::getTimeUs()
+{
+  spend(2, 4);
+  return (uint32_t)nowUs;
+}
+
+bool MockHal::isPhoneConnected()
+{
+  spend(20, 40);
+  updatePhone();
+  return connected;
+}
+
+int MockHal::readPhone(uint8_t *buffer, int size)
+{
+  updatePhone();
+
+  // A USB transfer: short if the phone has nothing to send (NAK), longer
+  // if a packet is received. Sometimes, it stalls (NAK retries...).
+  if(std::uniform_real_distribution<double>(0.0, 1.0)(random) < USB_STALL_PROBABILITY)
+    spend(1000, USB_STALL_MAX_US);
+
+  if(rxPackets.empty() || size < MOTOR_FRAME_SIZE)
+  {
+    spend(150, 400);
+    return 0;
+  }
+
+  spend(420, 1220); // Including the decoding of the frame.
+
+  const Packet &packet = rxPackets.front();
+
+  for(int i=0; i<MOTOR_FRAME_SIZE; i++)
+    buffer[i] = packet.frame[i];
+
+  pendingLatencyArrivalUs = packet.arrivalTimeUs;
+  pendingLatencyPulse = PULSE_MIN + (packet.frame[2] | (packet.frame[3] << 8));
+  latencyPending = true;
+  rxPackets.pop_front();
+
+  return MOTOR_FRAME_SIZE;
+}
+
+void MockHal::writePhone(const uint8_t *buffer, int size)
+{
+  (void)buffer;
+  (void)size;
+  spend(300, 900);
+}
+
+void MockHal::startPulseTimer(PulseStage &stage)
+{
+  pulseStage = &stage;
+  nextPeriodUs = nowUs + PULSES_PERIOD;
+}
+
+void MockHal::writeMotorPulse(int motor, int pulseUs)
+{
+  spend(1, 2); // Write of a compare register.
+  writtenPulses[motor] = pulseUs;
+}
+
+uint16_t MockHal::readBatteryLevel()
+{
+  spend(110, 120); // analogRead().
+  return 700;
+}
+
+void MockHal::spend(uint64_t minUs, uint64_t maxUs)
+{
+  advance(std::uniform_int_distribution<uint64_t>(minUs, maxUs)(random));
+}
+
+void MockHal::advance(uint64_t duration)
+{
+  uint64_t endUs = nowUs + duration;
+
+  if(inInterrupt)
+  {
+    nowUs = endUs;
+    return;
+  }
+
+  while(pulseStage != 0 && nextPeriodUs <= endUs)
+  {
+    uint64_t periodStartUs = nextPeriodUs;
+    nextPeriodUs += PULSES_PERIOD;
+
+    // The hardware applies the pulses at the start of the period...
+    startPeriod(periodStartUs);
+
+    // ...then the interrupt preempts the main loop, after a latency: other
+    // interrupts (timer 0, serial) or code with the interrupts disabled.
+    uint64_t latency = std::uniform_real_distribution<double>(0.0, 1.0)(random) < 0.1 ?
+        std::uniform_int_distribution<uint64_t>(4, 15)(random) :
+        std::uniform_int_distribution<uint64_t>(1, 4)(random);
+    uint64_t interruptStartUs = std::max(nowUs, periodStartUs + latency);
+
+    nowUs = interruptStartUs;
+    inInterrupt = true;
+    spend(2, 4); // Entry and exit.
+    pulseStage->onPeriod();
+    inInterrupt = false;
+
+    // The pulses must be written before the end of the period, to be
+    // applied at the next one.
+    interruptResponse.add(nowUs - periodStartUs);
+
+    if(nowUs >= nextPeriodUs)
+      lateInterruptsCount++;
+
+    // The main loop is delayed by the duration of the interrupt.
+    endUs += nowUs - interruptStartUs;
+  }
+
+  nowUs = std::max(nowUs, endUs);
+}
+
+void MockHal::startPeriod(uint64_t periodStartUs)
+{
+  if(lastPeriodUs != 0)
+    pulsePeriod.add(periodStartUs - lastPeriodUs);
+  lastPeriodUs = periodStartUs;
+
+  int nwPulse = writtenPulses[NW_MOTOR];
+
+  // Latency between the arrival of a command and its pulse.
+  if(latencyPending && nwPulse == pendingLatencyPulse)
+  {
+    commandLatency.add(periodStartUs - pendingLatencyArrivalUs);
+    latencyPending = false;
+  }
+
+  // Reaction time of the failsafe. The phone always sends non-zero commands,
+  // so a PULSE_MIN pulse means that the motors have been stopped.
+  if(failsafePending && nwPulse == PULSE_MIN)
+  {
+    uint64_t reaction = periodStartUs - outageStartTimeUs;
+    (outageDisconnect ? failsafeDisconnect : failsafeSilence).add(reaction);
+    failsafePending = false;
+  }
+}
+
+void MockHal::updatePhone()
+{
+  while(nextPacketTimeUs <= nowUs)
+  {
+    uint64_t packetTimeUs = nextPacketTimeUs;
+
+    if(packetTimeUs >= outageEndTimeUs)
+    {
+      // Normal flight: a command is sent, then an outage may start.
+      if(!connected || silent)
+      {
+        connected = true;
+        silent = false;
+        rxPackets.clear();
+      }
+
+      if(failsafePending)
+        missedFailsafesCount++;
+      failsafePending = false;
+
+      Packet packet;
+      packet.arrivalTimeUs = packetTimeUs;
+
+      uint16_t commands[MOTORS_COUNT];
+
+      for(int i=0; i<MOTORS_COUNT; i++)
+        commands[i] = (uint16_t)std::uniform_int_distribution<int>(1, MOTOR_COMMAND_MAX)(random);
+
+      encodeMotorFrame(txSequence++, commands, packet.frame);
+
+      rxPackets.push_back(packet);
+
+      double outageProbability = PHONE_OUTAGE_RATE * PHONE_TX_PERIOD_US / 1e6;
+
+      if(std::uniform_real_distribution<double>(0.0, 1.0)(random) < outageProbability)
+      {
+        // Frozen app or disconnection, from 0.1 to 2 s.
+        outageStartTimeUs = packetTimeUs;
+        outageEndTimeUs = packetTimeUs + std::uniform_int_distribution<uint64_t>(100000, 2000000)(random);
+        outageDisconnect = std::uniform_int_distribution<int>(0, 3)(random) == 0;
+        outagesCount++;
+
+        if(outageDisconnect)
+          connected = false;
+        else
+          silent = true;
+
+        // The failsafe is only expected if the outage lasts longer than
+        // MAX_TIME_WITHOUT_RECEPTION, or if the phone disconnects.
+        failsafePending = outageDisconnect ||
+            outageEndTimeUs - outageStartTimeUs > MAX_TIME_WITHOUT_RECEPTION * 1000 + PHONE_TX_PERIOD_US;
+      }
+    }
+
+    nextPacketTimeUs += PHONE_TX_PERIOD_US - PHONE_TX_JITTER_US / 2
+        + std::uniform_int_distribution<uint64_t>(0, PHONE_TX_JITTER_US)(random);
+  }
+}
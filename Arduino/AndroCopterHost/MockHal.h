@@ -0,0 +1,131 @@
+// Simulated hardware of the ADK board, to run the flight loop on a computer.
+// Romain Baud, 2026.
+
+// The clock is virtual: each call to the hardware advances it by a random
+// duration, close to the one measured on the board, and some USB transfers
+// stall for several milliseconds. Hours of flight are then simulated in
+// seconds.
+// The pulse timers are simulated too: at the start of each period, they
+// apply the pulses written during the previous one, and the timer interrupt
+// preempts the main loop after a random latency.
+// The phone sends a command every PHONE_TX_PERIOD_US, with some jitter, and
+// sometimes stops sending (app frozen) or disconnects. The mock records the
+// pulses sent to the ESCs, to measure the timing of the loop.
+
+#ifndef MOCK_HAL_H
+#define MOCK_HAL_H
+
+#include "FlightHal.h"
+#include "FlightLoop.h"
+
+#include <deque>
+#include <random>
+#include <vector>
+
+const uint64_t PHONE_TX_PERIOD_US = 10000; // Period of the commands sent by the phone [us].
+const uint64_t PHONE_TX_JITTER_US = 3000; // Max jitter of the commands sent by the phone [us].
+const double PHONE_OUTAGE_RATE = 1.0 / 60.0; // Mean number of outages per second of flight.
+const double USB_STALL_PROBABILITY = 0.005; // Probability that a USB transfer stalls.
+const uint64_t USB_STALL_MAX_US = 20000; // Max duration of a stalled USB transfer [us].
+
+// Statistics of a series of durations.
+class DurationStats
+{
+public:
+  // Adds a duration [us].
+  void add(uint64_t duration);
+
+  uint64_t getCount() const { return count; }
+  double getMean() const;
+  double getStdDev() const;
+  uint64_t getMin() const { return min; }
+  uint64_t getMax() const { return max; }
+
+  // Returns the duration under which the given fraction of the durations
+  // are [us].
+  uint64_t getPercentile(double fraction) const;
+
+private:
+  static const uint64_t HISTOGRAM_SIZE = 1000000; // 1 us bins, up to 1 s.
+
+  std::vector<uint64_t> histogram;
+  uint64_t count = 0, min = UINT64_MAX, max = 0;
+  double sum = 0.0, sumSquares = 0.0;
+};
+
+class MockHal : public FlightHal
+{
+public:
+  explicit MockHal(unsigned int seed);
+
+  // FlightHal.
+  uint32_t getTimeMs() override;
+  uint32_t getTimeUs() override;
+  bool isPhoneConnected() override;
+  int readPhone(uint8_t *buffer, int size) override;
+  void writePhone(const uint8_t *buffer, int size) override;
+  void startPulseTimer(PulseStage &stage) override;
+  void writeMotorPulse(int motor, int pulseUs) override;
+  uint16_t readBatteryLevel() override;
+
+  // Simulated time since the start [us]. Does not wrap around.
+  uint64_t getSimulationTimeUs() const { return nowUs; }
+
+  const DurationStats& getPulsePeriodStats() const { return pulsePeriod; }
+  const DurationStats& getInterruptResponseStats() const { return interruptResponse; }
+  const DurationStats& getLoopIterationStats() const { return loopIteration; }
+  const DurationStats& getCommandLatencyStats() const { return commandLatency; }
+  const DurationStats& getFailsafeSilenceStats() const { return failsafeSilence; }
+  const DurationStats& getFailsafeDisconnectStats() const { return failsafeDisconnect; }
+  uint64_t getOutagesCount() const { return outagesCount; }
+  uint64_t getMissedFailsafesCount() const { return missedFailsafesCount; }
+  uint64_t getLateInterruptsCount() const { return lateInterruptsCount; }
+
+private:
+  // Command sent by the phone (see MotorProtocol).
+  struct Packet
+  {
+    uint64_t arrivalTimeUs;
+    uint8_t frame[MOTOR_FRAME_SIZE];
+  };
+
+  // Advances the clock by a random duration between min and max [us].
+  void spend(uint64_t minUs, uint64_t maxUs);
+
+  // Advances the clock, running the timer interrupts of the elapsed
+  // periods.
+  void advance(uint64_t duration);
+
+  // Applies the written pulses, at the start of a period.
+  void startPeriod(uint64_t periodStartUs);
+
+  // Simulates the phone, until the current time.
+  void updatePhone();
+
+  std::mt19937 random;
+  uint64_t nowUs;
+
+  // Pulse timers.
+  PulseStage *pulseStage;
+  uint64_t nextPeriodUs;
+  bool inInterrupt;
+  int writtenPulses[MOTORS_COUNT]; // Applied at the start of the next period.
+
+  // Phone.
+  std::deque<Packet> rxPackets;
+  uint64_t nextPacketTimeUs, outageEndTimeUs;
+  bool connected, silent;
+  uint8_t txSequence;
+
+  // Measures.
+  uint64_t lastPeriodUs, lastIterationUs, pendingLatencyArrivalUs;
+  int pendingLatencyPulse;
+  bool latencyPending;
+  uint64_t outageStartTimeUs; // Last command before the outage, or disconnection.
+  bool outageDisconnect, failsafePending;
+  uint64_t outagesCount, missedFailsafesCount, lateInterruptsCount;
+  DurationStats pulsePeriod, interruptResponse, loopIteration;
+  DurationStats commandLatency, failsafeSilence, failsafeDisconnect;
+};
+
+#endif
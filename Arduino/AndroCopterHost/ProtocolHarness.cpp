@@ -0,0 +1,239 @@
+// Fault-injection harness of the motor commands protocol.
+// Romain Baud, 2026.
+
+// Encodes random motor commands (see MotorProtocol), damages the byte stream
+// (lost, corrupted and inserted bytes), cuts it in reads of random sizes, as
+// the USB transfers, and checks what the decoder of the sketch recovers:
+// - the intact frames must all be decoded, whatever happened before them.
+// - the decoded frames must have been sent, apart from the CRC collisions
+//   (about 1 out of 65536 damaged frames). A damaged frame can still be
+//   decoded, e.g. if the inserted garbage ends with a sync byte.
+// It also reports the max number of CRC checks for a read, which bounds the
+// time spent decoding in an iteration of the flight loop.
+//
+// Build and run, from this directory:
+//   g++ -std=c++11 -O2 -Wall -I../AndroCopterArduino ../AndroCopterArduino/MotorProtocol.cpp ProtocolHarness.cpp -o protocol-harness
+//   ./protocol-harness [frames] [seed]
+
+#include "MotorProtocol.h"
+#include "FlightLoop.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Time to check the CRC of a frame on the ADK (ATmega2560 at 16 MHz),
+// estimated from the generated code [us].
+const double ADK_CRC_CHECK_US = 20.0;
+
+// Faults injected in the byte stream.
+struct FaultRates
+{
+  const char *name;
+  double lostByte; // Probability that a byte is lost.
+  double corruptedByte; // Probability that a bit of a byte is flipped.
+  double insertedBytes; // Probability that garbage is inserted after a byte.
+};
+
+// A frame sent by the phone.
+struct SentFrame
+{
+  uint8_t sequence;
+  uint16_t commands[MOTORS_COUNT];
+  bool damaged;
+};
+
+// Results of a scenario.
+struct Results
+{
+  uint64_t intactCount, damagedCount;
+  uint64_t lostIntactCount; // Intact frames not decoded.
+  uint64_t wrongFramesCount; // Decoded frames that were not sent (CRC collisions).
+  int maxCrcChecksPerRead;
+};
+
+static Results runScenario(const FaultRates &faults, int framesCount, std::mt19937 &random)
+{
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<SentFrame> sent(framesCount);
+  std::vector<uint8_t> stream;
+  bool lostSyncLike = false;
+
+  // Encode the frames, and damage the stream.
+  for(int f=0; f<framesCount; f++)
+  {
+    SentFrame &frame = sent[f];
+    frame.sequence = (uint8_t)f;
+
+    // If the previous frame only lost a byte, and its last byte is equal to
+    // a sync byte, the sync byte of this frame completes the previous frame.
+    frame.damaged = lostSyncLike;
+
+    for(int i=0; i<MOTORS_COUNT; i++)
+      frame.commands[i] = (uint16_t)std::uniform_int_distribution<int>(0, MOTOR_COMMAND_MAX)(random);
+
+    uint8_t bytes[MOTOR_FRAME_SIZE];
+    encodeMotorFrame(frame.sequence, frame.commands, bytes);
+
+    size_t frameStart = stream.size();
+    bool inserted = false;
+
+    for(int b=0; b<MOTOR_FRAME_SIZE; b++)
+    {
+      if(uniform(random) < faults.lostByte)
+      {
+        frame.damaged = true;
+        continue;
+      }
+
+      uint8_t byte = bytes[b];
+
+      if(uniform(random) < faults.corruptedByte)
+      {
+        byte ^= (uint8_t)(1 << std::uniform_int_distribution<int>(0, 7)(random));
+        frame.damaged = true;
+      }
+
+      stream.push_back(byte);
+
+      if(uniform(random) < faults.insertedBytes)
+      {
+        // Garbage, with many sync bytes to mislead the decoder.
+        int count = std::uniform_int_distribution<int>(1, 2 * MOTOR_FRAME_SIZE)(random);
+
+        for(int i=0; i<count; i++)
+          stream.push_back(uniform(random) < 0.3 ? MOTOR_FRAME_SYNC :
+                           (uint8_t)std::uniform_int_distribution<int>(0, 255)(random));
+
+        // Bytes inserted after the last byte do not damage the frame.
+        if(b < MOTOR_FRAME_SIZE - 1)
+        {
+          frame.damaged = true;
+          inserted = true;
+        }
+      }
+    }
+
+    lostSyncLike = !inserted && bytes[MOTOR_FRAME_SIZE - 1] == MOTOR_FRAME_SYNC &&
+        stream.size() - frameStart == MOTOR_FRAME_SIZE - 1 &&
+        memcmp(&stream[frameStart], bytes, MOTOR_FRAME_SIZE - 1) == 0;
+  }
+
+  // Decode the stream, read by read, and match the decoded frames with the
+  // sent ones.
+  Results results;
+  memset(&results, 0, sizeof(results));
+
+  MotorFrameDecoder decoder;
+  size_t position = 0;
+  int nextSent = 0;
+
+  while(position < stream.size())
+  {
+    size_t readSize = std::uniform_int_distribution<size_t>(1, RX_BUFFER_SIZE)(random);
+    readSize = std::min(readSize, stream.size() - position);
+    uint32_t checksBefore = decoder.getFramesCount() + decoder.getBadFramesCount();
+
+    for(size_t i=0; i<readSize; i++)
+    {
+      if(!decoder.push(stream[position + i]))
+        continue;
+
+      // Look for the decoded frame among the next sent ones.
+      int match = -1;
+
+      for(int f=nextSent; f<framesCount && f<nextSent+512 && match<0; f++)
+      {
+        if(sent[f].sequence != decoder.getSequence())
+          continue;
+
+        bool same = true;
+
+        for(int m=0; m<MOTORS_COUNT; m++)
+          same = same && sent[f].commands[m] == decoder.getCommand(m);
+
+        if(same)
+          match = f;
+      }
+
+      if(match < 0)
+      {
+        results.wrongFramesCount++;
+        continue;
+      }
+
+      for(int f=nextSent; f<match; f++)
+      {
+        if(!sent[f].damaged)
+          results.lostIntactCount++;
+      }
+
+      nextSent = match + 1;
+    }
+
+    position += readSize;
+
+    int checks = (int)(decoder.getFramesCount() + decoder.getBadFramesCount() - checksBefore);
+    results.maxCrcChecksPerRead = std::max(results.maxCrcChecksPerRead, checks);
+  }
+
+  // The frames after the last decoded one.
+  for(int f=nextSent; f<framesCount; f++)
+  {
+    if(!sent[f].damaged)
+      results.lostIntactCount++;
+  }
+
+  for(int f=0; f<framesCount; f++)
+  {
+    if(sent[f].damaged)
+      results.damagedCount++;
+    else
+      results.intactCount++;
+  }
+
+  return results;
+}
+
+int main(int argc, char **argv)
+{
+  int framesCount = argc > 1 ? atoi(argv[1]) : 1000000;
+  unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+
+  const FaultRates SCENARIOS[] =
+  {
+    {"clean", 0.0, 0.0, 0.0},
+    {"lost bytes", 0.01, 0.0, 0.0},
+    {"corrupted bytes", 0.0, 0.01, 0.0},
+    {"inserted garbage", 0.0, 0.0, 0.01},
+    {"all faults", 0.01, 0.01, 0.01},
+    {"heavy faults", 0.1, 0.1, 0.05}
+  };
+
+  std::mt19937 random(seed);
+  bool ok = true;
+
+  printf("%d frames of %d bytes per scenario (seed %u).\n", framesCount, MOTOR_FRAME_SIZE, seed);
+
+  for(const FaultRates &faults : SCENARIOS)
+  {
+    Results results = runScenario(faults, framesCount, random);
+
+    printf("%-18s intact=%-8llu damaged=%-8llu lost intact=%-4llu wrong frames=%-4llu max CRC checks/read=%d (~%.0f us on the ADK)\n",
+           faults.name, (unsigned long long)results.intactCount,
+           (unsigned long long)results.damagedCount,
+           (unsigned long long)results.lostIntactCount,
+           (unsigned long long)results.wrongFramesCount,
+           results.maxCrcChecksPerRead, results.maxCrcChecksPerRead * ADK_CRC_CHECK_US);
+
+    // A wrong frame can hide the intact frame following it.
+    ok = ok && results.lostIntactCount <= results.wrongFramesCount &&
+        results.wrongFramesCount * 65536.0 <= 4.0 * results.damagedCount + 4.0 * 65536.0;
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+
+  return ok ? 0 : 1;
+}
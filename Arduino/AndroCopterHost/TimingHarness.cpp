@@ -0,0 +1,95 @@
+// Timing harness of the AndroCopter Arduino flight loop.
+// Romain Baud, 2026.
+
+// Runs the flight loop of the sketch (FlightLoop) against a simulated board
+// (MockHal) for hours of virtual time, with random USB delays, then reports
+// the period of the pulses, the response time of the timer interrupt, the
+// duration of the loop iterations, the latency between the reception of a
+// command and its pulse, and the reaction time of the failsafe.
+//
+// Build and run, from this directory:
+//   g++ -std=c++11 -O2 -Wall -I../AndroCopterArduino ../AndroCopterArduino/FlightLoop.cpp ../AndroCopterArduino/MotorProtocol.cpp ../AndroCopterArduino/PulseStage.cpp MockHal.cpp TimingHarness.cpp -o timing-harness
+//   ./timing-harness [hours] [seed]
+//
+// The exit code is not 0 if the pulse period varied, if the interrupt missed
+// a period, or if the failsafe missed an outage or reacted too late.
+
+#include "MockHal.h"
+#include "FlightLoop.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Max tolerated reaction time of the failsafe, after the last command, or
+// after the disconnection [us]. A silent phone is detected after
+// MAX_TIME_WITHOUT_RECEPTION, with the millis() resolution, by an iteration
+// that can be delayed by a stalled USB transfer; the new pulses are then
+// applied at the start of the next period.
+const uint64_t MAX_FAILSAFE_DELAY_US = USB_STALL_MAX_US + 2000 + 2 * PULSES_PERIOD;
+const uint64_t MAX_SILENCE_REACTION_US = MAX_TIME_WITHOUT_RECEPTION * 1000 + MAX_FAILSAFE_DELAY_US;
+
+// Max tolerated variation of the pulse period: the resolution of the timers
+// [us].
+const uint64_t MAX_PULSE_JITTER_US = 1;
+
+static void printStats(const char *name, const DurationStats &stats)
+{
+  if(stats.getCount() == 0)
+  {
+    printf("%-24s no samples\n", name);
+    return;
+  }
+
+  printf("%-24s n=%-9llu mean=%9.1f std=%7.1f min=%7llu p99=%7llu p99.99=%7llu max=%7llu [us]\n",
+         name, (unsigned long long)stats.getCount(), stats.getMean(), stats.getStdDev(),
+         (unsigned long long)stats.getMin(), (unsigned long long)stats.getPercentile(0.99),
+         (unsigned long long)stats.getPercentile(0.9999), (unsigned long long)stats.getMax());
+}
+
+int main(int argc, char **argv)
+{
+  double hours = argc > 1 ? atof(argv[1]) : 4.0;
+  unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+
+  MockHal hal(seed);
+  FlightLoop flightLoop(hal);
+
+  uint64_t durationUs = (uint64_t)(hours * 3600e6);
+
+  flightLoop.begin();
+
+  while(hal.getSimulationTimeUs() < durationUs)
+    flightLoop.step();
+
+  printf("Simulated %.2f h of flight (seed %u), target period %lu us.\n",
+         hours, seed, (unsigned long)PULSES_PERIOD);
+  printStats("Pulse period", hal.getPulsePeriodStats());
+  printStats("Interrupt response", hal.getInterruptResponseStats());
+  printStats("Loop iteration", hal.getLoopIterationStats());
+  printStats("Command to pulse", hal.getCommandLatencyStats());
+  printStats("Failsafe (silence)", hal.getFailsafeSilenceStats());
+  printStats("Failsafe (disconnect)", hal.getFailsafeDisconnectStats());
+  printf("Outages: %llu, missed failsafes: %llu, late interrupts: %llu.\n",
+         (unsigned long long)hal.getOutagesCount(),
+         (unsigned long long)hal.getMissedFailsafesCount(),
+         (unsigned long long)hal.getLateInterruptsCount());
+
+  const DurationStats &period = hal.getPulsePeriodStats();
+  bool pulsesOk = period.getMin() + MAX_PULSE_JITTER_US >= PULSES_PERIOD &&
+      period.getMax() <= PULSES_PERIOD + MAX_PULSE_JITTER_US &&
+      hal.getLateInterruptsCount() == 0;
+  bool failsafeOk = hal.getMissedFailsafesCount() == 0 &&
+      hal.getFailsafeSilenceStats().getMax() <= MAX_SILENCE_REACTION_US &&
+      hal.getFailsafeDisconnectStats().getMax() <= MAX_FAILSAFE_DELAY_US;
+
+  if(!pulsesOk)
+    printf("FAILED: the pulse period is not stable.\n");
+  if(!failsafeOk)
+    printf("FAILED: the failsafe is too slow.\n");
+  if(pulsesOk && failsafeOk)
+    printf("OK\n");
+
+  bool ok = pulsesOk && failsafeOk;
+
+  return ok ? 0 : 1;
+}
@@ -6,6 +6,9 @@
 
 QT += core widgets gui network
 
+# The lock-free queues use std::atomic.
+CONFIG += c++11
+
 TARGET = AndroCopterRemote
 TEMPLATE = app
 
@@ -14,14 +17,62 @@ SOURCES += main.cpp mainwindow.cpp \
     gamepad.cpp \
     plotter.cpp \
     pid.cpp \
-    spacespin.cpp
+    spacespin.cpp \
+    positionsimulator.cpp \
+    telemetrystore.cpp \
+    labelrefresher.cpp \
+    vehiclelink.cpp \
+    groundserver.cpp \
+    vehiclesession.cpp \
+    fpvratecontroller.cpp \
+    linkmonitor.cpp \
+    diskwriter.cpp \
+    messagelogmodel.cpp \
+    telemetryexporter.cpp \
+    flightarchive.cpp \
+    gamepadpoller.cpp \
+    telemetryhandoff.cpp \
+    bufferpool.cpp \
+    frameview.cpp \
+    inputshaper.cpp \
+    discoverybeacon.cpp \
+    chunkreceiver.cpp \
+    telemetrycodec.cpp \
+    clocksync.cpp \
+    outboundscheduler.cpp \
+    stateestimator.cpp
 
 HEADERS  += mainwindow.h \
     gamepad.h \
     plotter.h \
     constants.h \
     pid.h \
-    spacespin.h
+    spacespin.h \
+    positionsimulator.h \
+    telemetrystore.h \
+    labelrefresher.h \
+    vehiclelink.h \
+    groundserver.h \
+    vehiclesession.h \
+    fpvratecontroller.h \
+    linkmonitor.h \
+    diskwriter.h \
+    messagelogmodel.h \
+    telemetryexporter.h \
+    flightarchive.h \
+    lockfree.h \
+    gamepadpoller.h \
+    telemetryhandoff.h \
+    bufferpool.h \
+    frameview.h \
+    inputshaper.h \
+    discoverybeacon.h \
+    chunkreceiver.h \
+    telemetrycodec.h \
+    clocksync.h \
+    outboundscheduler.h \
+    matrix.h \
+    stateestimator.h
 
 FORMS    += mainwindow.ui
 
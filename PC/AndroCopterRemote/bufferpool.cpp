@@ -0,0 +1,237 @@
+#include "bufferpool.h"
+
+#include <QMutexLocker>
+#include <cstring>
+
+/// Get the size of the buffers of a class.
+static int getClassSize(int sizeClass)
+{
+    return BUFFER_POOL_MIN_SIZE << sizeClass;
+}
+
+/// Get the class of a pooled buffer, from its capacity.
+/// \return the class, or -1 if the buffer does not come from a pool.
+static int getCapacityClass(int capacity)
+{
+    for(int c=BUFFER_POOL_CLASSES_COUNT-1; c>=0; c--)
+    {
+        if(capacity >= getClassSize(c))
+            return (capacity < 2 * getClassSize(c)) ? c : -1;
+    }
+
+    return -1;
+}
+
+BufferPool::BufferPool(int maxFreePerClass)
+{
+    this->maxFreePerClass = maxFreePerClass;
+    memset(&stats, 0, sizeof(stats));
+
+    // The lists never grow, so the pool itself does not allocate.
+    for(int c=0; c<BUFFER_POOL_CLASSES_COUNT; c++)
+        freeBuffers[c].reserve(maxFreePerClass);
+
+    releasedBuffers.reserve(maxFreePerClass * BUFFER_POOL_CLASSES_COUNT);
+}
+
+QByteArray BufferPool::acquire(int size)
+{
+    int sizeClass = getSizeClass(size);
+
+    // Too big for the pool.
+    if(sizeClass < 0)
+    {
+        QMutexLocker locker(&mutex);
+        stats.misses++;
+        locker.unlock();
+
+        return QByteArray(size, Qt::Uninitialized);
+    }
+
+    QMutexLocker locker(&mutex);
+    QByteArray buffer;
+
+    recycleReleased();
+
+    if(!freeBuffers[sizeClass].isEmpty())
+    {
+        buffer = freeBuffers[sizeClass].last();
+        freeBuffers[sizeClass].removeLast();
+        stats.hits++;
+    }
+    else
+    {
+        buffer.reserve(getClassSize(sizeClass));
+        stats.misses++;
+        stats.pooledBytes += getClassSize(sizeClass);
+        stats.pooledBytesHighWater = qMax(stats.pooledBytesHighWater, stats.pooledBytes);
+    }
+
+    stats.inUse++;
+    stats.inUseHighWater = qMax(stats.inUseHighWater, stats.inUse);
+
+    locker.unlock();
+
+    // The capacity is kept, so this does not reallocate.
+    buffer.resize(size);
+
+    return buffer;
+}
+
+void BufferPool::release(QByteArray &buffer)
+{
+    int sizeClass = getCapacityClass(buffer.capacity());
+
+    if(sizeClass < 0)
+    {
+        buffer.clear();
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    stats.inUse--;
+
+    // If too many buffers are still shared, forget this one.
+    if(releasedBuffers.size() == releasedBuffers.capacity())
+        recycleReleased();
+
+    if(releasedBuffers.size() < releasedBuffers.capacity())
+        releasedBuffers.append(buffer);
+    else
+    {
+        stats.dropped++;
+        stats.pooledBytes -= getClassSize(sizeClass);
+    }
+
+    buffer.clear();
+}
+
+PoolStats BufferPool::getStats() const
+{
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+int BufferPool::getSizeClass(int size)
+{
+    for(int c=0; c<BUFFER_POOL_CLASSES_COUNT; c++)
+    {
+        if(size <= getClassSize(c))
+            return c;
+    }
+
+    return -1;
+}
+
+void BufferPool::recycleReleased()
+{
+    for(int i=releasedBuffers.size()-1; i>=0; i--)
+    {
+        // Still used by someone else.
+        if(!releasedBuffers.at(i).isDetached())
+            continue;
+
+        QByteArray buffer = releasedBuffers.at(i);
+        releasedBuffers[i] = releasedBuffers.last();
+        releasedBuffers.removeLast();
+
+        int sizeClass = getCapacityClass(buffer.capacity());
+
+        if(freeBuffers[sizeClass].size() < maxFreePerClass)
+            freeBuffers[sizeClass].append(buffer);
+        else
+        {
+            stats.dropped++;
+            stats.pooledBytes -= getClassSize(sizeClass);
+        }
+    }
+}
+
+ImagePool::ImagePool(int maxFree)
+{
+    this->maxFree = maxFree;
+    memset(&stats, 0, sizeof(stats));
+
+    freeImages.reserve(maxFree);
+    releasedImages.reserve(maxFree);
+}
+
+QImage ImagePool::acquire(const QSize &size, QImage::Format format)
+{
+    recycleReleased();
+
+    stats.inUse++;
+    stats.inUseHighWater = qMax(stats.inUseHighWater, stats.inUse);
+
+    for(int i=0; i<freeImages.size(); i++)
+    {
+        if(freeImages.at(i).size() == size && freeImages.at(i).format() == format)
+        {
+            QImage image = freeImages.at(i);
+            freeImages.remove(i);
+            stats.hits++;
+
+            return image;
+        }
+    }
+
+    QImage image(size, format);
+    stats.misses++;
+    stats.pooledBytes += image.byteCount();
+    stats.pooledBytesHighWater = qMax(stats.pooledBytesHighWater, stats.pooledBytes);
+
+    return image;
+}
+
+void ImagePool::release(QImage &image)
+{
+    if(image.isNull())
+        return;
+
+    stats.inUse--;
+
+    // If too many images are still shared, forget the oldest one.
+    if(releasedImages.size() == maxFree)
+        recycleReleased();
+
+    if(releasedImages.size() == maxFree)
+    {
+        stats.dropped++;
+        stats.pooledBytes -= releasedImages.first().byteCount();
+        releasedImages.remove(0);
+    }
+
+    releasedImages.append(image);
+    image = QImage();
+}
+
+PoolStats ImagePool::getStats() const
+{
+    return stats;
+}
+
+void ImagePool::recycleReleased()
+{
+    for(int i=0; i<releasedImages.size(); )
+    {
+        // Still displayed.
+        if(!releasedImages.at(i).isDetached())
+        {
+            i++;
+            continue;
+        }
+
+        // Keep the most recent images: the older ones may have the size of
+        // a previous resolution of the video.
+        if(freeImages.size() == maxFree)
+        {
+            stats.dropped++;
+            stats.pooledBytes -= freeImages.first().byteCount();
+            freeImages.remove(0);
+        }
+
+        freeImages.append(releasedImages.at(i));
+        releasedImages.remove(i);
+    }
+}
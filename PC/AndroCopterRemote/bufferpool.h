@@ -0,0 +1,127 @@
+/*!
+* \file bufferpool.h
+* \brief Pools of reusable message buffers and decoded images.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QVector>
+
+/// Size of the smallest buffers of a BufferPool, in bytes. The size classes
+/// are the powers of two from this size.
+const int BUFFER_POOL_MIN_SIZE = 256;
+
+/// Number of size classes of a BufferPool: from 256 bytes to 4 MB. The bigger
+/// buffers are allocated and freed as usual.
+const int BUFFER_POOL_CLASSES_COUNT = 15;
+
+/// Counters of a pool, to check that it is big enough.
+struct PoolStats
+{
+    qint64 hits; ///< Number of acquisitions served by a pooled object.
+    qint64 misses; ///< Number of acquisitions that allocated a new object.
+    qint64 dropped; ///< Number of released objects freed, pool full.
+    int inUse; ///< Objects acquired and not returned to the pool yet.
+    int inUseHighWater; ///< Maximum of inUse since the start.
+    qint64 pooledBytes; ///< Memory of the objects in the pool, free or in use.
+    qint64 pooledBytesHighWater; ///< Maximum of pooledBytes since the start.
+};
+
+/// Pool of reusable buffers, for the content of the received messages.
+/// The buffers are QByteArray, whose capacity is a size class (a power of
+/// two), so a buffer can be reused for any message of its class without
+/// reallocation.
+///
+/// A released buffer may still be shared (implicitly) with other QByteArray,
+/// for example by a queued signal, or by the DiskWriter queue. It is only
+/// reused once all the other copies are destroyed: the released buffers are
+/// checked at each acquisition.
+///
+/// All the methods can be called from any thread.
+class BufferPool
+{
+public:
+    /// Constructor.
+    /// \param maxFreePerClass maximum number of free buffers kept for each
+    /// size class.
+    explicit BufferPool(int maxFreePerClass);
+
+    /// Get a buffer of the given size. Its content is undefined.
+    /// \param size the size of the buffer, in bytes.
+    /// \return the buffer.
+    QByteArray acquire(int size);
+
+    /// Gives a buffer back to the pool, once it is not needed anymore. It is
+    /// cleared.
+    /// \param buffer the buffer, that was returned by acquire().
+    void release(QByteArray &buffer);
+
+    /// Get the counters of the pool.
+    /// \return a copy of the counters.
+    PoolStats getStats() const;
+
+private:
+    /// Get the smallest size class containing the given size.
+    /// \return the class, or -1 if it is too big for the pool.
+    static int getSizeClass(int size);
+
+    /// Moves the released buffers that are not shared anymore to the free
+    /// lists. The mutex must be locked.
+    void recycleReleased();
+
+    mutable QMutex mutex;
+    int maxFreePerClass;
+    QVector<QByteArray> freeBuffers[BUFFER_POOL_CLASSES_COUNT];
+    QVector<QByteArray> releasedBuffers;
+    PoolStats stats;
+};
+
+/// Pool of reusable images, for the decoded video frames. The images are
+/// reused for the frames of the same size and format, which is the case of
+/// all the frames of a stream, unless its resolution is changed.
+/// As for BufferPool, a released image is only reused once it is not shared
+/// anymore (e.g. by the widget displaying it).
+///
+/// The pool must be used by a single thread.
+class ImagePool
+{
+public:
+    /// Constructor.
+    /// \param maxFree maximum number of free images kept.
+    explicit ImagePool(int maxFree);
+
+    /// Get an image of the given size and format. Its content is undefined.
+    /// \param size the size of the image, in pixels.
+    /// \param format the format of the image.
+    /// \return the image.
+    QImage acquire(const QSize &size, QImage::Format format);
+
+    /// Gives an image back to the pool, once it is not needed anymore. It is
+    /// cleared.
+    /// \param image the image, that was returned by acquire().
+    void release(QImage &image);
+
+    /// Get the counters of the pool.
+    /// \return a copy of the counters.
+    PoolStats getStats() const;
+
+private:
+    /// Moves the released images that are not shared anymore to the free
+    /// list.
+    void recycleReleased();
+
+    int maxFree;
+    QVector<QImage> freeImages;
+    QVector<QImage> releasedImages;
+    PoolStats stats;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,104 @@
+#include "chunkreceiver.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+ChunkReceiver::ChunkReceiver(DiskWriter &diskWriter) : diskWriter(diskWriter)
+{
+}
+
+ChunkReceiver::~ChunkReceiver()
+{
+    foreach(const Transfer &transfer, transfers)
+        diskWriter.closeStream(transfer.diskStream);
+}
+
+void ChunkReceiver::setFilenamePattern(int type, const QString &pattern)
+{
+    filenamePatterns.insert(type, pattern);
+}
+
+ChunkReceiver::ChunkResult ChunkReceiver::addChunk(const QByteArray &data, qint64 groundTime,
+                                                   Transfer &transfer)
+{
+    if(data.size() < CHUNK_HEADER_SIZE)
+        return CHUNK_INVALID;
+
+    const uchar *header = (const uchar*)data.constData();
+    quint32 streamId = qFromBigEndian<quint32>(header);
+    int type = header[4];
+    qint64 totalSize = qFromBigEndian<quint32>(header + 5);
+    qint64 offset = qFromBigEndian<quint32>(header + 9);
+    int payloadSize = data.size() - CHUNK_HEADER_SIZE;
+
+    if(offset + payloadSize > totalSize)
+        return CHUNK_INVALID;
+
+    // Resent after the transfer was completed.
+    if(completedStreams.contains(streamId))
+        return CHUNK_IGNORED;
+
+    // The first chunk received opens the file, even if it is not at the
+    // beginning (the previous ones were lost): they will be resent.
+    if(!transfers.contains(streamId))
+    {
+        if(!filenamePatterns.contains(type))
+            return CHUNK_INVALID;
+
+        Transfer newTransfer;
+        newTransfer.streamId = streamId;
+        newTransfer.type = type;
+        newTransfer.totalSize = totalSize;
+        newTransfer.receivedSize = 0;
+        newTransfer.startTime = groundTime;
+        newTransfer.filename = filenamePatterns[type].arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss"));
+        newTransfer.diskStream = diskWriter.openStream(newTransfer.filename);
+        newTransfer.resendRequested = false;
+        transfers.insert(streamId, newTransfer);
+    }
+
+    Transfer &current = transfers[streamId];
+
+    if(totalSize != current.totalSize || type != current.type)
+        return CHUNK_INVALID;
+
+    // Only the chunk following the written data can be written. Ask once for
+    // the missing data, the following chunks are ignored until it comes.
+    if(offset != current.receivedSize)
+    {
+        transfer = current;
+
+        if(offset < current.receivedSize || current.resendRequested)
+            return CHUNK_IGNORED;
+
+        current.resendRequested = true;
+        transfer = current;
+        return CHUNK_MISSING;
+    }
+
+    // If the disk queue is full, the chunk will be resent later.
+    if(!diskWriter.appendStream(current.diskStream, data.mid(CHUNK_HEADER_SIZE)))
+    {
+        current.resendRequested = true;
+        transfer = current;
+        return CHUNK_MISSING;
+    }
+
+    current.receivedSize += payloadSize;
+    current.resendRequested = false;
+    transfer = current;
+
+    if(current.receivedSize < current.totalSize)
+        return CHUNK_ACCEPTED;
+
+    diskWriter.closeStream(current.diskStream);
+    transfers.remove(streamId);
+    completedStreams.insert(streamId);
+
+    return CHUNK_COMPLETED;
+}
+
+QList<ChunkReceiver::Transfer> ChunkReceiver::getIncompleteTransfers() const
+{
+    return transfers.values();
+}
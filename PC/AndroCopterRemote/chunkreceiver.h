@@ -0,0 +1,100 @@
+/*!
+* \file chunkreceiver.h
+* \brief Reception of the large messages sent in chunks by the phone.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef CHUNKRECEIVER_H
+#define CHUNKRECEIVER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QMap>
+#include <QSet>
+#include <QList>
+
+#include "diskwriter.h"
+
+/// Size of the header of a chunk: stream identifier (uint32), type of the
+/// whole message (uint8), total size (uint32), offset (uint32).
+const int CHUNK_HEADER_SIZE = 4 + 1 + 4 + 4;
+
+/// Reception of the large messages (photos, logs) that the phone splits into
+/// chunks, so they do not hold back the small messages (telemetry, text) for
+/// the whole transfer.
+///
+/// Each chunk is a CHUNK message: a header (big-endian, see
+/// CHUNK_HEADER_SIZE), then a piece of the message. The phone sends the
+/// chunks of a transfer in order, interleaved with the other messages. The
+/// chunks are written to the file of the transfer as they arrive, through
+/// the DiskWriter, so the message is never held in memory.
+///
+/// A chunk that does not follow the received data (lost with a previous
+/// link, or rejected by the full disk queue) makes the transfer wait for
+/// the phone to resend from the received size ("chunk_resume <stream>
+/// <offset>"). The completed transfers are acknowledged ("chunk_done
+/// <stream>"), so the phone can forget them.
+class ChunkReceiver
+{
+public:
+    /// Outcome of a received chunk.
+    enum ChunkResult
+    {
+        CHUNK_INVALID=0, ///< Malformed chunk, or unknown type of message.
+        CHUNK_IGNORED, ///< Already received, or waiting for a resend.
+        CHUNK_ACCEPTED, ///< Written, the transfer continues.
+        CHUNK_COMPLETED, ///< Written, the transfer is complete.
+        CHUNK_MISSING ///< Data is missing: ask the phone to resend it.
+    };
+
+    /// State of a transfer.
+    struct Transfer
+    {
+        quint32 streamId; ///< Identifier given by the phone.
+        int type; ///< Type of the whole message (see MessageType).
+        qint64 totalSize; ///< Size of the whole message [bytes].
+        qint64 receivedSize; ///< Size written to the file [bytes].
+        qint64 startTime; ///< Reception time of the first chunk [ms].
+        QString filename; ///< File the message is written to.
+        int diskStream; ///< Identifier of the DiskWriter stream.
+        bool resendRequested; ///< Waiting for the chunk at receivedSize.
+    };
+
+    /// Constructor.
+    /// \param diskWriter the writer of the files. It must outlive the
+    /// receiver.
+    explicit ChunkReceiver(DiskWriter &diskWriter);
+
+    /// Destructor. Closes the files of the incomplete transfers, which are
+    /// kept truncated.
+    ~ChunkReceiver();
+
+    /// Set the name of the files of a type of message.
+    /// \param type the type of message (see MessageType).
+    /// \param pattern the name of the files, where "%1" is replaced by the
+    /// date and time of the transfer.
+    void setFilenamePattern(int type, const QString &pattern);
+
+    /// Processes a received chunk.
+    /// \param data the content of the CHUNK message.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    /// \param transfer set to the state of the transfer after the chunk
+    /// (unchanged if the chunk is invalid).
+    /// \return the outcome.
+    ChunkResult addChunk(const QByteArray &data, qint64 groundTime, Transfer &transfer);
+
+    /// Get the incomplete transfers, to ask the phone to resume them after a
+    /// reconnection.
+    /// \return the transfers.
+    QList<Transfer> getIncompleteTransfers() const;
+
+private:
+    DiskWriter &diskWriter;
+    QMap<int, QString> filenamePatterns;
+    QMap<quint32, Transfer> transfers;
+    QSet<quint32> completedStreams;
+};
+
+#endif // CHUNKRECEIVER_H
@@ -0,0 +1,178 @@
+#include "clocksync.h"
+
+#include <cmath>
+
+ClockSync::ClockSync()
+{
+    intervalsCount = 0;
+    newestInterval = -1;
+    pingsCount = 0;
+
+    offset = 0.0;
+    drift = 0.0;
+    referenceTime = 0.0;
+    uncertainty = 0.0;
+
+    delaysValid = false;
+    uplinkDelay = 0.0;
+    downlinkDelay = 0.0;
+}
+
+void ClockSync::addPing(qint64 sentTime, double phoneTime, qint64 receivedTime)
+{
+    if(receivedTime < sentTime)
+        return;
+
+    pingsCount++;
+
+    // Keep the fastest ping of the interval.
+    qint64 intervalStart = receivedTime - receivedTime % CLOCK_SYNC_INTERVAL_MS;
+    bool newInterval = (intervalsCount == 0 || intervals[newestInterval].start != intervalStart);
+
+    if(newInterval)
+    {
+        newestInterval = (newestInterval + 1) % CLOCK_SYNC_INTERVALS;
+        intervalsCount = qMin(intervalsCount + 1, CLOCK_SYNC_INTERVALS);
+    }
+
+    Interval &interval = intervals[newestInterval];
+
+    if(newInterval || receivedTime - sentTime < interval.receivedTime - interval.sentTime)
+    {
+        interval.start = intervalStart;
+        interval.sentTime = sentTime;
+        interval.phoneTime = phoneTime;
+        interval.receivedTime = receivedTime;
+
+        fit();
+    }
+
+    if(!isSynchronized())
+        return;
+
+    // One-way delays of this ping, on the fitted timeline.
+    double answerTime = phoneToGround(phoneTime);
+    double uplink = answerTime - (double)sentTime;
+    double downlink = (double)receivedTime - answerTime;
+
+    if(!delaysValid)
+    {
+        uplinkDelay = uplink;
+        downlinkDelay = downlink;
+        delaysValid = true;
+    }
+    else
+    {
+        uplinkDelay = CLOCK_SYNC_DELAY_LPF * uplinkDelay + (1.0-CLOCK_SYNC_DELAY_LPF) * uplink;
+        downlinkDelay = CLOCK_SYNC_DELAY_LPF * downlinkDelay + (1.0-CLOCK_SYNC_DELAY_LPF) * downlink;
+    }
+}
+
+bool ClockSync::isSynchronized() const
+{
+    return pingsCount >= CLOCK_SYNC_MIN_PINGS;
+}
+
+double ClockSync::phoneToGround(double phoneTime) const
+{
+    return (phoneTime - offset + drift * referenceTime) / (1.0 + drift);
+}
+
+double ClockSync::groundToPhone(double groundTime) const
+{
+    return groundTime + getOffset(groundTime);
+}
+
+double ClockSync::getOffset(double groundTime) const
+{
+    return offset + drift * (groundTime - referenceTime);
+}
+
+double ClockSync::getDriftPpm() const
+{
+    return drift * 1e6;
+}
+
+double ClockSync::getUncertainty() const
+{
+    return uncertainty;
+}
+
+double ClockSync::getUplinkDelay() const
+{
+    return delaysValid ? uplinkDelay : NAN;
+}
+
+double ClockSync::getDownlinkDelay() const
+{
+    return delaysValid ? downlinkDelay : NAN;
+}
+
+void ClockSync::fit()
+{
+    // The pings much slower than the fastest one were queued.
+    double minRtt = INFINITY;
+    int fastest = newestInterval;
+
+    for(int i=0; i<intervalsCount; i++)
+    {
+        double rtt = (double)(intervals[i].receivedTime - intervals[i].sentTime);
+
+        if(rtt < minRtt)
+        {
+            minRtt = rtt;
+            fastest = i;
+        }
+    }
+
+    double maxRtt = 2.0 * minRtt + CLOCK_SYNC_RTT_MARGIN_MS;
+
+    // Offset of each ping, at the middle of its round trip. The times are
+    // relative to the newest ping, to keep the sums accurate.
+    const Interval &newest = intervals[newestInterval];
+    double reference = (newest.sentTime + newest.receivedTime) / 2.0;
+    double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+    double minX = INFINITY, maxX = -INFINITY;
+    int n = 0;
+
+    for(int i=0; i<intervalsCount; i++)
+    {
+        const Interval &interval = intervals[i];
+
+        if(interval.receivedTime - interval.sentTime > maxRtt)
+            continue;
+
+        double middle = (interval.sentTime + interval.receivedTime) / 2.0;
+        double x = middle - reference;
+        double y = interval.phoneTime - middle;
+
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        minX = qMin(minX, x);
+        maxX = qMax(maxX, x);
+        n++;
+    }
+
+    double maxDrift = CLOCK_SYNC_MAX_DRIFT_PPM * 1e-6;
+
+    if(n >= 3 && maxX - minX >= CLOCK_SYNC_MIN_DRIFT_SPAN_MS)
+    {
+        // Least squares line.
+        double slope = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+        drift = qBound(-maxDrift, slope, maxDrift);
+        offset = (sumY - drift * sumX) / n;
+    }
+    else
+    {
+        // Too short to see the drift: the offset of the fastest ping, with
+        // the previous drift.
+        const Interval &best = intervals[fastest];
+        double middle = (best.sentTime + best.receivedTime) / 2.0;
+        offset = best.phoneTime - middle - drift * (middle - reference);
+    }
+
+    referenceTime = reference;
+    uncertainty = minRtt / 2.0;
+}
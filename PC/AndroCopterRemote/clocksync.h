@@ -0,0 +1,109 @@
+/*!
+* \file clocksync.h
+* \brief Synchronization of the phone clock with the ground station clock.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <QtGlobal>
+
+#include "constants.h"
+
+/// Estimates the offset and the drift of the phone clock, relative to the
+/// ground station clock, from the pings (as NTP does).
+///
+/// Each ping is sent at the ground time t1, answered at the phone time tp,
+/// and the answer is received at the ground time t4. If the delays are the
+/// same both ways, the phone time tp was taken at the ground time
+/// (t1+t4)/2, and the error is at most half the round-trip time. The
+/// delays are the most symmetric for the fastest pings (nothing was queued),
+/// so only the fastest ping of each interval of CLOCK_SYNC_INTERVAL_MS is
+/// kept, and a line (offset and drift) is fitted on the kept pings of the
+/// last CLOCK_SYNC_INTERVALS intervals.
+///
+/// Once synchronized, the phone timestamps (telemetry, pongs) can be placed
+/// on the ground timeline, which gives the one-way delays of the link.
+class ClockSync
+{
+public:
+    /// Constructor.
+    ClockSync();
+
+    /// Adds an answered ping.
+    /// \param sentTime sending time of the ping, in the ground clock [ms].
+    /// \param phoneTime time of the answer, in the phone clock [ms].
+    /// \param receivedTime reception time of the answer, in the ground clock
+    /// [ms].
+    void addPing(qint64 sentTime, double phoneTime, qint64 receivedTime);
+
+    /// Get if enough pings have been answered to synchronize the clocks.
+    /// Otherwise, the conversions are meaningless.
+    /// \return true if the clocks are synchronized.
+    bool isSynchronized() const;
+
+    /// Converts a phone time to the ground clock.
+    /// \param phoneTime time in the phone clock [ms].
+    /// \return the same time, in the ground clock [ms].
+    double phoneToGround(double phoneTime) const;
+
+    /// Converts a ground time to the phone clock.
+    /// \param groundTime time in the ground clock [ms].
+    /// \return the same time, in the phone clock [ms].
+    double groundToPhone(double groundTime) const;
+
+    /// Get the offset of the phone clock.
+    /// \param groundTime time at which the offset is evaluated, in the ground
+    /// clock [ms].
+    /// \return the phone time minus the ground time [ms].
+    double getOffset(double groundTime) const;
+
+    /// Get the drift of the phone clock.
+    /// \return the drift, positive if the phone clock is faster [ppm].
+    double getDriftPpm() const;
+
+    /// Get the bound of the error of the offset: half of the smallest
+    /// round-trip time of the fitted pings.
+    /// \return the uncertainty [ms].
+    double getUncertainty() const;
+
+    /// Get the one-way delay of the pings from the ground station to the
+    /// phone, as the flight commands.
+    /// \return the smoothed delay [ms], NaN if not synchronized.
+    double getUplinkDelay() const;
+
+    /// Get the one-way delay of the answers from the phone to the ground
+    /// station, as the telemetry.
+    /// \return the smoothed delay [ms], NaN if not synchronized.
+    double getDownlinkDelay() const;
+
+private:
+    /// Fastest ping of an interval.
+    struct Interval
+    {
+        qint64 start; ///< Start of the interval, in the ground clock [ms].
+        qint64 sentTime; ///< Sending time of the ping, in the ground clock [ms].
+        double phoneTime; ///< Time of the answer, in the phone clock [ms].
+        qint64 receivedTime; ///< Reception time of the answer, in the ground clock [ms].
+    };
+
+    /// Fits the offset and the drift on the kept pings.
+    void fit();
+
+    // Kept pings, in a ring buffer.
+    Interval intervals[CLOCK_SYNC_INTERVALS];
+    int intervalsCount, newestInterval;
+    int pingsCount;
+
+    // Model: phone time = ground time + offset + drift * (ground time -
+    // referenceTime).
+    double offset, drift, referenceTime, uncertainty;
+
+    bool delaysValid;
+    double uplinkDelay, downlinkDelay;
+};
+
+#endif // CLOCKSYNC_H
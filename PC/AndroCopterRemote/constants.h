@@ -16,6 +16,20 @@
 /// http://www.iana.org/assignments/service-names-port-numbers/service-names-port-numbers.xml
 const int IN_PORT = 7444;
 
+/// UDP port of the discovery of the ground station by the phones (see
+/// DiscoveryBeacon). Next to IN_PORT, and unassigned as well.
+const int DISCOVERY_PORT = 7445;
+
+/// Version of the discovery messages, announced in the beacons.
+const int DISCOVERY_PROTOCOL_VERSION = 1;
+
+/// Period of the discovery beacons broadcast on the local networks [ms]. The
+/// phones do not wait for them: they send a query, answered immediately.
+const int DISCOVERY_BEACON_PERIOD_MS = 1000;
+
+/// Features of the ground station, announced in the discovery beacons.
+const QString DISCOVERY_CAPABILITIES = "telemetry,fpv,photo,ping,multi_vehicle";
+
 /// Maximum thrust command. It corresponds to the maximum of a 8 bits value,
 /// because the microcontroller expects a 8 bit value for the motors powers.
 const int MAX_THRUST = 255.0;
@@ -66,6 +80,8 @@ const double DEAD_ZONE_GAMEPAD = GP_AXIS_AMPLITUDE / 20.0;
 /// also has a state. In the case the quadcopter never receives the activation
 /// message (so will not respond), the checkbox will untick itself, to let the
 /// user checking it again.
+/// This is the delay used until the round-trip time of the link has been
+/// measured, and the maximum one after (see LinkMonitor::getStateTimeout()).
 const int REGU_ON_STATE_WAIT_TIME_MS = 4000;
 
 /// Maximum voltage of the Li-Po battery, in volts. This is used to get a rough
@@ -82,6 +98,296 @@ const QString APP_NAME = "AndroCopter remote";
 /// Maximum pitch or roll angle (in degrees) that can be outputted by the PIDs.
 const double MAX_PITCH_ROLL_TARGET_ANGLE = 20.0;
 
+/// Speed at which the sticks move the target of the position hold mode, in
+/// meters per second (at full stick deflection).
+const double POSITION_TARGET_VARSPEED = 1.0; // [m/s].
+
+/// Speed at which the thrust stick moves the altitude target of the position
+/// hold mode, in meters per second (at full stick deflection).
+const double ALTITUDE_TARGET_VARSPEED = 0.5; // [m/s].
+
+/// Maximum age of the last position estimate (from the telemetry or from the
+/// simulator), in milliseconds. If the estimate gets older, the position hold
+/// mode is aborted, because the PIDs would be fed with stale data.
+const int POSITION_ESTIMATE_TIMEOUT_MS = 500;
+
+/// Default coefficients of the horizontal position PIDs (xPid and yPid). The
+/// output is a pitch or roll target angle [deg], from a position error [m].
+const double DEFAULT_XY_PID_KP = 6.0;
+const double DEFAULT_XY_PID_KI = 0.5;
+const double DEFAULT_XY_PID_KD = 4.0;
+
+/// Default coefficients of the vertical position PID (zPid). The output is a
+/// thrust command, from an altitude error [m].
+const double DEFAULT_Z_PID_KP = 30.0;
+const double DEFAULT_Z_PID_KI = 5.0;
+const double DEFAULT_Z_PID_KD = 15.0;
+
+/// Thrust command that makes the simulated quadcopter hover. Used only when
+/// the position estimates come from the simulator instead of the telemetry.
+const double SIMULATOR_HOVER_THRUST = 130.0;
+
+/// Linear drag coefficient of the simulated quadcopter, in 1/s.
+const double SIMULATOR_DRAG = 0.5;
+
+/// Number of telemetry samples kept in memory by the telemetry store. At the
+/// usual telemetry rate (10 Hz), this is one hour of flight.
+const int TELEMETRY_STORE_CAPACITY = 36000;
+
+/// Default refresh rate of the values labels and of the charts, in Hz. The
+/// telemetry can arrive much faster, but refreshing the display at a higher
+/// rate would only waste CPU time. Can be changed in the settings
+/// ("display_refresh_rate").
+const int DISPLAY_REFRESH_RATE_HZ = 15;
+
+/// Number of threads reading and writing the sockets of the phones. Each
+/// connection is handled by one of them, so the GUI thread only processes
+/// whole messages. Two threads are enough for dozens of vehicles, because the
+/// telemetry messages are small.
+const int GROUND_IO_THREADS_COUNT = 2;
+
+/// Default maximum queuing delay of the link allowed by the adaptive FPV, in
+/// milliseconds. Above, the FPV quality and frame rate are lowered, so the
+/// commands and the telemetry are not delayed by the video. Can be changed in
+/// the settings ("fpv_latency_budget_ms").
+const int FPV_LATENCY_BUDGET_MS = 150;
+
+/// Time between two adjustments of the adaptive FPV, in milliseconds.
+const int FPV_CONTROL_PERIOD_MS = 500;
+
+/// Duration of the windows on which the minimum link delay is computed, in
+/// milliseconds. It has to be long enough to contain a moment without
+/// queuing, but short enough to follow the drift of the phone clock.
+const int FPV_BASE_DELAY_WINDOW_MS = 10000;
+
+/// JPEG quality range of the adaptive FPV (1-100). The default is the fixed
+/// quality used by the phone.
+const int FPV_DEFAULT_QUALITY = 80;
+const int FPV_MIN_QUALITY = 20;
+const int FPV_MAX_QUALITY = 90;
+
+/// Frame rate range of the adaptive FPV, in frames per second. The maximum is
+/// the fixed rate of the phone.
+const int FPV_MIN_FRAMERATE = 2;
+const int FPV_MAX_FRAMERATE = 10;
+
+/// Multiplicative decrease of the adaptive FPV, when the link is congested.
+const double FPV_DECREASE_FACTOR = 0.7;
+
+/// Additive increase of the JPEG quality, when the link is not congested.
+const int FPV_QUALITY_STEP = 5;
+
+/// Time between two pings sent to each phone, in milliseconds. The pings also
+/// act as heartbeats for the phone.
+const int LINK_PING_PERIOD_MS = 200;
+
+/// Number of the latest pings used to compute the loss rate of the link.
+const int LINK_LOSS_WINDOW = 50;
+
+/// Delay after which an unanswered ping is counted as lost, in milliseconds.
+const int LINK_PONG_TIMEOUT_MS = 1000;
+
+/// Default thresholds of the link health, in milliseconds. They can be changed
+/// in the settings ("link_degraded_rtt_ms", "link_critical_rtt_ms" and
+/// "link_lost_timeout_ms"). Above the "degraded" round-trip time, the FPV is
+/// reduced to the minimum. Above the "critical" one, the FPV is stopped and
+/// the altitude is locked. After the "lost" timeout without any answer, the
+/// vehicle is stopped.
+const int LINK_DEGRADED_RTT_MS = 200;
+const int LINK_CRITICAL_RTT_MS = 500;
+const int LINK_LOST_TIMEOUT_MS = 1500;
+
+/// Time a disconnected phone has to reconnect and resume its session, in
+/// milliseconds. Meanwhile, its charts and recordings are kept, and the
+/// telemetry of the gap is backfilled when it resumes. The phone keeps a
+/// backlog of the same duration.
+const int SESSION_RESUME_TIMEOUT_MS = 60000;
+
+/// Time to wait for the telemetry backlog of a resumed session, in
+/// milliseconds. The live telemetry is held meanwhile, so the rows stay in
+/// time order.
+const int SESSION_BACKLOG_TIMEOUT_MS = 2000;
+
+/// Default maximum age of the flight commands, from the gamepad sample to
+/// the writing to the socket, in milliseconds. The older commands are counted
+/// as late. Can be changed in the settings ("command_age_budget_ms").
+const int COMMAND_AGE_BUDGET_MS = 30;
+
+/// Default format of the telemetry asked to the phones: true for the compact
+/// binary states (COMPACT_STATE, see TelemetryDecoder), false for the text
+/// ones (CURRENT_STATE). Can be changed in the settings
+/// ("compact_telemetry").
+const bool COMPACT_TELEMETRY = true;
+
+/// Default source of the current attitude and altitude labels: true for the
+/// state predicted by the StateEstimator at the current time (smoother, and
+/// without the link delay), false for the latest telemetry. The charts always
+/// show the telemetry. Can be changed in the settings
+/// ("estimated_state_display").
+const bool ESTIMATED_STATE_DISPLAY = true;
+
+/// Maximum number of bytes waiting in the socket for a command to be written.
+/// Above, the link is congested, and the command waits (and may be replaced
+/// by a newer one).
+const qint64 COMMAND_MAX_SOCKET_BACKLOG = 512;
+
+/// Filtering constant for the low-pass filter of the commands age.
+/// Should be between 0.0 (no filtering) and 1.0 (strong filtering).
+const double COMMAND_AGE_LPF = 0.9;
+
+/// Maximum number of bytes waiting in the socket for a queued message to be
+/// written (see OutboundScheduler). Kept small, as the messages already in
+/// the socket can't be overtaken: a safety message waits at most for these
+/// bytes.
+const qint64 OUTBOUND_MAX_SOCKET_BACKLOG = 256;
+
+/// Rate limits of the queued messages, per priority class [messages/s]. The
+/// safety messages are not limited.
+const double OUTBOUND_COMMAND_RATE_LIMIT = 50.0;
+const double OUTBOUND_CONFIG_RATE_LIMIT = 20.0;
+const double OUTBOUND_BULK_RATE_LIMIT = 5.0;
+
+/// Number of messages of a priority class that can be written at once, after
+/// a quiet period (size of the token bucket).
+const int OUTBOUND_COMMAND_BURST = 10;
+const int OUTBOUND_CONFIG_BURST = 5;
+const int OUTBOUND_BULK_BURST = 2;
+
+/// Maximum number of queued messages of a priority class. Above, the oldest
+/// one is dropped.
+const int OUTBOUND_MAX_QUEUE_SIZE = 64;
+
+/// Filtering constant for the low-pass filter of the queued messages
+/// latency. Should be between 0.0 (no filtering) and 1.0 (strong filtering).
+const double OUTBOUND_LATENCY_LPF = 0.9;
+
+/// Jitter of the round-trip time above which the link is degraded, in
+/// milliseconds.
+const double LINK_DEGRADED_JITTER_MS = 50.0;
+
+/// Loss rates of the pings above which the link is degraded or critical.
+const double LINK_DEGRADED_LOSS_RATE = 0.1;
+const double LINK_CRITICAL_LOSS_RATE = 0.3;
+
+/// Time the link has to stay better before its health is raised again, in
+/// milliseconds. This avoids flapping between two states.
+const int LINK_RECOVERY_TIME_MS = 2000;
+
+/// Margin added to the round-trip time to get the time to wait for a state
+/// change of the phone, in milliseconds. It covers the period of the
+/// telemetry messages, which report the state.
+const int LINK_STATE_MARGIN_MS = 300;
+
+/// Minimum time to wait for a state change of the phone, in milliseconds.
+const int LINK_MIN_STATE_TIMEOUT_MS = 500;
+
+/// Clock synchronization with the phones (see ClockSync): duration of the
+/// intervals in which only the fastest ping is kept, in milliseconds, and
+/// number of intervals the offset and the drift are fitted on.
+const int CLOCK_SYNC_INTERVAL_MS = 4000;
+const int CLOCK_SYNC_INTERVALS = 30;
+
+/// Minimum time span of the fitted pings to estimate the drift of the
+/// clocks, in milliseconds. Below, only the offset is estimated.
+const int CLOCK_SYNC_MIN_DRIFT_SPAN_MS = 20000;
+
+/// Maximum drift between the clocks, in ppm. Larger estimates are clamped:
+/// a quartz drifts by less than 100 ppm.
+const double CLOCK_SYNC_MAX_DRIFT_PPM = 500.0;
+
+/// Margin on the round-trip time of the fitted pings, in milliseconds. The
+/// pings slower than twice the minimum RTT plus this margin were queued,
+/// probably in one direction only, so they are not fitted.
+const double CLOCK_SYNC_RTT_MARGIN_MS = 10.0;
+
+/// Number of answered pings before the clocks are considered synchronized.
+const int CLOCK_SYNC_MIN_PINGS = 5;
+
+/// Filtering constant for the low-pass filter of the one-way delays.
+/// Should be between 0.0 (no filtering) and 1.0 (strong filtering).
+const double CLOCK_SYNC_DELAY_LPF = 0.875;
+
+/// Maximum number of bytes waiting to be written by the disk writer. Above,
+/// the new files are rejected instead of blocking the GUI thread.
+const qint64 DISK_WRITER_MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+/// Alignment of the buffers and of the writes of the O_DIRECT streams, in
+/// bytes. It has to be a multiple of the logical block size of the disk.
+const int DISK_WRITER_DIRECT_ALIGNMENT = 4096;
+
+/// Size of the buffer of the O_DIRECT streams, in bytes. It has to be a
+/// multiple of DISK_WRITER_DIRECT_ALIGNMENT.
+const int DISK_WRITER_DIRECT_BUFFER_SIZE = 1024 * 1024;
+
+/// Size of the chunks preallocated for the streams, in bytes.
+const qint64 DISK_WRITER_PREALLOCATION_SIZE = 16 * 1024 * 1024;
+
+/// Number of rows of a block of the columnar telemetry export. Each column
+/// of a block is compressed separately: bigger blocks compress better, but
+/// more rows are lost if the application crashes.
+const int TELEMETRY_EXPORT_BLOCK_ROWS = 1024;
+
+/// Number of rows of the CSV telemetry export written at once.
+const int TELEMETRY_EXPORT_CSV_FLUSH_ROWS = 32;
+
+/// Distance between two points of the sparse index of a recorded FPV video,
+/// in bytes. Finding a frame reads at most the tags of the frames of this
+/// distance.
+const qint64 ARCHIVE_VIDEO_INDEX_STRIDE = 4 * 1024 * 1024;
+
+/// Duration of the recorded telemetry read for the charts, in milliseconds,
+/// before the browsed time.
+const int ARCHIVE_CHART_SPAN_MS = 10000;
+
+/// Maximum number of rows of the recorded telemetry read for the charts.
+const int ARCHIVE_STORE_CAPACITY = 4096;
+
+/// Number of messages kept in memory and displayed by the messages log. The
+/// older ones are only in the messages file.
+const int MESSAGE_LOG_CAPACITY = 5000;
+
+/// Reading period of the gamepad, in milliseconds. Shorter than
+/// UPDATE_PERIOD_MS, so the sent commands use a recent state of the sticks.
+const int GAMEPAD_POLL_PERIOD_MS = 5;
+
+/// Maximum number of button presses waiting to be processed.
+const int GAMEPAD_PRESSES_QUEUE_SIZE = 64;
+
+/// Cutoff frequency of the filter of the sticks speed, used by the one-euro
+/// filter of the input shaping, in Hz.
+const double INPUT_SHAPER_SPEED_CUTOFF_HZ = 1.0;
+
+/// Default expo of the sticks. Can be changed in the settings
+/// ("thrust_shaping", "yaw_shaping", "pitch_shaping", "roll_shaping": dead
+/// zone, expo, minimum cutoff [Hz], beta, maximum rate [full scales/s]).
+const double STICKS_EXPO = 0.3;
+
+/// Default dead zone of the pitch and roll sticks. Smaller than the one of
+/// the thrust and yaw (DEAD_ZONE_GAMEPAD), because these axes are not
+/// integrated.
+const double PITCH_ROLL_DEAD_ZONE = GP_AXIS_AMPLITUDE / 50.0;
+
+/// Default filtering of the pitch and roll sticks noise (one-euro filter):
+/// minimum cutoff frequency [Hz] and speed coefficient.
+const double PITCH_ROLL_FILTER_MIN_CUTOFF_HZ = 1.5;
+const double PITCH_ROLL_FILTER_BETA = 0.5;
+
+/// Default maximum variation speed of the pitch and roll sticks, in full
+/// scales per second.
+const double PITCH_ROLL_MAX_RATE = 4.0;
+
+/// Maximum number of telemetry messages waiting to be processed by the GUI
+/// thread. Above, the messages go through the event loop.
+const int TELEMETRY_HANDOFF_CAPACITY = 1024;
+
+/// Maximum number of free buffers of each size class kept by the pool of the
+/// received messages.
+const int MESSAGE_POOL_MAX_FREE = 16;
+
+/// Maximum number of free decoded FPV frames kept. Two are enough at a steady
+/// resolution: the displayed one and the one being decoded.
+const int FRAME_POOL_MAX_FREE = 3;
+
 /// Filtering constant for the low-pass filter of the FPV rate.
 /// Should be between 0.0 (no filtering) and 1.0 (strong filtering).
 const double FPV_RATE_LPF = 0.8;
@@ -0,0 +1,150 @@
+#include "discoverybeacon.h"
+
+#include <QHostInfo>
+#include <QNetworkInterface>
+
+/// First word of the discovery messages.
+static const char QUERY_KEYWORD[] = "ANDROCOPTER_DISCOVER";
+static const char BEACON_KEYWORD[] = "ANDROCOPTER_GROUND";
+
+/// Maximum size of a discovery message.
+static const int MAX_DATAGRAM_SIZE = 512;
+
+DiscoveryBeacon::DiscoveryBeacon(QObject *parent) :
+    QObject(parent), socket(this), beaconTimer(this)
+{
+    answeredQueriesCount = 0;
+
+    connect(&socket, SIGNAL(readyRead()), this, SLOT(readQueries()));
+    connect(&beaconTimer, SIGNAL(timeout()), this, SLOT(broadcastBeacon()));
+}
+
+bool DiscoveryBeacon::start(quint16 tcpPort, quint16 discoveryPort)
+{
+    stop();
+
+    // Share the port, so a second ground station on the same computer (e.g.
+    // the DiscoveryProbe) can still start.
+    if(!socket.bind(QHostAddress::AnyIPv4, discoveryPort,
+                    QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+    {
+        return false;
+    }
+
+    beacon = makeBeacon(tcpPort, QHostInfo::localHostName());
+
+    if(discoveryPort != 0)
+    {
+        broadcastBeacon();
+        beaconTimer.start(DISCOVERY_BEACON_PERIOD_MS);
+    }
+
+    return true;
+}
+
+void DiscoveryBeacon::stop()
+{
+    beaconTimer.stop();
+    socket.close();
+}
+
+quint16 DiscoveryBeacon::getDiscoveryPort() const
+{
+    return socket.localPort();
+}
+
+int DiscoveryBeacon::getAnsweredQueriesCount() const
+{
+    return answeredQueriesCount;
+}
+
+QByteArray DiscoveryBeacon::makeQuery()
+{
+    QByteArray query(QUERY_KEYWORD);
+    query += ' ';
+    query += QByteArray::number(DISCOVERY_PROTOCOL_VERSION);
+    query += '\n';
+
+    return query;
+}
+
+QByteArray DiscoveryBeacon::makeBeacon(quint16 tcpPort, const QString &name)
+{
+    // The name is the last field, so it must not contain line breaks.
+    QString line = QString("%1 %2 %3 %4 %5\n").arg(BEACON_KEYWORD)
+                                              .arg(DISCOVERY_PROTOCOL_VERSION)
+                                              .arg(tcpPort)
+                                              .arg(DISCOVERY_CAPABILITIES)
+                                              .arg(name.simplified());
+
+    return line.toLatin1();
+}
+
+bool DiscoveryBeacon::parseBeacon(const QByteArray &datagram, Announce &announce)
+{
+    QStringList words = QString::fromLatin1(datagram).trimmed().split(' ', QString::SkipEmptyParts);
+
+    if(words.size() < 4 || words[0] != BEACON_KEYWORD)
+        return false;
+
+    bool versionOk, portOk;
+    announce.version = words[1].toInt(&versionOk);
+    announce.port = words[2].toUShort(&portOk);
+
+    if(!versionOk || !portOk || announce.port == 0)
+        return false;
+
+    announce.capabilities = words[3].split(',', QString::SkipEmptyParts);
+    announce.name = QStringList(words.mid(4)).join(" ");
+
+    return true;
+}
+
+void DiscoveryBeacon::readQueries()
+{
+    char datagram[MAX_DATAGRAM_SIZE];
+
+    while(socket.hasPendingDatagrams())
+    {
+        QHostAddress sender;
+        quint16 senderPort;
+        qint64 size = socket.readDatagram(datagram, sizeof(datagram), &sender, &senderPort);
+
+        // Ignore the beacons (ours, or of other ground stations), and any
+        // unknown datagram. The version of the query is not checked: the
+        // beacon tells the version to the phone.
+        if(size < (qint64)sizeof(QUERY_KEYWORD) - 1 ||
+           !QByteArray::fromRawData(datagram, size).startsWith(QUERY_KEYWORD))
+        {
+            continue;
+        }
+
+        socket.writeDatagram(beacon, sender, senderPort);
+        answeredQueriesCount++;
+    }
+}
+
+void DiscoveryBeacon::broadcastBeacon()
+{
+    quint16 port = socket.localPort();
+
+    // The limited broadcast address (255.255.255.255) only goes out through
+    // the default interface on some systems, so broadcast on each network.
+    socket.writeDatagram(beacon, QHostAddress::Broadcast, port);
+
+    foreach(const QNetworkInterface &interface, QNetworkInterface::allInterfaces())
+    {
+        if(!interface.flags().testFlag(QNetworkInterface::IsRunning) ||
+           !interface.flags().testFlag(QNetworkInterface::CanBroadcast) ||
+           interface.flags().testFlag(QNetworkInterface::IsLoopBack))
+        {
+            continue;
+        }
+
+        foreach(const QNetworkAddressEntry &entry, interface.addressEntries())
+        {
+            if(!entry.broadcast().isNull())
+                socket.writeDatagram(beacon, entry.broadcast(), port);
+        }
+    }
+}
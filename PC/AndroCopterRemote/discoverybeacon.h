@@ -0,0 +1,97 @@
+/*!
+* \file discoverybeacon.h
+* \brief UDP discovery of the ground station on the local networks.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef DISCOVERYBEACON_H
+#define DISCOVERYBEACON_H
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QTimer>
+#include <QByteArray>
+#include <QStringList>
+
+#include "constants.h"
+
+/// UDP discovery of the ground station, so the phones connect to it without
+/// typing its IP address.
+///
+/// The messages are single lines of ASCII text:
+/// - query, sent by a phone to the broadcast address on DISCOVERY_PORT:
+/// "ANDROCOPTER_DISCOVER <version>".
+/// - beacon, answered immediately to the sender of a query, and broadcast
+/// every DISCOVERY_BEACON_PERIOD_MS on each local network:
+/// "ANDROCOPTER_GROUND <version> <TCP port> <capabilities> <host name>",
+/// where the capabilities are separated by commas.
+/// The phone then connects to the sender of the beacon, on the announced TCP
+/// port.
+class DiscoveryBeacon : public QObject
+{
+    Q_OBJECT
+public:
+    /// Content of a beacon.
+    struct Announce
+    {
+        int version; ///< Version of the discovery messages.
+        quint16 port; ///< TCP port of the ground station.
+        QStringList capabilities; ///< Features of the ground station.
+        QString name; ///< Host name of the ground station.
+    };
+
+    /// Constructor.
+    /// \param parent parent object.
+    explicit DiscoveryBeacon(QObject *parent = 0);
+
+    /// Starts answering the queries and broadcasting the beacons.
+    /// \param tcpPort TCP port of the ground station, to announce.
+    /// \param discoveryPort UDP port to listen on, and to broadcast to. 0 to
+    /// use any free port (see getDiscoveryPort()), without broadcasting.
+    /// \return true if the UDP port could be opened, false otherwise.
+    bool start(quint16 tcpPort, quint16 discoveryPort = DISCOVERY_PORT);
+
+    /// Stops answering and broadcasting.
+    void stop();
+
+    /// Get the UDP port listened on.
+    /// \return the port, or 0 if not started.
+    quint16 getDiscoveryPort() const;
+
+    /// Get the number of queries answered since the start.
+    /// \return the number of queries.
+    int getAnsweredQueriesCount() const;
+
+    /// Creates a query, as sent by the phones.
+    /// \return the datagram.
+    static QByteArray makeQuery();
+
+    /// Creates a beacon.
+    /// \param tcpPort TCP port of the ground station.
+    /// \param name host name of the ground station.
+    /// \return the datagram.
+    static QByteArray makeBeacon(quint16 tcpPort, const QString &name);
+
+    /// Reads a beacon.
+    /// \param datagram the received datagram.
+    /// \param announce set to the content of the beacon.
+    /// \return true if the datagram is a valid beacon, false otherwise.
+    static bool parseBeacon(const QByteArray &datagram, Announce &announce);
+
+private slots:
+    /// Answers the received queries.
+    void readQueries();
+
+    /// Broadcasts a beacon on each local network.
+    void broadcastBeacon();
+
+private:
+    QUdpSocket socket;
+    QTimer beaconTimer;
+    QByteArray beacon;
+    int answeredQueriesCount;
+};
+
+#endif // DISCOVERYBEACON_H
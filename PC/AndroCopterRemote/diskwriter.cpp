@@ -0,0 +1,432 @@
+#include "diskwriter.h"
+#include "constants.h"
+
+#include <QMutexLocker>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+DiskWriter::DiskWriter(qint64 maxQueuedBytes)
+{
+    this->maxQueuedBytes = maxQueuedBytes;
+    stopRequested = false;
+    nextStreamId = 1;
+    fsyncPolicy = FSYNC_ON_CLOSE;
+    memset(&stats, 0, sizeof(stats));
+
+    start(QThread::LowPriority);
+}
+
+DiskWriter::~DiskWriter()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopRequested = true;
+        queueNotEmpty.wakeOne();
+    }
+
+    wait();
+}
+
+void DiskWriter::setFsyncPolicy(FsyncPolicy policy)
+{
+    QMutexLocker locker(&mutex);
+    fsyncPolicy = policy;
+}
+
+bool DiskWriter::writeFile(const QString &filename, const QByteArray &data,
+                           bool notify)
+{
+    Request request;
+    request.type = Request::WRITE_FILE;
+    request.streamId = 0;
+    request.flags = 0;
+    request.notify = notify;
+    request.filename = filename;
+    request.data = data;
+
+    return enqueue(request);
+}
+
+int DiskWriter::openStream(const QString &filename, int flags)
+{
+    Request request;
+    request.type = Request::OPEN_STREAM;
+    request.flags = flags;
+    request.notify = false;
+    request.filename = filename;
+
+    {
+        QMutexLocker locker(&mutex);
+        request.streamId = nextStreamId;
+        nextStreamId++;
+    }
+
+    enqueue(request);
+
+    return request.streamId;
+}
+
+bool DiskWriter::appendStream(int streamId, const QByteArray &data)
+{
+    Request request;
+    request.type = Request::APPEND_STREAM;
+    request.streamId = streamId;
+    request.flags = 0;
+    request.notify = false;
+    request.data = data;
+
+    return enqueue(request);
+}
+
+void DiskWriter::closeStream(int streamId)
+{
+    Request request;
+    request.type = Request::CLOSE_STREAM;
+    request.streamId = streamId;
+    request.flags = 0;
+    request.notify = false;
+
+    enqueue(request);
+}
+
+DiskWriterStats DiskWriter::getStats() const
+{
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+bool DiskWriter::enqueue(const Request &request)
+{
+    QMutexLocker locker(&mutex);
+
+    // Only the requests carrying data can be rejected, so the streams are
+    // always closed.
+    if(!request.data.isEmpty() &&
+       stats.queuedBytes + request.data.size() > maxQueuedBytes)
+    {
+        stats.droppedCount++;
+        return false;
+    }
+
+    queue.enqueue(request);
+
+    stats.requestsCount++;
+    stats.queuedBytes += request.data.size();
+
+    if(stats.queuedBytes > stats.queuedBytesHighWater)
+        stats.queuedBytesHighWater = stats.queuedBytes;
+
+    queueNotEmpty.wakeOne();
+
+    return true;
+}
+
+void DiskWriter::run()
+{
+    while(true)
+    {
+        // Take all the queued requests at once.
+        QQueue<Request> batch;
+
+        {
+            QMutexLocker locker(&mutex);
+
+            while(queue.isEmpty() && !stopRequested)
+                queueNotEmpty.wait(&mutex);
+
+            if(queue.isEmpty()) // Stop requested, and everything written.
+                break;
+
+            batch = queue;
+            queue.clear();
+        }
+
+        qint64 batchBytes = 0;
+
+        while(!batch.isEmpty())
+        {
+            Request request = batch.dequeue();
+            batchBytes += request.data.size();
+            process(request);
+        }
+
+        // Write the appends coalesced during the batch.
+        bool syncStreams;
+
+        {
+            QMutexLocker locker(&mutex);
+            syncStreams = (fsyncPolicy == FSYNC_EACH_BATCH);
+        }
+
+        for(QMap<int, Stream>::iterator it = streams.begin(); it != streams.end(); ++it)
+        {
+            Stream &stream = it.value();
+
+            if(!stream.pending.isEmpty())
+            {
+                flushStream(stream);
+
+                if(syncStreams && !stream.failed)
+                    syncFile(*stream.file);
+            }
+        }
+
+        QMutexLocker locker(&mutex);
+        stats.queuedBytes -= batchBytes;
+    }
+
+    // Close the streams which have not been closed by the user.
+    for(QMap<int, Stream>::iterator it = streams.begin(); it != streams.end(); ++it)
+        closeStreamFile(it.value());
+
+    streams.clear();
+}
+
+void DiskWriter::process(Request &request)
+{
+    switch(request.type)
+    {
+    case Request::WRITE_FILE:
+        writeWholeFile(request);
+        break;
+
+    case Request::OPEN_STREAM:
+    {
+        Stream stream;
+        stream.file = new QFile(request.filename);
+        stream.flags = request.flags;
+        stream.failed = false;
+        stream.directBuffer = 0;
+        stream.directBufferUsed = 0;
+        stream.allocatedSize = 0;
+        stream.writtenSize = 0;
+
+        if(!stream.file->open(QFile::WriteOnly | QFile::Truncate | QFile::Unbuffered))
+        {
+            stream.failed = true;
+            emit writeFailed(request.filename);
+        }
+#if defined(Q_OS_LINUX)
+        else if(stream.flags & STREAM_DIRECT)
+        {
+            // O_DIRECT needs aligned buffers, and writes of whole blocks.
+            int fd = stream.file->handle();
+            void *buffer = 0;
+
+            if(posix_memalign(&buffer, DISK_WRITER_DIRECT_ALIGNMENT,
+                              DISK_WRITER_DIRECT_BUFFER_SIZE) == 0 &&
+               fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) == 0)
+            {
+                stream.directBuffer = (char*)buffer;
+            }
+            else
+            {
+                free(buffer); // Not supported by the file system.
+                stream.flags &= ~STREAM_DIRECT;
+            }
+        }
+#else
+        stream.flags &= ~(STREAM_DIRECT | STREAM_PREALLOCATE);
+#endif
+
+        streams.insert(request.streamId, stream);
+        break;
+    }
+
+    case Request::APPEND_STREAM:
+    {
+        QMap<int, Stream>::iterator it = streams.find(request.streamId);
+
+        if(it != streams.end() && !it.value().failed)
+            it.value().pending.append(request.data);
+
+        break;
+    }
+
+    case Request::CLOSE_STREAM:
+    {
+        QMap<int, Stream>::iterator it = streams.find(request.streamId);
+
+        if(it != streams.end())
+        {
+            flushStream(it.value());
+            closeStreamFile(it.value());
+            streams.erase(it);
+        }
+
+        break;
+    }
+    }
+}
+
+void DiskWriter::writeWholeFile(const Request &request)
+{
+    FsyncPolicy policy;
+
+    {
+        QMutexLocker locker(&mutex);
+        policy = fsyncPolicy;
+    }
+
+    QFile file(request.filename);
+    bool ok = file.open(QFile::WriteOnly | QFile::Truncate) &&
+              file.write(request.data) == request.data.size();
+
+    if(ok && policy != FSYNC_NEVER)
+        ok = file.flush() && syncFile(file);
+
+    file.close();
+
+    {
+        QMutexLocker locker(&mutex);
+        stats.writesCount++;
+
+        if(ok)
+            stats.bytesWritten += request.data.size();
+        else
+            stats.errorsCount++;
+    }
+
+    if(!ok)
+        emit writeFailed(request.filename);
+    else if(request.notify)
+        emit fileWritten(request.filename);
+}
+
+void DiskWriter::flushStream(Stream &stream)
+{
+    if(stream.pending.isEmpty())
+        return;
+
+    if(!stream.failed &&
+       !writeStreamData(stream, stream.pending.constData(), stream.pending.size()))
+    {
+        stream.failed = true;
+        emit writeFailed(stream.file->fileName());
+    }
+
+    stream.pending.clear();
+}
+
+bool DiskWriter::writeStreamData(Stream &stream, const char *data, qint64 size)
+{
+    bool ok = true;
+    qint64 written = 0;
+    int writesCount = 0;
+
+#if defined(Q_OS_LINUX)
+    // Reserve the disk space by big chunks, without changing the file size,
+    // so the file is not fragmented by the small appends.
+    if((stream.flags & STREAM_PREALLOCATE) &&
+       stream.writtenSize + size > stream.allocatedSize)
+    {
+        qint64 newSize = stream.writtenSize + size + DISK_WRITER_PREALLOCATION_SIZE;
+
+        if(fallocate(stream.file->handle(), FALLOC_FL_KEEP_SIZE,
+                     stream.allocatedSize, newSize - stream.allocatedSize) == 0)
+        {
+            stream.allocatedSize = newSize;
+        }
+        else
+            stream.flags &= ~STREAM_PREALLOCATE; // Not supported.
+    }
+#endif
+
+    if(stream.directBuffer != 0)
+    {
+        // Fill the aligned buffer, and write it when it is full.
+        while(ok && written < size)
+        {
+            int chunk = (int)qMin(size - written,
+                                  (qint64)(DISK_WRITER_DIRECT_BUFFER_SIZE - stream.directBufferUsed));
+            memcpy(stream.directBuffer + stream.directBufferUsed, data + written, chunk);
+            stream.directBufferUsed += chunk;
+            written += chunk;
+
+            if(stream.directBufferUsed == DISK_WRITER_DIRECT_BUFFER_SIZE)
+            {
+                ok = stream.file->write(stream.directBuffer, DISK_WRITER_DIRECT_BUFFER_SIZE)
+                     == DISK_WRITER_DIRECT_BUFFER_SIZE;
+                stream.directBufferUsed = 0;
+                writesCount++;
+            }
+        }
+    }
+    else
+    {
+        ok = stream.file->write(data, size) == size;
+        written = size;
+        writesCount++;
+    }
+
+    stream.writtenSize += written;
+
+    QMutexLocker locker(&mutex);
+    stats.writesCount += writesCount;
+
+    if(ok)
+        stats.bytesWritten += written;
+    else
+        stats.errorsCount++;
+
+    return ok;
+}
+
+void DiskWriter::closeStreamFile(Stream &stream)
+{
+    bool ok = !stream.failed;
+
+    // The tail of the data is not a whole block, so it is written without
+    // O_DIRECT.
+    if(stream.directBuffer != 0)
+    {
+#if defined(Q_OS_LINUX)
+        int fd = stream.file->handle();
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+#endif
+
+        if(ok && stream.directBufferUsed > 0)
+        {
+            ok = stream.file->write(stream.directBuffer, stream.directBufferUsed)
+                 == stream.directBufferUsed;
+        }
+
+        free(stream.directBuffer);
+        stream.directBuffer = 0;
+    }
+
+    FsyncPolicy policy;
+
+    {
+        QMutexLocker locker(&mutex);
+        policy = fsyncPolicy;
+    }
+
+    if(ok && stream.file->isOpen() && policy != FSYNC_NEVER)
+        ok = syncFile(*stream.file);
+
+    if(!ok && !stream.failed)
+        emit writeFailed(stream.file->fileName());
+
+    stream.file->close();
+    delete stream.file;
+    stream.file = 0;
+}
+
+bool DiskWriter::syncFile(QFile &file)
+{
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
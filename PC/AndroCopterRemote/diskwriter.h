@@ -0,0 +1,182 @@
+/*!
+* \file diskwriter.h
+* \brief Background thread writing the files of the application.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef DISKWRITER_H
+#define DISKWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QMap>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+/// Counters of the disk writer, to monitor the backpressure.
+struct DiskWriterStats
+{
+    qint64 queuedBytes; ///< Bytes waiting to be written.
+    qint64 queuedBytesHighWater; ///< Maximum of queuedBytes since the start.
+    qint64 requestsCount; ///< Number of accepted write requests.
+    qint64 writesCount; ///< Number of writes to the disk, after coalescing.
+    qint64 bytesWritten; ///< Number of bytes written to the disk.
+    qint64 droppedCount; ///< Number of requests rejected, queue full.
+    qint64 errorsCount; ///< Number of failed writes.
+};
+
+/// Background thread writing the files of the application.
+/// The GUI thread only queues the data to write, so a slow disk can't stall
+/// the control loop. The queue is bounded (in bytes): when it is full, the
+/// requests are rejected and counted, instead of blocking the caller.
+///
+/// Two kinds of outputs are supported:
+/// - whole files (photos, logs, FPV frames), written and closed at once.
+/// - streams (long recordings), opened once and appended to. The appends
+/// queued together are coalesced into a single write. On Linux, the streams
+/// can be preallocated (fallocate) and written with O_DIRECT, to avoid
+/// fragmenting the file and polluting the page cache.
+///
+/// All the methods can be called from any thread.
+class DiskWriter : public QThread
+{
+    Q_OBJECT
+public:
+    /// When the written data is flushed to the disk (fsync).
+    enum FsyncPolicy
+    {
+        FSYNC_NEVER=0, ///< Left to the OS.
+        FSYNC_ON_CLOSE, ///< When a file or a stream is closed.
+        FSYNC_EACH_BATCH ///< Also after each batch of appends to a stream.
+    };
+
+    /// Options of a stream, to be combined with '|'.
+    enum StreamFlag
+    {
+        STREAM_PREALLOCATE = 1, ///< Preallocate the disk space by chunks.
+        STREAM_DIRECT = 2 ///< Bypass the page cache (O_DIRECT).
+    };
+
+    /// Constructor. Starts the thread.
+    /// \param maxQueuedBytes maximum number of bytes waiting to be written.
+    explicit DiskWriter(qint64 maxQueuedBytes);
+
+    /// Destructor. Writes all the queued data, closes the streams, and stops
+    /// the thread.
+    ~DiskWriter();
+
+    /// Set when the data is flushed to the disk.
+    /// \param policy the policy.
+    void setFsyncPolicy(FsyncPolicy policy);
+
+    /// Queues the writing of a whole file. The file is replaced if it exists.
+    /// \param filename the name of the file.
+    /// \param data the content of the file.
+    /// \param notify if true, fileWritten() will be emitted once the file is
+    /// written.
+    /// \return true if the request has been queued, false if the queue is
+    /// full.
+    bool writeFile(const QString &filename, const QByteArray &data,
+                   bool notify = false);
+
+    /// Queues the opening of a stream. The file is replaced if it exists.
+    /// \param filename the name of the file.
+    /// \param flags combination of StreamFlag.
+    /// \return the identifier of the stream.
+    int openStream(const QString &filename, int flags = 0);
+
+    /// Queues data to append to a stream.
+    /// \param streamId the identifier returned by openStream().
+    /// \param data the data to append.
+    /// \return true if the request has been queued, false if the queue is
+    /// full (the data is then lost).
+    bool appendStream(int streamId, const QByteArray &data);
+
+    /// Queues the closing of a stream, after its pending data.
+    /// \param streamId the identifier returned by openStream().
+    void closeStream(int streamId);
+
+    /// Get the counters.
+    /// \return a copy of the counters.
+    DiskWriterStats getStats() const;
+
+signals:
+    /// Emitted when a file requested with notify has been written.
+    /// \param filename the name of the file.
+    void fileWritten(QString filename);
+
+    /// Emitted when a file or a stream can't be written.
+    /// \param filename the name of the file.
+    void writeFailed(QString filename);
+
+protected:
+    /// Main loop of the thread.
+    void run();
+
+private:
+    /// A queued request.
+    struct Request
+    {
+        enum Type { WRITE_FILE, OPEN_STREAM, APPEND_STREAM, CLOSE_STREAM };
+
+        Type type;
+        int streamId;
+        int flags;
+        bool notify;
+        QString filename;
+        QByteArray data;
+    };
+
+    /// State of an open stream, only used by the thread.
+    struct Stream
+    {
+        QFile *file;
+        int flags;
+        bool failed;
+        QByteArray pending; // Coalesced appends, not written yet.
+        char *directBuffer; // Aligned buffer, for O_DIRECT.
+        int directBufferUsed;
+        qint64 allocatedSize, writtenSize;
+    };
+
+    /// Adds a request to the queue.
+    bool enqueue(const Request &request);
+
+    /// Executes a request. The appends are only coalesced.
+    void process(Request &request);
+
+    /// Writes a whole file.
+    void writeWholeFile(const Request &request);
+
+    /// Writes the coalesced appends of a stream.
+    void flushStream(Stream &stream);
+
+    /// Writes data to a stream file, with the stream options.
+    bool writeStreamData(Stream &stream, const char *data, qint64 size);
+
+    /// Writes the remaining data of a stream, and closes it.
+    void closeStreamFile(Stream &stream);
+
+    /// Flushes a file to the disk.
+    static bool syncFile(QFile &file);
+
+    // Shared with the other threads, protected by the mutex.
+    mutable QMutex mutex;
+    QWaitCondition queueNotEmpty;
+    QQueue<Request> queue;
+    bool stopRequested;
+    int nextStreamId;
+    qint64 maxQueuedBytes;
+    FsyncPolicy fsyncPolicy;
+    DiskWriterStats stats;
+
+    // Only used by the thread.
+    QMap<int, Stream> streams;
+};
+
+#endif // DISKWRITER_H
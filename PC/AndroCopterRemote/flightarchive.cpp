@@ -0,0 +1,551 @@
+#include "flightarchive.h"
+#include "telemetryexporter.h"
+#include "constants.h"
+
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+
+/// Identifies an index file.
+const char INDEX_FILE_MAGIC[4] = {'A', 'C', 'I', 'X'};
+
+/// Version of the index file layout.
+const qint32 INDEX_FILE_VERSION = 1;
+
+/// Size of the header of an index file: magic, version, size of the
+/// recording, end time and number of points.
+const int INDEX_FILE_HEADER_SIZE = 4 + 4 + 8 + 8 + 4;
+
+/// Identifies the comment segment carrying the tag of a video frame.
+const char VIDEO_TAG_MAGIC[4] = {'A', 'C', 'F', 'R'};
+
+/// Size of the tag of a video frame: start of image marker (2), comment
+/// marker (2), segment length (2), magic (4), time (8) and frame size (4).
+const int VIDEO_TAG_SIZE = 2 + 2 + 2 + 4 + 8 + 4;
+
+/// Reads a native 32-bit integer from a mapped file.
+static qint32 readInt32(const uchar *p)
+{
+    qint32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/// Reads a native 64-bit integer from a mapped file.
+static qint64 readInt64(const uchar *p)
+{
+    qint64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+FlightArchive::FlightArchive()
+{
+    telemetryFile.data = 0;
+    telemetryFile.size = 0;
+    videoFile.data = 0;
+    videoFile.size = 0;
+
+    telemetryEndTime = 0;
+    videoEndTime = 0;
+    telemetryDataOffset = 0;
+    telemetryColumnsCount = 0;
+    telemetryChannelsCount = 0;
+}
+
+FlightArchive::~FlightArchive()
+{
+    close();
+}
+
+bool FlightArchive::openTelemetry(const QString &filename)
+{
+    unmapFile(telemetryFile);
+    telemetryIndex.clear();
+
+    if(!mapFile(telemetryFile, filename))
+        return false;
+
+    // File header: magic, version, columns, then the names of the columns.
+    const uchar *p = telemetryFile.data;
+    qint64 size = telemetryFile.size;
+
+    if(size < 12 || memcmp(p, COLUMNAR_FILE_MAGIC, 4) != 0 ||
+       (readInt32(p + 4) != COLUMNAR_FILE_VERSION && readInt32(p + 4) != 2))
+    {
+        qDebug() << "FlightArchive: not a supported telemetry file:" << filename;
+        unmapFile(telemetryFile);
+        return false;
+    }
+
+    telemetryColumnsCount = readInt32(p + 8);
+    qint64 offset = 12;
+
+    // The version 2 has no derived channels.
+    telemetryChannelsCount = (readInt32(p + 4) == 2) ? TM_SYNC_TIME : TM_CHANNELS_COUNT;
+
+    for(int c=0; c<telemetryColumnsCount && offset + 4 <= size; c++)
+        offset += 4 + readInt32(p + offset);
+
+    // The first column is the time, then come the telemetry channels.
+    if(offset > size || telemetryColumnsCount < 1 + telemetryChannelsCount)
+    {
+        qDebug() << "FlightArchive: truncated telemetry file:" << filename;
+        unmapFile(telemetryFile);
+        return false;
+    }
+
+    telemetryDataOffset = offset;
+
+    if(!loadIndex(telemetryFile, telemetryIndex, telemetryEndTime))
+    {
+        if(!buildTelemetryIndex())
+        {
+            unmapFile(telemetryFile);
+            return false;
+        }
+
+        saveIndex(telemetryFile, telemetryIndex, telemetryEndTime);
+    }
+
+    return true;
+}
+
+bool FlightArchive::openVideo(const QString &filename)
+{
+    unmapFile(videoFile);
+    videoIndex.clear();
+
+    if(!mapFile(videoFile, filename))
+        return false;
+
+    if(!loadIndex(videoFile, videoIndex, videoEndTime))
+    {
+        buildVideoIndex();
+
+        if(videoIndex.isEmpty())
+        {
+            qDebug() << "FlightArchive: no tagged frame in the video file:" << filename;
+            unmapFile(videoFile);
+            return false;
+        }
+
+        saveIndex(videoFile, videoIndex, videoEndTime);
+    }
+
+    return true;
+}
+
+void FlightArchive::close()
+{
+    unmapFile(telemetryFile);
+    unmapFile(videoFile);
+    telemetryIndex.clear();
+    videoIndex.clear();
+}
+
+bool FlightArchive::hasTelemetry() const
+{
+    return !telemetryIndex.isEmpty();
+}
+
+bool FlightArchive::hasVideo() const
+{
+    return !videoIndex.isEmpty();
+}
+
+qint64 FlightArchive::getStartTime() const
+{
+    if(hasTelemetry() && hasVideo())
+        return qMin(telemetryIndex.first().time, videoIndex.first().time);
+    else if(hasTelemetry())
+        return telemetryIndex.first().time;
+    else if(hasVideo())
+        return videoIndex.first().time;
+    else
+        return 0;
+}
+
+qint64 FlightArchive::getEndTime() const
+{
+    if(hasTelemetry() && hasVideo())
+        return qMax(telemetryEndTime, videoEndTime);
+    else if(hasTelemetry())
+        return telemetryEndTime;
+    else if(hasVideo())
+        return videoEndTime;
+    else
+        return 0;
+}
+
+int FlightArchive::readTelemetry(qint64 from, qint64 to, TelemetryStore &store) const
+{
+    if(!hasTelemetry())
+        return 0;
+
+    int rowsRead = 0;
+    QVector<qint64> times;
+    QVector<double> columns[TM_CHANNELS_COUNT];
+    double values[TM_CHANNELS_COUNT];
+
+    for(int b = findIndexEntry(telemetryIndex, from);
+        b < telemetryIndex.size() && telemetryIndex[b].time <= to; b++)
+    {
+        // The file may be corrupted, or partly written, and the index may
+        // come from an older file: check that the block is in the mapping.
+        qint64 offset = telemetryIndex[b].offset;
+
+        if(offset < 0 || offset + COLUMNAR_BLOCK_HEADER_SIZE > telemetryFile.size)
+        {
+            qDebug() << "FlightArchive: telemetry block out of the file at" << offset;
+            continue;
+        }
+
+        const uchar *block = telemetryFile.data + offset;
+        int rows = readInt32(block + 4);
+        qint64 lastTime = readInt64(block + 16);
+        int columnsSize = readInt32(block + 24);
+
+        if(memcmp(block, COLUMNAR_BLOCK_MAGIC, 4) != 0 || rows <= 0 || columnsSize < 0 ||
+           offset + COLUMNAR_BLOCK_HEADER_SIZE + columnsSize > telemetryFile.size)
+        {
+            qDebug() << "FlightArchive: corrupted telemetry block at" << offset;
+            continue;
+        }
+
+        if(lastTime < from)
+            continue;
+
+        // Decode the time and the telemetry columns, the commands are not
+        // displayed. Each column must stay inside the block.
+        const uchar *p = block + COLUMNAR_BLOCK_HEADER_SIZE;
+        const uchar *blockEnd = p + columnsSize;
+        bool ok = true;
+
+        times.resize(rows);
+
+        for(int c=0; c<1 + telemetryChannelsCount && ok; c++)
+        {
+            if(blockEnd - p < 8)
+            {
+                ok = false;
+                break;
+            }
+
+            int encoding = readInt32(p);
+            int size = readInt32(p + 4);
+
+            if(size < 0 || size > blockEnd - p - 8)
+            {
+                ok = false;
+                break;
+            }
+
+            QByteArray shuffled = qUncompress(p + 8, size);
+            p += 8 + size;
+
+            if((qint64)shuffled.size() != (qint64)rows * (qint64)sizeof(quint64))
+            {
+                ok = false;
+                break;
+            }
+
+            // Regroup the bytes of each word, then undo the delta or XOR.
+            const uchar *bytes = (const uchar*)shuffled.constData();
+            quint64 previous = 0;
+
+            if(c > 0)
+                columns[c-1].resize(rows);
+
+            for(int i=0; i<rows; i++)
+            {
+                quint64 word = 0;
+
+                for(int k=0; k<(int)sizeof(quint64); k++)
+                    word |= (quint64)bytes[k * rows + i] << (8 * k);
+
+                if(encoding == TelemetryExporter::COLUMN_DELTA_INT64)
+                    previous += word;
+                else
+                    previous ^= word;
+
+                if(c == 0)
+                    times[i] = (qint64)previous;
+                else
+                    memcpy(&columns[c-1][i], &previous, sizeof(double));
+            }
+        }
+
+        if(!ok)
+        {
+            qDebug() << "FlightArchive: corrupted telemetry block at" << offset;
+            continue;
+        }
+
+        for(int i=0; i<rows; i++)
+        {
+            if(times[i] < from || times[i] > to)
+                continue;
+
+            for(int c=0; c<TM_CHANNELS_COUNT; c++)
+                values[c] = (c < telemetryChannelsCount) ? columns[c][i] : NAN;
+
+            store.append(times[i], values);
+            rowsRead++;
+        }
+    }
+
+    return rowsRead;
+}
+
+QByteArray FlightArchive::videoFrameAt(qint64 time) const
+{
+    if(!hasVideo())
+        return QByteArray();
+
+    // Start from the index point, then follow the frames.
+    qint64 offset = videoIndex[findIndexEntry(videoIndex, time)].offset;
+    qint64 frameTime, frameSize;
+
+    if(!readVideoFrameTag(offset, frameTime, frameSize))
+        return QByteArray();
+
+    qint64 nextTime, nextSize;
+
+    while(readVideoFrameTag(offset + frameSize, nextTime, nextSize) && nextTime <= time)
+    {
+        offset += frameSize;
+        frameSize = nextSize;
+    }
+
+    return QByteArray::fromRawData((const char*)videoFile.data + offset, (int)frameSize);
+}
+
+QByteArray FlightArchive::tagVideoFrame(qint64 groundTime, const QByteArray &jpeg)
+{
+    // Not a JPEG image, it could not be tagged without breaking it.
+    if(jpeg.size() < 2 || (uchar)jpeg[0] != 0xFF || (uchar)jpeg[1] != 0xD8)
+        return QByteArray();
+
+    QByteArray frame(VIDEO_TAG_SIZE + jpeg.size() - 2, 0);
+    uchar *p = (uchar*)frame.data();
+
+    p[0] = 0xFF; p[1] = 0xD8; // Start of image.
+    p[2] = 0xFF; p[3] = 0xFE; // Comment segment.
+    qToBigEndian<quint16>(VIDEO_TAG_SIZE - 4, p + 4); // Without the markers.
+    memcpy(p + 6, VIDEO_TAG_MAGIC, 4);
+    qToBigEndian<qint64>(groundTime, p + 10);
+    qToBigEndian<qint32>(frame.size(), p + 18);
+    memcpy(p + VIDEO_TAG_SIZE, jpeg.constData() + 2, jpeg.size() - 2);
+
+    return frame;
+}
+
+QByteArray FlightArchive::makeIndexFile(const QVector<IndexEntry> &index,
+                                        qint64 fileSize, qint64 endTime)
+{
+    QByteArray content(INDEX_FILE_MAGIC, 4);
+    qint32 version = INDEX_FILE_VERSION;
+    qint32 count = index.size();
+
+    content.append((const char*)&version, sizeof(version));
+    content.append((const char*)&fileSize, sizeof(fileSize));
+    content.append((const char*)&endTime, sizeof(endTime));
+    content.append((const char*)&count, sizeof(count));
+    content.append((const char*)index.constData(), count * (int)sizeof(IndexEntry));
+
+    return content;
+}
+
+bool FlightArchive::mapFile(MappedFile &mapped, const QString &filename)
+{
+    mapped.file.setFileName(filename);
+
+    if(!mapped.file.open(QFile::ReadOnly))
+        return false;
+
+    mapped.size = mapped.file.size();
+    mapped.data = mapped.file.map(0, mapped.size);
+
+    // The whole file has to fit in the address space (64-bit systems).
+    if(mapped.data == 0)
+    {
+        qDebug() << "FlightArchive: can't map the file:" << filename;
+        mapped.file.close();
+        mapped.size = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void FlightArchive::unmapFile(MappedFile &mapped)
+{
+    if(mapped.data != 0)
+        mapped.file.unmap((uchar*)mapped.data);
+
+    mapped.file.close();
+    mapped.data = 0;
+    mapped.size = 0;
+}
+
+bool FlightArchive::loadIndex(const MappedFile &mapped, QVector<IndexEntry> &index,
+                              qint64 &endTime)
+{
+    QFile file(mapped.file.fileName() + ".idx");
+
+    if(!file.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray content = file.readAll();
+    const uchar *p = (const uchar*)content.constData();
+
+    // The index is out of date if the recording changed size.
+    if(content.size() < INDEX_FILE_HEADER_SIZE || memcmp(p, INDEX_FILE_MAGIC, 4) != 0 ||
+       readInt32(p + 4) != INDEX_FILE_VERSION || readInt64(p + 8) != mapped.size)
+    {
+        return false;
+    }
+
+    int count = readInt32(p + 24);
+
+    if(count <= 0 || content.size() != INDEX_FILE_HEADER_SIZE + count * (int)sizeof(IndexEntry))
+        return false;
+
+    endTime = readInt64(p + 16);
+    index.resize(count);
+    memcpy(index.data(), p + INDEX_FILE_HEADER_SIZE, count * sizeof(IndexEntry));
+
+    return true;
+}
+
+void FlightArchive::saveIndex(const MappedFile &mapped, const QVector<IndexEntry> &index,
+                              qint64 endTime)
+{
+    QFile file(mapped.file.fileName() + ".idx");
+
+    // Not an error: the index will be rebuilt next time.
+    if(!file.open(QFile::WriteOnly | QFile::Truncate) ||
+       file.write(makeIndexFile(index, mapped.size, endTime)) < 0)
+    {
+        qDebug() << "FlightArchive: can't save the index" << file.fileName();
+    }
+}
+
+bool FlightArchive::buildTelemetryIndex()
+{
+    // Jump from block header to block header. A truncated last block (the
+    // recording was interrupted) is ignored.
+    qint64 offset = telemetryDataOffset;
+
+    while(offset + COLUMNAR_BLOCK_HEADER_SIZE <= telemetryFile.size)
+    {
+        const uchar *block = telemetryFile.data + offset;
+        qint64 blockSize = COLUMNAR_BLOCK_HEADER_SIZE + readInt32(block + 24);
+
+        if(memcmp(block, COLUMNAR_BLOCK_MAGIC, 4) != 0 ||
+           offset + blockSize > telemetryFile.size)
+        {
+            break;
+        }
+
+        IndexEntry entry;
+        entry.time = readInt64(block + 8);
+        entry.offset = offset;
+        telemetryIndex.append(entry);
+        telemetryEndTime = readInt64(block + 16);
+
+        offset += blockSize;
+    }
+
+    return !telemetryIndex.isEmpty();
+}
+
+void FlightArchive::buildVideoIndex()
+{
+    const uchar *data = videoFile.data;
+    qint64 size = videoFile.size;
+    qint64 time, frameSize;
+
+    // Look for the first frame after each stride. The start of image marker
+    // can't appear inside the compressed data of a JPEG image, so the first
+    // one found is the beginning of a frame.
+    for(qint64 start = 0; start < size; start += ARCHIVE_VIDEO_INDEX_STRIDE)
+    {
+        qint64 end = qMin(start + ARCHIVE_VIDEO_INDEX_STRIDE, size);
+
+        for(qint64 offset = start; offset < end; offset++)
+        {
+            const uchar *marker = (const uchar*)memchr(data + offset, 0xFF, end - offset);
+
+            if(marker == 0)
+                break;
+
+            offset = marker - data;
+
+            if(readVideoFrameTag(offset, time, frameSize))
+            {
+                if(videoIndex.isEmpty() || offset > videoIndex.last().offset)
+                {
+                    IndexEntry entry;
+                    entry.time = time;
+                    entry.offset = offset;
+                    videoIndex.append(entry);
+                }
+
+                break;
+            }
+        }
+    }
+
+    // The end time is the time of the last complete frame.
+    if(videoIndex.isEmpty())
+        return;
+
+    qint64 offset = videoIndex.last().offset;
+
+    while(readVideoFrameTag(offset, time, frameSize))
+    {
+        videoEndTime = time;
+        offset += frameSize;
+    }
+}
+
+bool FlightArchive::readVideoFrameTag(qint64 offset, qint64 &time, qint64 &size) const
+{
+    if(offset < 0 || offset + VIDEO_TAG_SIZE > videoFile.size)
+        return false;
+
+    const uchar *p = videoFile.data + offset;
+
+    if(p[0] != 0xFF || p[1] != 0xD8 || p[2] != 0xFF || p[3] != 0xFE ||
+       qFromBigEndian<quint16>(p + 4) != VIDEO_TAG_SIZE - 4 ||
+       memcmp(p + 6, VIDEO_TAG_MAGIC, 4) != 0)
+    {
+        return false;
+    }
+
+    time = qFromBigEndian<qint64>(p + 10);
+    size = qFromBigEndian<qint32>(p + 18);
+
+    return size > VIDEO_TAG_SIZE && offset + size <= videoFile.size;
+}
+
+int FlightArchive::findIndexEntry(const QVector<IndexEntry> &index, qint64 time)
+{
+    // Binary search of the last point not after the time.
+    int first = 0, last = index.size() - 1;
+
+    while(first < last)
+    {
+        int middle = (first + last + 1) / 2;
+
+        if(index[middle].time <= time)
+            first = middle;
+        else
+            last = middle - 1;
+    }
+
+    return first;
+}
@@ -0,0 +1,155 @@
+/*!
+* \file flightarchive.h
+* \brief Memory-mapped reader of the recorded telemetry and FPV video.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef FLIGHTARCHIVE_H
+#define FLIGHTARCHIVE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+#include "telemetrystore.h"
+
+/// Memory-mapped reader of a recorded flight: the columnar telemetry file
+/// (.tmc, see TelemetryExporter) and the FPV video (.mjpg).
+///
+/// The files are never read as a whole: they are mapped in memory, and only
+/// the pages of the requested time range are loaded by the OS. To find a time
+/// quickly, a sparse index gives the time and the offset of some points of
+/// each file: each block of the telemetry, and a frame every
+/// ARCHIVE_VIDEO_INDEX_STRIDE bytes of the video. The index is loaded from
+/// the .idx file next to the recording if it is up to date, otherwise it is
+/// rebuilt (only the block headers and a few frames are read) and saved.
+///
+/// The video is a plain MJPEG stream (concatenated JPEG images), playable by
+/// the usual tools. Each frame carries its time and its size in a JPEG
+/// comment segment, inserted just after the start of image marker by
+/// tagVideoFrame().
+class FlightArchive
+{
+public:
+    /// Point of a sparse index.
+    struct IndexEntry
+    {
+        qint64 time; ///< Time of the row or of the frame [ms].
+        qint64 offset; ///< Offset of the block or of the frame in the file.
+    };
+
+    /// Constructor.
+    FlightArchive();
+
+    /// Destructor. Closes the files.
+    ~FlightArchive();
+
+    /// Opens a telemetry recording. The previous one is closed.
+    /// \param filename the .tmc file.
+    /// \return true if the file could be opened, false otherwise.
+    bool openTelemetry(const QString &filename);
+
+    /// Opens a video recording. The previous one is closed.
+    /// \param filename the .mjpg file.
+    /// \return true if the file could be opened, false otherwise.
+    bool openVideo(const QString &filename);
+
+    /// Closes the files.
+    void close();
+
+    /// Get if a telemetry recording is open.
+    /// \return true if it is open.
+    bool hasTelemetry() const;
+
+    /// Get if a video recording is open.
+    /// \return true if it is open.
+    bool hasVideo() const;
+
+    /// Get the time of the beginning of the open recordings.
+    /// \return the time, in the ground station clock [ms].
+    qint64 getStartTime() const;
+
+    /// Get the time of the end of the open recordings.
+    /// \return the time, in the ground station clock [ms].
+    qint64 getEndTime() const;
+
+    /// Reads the telemetry rows whose time is in the given range. Only the
+    /// blocks overlapping the range are decoded.
+    /// \param from beginning of the range [ms].
+    /// \param to end of the range (included) [ms].
+    /// \param store the store to append the rows to. If it is too small,
+    /// only the newest rows are kept.
+    /// \return the number of rows read.
+    int readTelemetry(qint64 from, qint64 to, TelemetryStore &store) const;
+
+    /// Get the video frame displayed at the given time: the last frame
+    /// received before it.
+    /// \param time the time [ms].
+    /// \return the JPEG data. It points directly to the mapped file, so it is
+    /// only valid until the video is closed. Empty if there is no frame.
+    QByteArray videoFrameAt(qint64 time) const;
+
+    /// Adds the time and the size to a received FPV frame, to record it.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    /// \param jpeg the JPEG image.
+    /// \return the tagged frame, to append to the .mjpg file.
+    static QByteArray tagVideoFrame(qint64 groundTime, const QByteArray &jpeg);
+
+    /// Creates the content of an index file.
+    /// \param index the points of the index, sorted by time.
+    /// \param fileSize size of the recording, to check that the index is up
+    /// to date.
+    /// \param endTime time of the last row or frame of the recording [ms].
+    /// \return the content of the .idx file.
+    static QByteArray makeIndexFile(const QVector<IndexEntry> &index,
+                                    qint64 fileSize, qint64 endTime);
+
+private:
+    /// A file mapped in memory.
+    struct MappedFile
+    {
+        QFile file;
+        const uchar *data;
+        qint64 size;
+    };
+
+    /// Maps a file in memory.
+    static bool mapFile(MappedFile &mapped, const QString &filename);
+
+    /// Unmaps and closes a file.
+    static void unmapFile(MappedFile &mapped);
+
+    /// Loads the index file of a recording, if it is up to date.
+    static bool loadIndex(const MappedFile &mapped, QVector<IndexEntry> &index,
+                          qint64 &endTime);
+
+    /// Saves the index file of a recording.
+    static void saveIndex(const MappedFile &mapped, const QVector<IndexEntry> &index,
+                          qint64 endTime);
+
+    /// Builds the index of the telemetry from the block headers.
+    bool buildTelemetryIndex();
+
+    /// Builds the index of the video by looking for a frame every
+    /// ARCHIVE_VIDEO_INDEX_STRIDE bytes.
+    void buildVideoIndex();
+
+    /// Reads the tag of a video frame.
+    /// \return true if there is a complete tagged frame at the offset.
+    bool readVideoFrameTag(qint64 offset, qint64 &time, qint64 &size) const;
+
+    /// Get the index point at or before the given time.
+    static int findIndexEntry(const QVector<IndexEntry> &index, qint64 time);
+
+    MappedFile telemetryFile, videoFile;
+    QVector<IndexEntry> telemetryIndex, videoIndex;
+    qint64 telemetryEndTime, videoEndTime;
+    qint64 telemetryDataOffset;
+    int telemetryColumnsCount;
+    int telemetryChannelsCount; // Channels in the file, the others are NaN.
+};
+
+#endif // FLIGHTARCHIVE_H
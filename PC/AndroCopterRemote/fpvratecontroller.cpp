@@ -0,0 +1,145 @@
+#include "fpvratecontroller.h"
+#include "constants.h"
+
+#include <cfloat>
+
+FpvRateController::FpvRateController()
+{
+    latencyBudget = FPV_LATENCY_BUDGET_MS;
+    reset();
+}
+
+void FpvRateController::setLatencyBudget(int budgetMs)
+{
+    latencyBudget = budgetMs;
+}
+
+void FpvRateController::reset()
+{
+    quality = FPV_DEFAULT_QUALITY;
+    frameRate = FPV_MAX_FRAMERATE;
+
+    lastUpdateTime = -1;
+    windowBytes = 0;
+    throughput = 0.0;
+    delay = 0.0;
+    queuingDelay = 0.0;
+    delayValid = false;
+
+    currentMinDelay = DBL_MAX;
+    previousMinDelay = DBL_MAX;
+    minDelayWindowStart = -1;
+}
+
+void FpvRateController::setMinimum()
+{
+    quality = FPV_MIN_QUALITY;
+    frameRate = FPV_MIN_FRAMERATE;
+}
+
+void FpvRateController::addFrame(int bytes)
+{
+    windowBytes += bytes;
+}
+
+void FpvRateController::addTelemetry(qint64 groundTime, double phoneTime)
+{
+    // One-way delay, plus the unknown offset between the clocks.
+    double sample = (double)groundTime - phoneTime;
+
+    // Track the minimum on two consecutive windows, so it can follow the
+    // drift of the clocks without forgetting it at the beginning of each
+    // window.
+    if(minDelayWindowStart < 0 ||
+       groundTime - minDelayWindowStart > FPV_BASE_DELAY_WINDOW_MS)
+    {
+        previousMinDelay = currentMinDelay;
+        currentMinDelay = sample;
+        minDelayWindowStart = groundTime;
+    }
+    else if(sample < currentMinDelay)
+        currentMinDelay = sample;
+
+    if(delayValid)
+        delay = FPV_RATE_LPF * delay + (1.0-FPV_RATE_LPF) * sample;
+    else
+        delay = sample;
+
+    delayValid = true;
+
+    double baseDelay = qMin(currentMinDelay, previousMinDelay);
+    queuingDelay = qMax(0.0, delay - baseDelay);
+}
+
+bool FpvRateController::update(qint64 groundTime, bool increaseAllowed)
+{
+    if(lastUpdateTime < 0)
+    {
+        lastUpdateTime = groundTime;
+        windowBytes = 0;
+        return false;
+    }
+
+    qint64 elapsed = groundTime - lastUpdateTime;
+
+    if(elapsed < FPV_CONTROL_PERIOD_MS)
+        return false;
+
+    throughput = FPV_RATE_LPF * throughput +
+                 (1.0-FPV_RATE_LPF) * windowBytes * 1000.0 / elapsed;
+    windowBytes = 0;
+    lastUpdateTime = groundTime;
+
+    // Without telemetry, the congestion can't be estimated.
+    if(!delayValid)
+        return false;
+
+    int previousQuality = quality;
+    int previousFrameRate = frameRate;
+
+    if(queuingDelay > latencyBudget)
+    {
+        // Congestion: decrease quickly. The quality is lowered first, the
+        // frame rate only if the quality can't be lowered anymore.
+        if(quality > FPV_MIN_QUALITY)
+            quality = qMax(FPV_MIN_QUALITY, (int)(quality * FPV_DECREASE_FACTOR));
+        else
+            frameRate = qMax(FPV_MIN_FRAMERATE, (int)(frameRate * FPV_DECREASE_FACTOR));
+    }
+    else if(increaseAllowed && queuingDelay < latencyBudget / 2 && throughput > 0.0)
+    {
+        // No congestion while streaming: increase slowly, in the reverse
+        // order.
+        if(frameRate < FPV_MAX_FRAMERATE)
+            frameRate++;
+        else
+            quality = qMin(FPV_MAX_QUALITY, quality + FPV_QUALITY_STEP);
+    }
+
+    return quality != previousQuality || frameRate != previousFrameRate;
+}
+
+int FpvRateController::getQuality() const
+{
+    return quality;
+}
+
+int FpvRateController::getFrameRate() const
+{
+    return frameRate;
+}
+
+double FpvRateController::getQueuingDelay() const
+{
+    return queuingDelay;
+}
+
+double FpvRateController::getQueuedBytes() const
+{
+    return queuingDelay / 1000.0 * throughput;
+}
+
+double FpvRateController::getThroughput() const
+{
+    return throughput;
+}
@@ -0,0 +1,98 @@
+/*!
+* \file fpvratecontroller.h
+* \brief Closed-loop control of the FPV stream bitrate.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef FPVRATECONTROLLER_H
+#define FPVRATECONTROLLER_H
+
+#include <QtGlobal>
+
+/// Closed-loop controller of the FPV stream bitrate.
+/// The FPV frames share the link with the telemetry and the commands. If the
+/// phone sends more than the link can carry, its send queue grows and
+/// everything gets late. This controller estimates the queuing delay of the
+/// link, and asks the phone to lower the JPEG quality or the frame rate
+/// (additive increase, multiplicative decrease) to keep it under a budget.
+///
+/// The queuing delay is estimated from the telemetry: each CURRENT_STATE
+/// message carries the phone time at which it was created. The difference
+/// between the arrival time and this time is the one-way delay plus an
+/// unknown (but constant) clock offset, so its excess over its recent minimum
+/// is the queuing delay. The queued bytes are then estimated from this delay
+/// and the measured throughput.
+class FpvRateController
+{
+public:
+    /// Constructor.
+    FpvRateController();
+
+    /// Set the maximum queuing delay allowed for the link.
+    /// \param budgetMs the maximum delay [ms].
+    void setLatencyBudget(int budgetMs);
+
+    /// Restores the default quality and frame rate, and forgets the
+    /// measurements. Should be called when the stream is (re)started.
+    void reset();
+
+    /// Sets the quality and the frame rate to their minimum values. They will
+    /// increase again if the link allows it.
+    void setMinimum();
+
+    /// Records the reception of a FPV frame.
+    /// \param bytes size of the frame [bytes].
+    void addFrame(int bytes);
+
+    /// Records the reception of a telemetry message.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    /// \param phoneTime creation time, in the phone clock [ms].
+    void addTelemetry(qint64 groundTime, double phoneTime);
+
+    /// Updates the quality and the frame rate, if the control period has
+    /// elapsed since the last update.
+    /// \param groundTime current time, in the ground station clock [ms].
+    /// \param increaseAllowed false to only allow decreases.
+    /// \return true if the quality or the frame rate changed, so the phone
+    /// should be notified.
+    bool update(qint64 groundTime, bool increaseAllowed = true);
+
+    /// Get the JPEG quality the phone should use.
+    /// \return the quality (1-100).
+    int getQuality() const;
+
+    /// Get the frame rate the phone should not exceed.
+    /// \return the frame rate [fps].
+    int getFrameRate() const;
+
+    /// Get the latest estimate of the queuing delay.
+    /// \return the delay [ms].
+    double getQueuingDelay() const;
+
+    /// Get the latest estimate of the number of bytes waiting in the link.
+    /// \return the number of bytes.
+    double getQueuedBytes() const;
+
+    /// Get the measured FPV throughput.
+    /// \return the throughput [bytes/s].
+    double getThroughput() const;
+
+private:
+    int latencyBudget;
+    int quality, frameRate;
+
+    // Measurements.
+    qint64 lastUpdateTime;
+    qint64 windowBytes;
+    double throughput;
+    double delay, queuingDelay;
+    bool delayValid;
+
+    // Minimum of the delay, over the current and the previous windows.
+    double currentMinDelay, previousMinDelay;
+    qint64 minDelayWindowStart;
+};
+
+#endif // FPVRATECONTROLLER_H
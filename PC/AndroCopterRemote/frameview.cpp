@@ -0,0 +1,93 @@
+#include "frameview.h"
+#include "constants.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QPainter>
+#include <QStyle>
+
+FrameView::FrameView(QWidget *parent) :
+    QLabel(parent), imagePool(FRAME_POOL_MAX_FREE)
+{
+}
+
+bool FrameView::showJpeg(const QByteArray &jpeg)
+{
+    QBuffer buffer;
+    buffer.setData(jpeg); // Shared, not copied.
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer, "JPEG");
+    QSize size = reader.size();
+
+    if(!size.isValid())
+        return false;
+
+    // The JPEG decoder reuses the image if it has the right size and format.
+    QImage image = imagePool.acquire(size, QImage::Format_RGB32);
+
+    if(!reader.read(&image))
+    {
+        imagePool.release(image);
+        return false;
+    }
+
+    bool resized = (image.size() != frame.size());
+
+    // The previous frame goes back to the pool once it is not painted
+    // anymore.
+    imagePool.release(frame);
+    frame = image;
+
+    if(resized)
+        updateGeometry();
+
+    update();
+
+    return true;
+}
+
+void FrameView::clearFrame()
+{
+    imagePool.release(frame);
+    updateGeometry();
+    update();
+}
+
+PoolStats FrameView::getImagePoolStats() const
+{
+    return imagePool.getStats();
+}
+
+QSize FrameView::sizeHint() const
+{
+    if(frame.isNull())
+        return QLabel::sizeHint();
+
+    int left, top, right, bottom;
+    getContentsMargins(&left, &top, &right, &bottom);
+
+    return frame.size() + QSize(left + right, top + bottom);
+}
+
+QSize FrameView::minimumSizeHint() const
+{
+    if(frame.isNull())
+        return QLabel::minimumSizeHint();
+
+    return sizeHint();
+}
+
+void FrameView::paintEvent(QPaintEvent *event)
+{
+    if(frame.isNull())
+    {
+        QLabel::paintEvent(event);
+        return;
+    }
+
+    QPainter painter(this);
+    QRect target = QStyle::alignedRect(layoutDirection(), alignment(),
+                                       frame.size(), contentsRect());
+    painter.drawImage(target.topLeft(), frame);
+}
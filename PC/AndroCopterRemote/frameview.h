@@ -0,0 +1,61 @@
+/*!
+* \file frameview.h
+* \brief QLabel displaying the FPV frames without reallocating them.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef FRAMEVIEW_H
+#define FRAMEVIEW_H
+
+#include <QLabel>
+#include <QImage>
+#include <QByteArray>
+#include <QPaintEvent>
+#include <QSize>
+
+#include "bufferpool.h"
+
+/// QLabel displaying the FPV frames.
+/// The JPEG frames are decoded into images taken from an ImagePool, and
+/// painted directly, instead of being converted to a new QPixmap each time:
+/// at a steady resolution, no image memory is allocated per frame.
+/// The text of the label is displayed when there is no frame.
+class FrameView : public QLabel
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// \param parent parent widget.
+    explicit FrameView(QWidget *parent = 0);
+
+    /// Decodes and displays a JPEG frame.
+    /// \param jpeg the JPEG image.
+    /// \return true if the frame could be decoded, false otherwise (the
+    /// previous frame stays displayed).
+    bool showJpeg(const QByteArray &jpeg);
+
+    /// Removes the frame, so the text is displayed instead.
+    void clearFrame();
+
+    /// Get the counters of the pool of decoded images.
+    /// \return a copy of the counters.
+    PoolStats getImagePoolStats() const;
+
+    /// Reimplemented method, to fit the size of the frames.
+    QSize sizeHint() const;
+
+    /// Reimplemented method, to fit the size of the frames.
+    QSize minimumSizeHint() const;
+
+protected:
+    /// Reimplemented method, to paint the frame.
+    void paintEvent(QPaintEvent *event);
+
+private:
+    ImagePool imagePool;
+    QImage frame;
+};
+
+#endif // FRAMEVIEW_H
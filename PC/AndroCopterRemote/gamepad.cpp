@@ -6,9 +6,119 @@ using namespace sf;
 
 #define JOYSTICK_AXIS_MAX 100.0
 
+// Default physical axes and buttons, in the order of GamepadAxis and
+// GamepadButton (Xbox 360 gamepad, the binding changes between OS...).
+#ifdef __APPLE__
+static const int DEFAULT_AXES[GAMEPAD_AXES_COUNT] = {1, 0, 3, 2};
+static const int DEFAULT_BUTTONS[GAMEPAD_BUTTONS_COUNT] = {11, 12, 13, 14, 8, 9, 5, 4, 6, 7};
+#else
+static const int DEFAULT_AXES[GAMEPAD_AXES_COUNT] = {1, 0, 3, 4};
+static const int DEFAULT_BUTTONS[GAMEPAD_BUTTONS_COUNT] = {0, 1, 2, 3, 4, 5, 6, 7, 9, 10};
+#endif
+
+/// Reads a list of indices of a mapping text, e.g. "1,0,3,4".
+static bool readSources(const QString &text, int *sources, int count)
+{
+    QStringList words = text.split(',');
+
+    if(words.size() != count)
+        return false;
+
+    for(int i=0; i<count; i++)
+    {
+        bool ok;
+        sources[i] = words[i].trimmed().toInt(&ok);
+
+        if(!ok || sources[i] < -1)
+            return false;
+    }
+
+    return true;
+}
+
+/// Writes a list of indices of a mapping text.
+static QString writeSources(const int *sources, int count)
+{
+    QStringList words;
+
+    for(int i=0; i<count; i++)
+        words << QString::number(sources[i]);
+
+    return words.join(",");
+}
+
+GamepadMapping::GamepadMapping()
+{
+    for(int i=0; i<GAMEPAD_AXES_COUNT; i++)
+        axisSources[i] = DEFAULT_AXES[i];
+
+    for(int i=0; i<GAMEPAD_BUTTONS_COUNT; i++)
+        buttonSources[i] = DEFAULT_BUTTONS[i];
+}
+
+int GamepadMapping::getAxisSource(int axis) const
+{
+    return axisSources[axis];
+}
+
+int GamepadMapping::getButtonSource(int button) const
+{
+    return buttonSources[button];
+}
+
+void GamepadMapping::setAxisSource(int axis, int source)
+{
+    axisSources[axis] = source;
+}
+
+void GamepadMapping::setButtonSource(int button, int source)
+{
+    buttonSources[button] = source;
+}
+
+QString GamepadMapping::toString() const
+{
+    return "axes=" + writeSources(axisSources, GAMEPAD_AXES_COUNT) +
+           " buttons=" + writeSources(buttonSources, GAMEPAD_BUTTONS_COUNT);
+}
+
+bool GamepadMapping::fromString(const QString &text, GamepadMapping &mapping)
+{
+    GamepadMapping read;
+    bool axesRead = false, buttonsRead = false;
+
+    foreach(const QString &part, text.split(' ', QString::SkipEmptyParts))
+    {
+        if(part.startsWith("axes="))
+            axesRead = readSources(part.mid(5), read.axisSources, GAMEPAD_AXES_COUNT);
+        else if(part.startsWith("buttons="))
+            buttonsRead = readSources(part.mid(8), read.buttonSources, GAMEPAD_BUTTONS_COUNT);
+        else
+            return false;
+    }
+
+    if(!axesRead || !buttonsRead)
+        return false;
+
+    mapping = read;
+    return true;
+}
+
+QString GamepadMapping::makeProfileKey(unsigned int vendorId, unsigned int productId)
+{
+    return QString("%1-%2").arg(vendorId, 4, 16, QChar('0'))
+                           .arg(productId, 4, 16, QChar('0'));
+}
+
 Gamepad::Gamepad()
 {
     gamepadIndex = 0;
+
+    for(int i=0; i<GAMEPAD_AXES_COUNT; i++)
+        axisSources[i] = -1;
+
+    for(int i=0; i<GAMEPAD_BUTTONS_COUNT; i++)
+        buttonSources[i] = -1;
 }
 
 Gamepad::~Gamepad()
@@ -33,6 +143,11 @@ QStringList Gamepad::getGamepadsList()
     return list;
 }
 
+void Gamepad::setProfiles(const QMap<QString, GamepadMapping> &profiles)
+{
+    this->profiles = profiles;
+}
+
 void Gamepad::startMonitoring(int index)
 {
     if(!Joystick::isConnected(index))
@@ -44,19 +159,41 @@ void Gamepad::startMonitoring(int index)
     gamepadIndex = index;
 
     // Get the name of the gamepad.
-    name = QString::fromStdString(Joystick::getIdentification(gamepadIndex).name.toAnsiString());
+    Joystick::Identification identification = Joystick::getIdentification(gamepadIndex);
+    name = QString::fromStdString(identification.name.toAnsiString());
 
-    // Count the number of axes.
+    // Count the number of axes and of buttons.
     int nAxes = 0;
     while(Joystick::hasAxis(gamepadIndex, (Joystick::Axis)nAxes))
         nAxes++;
 
-    axes.resize(nAxes);
+    int nButtons = Joystick::getButtonCount(gamepadIndex);
+
+    qDebug() << "Detected " << nAxes << " axes and " << nButtons << " buttons." << endl;
 
-    // Count the number of buttons.
-    buttons.resize(Joystick::getButtonCount(gamepadIndex));
+    // Resolve the mapping of the model once, so reading the gamepad is only
+    // indexed accesses. The physical axes and buttons that the gamepad does
+    // not have are ignored.
+    profileKey = GamepadMapping::makeProfileKey(identification.vendorId,
+                                                identification.productId);
+    mapping = profiles.value(profileKey, GamepadMapping());
 
-    qDebug() << "Detected " << nAxes << " axes and " << buttons.size() << " buttons." << endl;
+    for(int i=0; i<GAMEPAD_AXES_COUNT; i++)
+    {
+        int source = mapping.getAxisSource(i);
+        bool exists = (source >= 0 && source < Joystick::AxisCount &&
+                       Joystick::hasAxis(gamepadIndex, (Joystick::Axis)source));
+        axisSources[i] = exists ? source : -1;
+    }
+
+    for(int i=0; i<GAMEPAD_BUTTONS_COUNT; i++)
+    {
+        int source = mapping.getButtonSource(i);
+        buttonSources[i] = (source >= 0 && source < nButtons) ? source : -1;
+    }
+
+    axes.fill(0.0, GAMEPAD_AXES_COUNT);
+    buttons.fill(false, GAMEPAD_BUTTONS_COUNT);
 }
 
 QString Gamepad::getName()
@@ -64,12 +201,25 @@ QString Gamepad::getName()
     return name;
 }
 
+QString Gamepad::getProfileKey() const
+{
+    return profileKey;
+}
+
+GamepadMapping Gamepad::getMapping() const
+{
+    return mapping;
+}
+
 QVector<double> Gamepad::getAxes()
 {
     Joystick::update();
 
     for(int i=0; i<axes.size(); i++)
-        axes[i] = (double)Joystick::getAxisPosition(gamepadIndex, (Joystick::Axis)i) / JOYSTICK_AXIS_MAX;
+    {
+        if(axisSources[i] >= 0)
+            axes[i] = (double)Joystick::getAxisPosition(gamepadIndex, (Joystick::Axis)axisSources[i]) / JOYSTICK_AXIS_MAX;
+    }
 
     return axes;
 }
@@ -79,7 +229,10 @@ QVector<bool> Gamepad::getButtons()
     Joystick::update();
 
     for(int i=0; i<buttons.size(); i++)
-        buttons[i] = Joystick::isButtonPressed(gamepadIndex, i);
+    {
+        if(buttonSources[i] >= 0)
+            buttons[i] = Joystick::isButtonPressed(gamepadIndex, buttonSources[i]);
+    }
 
     return buttons;
 }
@@ -17,34 +17,85 @@
 #include <QThread>
 #include <QDebug>
 
-// Axes and keys binding (unfortunately change between OS...).
-#ifdef __APPLE__
-#define THRUST_AXIS 1
-#define YAW_AXIS 0
-#define PITCH_AXIS 3
-#define ROLL_AXIS 2
-#define LEFT_TRIGGER 8
-#define RIGHT_TRIGGER 9
-#define B_BUTTON 12
-#define X_BUTTON 13
-#define Y_BUTTON 14
-#define RIGHT_STICK_BUTTON 7
-#else
-#define THRUST_AXIS 1
-#define YAW_AXIS 0
-#define PITCH_AXIS 3
-#define ROLL_AXIS 4
-#define A_BUTTON 0
-#define B_BUTTON 1
-#define X_BUTTON 2
-#define Y_BUTTON 3
-#define LEFT_TRIGGER 4
-#define RIGHT_TRIGGER 5
-#define BACK_BUTTON 6
-#define START_BUTTON 7
-#define LEFT_STICK_BUTTON 9
-#define RIGHT_STICK_BUTTON 9
-#endif
+/// Axes used by the application. The physical axis of each one is given by
+/// the GamepadMapping of the gamepad.
+enum GamepadAxis
+{
+    THRUST_AXIS=0, ///< Changes the mean thrust.
+    YAW_AXIS, ///< Changes the yaw target angle.
+    PITCH_AXIS, ///< Pitch target angle.
+    ROLL_AXIS, ///< Roll target angle.
+    GAMEPAD_AXES_COUNT ///< Number of axes, not an axis.
+};
+
+/// Buttons used by the application. The physical button of each one is given
+/// by the GamepadMapping of the gamepad.
+enum GamepadButton
+{
+    A_BUTTON=0,
+    B_BUTTON,
+    X_BUTTON,
+    Y_BUTTON,
+    LEFT_TRIGGER,
+    RIGHT_TRIGGER,
+    BACK_BUTTON,
+    START_BUTTON,
+    LEFT_STICK_BUTTON,
+    RIGHT_STICK_BUTTON,
+    GAMEPAD_BUTTONS_COUNT ///< Number of buttons, not a button.
+};
+
+/// Physical axis and button of each GamepadAxis and GamepadButton of a
+/// gamepad model. The mappings are stored in the settings as text, e.g.
+/// "axes=1,0,3,4 buttons=0,1,2,3,4,5,6,7,9,10" (-1 if not mapped).
+class GamepadMapping
+{
+public:
+    /// Constructor. Gives the mapping of an Xbox 360 gamepad, which changes
+    /// between the OS...
+    GamepadMapping();
+
+    /// Get the physical axis of an axis.
+    /// \param axis the axis (see GamepadAxis).
+    /// \return the index of the physical axis, or -1 if not mapped.
+    int getAxisSource(int axis) const;
+
+    /// Get the physical button of a button.
+    /// \param button the button (see GamepadButton).
+    /// \return the index of the physical button, or -1 if not mapped.
+    int getButtonSource(int button) const;
+
+    /// Set the physical axis of an axis.
+    /// \param axis the axis (see GamepadAxis).
+    /// \param source the index of the physical axis, or -1 if not mapped.
+    void setAxisSource(int axis, int source);
+
+    /// Set the physical button of a button.
+    /// \param button the button (see GamepadButton).
+    /// \param source the index of the physical button, or -1 if not mapped.
+    void setButtonSource(int button, int source);
+
+    /// Get the text form of the mapping, to store it in the settings.
+    /// \return the text.
+    QString toString() const;
+
+    /// Reads the text form of a mapping.
+    /// \param text the text, as returned by toString().
+    /// \param mapping set to the read mapping.
+    /// \return true if the text is valid, false otherwise (mapping is left
+    /// unchanged).
+    static bool fromString(const QString &text, GamepadMapping &mapping);
+
+    /// Get the key identifying a gamepad model, used to store its mapping.
+    /// \param vendorId USB vendor ID of the gamepad.
+    /// \param productId USB product ID of the gamepad.
+    /// \return the key, e.g. "045e-028e".
+    static QString makeProfileKey(unsigned int vendorId, unsigned int productId);
+
+private:
+    int axisSources[GAMEPAD_AXES_COUNT];
+    int buttonSources[GAMEPAD_BUTTONS_COUNT];
+};
 
 /// Encapsulate the SDL joystick interface.
 class Gamepad
@@ -60,9 +111,16 @@ public:
 	/// \return the list of the gamepads.
     QStringList getGamepadsList();
 	
+	/// Set the mappings of the known gamepad models. Must be called before
+	/// startMonitoring().
+	/// \param profiles the mappings, by profile key (see
+	/// GamepadMapping::makeProfileKey()).
+    void setProfiles(const QMap<QString, GamepadMapping> &profiles);
+
 	/// Starts the gamepad monitoring of the selected gamepad index.
 	/// This index can be obtained by choosing a name from the list returned by
-	/// the getGamepadsList() method.
+	/// the getGamepadsList() method. The mapping of the gamepad model is
+	/// resolved once here, or the default one if the model is unknown.
 	/// \param the index of the gamepad to monitor.
     void startMonitoring(int index);
 	
@@ -73,15 +131,25 @@ public:
 	/// Get the name of the gamepad this object is listening to.
 	/// \return the name of the current gamepad.
     QString getName();
+
+	/// Get the profile key of the monitored gamepad model.
+	/// \return the key, empty if no gamepad is monitored.
+    QString getProfileKey() const;
+
+	/// Get the mapping used for the monitored gamepad.
+	/// \return the mapping.
+    GamepadMapping getMapping() const;
 	
-	/// Get the list of all the axes of the monitored gamepad. Each number of
-    /// the QVector corresponds to the value of an analog axis, and is mapped
-    /// between -1 and 1.
+	/// Get the list of all the axes of the monitored gamepad, in the order of
+    /// GamepadAxis. Each number of the QVector corresponds to the value of an
+    /// analog axis, and is mapped between -1 and 1 (0 if the axis is not
+    /// mapped).
 	/// \return the list of the axes.
     QVector<double> getAxes();
 	
-	/// Get the list of all the buttons of the monitored gamepad. true means
-	/// pushed, false means released.
+	/// Get the list of all the buttons of the monitored gamepad, in the order
+	/// of GamepadButton. true means pushed, false means released (or not
+	/// mapped).
 	/// \return the list of the buttons.
     QVector<bool> getButtons();
 	
@@ -94,6 +162,15 @@ private:
     QVector<double> axes;
     QVector<bool> buttons;
     int gamepadIndex;
+
+    QMap<QString, GamepadMapping> profiles;
+    QString profileKey;
+    GamepadMapping mapping;
+
+    // Physical axis and button of each axis and button, checked against the
+    // gamepad, -1 if not available.
+    int axisSources[GAMEPAD_AXES_COUNT];
+    int buttonSources[GAMEPAD_BUTTONS_COUNT];
 };
 
 #endif // GAMEPAD_H
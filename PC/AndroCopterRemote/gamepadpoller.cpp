@@ -0,0 +1,80 @@
+#include "gamepadpoller.h"
+#include "constants.h"
+
+#include <QElapsedTimer>
+
+GamepadPoller::GamepadPoller(Gamepad &gamepad, int periodMs) :
+    gamepad(gamepad), buttonPresses(GAMEPAD_PRESSES_QUEUE_SIZE)
+{
+    this->periodMs = periodMs;
+
+    GamepadSnapshot disconnected;
+    disconnected.connected = false;
+    disconnected.sampleTime = 0;
+    snapshots.write(disconnected);
+}
+
+GamepadPoller::~GamepadPoller()
+{
+    stopRequested.storeRelease(1);
+    wait();
+}
+
+void GamepadPoller::setAxisShaping(int axis, const AxisShaping &shaping)
+{
+    shaper.setAxisShaping(axis, shaping);
+}
+
+GamepadSnapshot GamepadPoller::getSnapshot()
+{
+    return snapshots.read();
+}
+
+bool GamepadPoller::takeButtonPress(int &button)
+{
+    return buttonPresses.tryPop(button);
+}
+
+void GamepadPoller::run()
+{
+    GamepadSnapshot snapshot;
+    QVector<bool> previousButtons;
+    QElapsedTimer clock;
+    clock.start();
+
+    while(stopRequested.loadAcquire() == 0)
+    {
+        snapshot.axes = gamepad.getAxes();
+        snapshot.buttons = gamepad.getButtons();
+        snapshot.connected = !snapshot.axes.isEmpty() &&
+                             gamepad.isGamepadStillConnected();
+
+        // The actual period, as the sleep is not accurate. Once restarted,
+        // the reference of the clock is the current time.
+        double dt = clock.nsecsElapsed() * 1e-9;
+        clock.restart();
+        snapshot.sampleTime = clock.msecsSinceReference();
+
+        if(snapshot.connected)
+            shaper.process(snapshot.axes, dt);
+        else
+            shaper.reset();
+
+        // Queue the buttons that have just been pushed. If the GUI thread is
+        // late and the queue is full, the press is still visible in the
+        // snapshot, as long as the button is held.
+        if(previousButtons.size() == snapshot.buttons.size())
+        {
+            for(int i=0; i<snapshot.buttons.size(); i++)
+            {
+                if(snapshot.buttons[i] && !previousButtons[i])
+                    buttonPresses.tryPush(i);
+            }
+        }
+
+        previousButtons = snapshot.buttons;
+        snapshots.write(snapshot);
+
+        msleep(periodMs);
+    }
+}
@@ -0,0 +1,79 @@
+/*!
+* \file gamepadpoller.h
+* \brief Thread reading the gamepad at a fixed rate.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef GAMEPADPOLLER_H
+#define GAMEPADPOLLER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+
+#include "gamepad.h"
+#include "lockfree.h"
+#include "inputshaper.h"
+
+/// State of the gamepad at a given time.
+struct GamepadSnapshot
+{
+    bool connected; ///< true if the monitored gamepad is connected.
+    QVector<double> axes; ///< Axes, between -1 and 1 (see Gamepad::getAxes()).
+    QVector<bool> buttons; ///< Buttons, true if pushed.
+    qint64 sampleTime; ///< Time of the reading, in the clock of QElapsedTimer::msecsSinceReference() [ms].
+};
+
+/// Thread reading the gamepad at a fixed rate, faster than the commands are
+/// sent, so the commands use a recent state of the sticks.
+/// The latest state is shared through a TripleBuffer: the GUI thread never
+/// waits for the gamepad. The button presses are also queued (SpscQueue), so
+/// a press shorter than the commands period is not missed.
+/// The axes are shaped (InputShaper) at the polling rate, before being
+/// shared.
+///
+/// Once started, only this thread uses the Gamepad object.
+class GamepadPoller : public QThread
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// \param gamepad the gamepad to read. Its monitoring must be started
+    /// before this thread, and it must outlive this object.
+    /// \param periodMs reading period [ms].
+    GamepadPoller(Gamepad &gamepad, int periodMs);
+
+    /// Destructor. Stops the thread.
+    ~GamepadPoller();
+
+    /// Set the shaping of an axis. Must be called before start().
+    /// \param axis index of the axis.
+    /// \param shaping the parameters.
+    void setAxisShaping(int axis, const AxisShaping &shaping);
+
+    /// Get the latest state of the gamepad. Only one thread may call it.
+    /// \return the state. Not connected if the thread is not started.
+    GamepadSnapshot getSnapshot();
+
+    /// Get the next button press, in the order they happened. Only one thread
+    /// may call it.
+    /// \param button set to the index of the pressed button.
+    /// \return true if there was a press, false otherwise.
+    bool takeButtonPress(int &button);
+
+protected:
+    /// Reads the gamepad, until the destruction.
+    void run();
+
+private:
+    Gamepad &gamepad;
+    int periodMs;
+    QAtomicInt stopRequested;
+    TripleBuffer<GamepadSnapshot> snapshots;
+    SpscQueue<int> buttonPresses;
+    InputShaper shaper;
+};
+
+#endif // GAMEPADPOLLER_H
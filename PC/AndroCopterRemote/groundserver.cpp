@@ -0,0 +1,50 @@
+#include "groundserver.h"
+
+#include <QMetaObject>
+
+GroundServer::GroundServer(int threadsCount, QObject *parent) :
+    QTcpServer(parent)
+{
+    qRegisterMetaType<qintptr>("qintptr");
+
+    for(int i=0; i<threadsCount; i++)
+    {
+        QThread *thread = new QThread(this);
+        thread->start();
+        ioThreads.append(thread);
+    }
+
+    nextThreadIndex = 0;
+    nextVehicleId = 1;
+}
+
+GroundServer::~GroundServer()
+{
+    close();
+
+    for(int i=0; i<ioThreads.size(); i++)
+    {
+        ioThreads[i]->quit();
+        ioThreads[i]->wait();
+    }
+}
+
+void GroundServer::incomingConnection(qintptr socketDescriptor)
+{
+    VehicleLink *link = new VehicleLink(nextVehicleId);
+    nextVehicleId++;
+
+    // Give the link to the next I/O thread. It is deleted with the thread, if
+    // it has not been deleted before.
+    QThread *thread = ioThreads[nextThreadIndex];
+    nextThreadIndex = (nextThreadIndex + 1) % ioThreads.size();
+
+    link->moveToThread(thread);
+    connect(thread, SIGNAL(finished()), link, SLOT(deleteLater()));
+
+    emit newLink(link);
+
+    // The socket has to be created in the I/O thread.
+    QMetaObject::invokeMethod(link, "start", Qt::QueuedConnection,
+                              Q_ARG(qintptr, socketDescriptor));
+}
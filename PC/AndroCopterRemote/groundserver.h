@@ -0,0 +1,52 @@
+/*!
+* \file groundserver.h
+* \brief TCP server accepting the connections of several phones.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef GROUNDSERVER_H
+#define GROUNDSERVER_H
+
+#include <QTcpServer>
+#include <QThread>
+#include <QList>
+
+#include "vehiclelink.h"
+
+/// TCP server accepting the connections of several phones at once.
+/// Each accepted connection gets a VehicleLink, which is moved to one of the
+/// I/O threads of the server (round-robin), so the sockets are not read by
+/// the GUI thread.
+class GroundServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    /// Constructor. Starts the I/O threads.
+    /// \param threadsCount number of I/O threads.
+    /// \param parent parent object.
+    explicit GroundServer(int threadsCount, QObject *parent = 0);
+
+    /// Destructor. Stops the I/O threads, which deletes the remaining links.
+    ~GroundServer();
+
+signals:
+    /// Emitted when a phone connected. The link is not started yet, so the
+    /// receiver can connect to its signals before any message arrives.
+    /// \param link the link of the new connection. It lives in an I/O
+    /// thread, so its slots should only be called with queued connections.
+    void newLink(VehicleLink *link);
+
+protected:
+    /// Method called by Qt when a connection is accepted.
+    /// \param socketDescriptor native descriptor of the connection.
+    void incomingConnection(qintptr socketDescriptor);
+
+private:
+    QList<QThread*> ioThreads;
+    int nextThreadIndex;
+    int nextVehicleId;
+};
+
+#endif // GROUNDSERVER_H
@@ -0,0 +1,154 @@
+#include "inputshaper.h"
+#include "constants.h"
+
+#include <QtMath>
+#include <cmath>
+
+AxisShaping::AxisShaping()
+{
+    deadZone = 0.0;
+    expo = 0.0;
+    minCutoff = 0.0;
+    beta = 0.0;
+    maxRate = 0.0;
+}
+
+/// Get the smoothing factor of a first-order low-pass filter.
+/// \param cutoff the cutoff frequency [Hz].
+/// \param dt the sampling period [s].
+static double getSmoothingFactor(double cutoff, double dt)
+{
+    double tau = 1.0 / (2.0 * M_PI * cutoff);
+    return 1.0 / (1.0 + tau / dt);
+}
+
+InputShaper::InputShaper()
+{
+}
+
+void InputShaper::setAxisShaping(int axis, const AxisShaping &shaping)
+{
+    if(axis < 0)
+        return;
+
+    if(axes.size() <= axis)
+    {
+        Axis unchanged;
+        unchanged.initialized = false;
+        axes.resize(axis + 1);
+
+        for(int i=0; i<axes.size(); i++)
+        {
+            if(axes[i].expoTable.isEmpty())
+                axes[i] = unchanged;
+        }
+    }
+
+    Axis &a = axes[axis];
+    a.shaping = shaping;
+    a.initialized = false;
+
+    // Precompute the expo curve, for the positive values only (it is odd).
+    a.expoTable.resize(INPUT_SHAPER_TABLE_SIZE);
+
+    for(int i=0; i<INPUT_SHAPER_TABLE_SIZE; i++)
+    {
+        double x = (double)i / (INPUT_SHAPER_TABLE_SIZE - 1);
+        a.expoTable[i] = (1.0 - shaping.expo) * x + shaping.expo * x * x * x;
+    }
+}
+
+AxisShaping InputShaper::getAxisShaping(int axis) const
+{
+    if(axis < 0 || axis >= axes.size())
+        return AxisShaping();
+    else
+        return axes[axis].shaping;
+}
+
+void InputShaper::process(QVector<double> &values, double dt)
+{
+    int count = qMin(values.size(), axes.size());
+
+    for(int i=0; i<count; i++)
+    {
+        Axis &axis = axes[i];
+
+        if(axis.expoTable.isEmpty())
+            continue; // Not shaped.
+
+        double value = applyCurve(axis, values[i]);
+
+        if(!axis.initialized || dt <= 0.0)
+        {
+            axis.filtered = value;
+            axis.filteredSpeed = 0.0;
+            axis.output = value;
+            axis.initialized = true;
+            values[i] = value;
+            continue;
+        }
+
+        value = applyFilter(axis, value, dt);
+
+        // Rate limit.
+        if(axis.shaping.maxRate > 0.0)
+        {
+            double maxStep = axis.shaping.maxRate * dt;
+
+            if(value > axis.output + maxStep)
+                value = axis.output + maxStep;
+            else if(value < axis.output - maxStep)
+                value = axis.output - maxStep;
+        }
+
+        axis.output = value;
+        values[i] = value;
+    }
+}
+
+void InputShaper::reset()
+{
+    for(int i=0; i<axes.size(); i++)
+        axes[i].initialized = false;
+}
+
+double InputShaper::applyCurve(const Axis &axis, double value)
+{
+    double magnitude = fabs(value);
+
+    if(magnitude <= axis.shaping.deadZone)
+        return 0.0;
+
+    // Rescale the range outside of the dead zone to [0;1].
+    magnitude = (magnitude - axis.shaping.deadZone) / (1.0 - axis.shaping.deadZone);
+
+    if(magnitude > 1.0)
+        magnitude = 1.0;
+
+    // Linear interpolation in the table.
+    double position = magnitude * (INPUT_SHAPER_TABLE_SIZE - 1);
+    int index = qMin((int)position, INPUT_SHAPER_TABLE_SIZE - 2);
+    double fraction = position - index;
+    double shaped = axis.expoTable[index] +
+                    fraction * (axis.expoTable[index+1] - axis.expoTable[index]);
+
+    return (value < 0.0) ? -shaped : shaped;
+}
+
+double InputShaper::applyFilter(Axis &axis, double value, double dt)
+{
+    if(axis.shaping.minCutoff <= 0.0)
+        return value;
+
+    // Filtered speed of the stick, to adapt the cutoff frequency.
+    double speed = (value - axis.filtered) / dt;
+    double speedAlpha = getSmoothingFactor(INPUT_SHAPER_SPEED_CUTOFF_HZ, dt);
+    axis.filteredSpeed += speedAlpha * (speed - axis.filteredSpeed);
+
+    // Filtered value.
+    double cutoff = axis.shaping.minCutoff + axis.shaping.beta * fabs(axis.filteredSpeed);
+    axis.filtered += getSmoothingFactor(cutoff, dt) * (value - axis.filtered);
+
+    return axis.filtered;
+}
@@ -0,0 +1,100 @@
+/*!
+* \file inputshaper.h
+* \brief Shaping of the gamepad axes: dead zone, expo, filtering, rate limit.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef INPUTSHAPER_H
+#define INPUTSHAPER_H
+
+#include <QVector>
+
+/// Number of points of the expo lookup table, between 0 and 1.
+const int INPUT_SHAPER_TABLE_SIZE = 256;
+
+/// Shaping parameters of a gamepad axis. The default ones leave the axis
+/// unchanged.
+struct AxisShaping
+{
+    /// Constructor, with the default parameters.
+    AxisShaping();
+
+    /// Dead zone around the center, as a fraction of the full scale. The
+    /// output is zero inside, and the rest of the range is rescaled, so the
+    /// output starts from zero at the edge of the dead zone.
+    double deadZone;
+
+    /// Expo, between 0 (linear) and 1 (cubic): the output is
+    /// (1-expo)*x + expo*x^3. Gives a finer control around the center.
+    double expo;
+
+    /// Minimum cutoff frequency of the one-euro filter [Hz]. 0 disables the
+    /// filter.
+    double minCutoff;
+
+    /// Speed coefficient of the one-euro filter: the cutoff frequency is
+    /// increased by beta for each full scale per second of the stick speed,
+    /// so the fast moves are not delayed, while the noise of a still stick is
+    /// filtered.
+    double beta;
+
+    /// Maximum variation speed of the output [full scales/s]. 0 disables the
+    /// rate limit.
+    double maxRate;
+};
+
+/// Shaping of the gamepad axes, between the Gamepad and the commands.
+/// Each axis goes through: dead zone, expo (precomputed lookup table),
+/// one-euro filter, and rate limit. All the stages are cheap enough to be run
+/// at the gamepad polling rate.
+///
+/// Not thread-safe: the parameters must be set before the thread processing
+/// the axes is started.
+class InputShaper
+{
+public:
+    /// Constructor. All the axes are left unchanged.
+    InputShaper();
+
+    /// Set the shaping of an axis.
+    /// \param axis index of the axis.
+    /// \param shaping the parameters.
+    void setAxisShaping(int axis, const AxisShaping &shaping);
+
+    /// Get the shaping of an axis.
+    /// \param axis index of the axis.
+    /// \return the parameters.
+    AxisShaping getAxisShaping(int axis) const;
+
+    /// Shapes the values of all the axes.
+    /// \param values the values of the axes, between -1 and 1. Replaced by the
+    /// shaped values.
+    /// \param dt time since the previous call [s].
+    void process(QVector<double> &values, double dt);
+
+    /// Forgets the state of the filters and of the rate limits, e.g. when the
+    /// gamepad has been disconnected.
+    void reset();
+
+private:
+    /// Parameters and state of an axis.
+    struct Axis
+    {
+        AxisShaping shaping;
+        QVector<double> expoTable;
+        bool initialized;
+        double filtered, filteredSpeed, output;
+    };
+
+    /// Applies the dead zone and the expo.
+    static double applyCurve(const Axis &axis, double value);
+
+    /// Applies the one-euro filter.
+    static double applyFilter(Axis &axis, double value, double dt);
+
+    QVector<Axis> axes;
+};
+
+#endif // INPUTSHAPER_H
@@ -0,0 +1,107 @@
+#include "labelrefresher.h"
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+
+LabelRefresher::LabelRefresher()
+{
+    updatesCount = 0;
+    changesCount = 0;
+    refreshesCount = 0;
+    refreshNs = 0;
+}
+
+int LabelRefresher::addLabel(QLabel *label, const char *format)
+{
+    Entry entry;
+    entry.label = label;
+    entry.format = format;
+    entry.value1 = 0.0;
+    entry.value2 = 0.0;
+    entry.displayedValue1 = 0.0;
+    entry.displayedValue2 = 0.0;
+    entry.text = 0;
+    entry.displayedText = 0;
+    entry.displayed = false;
+
+    entries.append(entry);
+
+    return entries.size() - 1;
+}
+
+void LabelRefresher::setValue(int id, double value1, double value2)
+{
+    Entry &entry = entries[id];
+    entry.value1 = value1;
+    entry.value2 = value2;
+    entry.text = 0;
+
+    changesCount++;
+}
+
+void LabelRefresher::setText(int id, const char *text)
+{
+    entries[id].text = text;
+
+    changesCount++;
+}
+
+void LabelRefresher::update()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int i=0; i<entries.size(); i++)
+    {
+        Entry &entry = entries[i];
+
+        // Skip the labels which already display the right content.
+        if(entry.displayed && entry.text == entry.displayedText &&
+           (entry.text != 0 || (entry.value1 == entry.displayedValue1 &&
+                                entry.value2 == entry.displayedValue2)))
+        {
+            continue;
+        }
+
+        if(entry.text != 0)
+            entry.label->setText(QLatin1String(entry.text));
+        else
+        {
+            // Format in the preallocated buffer, to avoid the temporary
+            // strings of QString::number().
+            qsnprintf(buffer, LABEL_TEXT_MAX_SIZE, entry.format,
+                      entry.value1, entry.value2);
+            entry.label->setText(QLatin1String(buffer));
+        }
+
+        entry.displayedText = entry.text;
+        entry.displayedValue1 = entry.value1;
+        entry.displayedValue2 = entry.value2;
+        entry.displayed = true;
+
+        updatesCount++;
+    }
+
+    refreshesCount++;
+    refreshNs += timer.nsecsElapsed();
+}
+
+qint64 LabelRefresher::getUpdatesCount() const
+{
+    return updatesCount;
+}
+
+qint64 LabelRefresher::getSkippedCount() const
+{
+    return changesCount - updatesCount;
+}
+
+qint64 LabelRefresher::getRefreshesCount() const
+{
+    return refreshesCount;
+}
+
+qint64 LabelRefresher::getRefreshTime() const
+{
+    return refreshNs;
+}
@@ -0,0 +1,88 @@
+/*!
+* \file labelrefresher.h
+* \brief Coalesces the updates of the value labels of the GUI.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef LABELREFRESHER_H
+#define LABELREFRESHER_H
+
+#include <QLabel>
+#include <QVector>
+
+/// Maximum length of a formatted label text, including the terminal '\0'.
+const int LABEL_TEXT_MAX_SIZE = 64;
+
+/// Coalesces the updates of QLabel widgets displaying values.
+/// Setting a value only stores it, which is cheap and does not allocate. The
+/// labels are actually updated only when update() is called (at a low, fixed
+/// rate), and only if their value changed since the last displayed one. This
+/// way, the layout work does not depend on the telemetry rate.
+class LabelRefresher
+{
+public:
+    /// Constructor.
+    LabelRefresher();
+
+    /// Registers a label displaying one or two numbers.
+    /// \param label the label to update.
+    /// \param format printf-like format of the text, with up to two double
+    /// conversions (e.g. "%.1f" or "%.4g (%.0f%%)"). The string is not copied,
+    /// so it should be a literal.
+    /// \return the identifier of the label, to be given to setValue().
+    int addLabel(QLabel *label, const char *format);
+
+    /// Set the value(s) displayed by a label. The label will be updated at
+    /// the next call to update().
+    /// \param id the identifier returned by addLabel().
+    /// \param value1 the first value of the format.
+    /// \param value2 the second value of the format, if any.
+    void setValue(int id, double value1, double value2 = 0.0);
+
+    /// Set a fixed text to display instead of the formatted value(s).
+    /// \param id the identifier returned by addLabel().
+    /// \param text the text. The string is not copied, so it should be a
+    /// literal.
+    void setText(int id, const char *text);
+
+    /// Updates the labels whose content changed since the last call.
+    void update();
+
+    /// Get the number of QLabel::setText() calls done since the creation.
+    /// \return the number of calls.
+    qint64 getUpdatesCount() const;
+
+    /// Get the number of value changes which did not lead to a setText()
+    /// call, because they were coalesced or unchanged.
+    /// \return the number of skipped changes.
+    qint64 getSkippedCount() const;
+
+    /// Get the number of update() calls since the creation.
+    /// \return the number of calls.
+    qint64 getRefreshesCount() const;
+
+    /// Get the time spent in update() since the creation, formatting and
+    /// setting the texts.
+    /// \return the time [ns].
+    qint64 getRefreshTime() const;
+
+private:
+    /// A registered label, with its pending and displayed contents.
+    struct Entry
+    {
+        QLabel *label;
+        const char *format;
+        double value1, value2, displayedValue1, displayedValue2;
+        const char *text, *displayedText;
+        bool displayed;
+    };
+
+    QVector<Entry> entries;
+    char buffer[LABEL_TEXT_MAX_SIZE];
+    qint64 updatesCount, changesCount;
+    qint64 refreshesCount, refreshNs;
+};
+
+#endif // LABELREFRESHER_H
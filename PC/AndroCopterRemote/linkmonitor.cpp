@@ -0,0 +1,218 @@
+#include "linkmonitor.h"
+
+#include <QStringList>
+#include <cmath>
+
+LinkMonitor::LinkMonitor()
+{
+    degradedRtt = LINK_DEGRADED_RTT_MS;
+    criticalRtt = LINK_CRITICAL_RTT_MS;
+    lostTimeout = LINK_LOST_TIMEOUT_MS;
+
+    nextSequence = 0;
+
+    for(int i=0; i<LINK_LOSS_WINDOW; i++)
+    {
+        sentSequences[i] = 0;
+        sentTimes[i] = -1;
+        answered[i] = false;
+    }
+
+    firstPingTime = -1;
+    lastPongTime = -1;
+
+    rttValid = false;
+    smoothedRtt = 0.0;
+    rttVariation = 0.0;
+    jitter = 0.0;
+    lastRtt = 0.0;
+    lossRate = 0.0;
+
+    health = LINK_HEALTHY;
+    betterSince = -1;
+}
+
+void LinkMonitor::setThresholds(int degradedRttMs, int criticalRttMs, int lostTimeoutMs)
+{
+    degradedRtt = degradedRttMs;
+    criticalRtt = criticalRttMs;
+    lostTimeout = lostTimeoutMs;
+}
+
+QString LinkMonitor::makePing(qint64 now)
+{
+    int index = nextSequence % LINK_LOSS_WINDOW;
+    sentSequences[index] = nextSequence;
+    sentTimes[index] = now;
+    answered[index] = false;
+
+    if(firstPingTime < 0)
+        firstPingTime = now;
+
+    QString message = QString("ping %1 %2").arg(nextSequence).arg(now);
+    nextSequence++;
+
+    return message;
+}
+
+bool LinkMonitor::addPong(const QByteArray &data, qint64 now, PingTimes *times)
+{
+    QStringList words = QString(data).split(' ');
+
+    if(words.size() < 2)
+        return false;
+
+    bool ok;
+    quint32 sequence = words[0].toUInt(&ok);
+
+    if(!ok)
+        return false;
+
+    // Ignore the answers to pings too old to be remembered, or answered
+    // twice.
+    int index = sequence % LINK_LOSS_WINDOW;
+
+    if(sentSequences[index] != sequence || sentTimes[index] < 0 || answered[index])
+        return false;
+
+    answered[index] = true;
+    lastPongTime = now;
+
+    double rtt = (double)(now - sentTimes[index]);
+
+    // Same estimators as the TCP retransmission timer (RFC 6298), and as the
+    // RTP interarrival jitter (RFC 3550).
+    if(!rttValid)
+    {
+        smoothedRtt = rtt;
+        rttVariation = rtt / 2.0;
+        jitter = 0.0;
+        rttValid = true;
+    }
+    else
+    {
+        rttVariation = 0.75 * rttVariation + 0.25 * fabs(smoothedRtt - rtt);
+        smoothedRtt = 0.875 * smoothedRtt + 0.125 * rtt;
+        jitter += (fabs(rtt - lastRtt) - jitter) / 16.0;
+    }
+
+    lastRtt = rtt;
+
+    if(times != 0)
+    {
+        times->sentTime = sentTimes[index];
+        times->phoneTime = (words.size() >= 3) ? words[2].toDouble(&ok) : NAN;
+        times->receivedTime = now;
+
+        if(!ok)
+            times->phoneTime = NAN;
+    }
+
+    return true;
+}
+
+LinkHealth LinkMonitor::evaluate(qint64 now)
+{
+    // Loss rate of the pings old enough to have been answered.
+    int consideredCount = 0, lostCount = 0;
+
+    for(int i=0; i<LINK_LOSS_WINDOW; i++)
+    {
+        if(sentTimes[i] >= 0 && now - sentTimes[i] > LINK_PONG_TIMEOUT_MS)
+        {
+            consideredCount++;
+
+            if(!answered[i])
+                lostCount++;
+        }
+    }
+
+    if(consideredCount > 0)
+        lossRate = (double)lostCount / (double)consideredCount;
+    else
+        lossRate = 0.0;
+
+    // A worse health is applied immediately, a better one only if it lasts.
+    LinkHealth newHealth = computeHealth(now);
+
+    if(newHealth >= health)
+    {
+        health = newHealth;
+        betterSince = -1;
+    }
+    else if(betterSince < 0)
+        betterSince = now;
+    else if(now - betterSince > LINK_RECOVERY_TIME_MS)
+    {
+        health = newHealth;
+        betterSince = -1;
+    }
+
+    return health;
+}
+
+LinkHealth LinkMonitor::getHealth() const
+{
+    return health;
+}
+
+bool LinkMonitor::hasRttEstimate() const
+{
+    return rttValid;
+}
+
+double LinkMonitor::getSmoothedRtt() const
+{
+    return smoothedRtt;
+}
+
+double LinkMonitor::getRttVariation() const
+{
+    return rttVariation;
+}
+
+double LinkMonitor::getJitter() const
+{
+    return jitter;
+}
+
+double LinkMonitor::getLossRate() const
+{
+    return lossRate;
+}
+
+int LinkMonitor::getStateTimeout() const
+{
+    if(!rttValid)
+        return REGU_ON_STATE_WAIT_TIME_MS;
+
+    int timeout = (int)(smoothedRtt + 4.0 * rttVariation) + LINK_STATE_MARGIN_MS;
+
+    return qBound(LINK_MIN_STATE_TIMEOUT_MS, timeout, REGU_ON_STATE_WAIT_TIME_MS);
+}
+
+LinkHealth LinkMonitor::computeHealth(qint64 now) const
+{
+    // Nothing can be said before the first ping.
+    if(firstPingTime < 0)
+        return LINK_HEALTHY;
+
+    qint64 lastAnswerTime = (lastPongTime >= 0) ? lastPongTime : firstPingTime;
+
+    if(now - lastAnswerTime > lostTimeout)
+        return LINK_LOST;
+
+    if(!rttValid)
+        return LINK_HEALTHY;
+
+    if(smoothedRtt > criticalRtt || lossRate > LINK_CRITICAL_LOSS_RATE)
+        return LINK_CRITICAL;
+
+    if(smoothedRtt > degradedRtt || lossRate > LINK_DEGRADED_LOSS_RATE ||
+       jitter > LINK_DEGRADED_JITTER_MS)
+    {
+        return LINK_DEGRADED;
+    }
+
+    return LINK_HEALTHY;
+}
@@ -0,0 +1,130 @@
+/*!
+* \file linkmonitor.h
+* \brief Health monitoring of the link with a phone (RTT, jitter, loss).
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef LINKMONITOR_H
+#define LINKMONITOR_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "constants.h"
+
+/// Health of a link, from the best to the worst. Each state triggers a
+/// failsafe stage.
+enum LinkHealth
+{
+    LINK_HEALTHY=0, ///< Normal operation.
+    LINK_DEGRADED, ///< High latency, jitter or loss: the FPV is reduced.
+    LINK_CRITICAL, ///< Very high latency or loss: FPV stopped, altitude lock.
+    LINK_LOST ///< No answer anymore: the vehicle is stopped.
+};
+
+/// Timestamps of an answered ping, for the clock synchronization (see
+/// ClockSync).
+struct PingTimes
+{
+    qint64 sentTime; ///< Sending time of the ping, in the ground clock [ms].
+    double phoneTime; ///< Time of the answer, in the phone clock [ms], NaN if not given.
+    qint64 receivedTime; ///< Reception time of the answer, in the ground clock [ms].
+};
+
+/// Health monitoring of the link with a phone.
+/// The ground station regularly sends timestamped pings, which the phone
+/// echoes in PONG messages. From the answers, the monitor estimates the
+/// round-trip time (smoothed, with its variation, as for the TCP
+/// retransmission timer), its jitter and the loss rate of the pings, and
+/// deduces the health of the link.
+class LinkMonitor
+{
+public:
+    /// Constructor.
+    LinkMonitor();
+
+    /// Set the thresholds of the link health.
+    /// \param degradedRttMs smoothed RTT above which the link is degraded [ms].
+    /// \param criticalRttMs smoothed RTT above which the link is critical [ms].
+    /// \param lostTimeoutMs time without any answer after which the link is
+    /// lost [ms].
+    void setThresholds(int degradedRttMs, int criticalRttMs, int lostTimeoutMs);
+
+    /// Creates the next ping message, to send to the phone.
+    /// \param now current time, in the ground station clock [ms].
+    /// \return the message.
+    QString makePing(qint64 now);
+
+    /// Processes the answer of the phone to a ping.
+    /// \param data content of the PONG message: the sequence number and the
+    /// ground time of the ping, and the phone time of the answer.
+    /// \param now reception time, in the ground station clock [ms].
+    /// \param times if not null, set to the timestamps of the ping, if the
+    /// answer matched it.
+    /// \return true if the answer matched a ping, false otherwise.
+    bool addPong(const QByteArray &data, qint64 now, PingTimes *times = 0);
+
+    /// Updates the loss rate and the health of the link. Should be called
+    /// regularly.
+    /// \param now current time, in the ground station clock [ms].
+    /// \return the health of the link.
+    LinkHealth evaluate(qint64 now);
+
+    /// Get the health computed by the last call to evaluate().
+    /// \return the health.
+    LinkHealth getHealth() const;
+
+    /// Get if at least one ping has been answered. Otherwise, the other
+    /// estimates are meaningless, and the phone may not support the pings.
+    /// \return true if the RTT has been measured.
+    bool hasRttEstimate() const;
+
+    /// Get the smoothed round-trip time.
+    /// \return the RTT [ms].
+    double getSmoothedRtt() const;
+
+    /// Get the variation of the round-trip time.
+    /// \return the mean deviation of the RTT [ms].
+    double getRttVariation() const;
+
+    /// Get the jitter of the round-trip time (mean difference between two
+    /// consecutive RTTs).
+    /// \return the jitter [ms].
+    double getJitter() const;
+
+    /// Get the proportion of the latest pings which have not been answered in
+    /// time.
+    /// \return the loss rate (0-1).
+    double getLossRate() const;
+
+    /// Get the time to wait for a state change requested to the phone, before
+    /// considering that the request has been lost. It follows the RTT, and is
+    /// REGU_ON_STATE_WAIT_TIME_MS until the RTT is measured.
+    /// \return the timeout [ms].
+    int getStateTimeout() const;
+
+private:
+    /// Computes the health from the current estimates, without hysteresis.
+    LinkHealth computeHealth(qint64 now) const;
+
+    int degradedRtt, criticalRtt, lostTimeout;
+
+    // Sent pings, indexed by their sequence number modulo LINK_LOSS_WINDOW.
+    quint32 nextSequence;
+    quint32 sentSequences[LINK_LOSS_WINDOW];
+    qint64 sentTimes[LINK_LOSS_WINDOW];
+    bool answered[LINK_LOSS_WINDOW];
+    qint64 firstPingTime, lastPongTime;
+
+    // Estimates.
+    bool rttValid;
+    double smoothedRtt, rttVariation, jitter, lastRtt, lossRate;
+
+    // Health, with the time since which the link is better than it.
+    LinkHealth health;
+    qint64 betterSince;
+};
+
+#endif // LINKMONITOR_H
@@ -0,0 +1,354 @@
+/*!
+* \file lockfree.h
+* \brief Lock-free queues and shared values, to exchange data between threads.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef LOCKFREE_H
+#define LOCKFREE_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+
+/// Size of a cache line, in bytes. The indices written by different threads
+/// are separated by this much padding, so a thread writing its index does not
+/// invalidate the cache line of the other thread (false sharing). Padding is
+/// used instead of alignas(), which C++11 does not honour for the objects
+/// allocated on the heap (operator new only aligns to 16 bytes).
+const int CACHE_LINE_SIZE = 64;
+
+/// Bounded queue with a single producer thread and a single consumer thread.
+/// Pushing and popping never block, and never allocate once the queue is
+/// constructed: when the queue is full, tryPush() fails.
+/// \param T the type of the elements. It must be default-constructible and
+/// copyable.
+template<class T> class SpscQueue
+{
+public:
+    /// Constructor.
+    /// \param capacity maximum number of elements. Rounded up to a power of
+    /// two.
+    explicit SpscQueue(int capacity) : cachedTail(0), cachedHead(0)
+    {
+        int size = 1;
+
+        while(size < capacity)
+            size *= 2;
+
+        cells = new T[size];
+        mask = size - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /// Destructor.
+    ~SpscQueue()
+    {
+        delete[] cells;
+    }
+
+    /// Adds an element at the end of the queue. Only the producer thread may
+    /// call it.
+    /// \param value the element.
+    /// \return true if the element has been added, false if the queue is full.
+    bool tryPush(const T &value)
+    {
+        quint64 t = tail.load(std::memory_order_relaxed);
+
+        // Read the index of the consumer only when the queue looks full.
+        if(t - cachedHead > (quint64)mask)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+
+            if(t - cachedHead > (quint64)mask)
+                return false;
+        }
+
+        cells[(int)(t & mask)] = value;
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Removes the first element of the queue. Only the consumer thread may
+    /// call it.
+    /// \param value set to the element.
+    /// \return true if an element has been removed, false if the queue is
+    /// empty.
+    bool tryPop(T &value)
+    {
+        quint64 h = head.load(std::memory_order_relaxed);
+
+        // Read the index of the producer only when the queue looks empty.
+        if(h == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+
+            if(h == cachedTail)
+                return false;
+        }
+
+        value = cells[(int)(h & mask)];
+        cells[(int)(h & mask)] = T(); // Release the resources of the element.
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Get the number of elements. It is only a snapshot, if the other
+    /// thread is working on the queue.
+    /// \return the number of elements.
+    int size() const
+    {
+        return (int)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+
+private:
+    T *cells;
+    int mask;
+    char padding0[CACHE_LINE_SIZE];
+
+    // Written by the consumer.
+    std::atomic<quint64> head;
+    quint64 cachedTail;
+    char padding1[CACHE_LINE_SIZE];
+
+    // Written by the producer.
+    std::atomic<quint64> tail;
+    quint64 cachedHead;
+    char padding2[CACHE_LINE_SIZE];
+
+    Q_DISABLE_COPY(SpscQueue)
+};
+
+/// Bounded queue with several producer threads and a single consumer thread.
+/// Each slot has a sequence number telling if it is ready to be written or
+/// read (Vyukov's bounded queue), so the producers only compete on the tail
+/// index, with a compare-and-swap. Pushing and popping never block, and never
+/// allocate once the queue is constructed.
+/// \param T the type of the elements. It must be default-constructible and
+/// copyable.
+template<class T> class MpscQueue
+{
+public:
+    /// Constructor.
+    /// \param capacity maximum number of elements. Rounded up to a power of
+    /// two.
+    explicit MpscQueue(int capacity) : head(0), tail(0)
+    {
+        int size = 1;
+
+        while(size < capacity)
+            size *= 2;
+
+        cells = new Slot[size];
+        mask = size - 1;
+
+        for(int i=0; i<size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// Destructor.
+    ~MpscQueue()
+    {
+        delete[] cells;
+    }
+
+    /// Adds an element at the end of the queue. Can be called from any
+    /// thread.
+    /// \param value the element.
+    /// \return true if the element has been added, false if the queue is full.
+    bool tryPush(const T &value)
+    {
+        quint64 t = tail.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            Slot &slot = cells[(int)(t & mask)];
+            qint64 difference = (qint64)(slot.sequence.load(std::memory_order_acquire) - t);
+
+            if(difference == 0)
+            {
+                // The slot is free: take it, if no other producer did.
+                if(tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed))
+                {
+                    slot.value = value;
+                    slot.sequence.store(t + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(difference < 0)
+                return false; // The slot has not been read yet: full.
+            else
+                t = tail.load(std::memory_order_relaxed); // Taken by another producer.
+        }
+    }
+
+    /// Removes the first element of the queue. Only the consumer thread may
+    /// call it.
+    /// \param value set to the element.
+    /// \return true if an element has been removed, false if the queue is
+    /// empty (or if the first element is still being written).
+    bool tryPop(T &value)
+    {
+        quint64 h = head.load(std::memory_order_relaxed);
+        Slot &slot = cells[(int)(h & mask)];
+
+        if(slot.sequence.load(std::memory_order_acquire) != h + 1)
+            return false;
+
+        value = slot.value;
+        slot.value = T(); // Release the resources of the element.
+        slot.sequence.store(h + mask + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+private:
+    /// A slot of the queue.
+    struct Slot
+    {
+        std::atomic<quint64> sequence;
+        T value;
+    };
+
+    Slot *cells;
+    int mask;
+    char padding0[CACHE_LINE_SIZE];
+
+    // Written by the consumer.
+    std::atomic<quint64> head;
+    char padding1[CACHE_LINE_SIZE];
+
+    // Written by the producers.
+    std::atomic<quint64> tail;
+    char padding2[CACHE_LINE_SIZE];
+
+    Q_DISABLE_COPY(MpscQueue)
+};
+
+/// Latest value shared by a writer thread with a reader thread.
+/// The writer and the reader each own a buffer, and the third one is
+/// exchanged atomically: the writer never waits for the reader, the reader
+/// always gets the latest complete value, and the intermediate values are
+/// skipped.
+/// \param T the type of the value. It must be copyable.
+template<class T> class TripleBuffer
+{
+public:
+    /// Constructor.
+    /// \param initialValue the value read before the first write.
+    explicit TripleBuffer(const T &initialValue = T()) :
+        writeIndex(0), readIndex(1), shared(2)
+    {
+        for(int i=0; i<3; i++)
+            buffers[i] = initialValue;
+    }
+
+    /// Publishes a new value. Only the writer thread may call it.
+    /// \param value the value.
+    void write(const T &value)
+    {
+        buffers[writeIndex] = value;
+
+        // Exchange the written buffer with the shared one, marked as new.
+        int previous = shared.exchange(writeIndex | NEW_VALUE_FLAG, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    /// Get the latest published value. Only the reader thread may call it.
+    /// \param isNew if not null, set to true if the value has been published
+    /// since the previous read.
+    /// \return the value.
+    const T& read(bool *isNew = 0)
+    {
+        bool newValue = (shared.load(std::memory_order_relaxed) & NEW_VALUE_FLAG) != 0;
+
+        if(newValue)
+        {
+            // Exchange the read buffer with the shared one, marked as read.
+            int previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+            readIndex = previous & INDEX_MASK;
+        }
+
+        if(isNew != 0)
+            *isNew = newValue;
+
+        return buffers[readIndex];
+    }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int NEW_VALUE_FLAG = 4;
+
+    T buffers[3];
+    char padding0[CACHE_LINE_SIZE];
+    int writeIndex; // Only used by the writer.
+    char padding1[CACHE_LINE_SIZE];
+    int readIndex; // Only used by the reader.
+    char padding2[CACHE_LINE_SIZE];
+    std::atomic<int> shared;
+    char padding3[CACHE_LINE_SIZE];
+};
+
+/// Small value shared by a writer thread with any number of reader threads,
+/// protected by a sequence lock. The writer never waits; a reader retries if
+/// the value has been modified while it was copying it. Suited for values
+/// written often and read often, as counters and state snapshots.
+/// \param T the type of the value. It must be trivially copyable (no
+/// pointers to owned memory, e.g. no QVector).
+template<class T> class SeqLock
+{
+public:
+    /// Constructor.
+    /// \param initialValue the value read before the first store.
+    explicit SeqLock(const T &initialValue = T()) : sequence(0)
+    {
+        value = initialValue;
+    }
+
+    /// Stores a new value. Only one thread may call it.
+    /// \param newValue the value.
+    void store(const T &newValue)
+    {
+        // An odd sequence number means that a write is in progress.
+        unsigned int s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy((void*)&value, &newValue, sizeof(T));
+
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    /// Get a consistent copy of the value. Can be called from any thread.
+    /// \return the value.
+    T load() const
+    {
+        T copy;
+        unsigned int before, after;
+
+        do
+        {
+            before = sequence.load(std::memory_order_acquire);
+            memcpy((void*)&copy, (const void*)&value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        }
+        while((before & 1) != 0 || before != after);
+
+        return copy;
+    }
+
+private:
+    char padding0[CACHE_LINE_SIZE];
+    std::atomic<unsigned int> sequence;
+    T value;
+    char padding1[CACHE_LINE_SIZE];
+};
+
+#endif // LOCKFREE_H
@@ -2,24 +2,42 @@
 #include "ui_mainwindow.h"
 
 #include <QDebug>
+#include <QScrollBar>
 #include <cmath>
 
 const double PI = 3.14159265;
 
+/// Names of the LinkHealth states, for the messages.
+const char* LINK_HEALTH_NAMES[] = {"healthy", "degraded", "critical", "lost"};
+
+/// Names of the priority classes of the messages (see MessagePriority).
+const char* PRIORITY_NAMES[] = {"Safety", "Command", "Config", "Bulk"};
+
 Q_DECLARE_METATYPE(QList<double>)
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent), ui(new Ui::MainWindow),
+    telemetryHandoff(TELEMETRY_HANDOFF_CAPACITY),
+    messageBuffers(MESSAGE_POOL_MAX_FREE),
+    server(GROUND_IO_THREADS_COUNT),
+    diskWriter(DISK_WRITER_MAX_QUEUED_BYTES),
+    messagesLog(MESSAGE_LOG_CAPACITY),
+    archiveTelemetry(ARCHIVE_STORE_CAPACITY),
+    gamepadPoller(gamepad, GAMEPAD_POLL_PERIOD_MS),
     xPid(-MAX_PITCH_ROLL_TARGET_ANGLE, MAX_PITCH_ROLL_TARGET_ANGLE, 0.0, true),
     yPid(-MAX_PITCH_ROLL_TARGET_ANGLE, MAX_PITCH_ROLL_TARGET_ANGLE, 0.0, true),
     zPid(0.0, (double)MAX_THRUST, 0.0, true) // Add A_PRIORI_THRUST later.
 {
     ui->setupUi(this);
 
+    groundClock.start();
+
     setWindowTitle(APP_NAME);
 
-    // Setup the TCP server.
-    connect(&server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    // Setup the TCP server. Each phone gets its own session.
+    currentSession = 0;
+    connect(&server, SIGNAL(newLink(VehicleLink*)), this, SLOT(onNewLink(VehicleLink*)));
+    connect(&telemetryHandoff, SIGNAL(available()), this, SLOT(drainTelemetry()));
 
     if(!server.listen(QHostAddress::Any, IN_PORT))
     {
@@ -27,7 +45,22 @@ MainWindow::MainWindow(QWidget *parent) :
         exit(0);
     }
 
-    onClientDisconnected();
+    // Get the mappings of the known gamepad models.
+    QMap<QString, GamepadMapping> gamepadProfiles;
+    settings.beginGroup("gamepad_profiles");
+
+    foreach(const QString &key, settings.childKeys())
+    {
+        GamepadMapping mapping;
+
+        if(GamepadMapping::fromString(settings.value(key).toString(), mapping))
+            gamepadProfiles.insert(key, mapping);
+        else
+            qDebug() << "Invalid gamepad profile:" << key;
+    }
+
+    settings.endGroup();
+    gamepad.setProfiles(gamepadProfiles);
 
     // Get the gamepad.
     QStringList gamepads = gamepad.getGamepadsList();
@@ -58,6 +91,13 @@ MainWindow::MainWindow(QWidget *parent) :
         gamepadWasConnected = false;
     }
 
+    // Save the mapping of the gamepad model, so it can be edited.
+    if(!gamepad.getProfileKey().isEmpty())
+    {
+        settings.setValue("gamepad_profiles/" + gamepad.getProfileKey(),
+                          gamepad.getMapping().toString());
+    }
+
     // Setup the timer.
     updateTimer.setSingleShot(false);
     updateTimer.start(UPDATE_PERIOD_MS);
@@ -67,6 +107,22 @@ MainWindow::MainWindow(QWidget *parent) :
     qRegisterMetaType<QList<double> >("charList");
     qRegisterMetaTypeStreamOperators<QList<double> >("charList");
 
+    // Setup the shaping of the gamepad axes, then start reading the gamepad.
+    AxisShaping sticksShaping;
+    sticksShaping.deadZone = DEAD_ZONE_GAMEPAD;
+    sticksShaping.expo = STICKS_EXPO;
+    gamepadPoller.setAxisShaping(THRUST_AXIS, loadAxisShaping("thrust_shaping", sticksShaping));
+    gamepadPoller.setAxisShaping(YAW_AXIS, loadAxisShaping("yaw_shaping", sticksShaping));
+
+    sticksShaping.deadZone = PITCH_ROLL_DEAD_ZONE;
+    sticksShaping.minCutoff = PITCH_ROLL_FILTER_MIN_CUTOFF_HZ;
+    sticksShaping.beta = PITCH_ROLL_FILTER_BETA;
+    sticksShaping.maxRate = PITCH_ROLL_MAX_RATE;
+    gamepadPoller.setAxisShaping(PITCH_AXIS, loadAxisShaping("pitch_shaping", sticksShaping));
+    gamepadPoller.setAxisShaping(ROLL_AXIS, loadAxisShaping("roll_shaping", sticksShaping));
+
+    gamepadPoller.start(QThread::HighPriority);
+
     QList<double> defaultList;
     QList<double> coefs = settings.value("regulators_coefficients", QVariant::fromValue(defaultList)).value< QList<double> >();
 
@@ -101,18 +157,117 @@ MainWindow::MainWindow(QWidget *parent) :
         ui->reguCoefRollD->setValue(0.1);
     }
 
+    // Retrieve the previously saved position PIDs coefficients.
+    QList<double> positionCoefs = settings.value("position_coefficients", QVariant::fromValue(defaultList)).value< QList<double> >();
+
+    if(positionCoefs.size() != 6) // No previous values exist, use the default values.
+    {
+        positionCoefs.clear();
+        positionCoefs << DEFAULT_XY_PID_KP << DEFAULT_XY_PID_KI << DEFAULT_XY_PID_KD
+                      << DEFAULT_Z_PID_KP << DEFAULT_Z_PID_KI << DEFAULT_Z_PID_KD;
+    }
+
+    xPid.setCoefficients(positionCoefs[0], positionCoefs[1], positionCoefs[2]);
+    yPid.setCoefficients(positionCoefs[0], positionCoefs[1], positionCoefs[2]);
+    zPid.setCoefficients(positionCoefs[3], positionCoefs[4], positionCoefs[5]);
+
+    // Save them back, so they can be tuned by editing the settings.
+    settings.setValue("position_coefficients", QVariant::fromValue(positionCoefs));
+
     // Other initializations.
     currentThrust = 0;
     currentYaw = 0;
-    clientSocket = 0;
-    fpvFrameNumber = 0;
-    clientSocket = 0;
+    positionX = 0.0;
+    positionY = 0.0;
+    positionZ = 0.0;
+    positionYaw = 0.0;
+    sentPitchAngle = 0.0;
+    sentRollAngle = 0.0;
 
     ui->yawGraphic->setup(50, 180.0, 20.0);
     ui->pitchGraphic->setup(50, 40.0, 20.0);
     ui->rollGraphic->setup(50, 40.0, 20.0);
     ui->altitudeGraphic->setup(50, 3, 255.0);
 
+    // The charts display the telemetry store of the selected vehicle, set by
+    // selectVehicle().
+    displayedTelemetryCount = 0;
+
+    // Register the values labels, in the order of the DisplayedLabel enum.
+    labels.addLabel(ui->currentYawLabel, "%.6g");
+    labels.addLabel(ui->currentPitchLabel, "%.6g");
+    labels.addLabel(ui->currentRollLabel, "%.6g");
+    labels.addLabel(ui->currentAltitudeLabel, "%.6g");
+    labels.addLabel(ui->currentYawCommandLabel, "%.6g");
+    labels.addLabel(ui->currentPitchCommandLabel, "%.6g");
+    labels.addLabel(ui->currentRollCommandLabel, "%.6g");
+    labels.addLabel(ui->currentAltitudeCommandLabel, "%.6g");
+    labels.addLabel(ui->currentBatteryLabel, "%.4g (%.6g%%)");
+    labels.addLabel(ui->currentTemperatureLabel, "%.0f");
+    labels.addLabel(ui->regulatorStateLabel, "%.0f");
+    labels.addLabel(ui->thrustLabel, "%.0f");
+    labels.addLabel(ui->yawLabel, "%.1f");
+    labels.addLabel(ui->pitchLabel, "%.1f");
+    labels.addLabel(ui->rollLabel, "%.1f");
+    labels.addLabel(ui->diskStatusLabel, "Disk queue: %.0f kB, %.0f file(s) dropped");
+
+    // Setup the display timer. The labels and the charts are not refreshed
+    // at each telemetry message, but at a lower, fixed rate.
+    int displayRate = settings.value("display_refresh_rate", DISPLAY_REFRESH_RATE_HZ).toInt();
+
+    if(displayRate <= 0)
+        displayRate = DISPLAY_REFRESH_RATE_HZ;
+
+    settings.setValue("display_refresh_rate", displayRate);
+    displayTimer.setSingleShot(false);
+    displayTimer.start(1000 / displayRate);
+    connect(&displayTimer, SIGNAL(timeout()), this, SLOT(refreshDisplay()));
+
+    // Latency budget of the adaptive FPV.
+    fpvLatencyBudget = settings.value("fpv_latency_budget_ms", FPV_LATENCY_BUDGET_MS).toInt();
+    settings.setValue("fpv_latency_budget_ms", fpvLatencyBudget);
+
+    // Setup the disk writer.
+    int fsyncPolicy = settings.value("disk_fsync_policy", DiskWriter::FSYNC_ON_CLOSE).toInt();
+
+    if(fsyncPolicy < DiskWriter::FSYNC_NEVER || fsyncPolicy > DiskWriter::FSYNC_EACH_BATCH)
+        fsyncPolicy = DiskWriter::FSYNC_ON_CLOSE;
+
+    settings.setValue("disk_fsync_policy", fsyncPolicy);
+    diskWriter.setFsyncPolicy((DiskWriter::FsyncPolicy)fsyncPolicy);
+    connect(&diskWriter, SIGNAL(fileWritten(QString)), this, SLOT(onFileWritten(QString)));
+    connect(&diskWriter, SIGNAL(writeFailed(QString)), this, SLOT(onWriteFailed(QString)));
+
+    // Setup the messages log. Only the recent messages are kept in memory,
+    // all of them are streamed to a file.
+    ui->logView->setModel(&messagesLog);
+    ui->logView->setUniformItemSizes(true);
+    messagesLogStream = diskWriter.openStream(QString("../logs/messages(%1).txt")
+                                              .arg(QDateTime::currentDateTime()
+                                                   .toString("yyyy-MM-dd-hh-mm-ss")));
+    connect(ui->logSeverityCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(setLogSeverity(int)));
+
+    // Setup the link health monitoring.
+    linkDegradedRtt = settings.value("link_degraded_rtt_ms", LINK_DEGRADED_RTT_MS).toInt();
+    linkCriticalRtt = settings.value("link_critical_rtt_ms", LINK_CRITICAL_RTT_MS).toInt();
+    linkLostTimeout = settings.value("link_lost_timeout_ms", LINK_LOST_TIMEOUT_MS).toInt();
+    settings.setValue("link_degraded_rtt_ms", linkDegradedRtt);
+    settings.setValue("link_critical_rtt_ms", linkCriticalRtt);
+    settings.setValue("link_lost_timeout_ms", linkLostTimeout);
+
+    commandAgeBudget = settings.value("command_age_budget_ms", COMMAND_AGE_BUDGET_MS).toInt();
+    settings.setValue("command_age_budget_ms", commandAgeBudget);
+
+    compactTelemetry = settings.value("compact_telemetry", COMPACT_TELEMETRY).toBool();
+    settings.setValue("compact_telemetry", compactTelemetry);
+
+    estimatedStateDisplay = settings.value("estimated_state_display", ESTIMATED_STATE_DISPLAY).toBool();
+    settings.setValue("estimated_state_display", estimatedStateDisplay);
+
+    linkTimer.setSingleShot(false);
+    linkTimer.start(LINK_PING_PERIOD_MS);
+    connect(&linkTimer, SIGNAL(timeout()), this, SLOT(checkLinks()));
+
     // Connect the signals to the slot functions.
     connect(ui->reguCoefYawP, SIGNAL(editingFinished()), this, SLOT(updateReguCoefs()));
     connect(ui->reguCoefYawI, SIGNAL(editingFinished()), this, SLOT(updateReguCoefs()));
@@ -134,13 +289,25 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->saveLogButton, SIGNAL(clicked()), this, SLOT(saveMessagesLog()));
     connect(ui->resetDeviceYawButton, SIGNAL(clicked()), this, SLOT(resetDeviceOrientation()));
     connect(ui->altitudeLockCheckbox, SIGNAL(toggled(bool)), this, SLOT(setAltitudeLock()));
+    connect(ui->positionHoldCheckbox, SIGNAL(toggled(bool)), this, SLOT(setPositionHold()));
+    connect(ui->positionSimulationCheckbox, SIGNAL(toggled(bool)), this, SLOT(setPositionSimulation()));
 
+    connect(ui->vehicleCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(selectVehicle(int)));
     connect(ui->fpvCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(setFpvState()));
+    connect(ui->fpvAdaptiveCheckbox, SIGNAL(toggled(bool)), this, SLOT(setFpvState()));
     connect(ui->fpvSaveFramesCheckbox, SIGNAL(toggled(bool)), this, SLOT(setFpvRecording()));
     connect(ui->fpvTakePictureButton, SIGNAL(clicked()), this, SLOT(takePicture()));
+    connect(ui->archiveOpenButton, SIGNAL(clicked()), this, SLOT(openArchive()));
+    connect(ui->archiveCloseButton, SIGNAL(clicked()), this, SLOT(closeArchive()));
+    connect(ui->archiveSlider, SIGNAL(valueChanged(int)), this, SLOT(showArchiveTime(int)));
+
+    // Let the phones find the ground station on the LAN. If the discovery
+    // port is taken, the phone can still connect to a typed address.
+    if(!discoveryBeacon.start(IN_PORT))
+        logMessage(LOG_WARNING, "Can't listen on the discovery port " + QString::number(DISCOVERY_PORT) + ", the phone will need the IP address.");
 
     // Reload the address the phone should connect to.
-    onClientDisconnected();
+    updateConnectionStatus();
 
     // Listen to the keypresses.
     setFocusPolicy(Qt::StrongFocus);
@@ -149,122 +316,374 @@ MainWindow::MainWindow(QWidget *parent) :
 MainWindow::~MainWindow()
 {
     // Save the regulators coefficients.
-    QList<double> coefs;
-    coefs << ui->reguCoefYawP->value() << ui->reguCoefYawI->value() << ui->reguCoefYawD->value()
-          << ui->reguCoefPitchP->value() << ui->reguCoefPitchI->value() << ui->reguCoefPitchD->value()
-          << ui->reguCoefRollP->value() << ui->reguCoefRollI->value() << ui->reguCoefRollD->value()
-          << ui->reguCoefAltitudeP->value() << ui->reguCoefAltitudeI->value() << ui->reguCoefAltitudeD->value();
-    settings.setValue("regulators_coefficients", QVariant::fromValue(coefs));
+    settings.setValue("regulators_coefficients", QVariant::fromValue(getRegulatorCoefficients()));
+
+    // Close the connections. The links are deleted by their I/O threads, when
+    // the server is destroyed: before telemetryHandoff and messageBuffers,
+    // which they use (see the declaration order in mainwindow.h).
+    qDeleteAll(sessions);
+    sessions.clear();
+    linkSessions.clear();
+    currentSession = 0;
+
+    foreach(const PendingLink &pending, pendingLinks)
+    {
+        QMetaObject::invokeMethod(pending.link, "close", Qt::QueuedConnection);
+        pending.link->deleteLater();
+    }
+
+    pendingLinks.clear();
+
+    diskWriter.closeStream(messagesLogStream);
 
     // Delete all the widgets.
     delete ui;
 }
 
-void MainWindow::acceptConnection()
+void MainWindow::onNewLink(VehicleLink *link)
 {
-    clientSocket = server.nextPendingConnection();
+    PendingLink pending;
+    pending.link = link;
+    pendingLinks.insert(link->getVehicleId(), pending);
+
+    // The link lives in an I/O thread, so these connections are queued.
+    link->setTelemetryHandoff(&telemetryHandoff, (1u << CURRENT_STATE) | (1u << COMPACT_STATE));
+    link->setBufferPool(&messageBuffers);
+    link->setCommandAgeBudget(commandAgeBudget);
+    connect(link, SIGNAL(started(int,QString)), this, SLOT(onLinkStarted(int,QString)));
+    connect(link, SIGNAL(messageReceived(int,int,QByteArray)),
+            this, SLOT(onMessageReceived(int,int,QByteArray)));
+    connect(link, SIGNAL(disconnected(int)), this, SLOT(onLinkDisconnected(int)));
+}
 
-    connect(clientSocket, SIGNAL(readyRead()), this, SLOT(onDataReceived()));
-    connect(clientSocket, SIGNAL(disconnected()),
-            this, SLOT(onClientDisconnected()));
+void MainWindow::drainTelemetry()
+{
+    telemetryHandoff.startDrain();
 
-    inMessageSize = 0;
-    ui->yawGraphic->clearGraph();
-    ui->pitchGraphic->clearGraph();
-    ui->rollGraphic->clearGraph();
+    ReceivedTelemetry telemetry;
 
-    // Update the UI.
-    ui->statusLabel->setText("Connected to: " +
-                             clientSocket->peerAddress().toString() + ":" +
-                             QString::number(clientSocket->peerPort()));
+    while(telemetryHandoff.pop(telemetry))
+    {
+        // The session may have been suspended since the reception, or not be
+        // opened yet (the telemetry can overtake the session token).
+        VehicleSession *session = linkSessions.value(telemetry.vehicleId, 0);
 
-    ui->statusLabel->setStyleSheet("color: green;");
+        if(session != 0)
+            displayCurrentState(session, telemetry.type, telemetry.data);
 
-    ui->regulatorsGroup->setEnabled(true);
+        messageBuffers.release(telemetry.data);
+    }
+}
 
-    // Send the regulators parameters.
-    updateReguCoefs();
+void MainWindow::onLinkStarted(int vehicleId, QString peerName)
+{
+    if(pendingLinks.contains(vehicleId))
+        pendingLinks[vehicleId].peerName = peerName;
 }
 
-void MainWindow::onDataReceived()
+void MainWindow::onMessageReceived(int vehicleId, int type, QByteArray data)
 {
-    while((clientSocket != 0) && (clientSocket->bytesAvailable() >= MESSAGE_SIZE_SIZE))
+    VehicleSession *session = linkSessions.value(vehicleId, 0);
+
+    // The first message of a phone opens its session. It should be its
+    // token, otherwise the session can't be resumed.
+    if(session == 0 && pendingLinks.contains(vehicleId))
+        session = openSession(vehicleId, (type == SESSION) ? data.trimmed() : QByteArray());
+
+    if(session == 0)
     {
-        // Get the size of the message, if not acquired yet.
-        // The size is given by the first 32 bits (4 bytes) of the message.
-        if(inMessageSize == 0)
-        {
-            if(clientSocket->bytesAvailable() < MESSAGE_SIZE_SIZE)
-                return; // The size has not been received entirely.
-            else
-            {
-                const QByteArray ba = clientSocket->read(MESSAGE_SIZE_SIZE);
+        messageBuffers.release(data);
+        return;
+    }
 
-                // Conversion des octets reus en int.
-                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(ba.data());
-                inMessageSize = ((bytes[0]<<24)|(bytes[1]<<16)|(bytes[2]<<8)|(bytes[3]));
-            }
+    switch(type)
+    {
+    case TEXT: // Display the text message to the user.
+        displayTextMessage(session, data);
+        break;
+
+    case VIDEO_FRAME: // Display the image to the user.
+        displayImage(session, data);
+        break;
+
+    case LOG: // Save the log to a text file.
+        savePhoneLog(session, data);
+        break;
+
+    case CURRENT_STATE: // Update the states chart.
+    case COMPACT_STATE:
+        displayCurrentState(session, type, data);
+        break;
+
+    case PHOTO: // Save the photo.
+        savePhoto(session, data);
+        break;
+
+    case PONG: // Update the link health estimates and the clock synchronization.
+        session->addPong(data, groundClock.elapsed());
+        break;
+
+    case SESSION: // Already processed by openSession().
+        break;
+
+    case CHUNK: // Write the piece of photo or log to its file.
+        receiveChunk(session, data);
+        break;
+
+    case TELEMETRY_BACKLOG: // Fill the gap of the charts and of the export.
+    {
+        int addedCount = session->addTelemetryBacklog(data, groundClock.elapsed());
+        logMessage(LOG_INFO, QString("%1: %2 missed telemetry samples recovered.")
+                             .arg(session->getName()).arg(addedCount));
+        break;
+    }
+
+    default: // Error.
+        qDebug() << "Unexpected message type:" << type;
+        break;
+    }
+
+    // The buffer is reused once the copies kept meanwhile (e.g. by the disk
+    // writer) are destroyed.
+    messageBuffers.release(data);
+}
+
+void MainWindow::onLinkDisconnected(int vehicleId)
+{
+    // A phone which disconnected before sending anything.
+    if(pendingLinks.contains(vehicleId))
+    {
+        VehicleLink *link = pendingLinks.take(vehicleId).link;
+        QMetaObject::invokeMethod(link, "close", Qt::QueuedConnection);
+        link->deleteLater();
+        return;
+    }
+
+    VehicleSession *session = linkSessions.take(vehicleId);
+
+    if(session == 0)
+        return;
+
+    logMessage(LOG_WARNING, session->getName() + " disconnected.");
+    logCommandStats(session);
+    logOutboundStats(session);
+
+    if(session->getToken().isEmpty())
+    {
+        closeSession(session);
+        return;
+    }
+
+    // Keep the session, its charts and its recordings, so the phone can
+    // resume it. The phone stops by itself when the link drops, so do not
+    // keep the regulators enabled.
+    session->suspend(groundClock.elapsed());
+
+    if(session == currentSession)
+        ui->regulatorsOnCheckBox->setChecked(false);
+
+    int index = ui->vehicleCombo->findData(session->getId());
+
+    if(index >= 0)
+        ui->vehicleCombo->setItemText(index, session->getName());
+
+    updateConnectionStatus();
+}
+
+VehicleSession* MainWindow::openSession(int linkId, const QByteArray &token)
+{
+    PendingLink pending = pendingLinks.take(linkId);
+    VehicleSession *session = 0;
+
+    // Find the session of the phone. After a Wi-Fi drop, the phone usually
+    // reconnects before the old socket is known to be dead, so the session
+    // may still look connected.
+    if(!token.isEmpty())
+    {
+        foreach(VehicleSession *previous, sessions)
+        {
+            if(previous->getToken() == token)
+                session = previous;
         }
+    }
+
+    if(session != 0)
+    {
+        qint64 suspendedDuration = session->getSuspendedDuration(groundClock.elapsed());
 
-        // If the whole message arrived, it is now possible to read it.
-        if(clientSocket->bytesAvailable() >= inMessageSize)
+        if(session->isConnected())
         {
-            // The first byte is the signification of the message.
-            int type = clientSocket->read(1)[0];
+            // The old link is closed by resume(). Its disconnection will not
+            // be reported to the session anymore.
+            linkSessions.remove(session->getLinkId());
+            logMessage(LOG_WARNING, session->getName() + " reconnected, its previous link is closed.");
+
+            // The phone stopped by itself when the old link dropped.
+            if(session == currentSession)
+                ui->regulatorsOnCheckBox->setChecked(false);
+        }
 
-            // Read the rest of the message, according to its type.
-            QByteArray data = clientSocket->read(inMessageSize-1);
+        // The coefficients are only sent if they changed, and the missed
+        // telemetry is requested.
+        session->resume(pending.link, groundClock.elapsed());
+        session->setPeerName(pending.peerName);
+        logMessage(LOG_INFO, QString("%1 resumed its session, after %2 s.")
+                             .arg(session->getName())
+                             .arg(suspendedDuration / 1000.0, 0, 'f', 1));
 
-            switch(type)
-            {
-            case TEXT: // Display the text message to the user.
-                displayTextMessage(data);
-                break;
+        int index = ui->vehicleCombo->findData(session->getId());
+
+        if(index >= 0)
+            ui->vehicleCombo->setItemText(index, session->getName());
+
+        // Restore the FPV of the displayed vehicle.
+        if(session == currentSession)
+            setFpvState();
+    }
+    else
+    {
+        session = new VehicleSession(pending.link, token, getRegulatorCoefficients(), diskWriter);
+        session->setPeerName(pending.peerName);
+        session->getChunkReceiver().setFilenamePattern(PHOTO, "../pictures/pic(%1)_" + session->getFileTag() + ".jpg");
+        session->getChunkReceiver().setFilenamePattern(LOG, "../logs/log(%1)_" + session->getFileTag() + ".txt");
+        sessions.insert(session->getId(), session);
+        logMessage(LOG_INFO, session->getName() + " connected.");
 
-            case VIDEO_FRAME: // Display the image to the user.
-                displayImage(data);
-                break;
+        // The charts and the FPV label are needed for the live data.
+        closeArchive();
 
-            case LOG: // Save the log to a text file.
-                savePhoneLog(data);
-                break;
+        // Send the regulators parameters.
+        session->setRegulatorCoefficients(session->getRegulatorCoefficients());
 
-            case CURRENT_STATE: // Update the states chart.
-                displayCurrentState(data);
-                break;
+        // Update the UI. The first vehicle is selected automatically.
+        ui->vehicleCombo->addItem(session->getName(), session->getId());
+    }
 
-            case PHOTO: // Save the photo.
-                savePhoto(data);
-                break;
+    session->getFpvController().setLatencyBudget(fpvLatencyBudget);
+    session->getLinkMonitor().setThresholds(linkDegradedRtt, linkCriticalRtt, linkLostTimeout);
+    linkSessions.insert(linkId, session);
 
-            default: // Error.
-                qDebug() << "Unexpected message type:" << type;
-                break;
-            }
+    // The phone sends the text states until asked otherwise, at each
+    // connection.
+    if(compactTelemetry)
+        session->sendMessage("telemetry_format compact");
+
+    updateConnectionStatus();
+
+    return session;
+}
+
+void MainWindow::closeSession(VehicleSession *session)
+{
+    sessions.remove(session->getId());
+    linkSessions.remove(session->getLinkId());
+
+    logExportStats(session);
+    logPoolStats();
+    logLabelStats();
+
+    // Never keep controlling a vehicle that is not there anymore.
+    if(session == currentSession)
+    {
+        currentSession = 0;
+        ui->regulatorsOnCheckBox->setChecked(false);
+    }
+
+    // Removing the item selects another vehicle, if any.
+    int index = ui->vehicleCombo->findData(session->getId());
+
+    if(index >= 0)
+        ui->vehicleCombo->removeItem(index);
+
+    delete session;
+
+    updateConnectionStatus();
+}
+
+void MainWindow::selectVehicle(int index)
+{
+    VehicleSession *session = 0;
 
-            // Ready to receive a new message.
-            inMessageSize = 0;
+    if(index >= 0)
+        session = sessions.value(ui->vehicleCombo->itemData(index).toInt(), 0);
+
+    if(session == currentSession)
+        return;
+
+    // Stop the video of the previous vehicle, only the selected one is
+    // displayed.
+    if(currentSession != 0)
+    {
+        if(ui->fpvCombo->currentIndex() != 0)
+            currentSession->sendMessage("fpv stop");
+
+        currentSession->stopFpvRecording();
+    }
+
+    ui->fpvCombo->blockSignals(true);
+    ui->fpvCombo->setCurrentIndex(0);
+    ui->fpvCombo->blockSignals(false);
+    ui->fpvSaveFramesCheckbox->blockSignals(true);
+    ui->fpvSaveFramesCheckbox->setChecked(false);
+    ui->fpvSaveFramesCheckbox->blockSignals(false);
+
+    // The position estimate belonged to the previous vehicle.
+    ui->positionHoldCheckbox->setChecked(false);
+    positionEstimateTime = QTime();
+
+    currentSession = session;
+
+    const TelemetryStore *store = 0;
+
+    if(session != 0)
+    {
+        store = &session->getTelemetry();
+
+        // Display the coefficients of this vehicle.
+        QList<double> coefs = session->getRegulatorCoefficients();
+
+        if(coefs.size() == 12)
+        {
+            ui->reguCoefYawP->setValue(coefs[0]);
+            ui->reguCoefYawI->setValue(coefs[1]);
+            ui->reguCoefYawD->setValue(coefs[2]);
+            ui->reguCoefPitchP->setValue(coefs[3]);
+            ui->reguCoefPitchI->setValue(coefs[4]);
+            ui->reguCoefPitchD->setValue(coefs[5]);
+            ui->reguCoefRollP->setValue(coefs[6]);
+            ui->reguCoefRollI->setValue(coefs[7]);
+            ui->reguCoefRollD->setValue(coefs[8]);
+            ui->reguCoefAltitudeP->setValue(coefs[9]);
+            ui->reguCoefAltitudeI->setValue(coefs[10]);
+            ui->reguCoefAltitudeD->setValue(coefs[11]);
         }
-        else
-            break;
     }
+
+    // The charts display the telemetry of the selected vehicle.
+    ui->yawGraphic->setSource(store, TM_YAW, TM_TARGET_YAW, TM_YAW_COMMAND);
+    ui->pitchGraphic->setSource(store, TM_PITCH, TM_TARGET_PITCH, TM_PITCH_COMMAND);
+    ui->rollGraphic->setSource(store, TM_ROLL, TM_TARGET_ROLL, TM_ROLL_COMMAND);
+    ui->altitudeGraphic->setSource(store, TM_ALTITUDE, TM_TARGET_ALTITUDE, TM_ALTITUDE_COMMAND);
+    displayedTelemetryCount = -1;
 }
 
-void MainWindow::displayTextMessage(QByteArray data)
+void MainWindow::displayTextMessage(VehicleSession *session, QByteArray data)
 {
     QString textMessage(data);
 
-    QDateTime now = QDateTime::currentDateTime();
-    ui->logEdit->appendPlainText(now.toString("(yyyy.MM.dd hh.mm.ss.zzz) ")
-                                 + textMessage);
+    logMessage(LOG_INFO, "[" + session->getFileTag() + "] " + textMessage);
 }
 
-void MainWindow::displayImage(QByteArray data)
+void MainWindow::displayImage(VehicleSession *session, QByteArray data)
 {
-    // Create a QPixmap from the byte array.
-    QPixmap pixmap;
-    pixmap.loadFromData(data);
-    ui->fpvVideoLabel->setPixmap(pixmap);
+    // Only the video of the selected vehicle is displayed.
+    if(session != currentSession)
+        return;
+
+    session->getFpvController().addFrame(data.size());
+    adjustFpvRate(session);
+
+    ui->fpvVideoLabel->showJpeg(data);
 
     // Compute the bitrate and the number of frames per second.
     double elapsedTime = (double)time.restart();
@@ -274,6 +693,8 @@ void MainWindow::displayImage(QByteArray data)
         fpvBitrate = FPV_RATE_LPF * fpvBitrate + (1.0-FPV_RATE_LPF) * data.size() / elapsedTime;
         fpvFramerate = FPV_RATE_LPF * fpvFramerate + (1.0-FPV_RATE_LPF) * 1000.0 / elapsedTime;
 
+        FpvRateController &fpvController = session->getFpvController();
+
         // Affichage de l'estimation du dbit et du FPS.
         if(elapsedTime > 0)
         {
@@ -281,136 +702,220 @@ void MainWindow::displayImage(QByteArray data)
                                         + QString::number(fpvBitrate, 'f', 0)
                                         + " ko/s ("
                                         + QString::number(fpvFramerate, 'f', 0)
-                                        + " fps).");
+                                        + " fps, quality "
+                                        + QString::number(fpvController.getQuality())
+                                        + ", queuing "
+                                        + QString::number(fpvController.getQueuingDelay(), 'f', 0)
+                                        + " ms).");
         }
         else
             ui->fpvStatusLabel->setText("Data reception.");
     }
 
-    // Save the frame if needed.
-    if(ui->fpvSaveFramesCheckbox->isChecked() && QFile::exists(fpvSaveFolder))
-    {
-        pixmap.save(fpvSaveFolder + "\\frame_" +
-                    QString::number(fpvFrameNumber).rightJustified(9, '0')
-                    + ".jpg", "JPG");
-        fpvFrameNumber++;
-    }
+    // Record the frame if needed. The received JPEG is written as it is,
+    // with its time.
+    session->recordFpvFrame(groundClock.elapsed(), data);
 }
 
-void MainWindow::savePhoneLog(QByteArray data)
+void MainWindow::receiveChunk(VehicleSession *session, QByteArray data)
 {
-    QString filename = QString("../logs/log(%1).txt").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss"));
-    QFile file(filename);
+    qint64 now = groundClock.elapsed();
+    ChunkReceiver::Transfer transfer;
+
+    switch(session->getChunkReceiver().addChunk(data, now, transfer))
+    {
+    case ChunkReceiver::CHUNK_MISSING:
+        session->sendMessage(QString("chunk_resume %1 %2").arg(transfer.streamId).arg(transfer.receivedSize));
+        break;
 
-    if(file.open(QFile::WriteOnly | QFile::Text))
+    case ChunkReceiver::CHUNK_COMPLETED:
     {
-        file.write(data);
-        ui->logEdit->appendPlainText(QString("Phone logfile saved: ") + filename);
+        session->sendMessage(QString("chunk_done %1").arg(transfer.streamId));
+
+        // The longest interval between two telemetry messages shows how much
+        // the transfer delayed them.
+        logMessage(LOG_INFO, QString("[%1] %2 received: %3 kB in %4 ms, telemetry delayed by %5 ms at most.")
+                             .arg(session->getFileTag())
+                             .arg(transfer.filename)
+                             .arg(transfer.totalSize / 1024)
+                             .arg(now - transfer.startTime)
+                             .arg(session->getTelemetry().longestGap(transfer.startTime, now)));
+        break;
+    }
+
+    case ChunkReceiver::CHUNK_INVALID:
+        qDebug() << "receiveChunk(): invalid chunk of" << data.size() << "bytes.";
+        break;
+
+    default:
+        break;
     }
-    else
-        ui->logEdit->appendPlainText("Can't write the phone log to file!");
 }
 
-void MainWindow::displayCurrentState(QByteArray data)
+void MainWindow::savePhoneLog(VehicleSession *session, QByteArray data)
 {
-    QString str(data);
+    logUnchunkedDelay(session, "log", data.size());
+
+    QString filename = QString("../logs/log(%1)_%2.txt").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss")).arg(session->getFileTag());
+
+    if(!diskWriter.writeFile(filename, data, true))
+        logMessage(LOG_WARNING, "Can't write the phone log to file, the disk is too slow!");
+}
 
-    QStringList words = str.split(' ');
+void MainWindow::displayCurrentState(VehicleSession *session, int type, QByteArray data)
+{
+    double values[TM_CHANNELS_COUNT];
+    TelemetryDecoder::Result result;
+
+    if(type == COMPACT_STATE)
+        result = session->decodeCompactState(data, values);
+    else if(VehicleSession::parseState(data, values))
+        result = TelemetryDecoder::DECODE_OK;
+    else
+        result = TelemetryDecoder::DECODE_INVALID;
 
-    if(words.size() == 16)
+    if(result == TelemetryDecoder::DECODE_OK)
     {
-        int time = words[0].toInt();
-        double currentYaw = words[1].toDouble();
-        double targetYaw = words[2].toDouble();
-        double yawCommand = words[3].toDouble();
-        double currentPitch = words[4].toDouble();
-        double targetPitch = words[5].toDouble();
-        double pitchCommand = words[6].toDouble();
-        double currentRoll = words[7].toDouble();
-        double targetRoll = words[8].toDouble();
-        double rollCommand = words[9].toDouble();
-        double batteryVoltage = words[10].toDouble();
-        double temperature = words[11].toDouble();
-        bool regulatorEnabled = words[12].toInt() != 0;
-        double currentAltitude = words[13].toDouble();
-        double targetAltitude = words[14].toDouble();
-        double altitudeCommand = words[15].toDouble();
+        // Store the new sample.
+        qint64 groundTime = groundClock.elapsed();
+        session->addTelemetry(groundTime, values);
 
-        double batteryPercent = (batteryVoltage-MIN_BATTERY_VOLTAGE) / (MAX_BATTERY_VOLTAGE-MIN_BATTERY_VOLTAGE) * 100.0;
+        // The telemetry timestamps give the delay of the link.
+        session->getFpvController().addTelemetry(groundTime, values[TM_PHONE_TIME]);
+        adjustFpvRate(session);
+
+        // The other vehicles are only recorded, not displayed.
+        if(session != currentSession)
+            return;
 
-        ui->yawGraphic->nextStep(time, currentYaw, targetYaw, yawCommand);
-        ui->pitchGraphic->nextStep(time, currentPitch, targetPitch, pitchCommand);
-        ui->rollGraphic->nextStep(time, currentRoll, targetRoll, rollCommand);
-        ui->altitudeGraphic->nextStep(time, currentAltitude, targetAltitude, altitudeCommand);
+        // Update the labels values. They will actually be displayed by
+        // refreshDisplay(), as the charts. The values are read from the
+        // sample, not from the store: while the session holds the telemetry
+        // for the backlog, the store still ends before the link drop.
+        double currentYaw = values[TM_YAW];
+        double currentAltitude = values[TM_ALTITUDE];
+        double batteryVoltage = values[TM_BATTERY_VOLTAGE];
+        bool regulatorEnabled = values[TM_REGULATOR_STATE] != 0.0;
 
-        ui->currentYawLabel->setText(QString::number(currentYaw));
-        ui->currentPitchLabel->setText(QString::number(currentPitch));
-        ui->currentRollLabel->setText(QString::number(currentRoll));
-        ui->currentAltitudeLabel->setText(QString::number(currentAltitude));
+        double batteryPercent = (batteryVoltage-MIN_BATTERY_VOLTAGE) / (MAX_BATTERY_VOLTAGE-MIN_BATTERY_VOLTAGE) * 100.0;
+
+        // The predicted state is displayed by updateStateEstimate() instead,
+        // once available.
+        if(!estimatedStateDisplay || !session->getStateEstimator().isInitialized())
+        {
+            labels.setValue(CURRENT_YAW_LABEL, currentYaw);
+            labels.setValue(CURRENT_PITCH_LABEL, values[TM_PITCH]);
+            labels.setValue(CURRENT_ROLL_LABEL, values[TM_ROLL]);
+            labels.setValue(CURRENT_ALTITUDE_LABEL, currentAltitude);
+        }
 
-        ui->currentYawCommandLabel->setText(QString::number(yawCommand));
-        ui->currentPitchCommandLabel->setText(QString::number(pitchCommand));
-        ui->currentRollCommandLabel->setText(QString::number(rollCommand));
-        ui->currentAltitudeCommandLabel->setText(QString::number(altitudeCommand));
+        labels.setValue(YAW_COMMAND_LABEL, values[TM_YAW_COMMAND]);
+        labels.setValue(PITCH_COMMAND_LABEL, values[TM_PITCH_COMMAND]);
+        labels.setValue(ROLL_COMMAND_LABEL, values[TM_ROLL_COMMAND]);
+        labels.setValue(ALTITUDE_COMMAND_LABEL, values[TM_ALTITUDE_COMMAND]);
 
         if(batteryVoltage > 1.0)
-            ui->currentBatteryLabel->setText(QString::number(batteryVoltage, 'g', 4) + " (" + QString::number(batteryPercent) + "%)");
+            labels.setValue(BATTERY_LABEL, batteryVoltage, batteryPercent);
         else
-            ui->currentBatteryLabel->setText("0");
+            labels.setText(BATTERY_LABEL, "0");
 
-        ui->currentTemperatureLabel->setText(QString::number((int)temperature));
-        ui->regulatorStateLabel->setText(regulatorEnabled ? "ON" : "OFF");
+        labels.setValue(TEMPERATURE_LABEL, (int)values[TM_TEMPERATURE]);
+        labels.setText(REGULATOR_STATE_LABEL, regulatorEnabled ? "ON" : "OFF");
 
+        // The time to wait for the phone to enable its regulators depends on
+        // the latency of the link.
         if(!regulatorEnabled &&
-           regulatorStartRequestTime.msecsTo(QTime::currentTime()) > REGU_ON_STATE_WAIT_TIME_MS)
+           regulatorStartRequestTime.msecsTo(QTime::currentTime()) > session->getLinkMonitor().getStateTimeout())
         {
             ui->regulatorsOnCheckBox->setChecked(false);
         }
 
-        ui->currentAltitudeLabel->setText(QString::number(currentAltitude));
+        // Store the position estimate, for the "position hold" mode. The
+        // simulator has the priority, if it is enabled.
+        if(!std::isnan(values[TM_POSITION_X]) && !ui->positionSimulationCheckbox->isChecked())
+        {
+            positionX = values[TM_POSITION_X];
+            positionY = values[TM_POSITION_Y];
+            positionZ = currentAltitude;
+            positionYaw = currentYaw;
+            positionEstimateTime.start();
+        }
     }
-    else
-        qDebug() << "displayCurrentState(): bad number of words:" << words.size();
+    else if(result == TelemetryDecoder::DECODE_INVALID)
+        qDebug() << "displayCurrentState(): bad message:" << ((type == COMPACT_STATE) ? data.toHex() : data);
+}
+
+void MainWindow::savePhoto(VehicleSession *session, QByteArray data)
+{
+    logUnchunkedDelay(session, "photo", data.size());
+
+    QString filename = QString("../pictures/pic(%1)_%2.jpg").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss")).arg(session->getFileTag());
+
+    if(!diskWriter.writeFile(filename, data, true))
+        logMessage(LOG_WARNING, "Can't write the picture to file, the disk is too slow!");
 }
 
-void MainWindow::savePhoto(QByteArray data)
+void MainWindow::updateConnectionStatus()
 {
-    QString filename = QString("../pictures/pic(%1).jpg").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss"));
-    QFile file(filename);
+    int suspendedCount = sessions.size() - linkSessions.size();
 
-    if(file.open(QFile::WriteOnly))
+    if(linkSessions.isEmpty())
     {
-        file.write(data);
-        ui->logEdit->appendPlainText(QString("Picture saved: ") + filename);
+        // Get all the possible IP addresses.
+        QStringList ipsList = getIpAddresses();
+        QString ipsString = "Waiting for a phone. On the same network, it finds this station by itself";
+
+        if(discoveryBeacon.getDiscoveryPort() != 0)
+            ipsString += " (UDP port " + QString::number(discoveryBeacon.getDiscoveryPort()) + ")";
+
+        ipsString += ".\nOtherwise, connect it to one of the following IP addresses:";
+
+        for(int i=0; i<ipsList.size(); i++)
+            ipsString += "\n    -" + ipsList[i] + ":" + QString::number(IN_PORT);
+
+        if(suspendedCount > 0)
+            ipsString += QString("\n%1 vehicle(s) can resume their session.").arg(suspendedCount);
+
+        ui->statusLabel->setText(ipsString);
+
+        ui->statusLabel->setStyleSheet("color: red;");
+
+        ui->regulatorsOnCheckBox->setChecked(false);
+        ui->regulatorsGroup->setEnabled(false);
     }
     else
-        ui->logEdit->appendPlainText("Can't write the picture to file!");
-}
+    {
+        QString status = QString("Connected to %1 vehicle(s).").arg(linkSessions.size());
 
-void MainWindow::onClientDisconnected()
-{
-    // Get all the possible IP addresses.
-    QStringList ipsList = getIpAddresses();
-    QString ipsString = "Please connect the phone to one of the following IP addresses:";
+        if(suspendedCount > 0)
+            status += QString(" %1 reconnecting.").arg(suspendedCount);
 
-    for(int i=0; i<ipsList.size(); i++)
-        ipsString += "\n    -" + ipsList[i] + ":" + QString::number(IN_PORT);
+        ui->statusLabel->setText(status);
 
-    ui->statusLabel->setText(ipsString);
+        ui->statusLabel->setStyleSheet("color: green;");
 
-    ui->statusLabel->setStyleSheet("color: red;");
+        ui->regulatorsGroup->setEnabled(true);
+    }
 
-    ui->regulatorsOnCheckBox->setChecked(false);
-    ui->regulatorsGroup->setEnabled(false);
+    // The charts and the FPV label can't display a recording and a vehicle.
+    ui->archiveOpenButton->setEnabled(ui->vehicleCombo->count() == 0);
 }
 
 void MainWindow::sendMessage(QString text)
 {
-    if(clientSocket != 0 && clientSocket->isOpen())
-    {
-        text.append("\n");
-        clientSocket->write(text.toLatin1());
-    }
+    if(currentSession != 0)
+        currentSession->sendMessage(text);
+}
+
+QList<double> MainWindow::getRegulatorCoefficients() const
+{
+    QList<double> coefs;
+    coefs << ui->reguCoefYawP->value() << ui->reguCoefYawI->value() << ui->reguCoefYawD->value()
+          << ui->reguCoefPitchP->value() << ui->reguCoefPitchI->value() << ui->reguCoefPitchD->value()
+          << ui->reguCoefRollP->value() << ui->reguCoefRollI->value() << ui->reguCoefRollD->value()
+          << ui->reguCoefAltitudeP->value() << ui->reguCoefAltitudeI->value() << ui->reguCoefAltitudeD->value();
+
+    return coefs;
 }
 
 QStringList MainWindow::getIpAddresses() const
@@ -438,23 +943,55 @@ QStringList MainWindow::getIpAddresses() const
 
 void MainWindow::computeAndSendCommands()
 {
-    // Do not compute a command if the regulators are supposed to be OFF.
+    // Advance the simulated quadcopter with the last commands sent, if it
+    // stands in for the telemetry position estimates.
+    if(ui->positionSimulationCheckbox->isChecked())
+    {
+        positionSimulator.step(currentThrust, currentYaw, sentPitchAngle,
+                               sentRollAngle, UPDATE_PERIOD_S);
+
+        positionX = positionSimulator.getX();
+        positionY = positionSimulator.getY();
+        positionZ = positionSimulator.getZ();
+        positionYaw = currentYaw;
+        positionEstimateTime.start();
+    }
+
+    updateStateEstimate();
+
+    // Do not compute a command if the regulators are supposed to be OFF. The
+    // buttons pressed meanwhile are ignored.
     if(!ui->regulatorsOnCheckBox->isChecked())
+    {
+        int button;
+        while(gamepadPoller.takeButtonPress(button))
+            ;
+
         return;
+    }
 
     // Get the data from the gamepad, or from the spinners if there is no
     // gamepad connected.
-    QVector<double> axes = gamepad.getAxes();
+    GamepadSnapshot gamepadState = gamepadPoller.getSnapshot();
+    const QVector<double> &axes = gamepadState.axes;
 
     double pitchAngle, rollAngle;
+    double climbStick = 0.0; // Thrust stick, in [-1;1], positive upwards.
 
-    if(axes.isEmpty() || !gamepad.isGamepadStillConnected())
+    // Time of the inputs, to measure the age of the command. The sliders are
+    // read now.
+    QElapsedTimer now;
+    now.start();
+    qint64 sampleTime = gamepadState.connected ? gamepadState.sampleTime :
+                                                 now.msecsSinceReference();
+
+    if(!gamepadState.connected)
     {
         if(gamepadWasConnected)
         {
             // The gamepad has just disconnected, this is very dangerous, so
             // we stop the quadcopter.
-            ui->logEdit->appendPlainText("### The gamepad has been disconnected! ###");
+            logMessage(LOG_ALARM, "### The gamepad has been disconnected! ###");
             emergencyStop();
             gamepadWasConnected = false;
             currentThrust = 0;
@@ -475,7 +1012,8 @@ void MainWindow::computeAndSendCommands()
         gamepadWasConnected = true;
 
         // Update the thrust.
-        if(fabs(axes[THRUST_AXIS]) > DEAD_ZONE_GAMEPAD)
+        // The dead zones are applied by the input shaping.
+        if(axes[THRUST_AXIS] != 0.0)
         {
             currentThrust -= (int)(axes[THRUST_AXIS] / GP_AXIS_AMPLITUDE * THRUST_VARSPEED);
 
@@ -485,8 +1023,10 @@ void MainWindow::computeAndSendCommands()
                 currentThrust = MAX_THRUST;
         }
 
+        climbStick = -axes[THRUST_AXIS] / GP_AXIS_AMPLITUDE;
+
         // Update the yaw angle.
-        if((!ui->lockYawTargetCheckBox->isChecked()) && abs(axes[YAW_AXIS]) > DEAD_ZONE_GAMEPAD)
+        if((!ui->lockYawTargetCheckBox->isChecked()) && axes[YAW_AXIS] != 0.0)
         {
             currentYaw += axes[YAW_AXIS] / GP_AXIS_AMPLITUDE * YAW_VARSPEED;
 
@@ -500,7 +1040,16 @@ void MainWindow::computeAndSendCommands()
         pitchAngle = axes[PITCH_AXIS] / GP_AXIS_AMPLITUDE * PITCH_AMPLITUDE;
         rollAngle = axes[ROLL_AXIS] / GP_AXIS_AMPLITUDE * ROLL_AMPLITUDE;
 
-        QVector<bool> buttons = gamepad.getButtons();
+        // A button pressed and released since the previous command is
+        // considered as pushed.
+        QVector<bool> &buttons = gamepadState.buttons;
+        int button;
+
+        while(gamepadPoller.takeButtonPress(button))
+        {
+            if(button < buttons.size())
+                buttons[button] = true;
+        }
 
         // Emergency stop ("safe" state). The propellers should not move, until the
         // regulators are explicitely restarted.
@@ -523,55 +1072,58 @@ void MainWindow::computeAndSendCommands()
             takePicture();
     }
 
+    // In "position hold" mode, the position PIDs compute the pitch, roll and
+    // thrust commands instead of the pilot.
+    if(ui->positionHoldCheckbox->isChecked())
+        computePositionHoldCommands(pitchAngle, rollAngle, climbStick);
+
+    sentPitchAngle = pitchAngle;
+    sentRollAngle = rollAngle;
+
     // Update the bars and the labels.
     ui->thrustSlider->setValue(currentThrust);
     ui->yawSlider->setValue((int)(currentYaw/YAW_AMPLITUDE*100.0));
     ui->pitchSlider->setValue((int)(pitchAngle/PITCH_AMPLITUDE*100.0));
     ui->rollSlider->setValue((int)(rollAngle/ROLL_AMPLITUDE*100.0));
 
-    ui->thrustLabel->setText(QString::number((int)currentThrust));
-    ui->yawLabel->setText(QString::number(currentYaw, 'f', 1));
-    ui->pitchLabel->setText(QString::number(pitchAngle, 'f', 1));
-    ui->rollLabel->setText(QString::number(rollAngle, 'f', 1));
+    labels.setValue(THRUST_TARGET_LABEL, (int)currentThrust);
+    labels.setValue(YAW_TARGET_LABEL, currentYaw);
+    labels.setValue(PITCH_TARGET_LABEL, pitchAngle);
+    labels.setValue(ROLL_TARGET_LABEL, rollAngle);
 
     // Send the command to the phone.
-    sendMessage(QString("command ") + QString::number(currentThrust) + " "
-                + QString::number(currentYaw) + " " + QString::number(pitchAngle)
-                + " " + QString::number(rollAngle));
+    if(currentSession != 0)
+        currentSession->sendCommand(currentThrust, currentYaw, pitchAngle, rollAngle,
+                                    sampleTime, groundClock.elapsed());
 }
 
 void MainWindow::emergencyStop()
 {
-    sendMessage("emergency_stop");
+    // Stop all the vehicles, not only the selected one.
+    foreach(VehicleSession *session, sessions)
+        session->sendMessage("emergency_stop");
+
     currentThrust = 0.0;
     ui->regulatorsOnCheckBox->setChecked(false);
-    ui->logEdit->appendPlainText("### Emergency stop! ###");
+    logMessage(LOG_ALARM, "### Emergency stop! ###");
 }
 
 void MainWindow::updateReguCoefs()
 {
-    sendMessage("regulator_coefs " +
-                QString::number(ui->reguCoefYawP->value()) + " " +
-                QString::number(ui->reguCoefYawI->value()) + " " +
-                QString::number(ui->reguCoefYawD->value()) + " " +
-                QString::number(ui->reguCoefPitchP->value()) + " " +
-                QString::number(ui->reguCoefPitchI->value()) + " " +
-                QString::number(ui->reguCoefPitchD->value()) + " " +
-                QString::number(ui->reguCoefRollP->value()) + " " +
-                QString::number(ui->reguCoefRollI->value()) + " " +
-                QString::number(ui->reguCoefRollD->value()) + " " +
-                QString::number(ui->reguCoefAltitudeP->value()) + " " +
-                QString::number(ui->reguCoefAltitudeI->value()) + " " +
-                QString::number(ui->reguCoefAltitudeD->value()));
+    if(currentSession != 0)
+        currentSession->setRegulatorCoefficients(getRegulatorCoefficients());
 }
 
 void MainWindow::updateReguState(bool on)
 {
     ui->quadControlGroupBox->setEnabled(on);
 
+    // The controlled vehicle can't change while its regulators are enabled.
+    ui->vehicleCombo->setEnabled(!on);
+
     regulatorStartRequestTime = QTime::currentTime();
 
-    if(gamepad.isGamepadStillConnected())
+    if(gamepadPoller.getSnapshot().connected)
     {
         // Disable the spinBoxes for mouse/keyboard control, to avoid
         // conflicting with the gamepad commands.
@@ -595,10 +1147,10 @@ void MainWindow::updateReguState(bool on)
         ui->yawSlider->setValue(0);
         ui->rollSlider->setValue(0);
         ui->pitchSlider->setValue(0);
-        ui->thrustLabel->setText("0");
-        ui->yawLabel->setText("0");
-        ui->pitchLabel->setText("0");
-        ui->rollLabel->setText("0");
+        labels.setText(THRUST_TARGET_LABEL, "0");
+        labels.setText(YAW_TARGET_LABEL, "0");
+        labels.setText(PITCH_TARGET_LABEL, "0");
+        labels.setText(ROLL_TARGET_LABEL, "0");
         sendMessage("regulator_state off");
     }
 }
@@ -613,20 +1165,192 @@ void MainWindow::togglePhoneLogging()
 
 void MainWindow::clearMessagesLog()
 {
-    ui->logEdit->clear();
+    messagesLog.clear();
 }
 
 void MainWindow::saveMessagesLog()
 {
-    QFile file(QString("logs/messagesLog(%1).txt").arg(QDateTime::currentDateTime()
-                                                  .toString("yyyy-MM-dd-hh-mm-ss")));
+    QString filename = QString("logs/messagesLog(%1).txt").arg(QDateTime::currentDateTime()
+                                                              .toString("yyyy-MM-dd-hh-mm-ss"));
 
-    if(file.open(QFile::WriteOnly | QFile::Text))
-        file.write(ui->logEdit->toPlainText().toLatin1());
-    else
+    if(!diskWriter.writeFile(filename, messagesLog.toText().toLatin1(), true))
         QMessageBox::warning(this, "Warning", "Can't write messages log to file!");
 }
 
+void MainWindow::logExportStats(VehicleSession *session)
+{
+    TelemetryExportStats stats = session->getExporter().getStats();
+
+    if(stats.rowsCount == 0)
+        return;
+
+    // Throughput of the formatting and of the compression, the writing is
+    // done by the disk writer.
+    double csvSeconds = qMax(stats.csvEncodingNs, (qint64)1) * 1e-9;
+    double columnarSeconds = qMax(stats.columnarEncodingNs, (qint64)1) * 1e-9;
+    double rawMegabytes = stats.rowsCount * (1 + TM_CHANNELS_COUNT + CMD_COUNT) * 8.0 / (1024.0 * 1024.0);
+
+    logMessage(stats.droppedCount > 0 ? LOG_WARNING : LOG_INFO,
+               QString("Telemetry export of %1: %2 rows, CSV %3 MB at %4 rows/s, "
+                       "columnar %5 MB (%6x smaller than raw) at %7 rows/s, %8 part(s) dropped.")
+               .arg(session->getName())
+               .arg(stats.rowsCount)
+               .arg(stats.csvBytes / (1024.0 * 1024.0), 0, 'f', 2)
+               .arg(stats.rowsCount / csvSeconds, 0, 'f', 0)
+               .arg(stats.columnarBytes / (1024.0 * 1024.0), 0, 'f', 2)
+               .arg(rawMegabytes / qMax(stats.columnarBytes / (1024.0 * 1024.0), 1e-9), 0, 'f', 1)
+               .arg(stats.rowsCount / columnarSeconds, 0, 'f', 0)
+               .arg(stats.droppedCount));
+}
+
+AxisShaping MainWindow::loadAxisShaping(const QString &key, const AxisShaping &defaults)
+{
+    QList<double> defaultList;
+    defaultList << defaults.deadZone << defaults.expo << defaults.minCutoff
+                << defaults.beta << defaults.maxRate;
+
+    QList<double> values = settings.value(key, QVariant::fromValue(defaultList)).value< QList<double> >();
+
+    if(values.size() != defaultList.size())
+        values = defaultList;
+
+    settings.setValue(key, QVariant::fromValue(values));
+
+    AxisShaping shaping;
+    shaping.deadZone = qBound(0.0, values[0], 0.9);
+    shaping.expo = qBound(0.0, values[1], 1.0);
+    shaping.minCutoff = qMax(values[2], 0.0);
+    shaping.beta = qMax(values[3], 0.0);
+    shaping.maxRate = qMax(values[4], 0.0);
+
+    return shaping;
+}
+
+void MainWindow::logCommandStats(VehicleSession *session)
+{
+    CommandStats stats = session->getCommandStats();
+
+    if(stats.sentCount == 0)
+        return;
+
+    logMessage(stats.overBudgetCount > 0 ? LOG_WARNING : LOG_INFO,
+               QString("Commands of %1: %2 sent, %3 replaced before sending, %4 delayed by the link, "
+                       "%5 older than %6 ms, maximum age %7 ms.")
+               .arg(session->getName())
+               .arg(stats.sentCount)
+               .arg(stats.supersededCount)
+               .arg(stats.deferredCount)
+               .arg(stats.overBudgetCount)
+               .arg(commandAgeBudget)
+               .arg(stats.maxAgeMs));
+}
+
+void MainWindow::logOutboundStats(VehicleSession *session)
+{
+    OutboundStats stats = session->getOutboundStats();
+
+    for(int p=0; p<PRIORITIES_COUNT; p++)
+    {
+        const OutboundClassStats &classStats = stats.classes[p];
+
+        if(classStats.sentCount == 0 && classStats.droppedCount == 0)
+            continue;
+
+        logMessage(LOG_INFO,
+                   QString("%1 messages of %2: %3 sent, %4 replaced before sending, %5 dropped, "
+                           "latency %6 ms (maximum %7 ms), up to %8 queued.")
+                   .arg(PRIORITY_NAMES[p])
+                   .arg(session->getName())
+                   .arg(classStats.sentCount)
+                   .arg(classStats.supersededCount)
+                   .arg(classStats.droppedCount)
+                   .arg(classStats.smoothedLatencyMs, 0, 'f', 0)
+                   .arg(classStats.maxLatencyMs)
+                   .arg(classStats.maxQueuedCount));
+    }
+}
+
+void MainWindow::logUnchunkedDelay(VehicleSession *session, const QString &what, int size)
+{
+    const TelemetryStore &telemetry = session->getTelemetry();
+
+    if(telemetry.size() == 0)
+        return;
+
+    logMessage(LOG_INFO, QString("[%1] Unchunked %2 received (%3 kB), telemetry delayed by %4 ms.")
+                         .arg(session->getFileTag())
+                         .arg(what)
+                         .arg(size / 1024)
+                         .arg(groundClock.elapsed() - telemetry.latestTime()));
+}
+
+void MainWindow::logPoolStats()
+{
+    PoolStats pools[2] = {messageBuffers.getStats(),
+                          ui->fpvVideoLabel->getImagePoolStats()};
+    const char* names[2] = {"Message buffers", "FPV frames"};
+
+    for(int i=0; i<2; i++)
+    {
+        const PoolStats &stats = pools[i];
+
+        if(stats.hits + stats.misses == 0)
+            continue;
+
+        logMessage(LOG_INFO,
+                   QString("%1 pool: %2% hits (%3 misses), %4 in use at most, %5 MB at most, %6 dropped.")
+                   .arg(names[i])
+                   .arg(100.0 * stats.hits / (stats.hits + stats.misses), 0, 'f', 1)
+                   .arg(stats.misses)
+                   .arg(stats.inUseHighWater)
+                   .arg(stats.pooledBytesHighWater / (1024.0 * 1024.0), 0, 'f', 2)
+                   .arg(stats.dropped));
+    }
+}
+
+void MainWindow::logLabelStats()
+{
+    qint64 updatesCount = labels.getUpdatesCount();
+    qint64 changesCount = updatesCount + labels.getSkippedCount();
+    qint64 refreshesCount = labels.getRefreshesCount();
+
+    if(changesCount == 0 || refreshesCount == 0)
+        return;
+
+    logMessage(LOG_INFO,
+               QString("Values labels: %1 changes, %2 label updates (%3% skipped), "
+                       "%4 us per refresh, %5 us in total.")
+               .arg(changesCount)
+               .arg(updatesCount)
+               .arg(100.0 * (changesCount - updatesCount) / changesCount, 0, 'f', 1)
+               .arg(labels.getRefreshTime() / 1000.0 / refreshesCount, 0, 'f', 1)
+               .arg(labels.getRefreshTime() / 1000));
+}
+
+void MainWindow::setLogSeverity(int index)
+{
+    messagesLog.setMinimumSeverity((LogSeverity)qBound((int)LOG_INFO, index, (int)LOG_ALARM));
+    ui->logView->scrollToBottom();
+}
+
+void MainWindow::logMessage(LogSeverity severity, QString text)
+{
+    QDateTime now = QDateTime::currentDateTime();
+
+    // Follow the new messages, unless the user scrolled up to read.
+    QScrollBar *scrollBar = ui->logView->verticalScrollBar();
+    bool followNewMessages = (scrollBar->value() == scrollBar->maximum());
+
+    messagesLog.append(now, severity, text);
+
+    if(followNewMessages)
+        ui->logView->scrollToBottom();
+
+    // If the disk is too slow, the line is only lost in the file.
+    diskWriter.appendStream(messagesLogStream,
+                            (MessageLogModel::formatLine(now, severity, text) + "\n").toLatin1());
+}
+
 void MainWindow::resetDeviceOrientation()
 {
     sendMessage("orientation_reset");
@@ -640,16 +1364,141 @@ void MainWindow::setFpvState()
         sendMessage("fpv sd");
     else if(ui->fpvCombo->currentIndex() == 2)
         sendMessage("fpv hd");
+
+    // Restart from the default quality and frame rate.
+    if(currentSession != 0 && ui->fpvCombo->currentIndex() != 0)
+    {
+        currentSession->getFpvController().reset();
+        sendFpvRate(currentSession);
+    }
+}
+
+void MainWindow::adjustFpvRate(VehicleSession *session)
+{
+    if(session != currentSession || ui->fpvCombo->currentIndex() == 0 ||
+       !ui->fpvAdaptiveCheckbox->isChecked())
+    {
+        return;
+    }
+
+    // While the link failsafes are active, the FPV is not raised.
+    bool increaseAllowed = (session->getLinkMonitor().getHealth() == LINK_HEALTHY);
+
+    if(session->getFpvController().update(groundClock.elapsed(), increaseAllowed))
+        sendFpvRate(session);
+}
+
+void MainWindow::sendFpvRate(VehicleSession *session)
+{
+    FpvRateController &fpvController = session->getFpvController();
+
+    session->sendMessage("fpv quality " + QString::number(fpvController.getQuality()));
+    session->sendMessage("fpv rate " + QString::number(fpvController.getFrameRate()));
 }
 
 void MainWindow::setFpvRecording()
 {
+    if(currentSession == 0)
+        return;
+
     if(ui->fpvSaveFramesCheckbox->isChecked())
     {
-        fpvSaveFolder = QString("../pictures/record_") + QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss");
+        QString filename = QString("../pictures/record_") + QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss")
+                           + "_" + currentSession->getFileTag() + ".mjpg";
         QDir dir;
-        dir.mkpath(fpvSaveFolder);
+
+        if(dir.mkpath("../pictures"))
+            currentSession->startFpvRecording(filename);
+    }
+    else
+        currentSession->stopFpvRecording();
+}
+
+void MainWindow::openArchive()
+{
+    QStringList filenames = QFileDialog::getOpenFileNames(this, "Open a recording", "..",
+                                                          "Recordings (*.tmc *.mjpg)");
+
+    if(filenames.isEmpty())
+        return;
+
+    closeArchive();
+
+    QElapsedTimer openTimer;
+    openTimer.start();
+
+    foreach(QString filename, filenames)
+    {
+        bool ok;
+
+        if(filename.endsWith(".tmc"))
+            ok = archive.openTelemetry(filename);
+        else
+            ok = archive.openVideo(filename);
+
+        if(!ok)
+            logMessage(LOG_WARNING, QString("Can't open the recording: ") + filename);
     }
+
+    if(!archive.hasTelemetry() && !archive.hasVideo())
+        return;
+
+    logMessage(LOG_INFO, QString("Recording opened in %1 ms.").arg(openTimer.elapsed()));
+
+    // The charts display the recording, until it is closed.
+    ui->yawGraphic->setSource(&archiveTelemetry, TM_YAW, TM_TARGET_YAW, TM_YAW_COMMAND);
+    ui->pitchGraphic->setSource(&archiveTelemetry, TM_PITCH, TM_TARGET_PITCH, TM_PITCH_COMMAND);
+    ui->rollGraphic->setSource(&archiveTelemetry, TM_ROLL, TM_TARGET_ROLL, TM_ROLL_COMMAND);
+    ui->altitudeGraphic->setSource(&archiveTelemetry, TM_ALTITUDE, TM_TARGET_ALTITUDE, TM_ALTITUDE_COMMAND);
+
+    ui->archiveSlider->blockSignals(true);
+    ui->archiveSlider->setRange(0, (int)(archive.getEndTime() - archive.getStartTime()));
+    ui->archiveSlider->setValue(0);
+    ui->archiveSlider->blockSignals(false);
+    ui->archiveSlider->setEnabled(true);
+    ui->archiveCloseButton->setEnabled(true);
+
+    showArchiveTime(0);
+}
+
+void MainWindow::closeArchive()
+{
+    if(!archive.hasTelemetry() && !archive.hasVideo())
+        return;
+
+    // The FPV label may show a frame of the mapped file.
+    ui->fpvVideoLabel->clearFrame();
+    ui->fpvVideoLabel->setText("...");
+
+    archive.close();
+    archiveTelemetry.clear();
+
+    ui->archiveSlider->setEnabled(false);
+    ui->archiveCloseButton->setEnabled(false);
+    ui->archiveTimeLabel->setText("...");
+}
+
+void MainWindow::showArchiveTime(int position)
+{
+    qint64 time = archive.getStartTime() + position;
+
+    // Only the rows displayed by the charts are decoded.
+    archiveTelemetry.clear();
+    archive.readTelemetry(time - ARCHIVE_CHART_SPAN_MS, time, archiveTelemetry);
+
+    ui->yawGraphic->refresh();
+    ui->pitchGraphic->refresh();
+    ui->rollGraphic->refresh();
+    ui->altitudeGraphic->refresh();
+
+    QByteArray frame = archive.videoFrameAt(time);
+
+    if(!frame.isEmpty())
+        ui->fpvVideoLabel->showJpeg(frame);
+
+    ui->archiveTimeLabel->setText(QString("%1 / %2 s")
+                                  .arg(position / 1000.0, 0, 'f', 1)
+                                  .arg((archive.getEndTime() - archive.getStartTime()) / 1000.0, 0, 'f', 1));
 }
 
 void MainWindow::takePicture()
@@ -666,6 +1515,216 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
         emergencyStop();
 }
 
+void MainWindow::onFileWritten(QString filename)
+{
+    logMessage(LOG_INFO, QString("File saved: ") + filename);
+}
+
+void MainWindow::onWriteFailed(QString filename)
+{
+    logMessage(LOG_WARNING, QString("Can't write to file: ") + filename);
+}
+
+void MainWindow::checkLinks()
+{
+    qint64 now = groundClock.elapsed();
+
+    foreach(VehicleSession *session, sessions)
+    {
+        // Give up the phones which did not come back in time.
+        if(!session->isConnected())
+        {
+            if(session->getSuspendedDuration(now) > SESSION_RESUME_TIMEOUT_MS)
+            {
+                logMessage(LOG_WARNING, session->getName() + " did not resume its session.");
+                closeSession(session);
+            }
+
+            continue;
+        }
+
+        LinkMonitor &linkMonitor = session->getLinkMonitor();
+
+        session->sendMessage(linkMonitor.makePing(now));
+
+        LinkHealth previousHealth = linkMonitor.getHealth();
+        LinkHealth health = linkMonitor.evaluate(now);
+
+        if(health != previousHealth)
+            applyLinkFailsafe(session, previousHealth, health);
+    }
+
+    // Display the health of the link with the selected vehicle.
+    if(currentSession != 0 && !currentSession->isConnected())
+    {
+        ui->linkHealthLabel->setText("Link lost, waiting for the phone to reconnect.");
+        ui->linkHealthLabel->setStyleSheet("color: red;");
+        return;
+    }
+
+    if(currentSession == 0 || !currentSession->getLinkMonitor().hasRttEstimate())
+    {
+        ui->linkHealthLabel->setText("");
+        return;
+    }
+
+    LinkMonitor &linkMonitor = currentSession->getLinkMonitor();
+
+    QString linkText = QString("RTT %1 +/- %2 ms, jitter %3 ms, loss %4%")
+                       .arg(linkMonitor.getSmoothedRtt(), 0, 'f', 0)
+                       .arg(linkMonitor.getRttVariation(), 0, 'f', 0)
+                       .arg(linkMonitor.getJitter(), 0, 'f', 0)
+                       .arg(linkMonitor.getLossRate() * 100.0, 0, 'f', 0);
+
+    CommandStats commandStats = currentSession->getCommandStats();
+
+    if(commandStats.sentCount > 0)
+    {
+        linkText += QString(", command age %1 ms").arg(commandStats.smoothedAgeMs, 0, 'f', 0);
+
+        if(commandStats.smoothedAgeMs > commandAgeBudget)
+            linkText += " (late!)";
+    }
+
+    // Messages held by the scheduler, and their latency per class.
+    OutboundStats outboundStats = currentSession->getOutboundStats();
+    int queuedCount = 0;
+    QString outboundText;
+
+    for(int p=0; p<PRIORITIES_COUNT; p++)
+    {
+        const OutboundClassStats &classStats = outboundStats.classes[p];
+        queuedCount += classStats.queuedCount;
+
+        if(classStats.sentCount > 0)
+        {
+            outboundText += QString("%1: %2 queued, latency %3 ms (maximum %4 ms)\n")
+                            .arg(PRIORITY_NAMES[p])
+                            .arg(classStats.queuedCount)
+                            .arg(classStats.smoothedLatencyMs, 0, 'f', 0)
+                            .arg(classStats.maxLatencyMs);
+        }
+    }
+
+    if(queuedCount > 0)
+        linkText += QString(", %1 messages queued").arg(queuedCount);
+
+    ui->linkHealthLabel->setToolTip(outboundText.trimmed());
+
+    // One-way delays, once the clocks are synchronized.
+    const ClockSync &clockSync = currentSession->getClockSync();
+
+    if(clockSync.isSynchronized())
+    {
+        linkText += QString(", uplink %1 ms, downlink %2 ms")
+                    .arg(clockSync.getUplinkDelay(), 0, 'f', 0)
+                    .arg(clockSync.getDownlinkDelay(), 0, 'f', 0);
+
+        if(!std::isnan(currentSession->getTelemetryDelay()))
+            linkText += QString(", telemetry %1 ms").arg(currentSession->getTelemetryDelay(), 0, 'f', 0);
+
+        linkText += QString(" (clocks +/- %1 ms)").arg(clockSync.getUncertainty(), 0, 'f', 0);
+    }
+
+    ui->linkHealthLabel->setText(linkText);
+
+    if(linkMonitor.getHealth() == LINK_HEALTHY)
+        ui->linkHealthLabel->setStyleSheet("color: green;");
+    else if(linkMonitor.getHealth() == LINK_DEGRADED)
+        ui->linkHealthLabel->setStyleSheet("color: orange;");
+    else
+        ui->linkHealthLabel->setStyleSheet("color: red;");
+}
+
+void MainWindow::applyLinkFailsafe(VehicleSession *session, LinkHealth previousHealth,
+                                   LinkHealth health)
+{
+    LinkMonitor &linkMonitor = session->getLinkMonitor();
+    bool isCurrent = (session == currentSession);
+
+    if(health < previousHealth)
+    {
+        logMessage(LOG_INFO, QString("Link with %1 is %2 again.")
+                             .arg(session->getName())
+                             .arg(LINK_HEALTH_NAMES[health]));
+        return;
+    }
+
+    // A phone which never answered the pings may not support them, so it is
+    // not stopped (it has its own timeout).
+    if(health == LINK_LOST && !linkMonitor.hasRttEstimate())
+    {
+        logMessage(LOG_WARNING, QString("%1 does not answer the pings, the link health is not monitored.")
+                                .arg(session->getName()));
+        return;
+    }
+
+    logMessage(health >= LINK_CRITICAL ? LOG_ALARM : LOG_WARNING,
+               QString("### Link with %1 %2 (RTT %3 ms, jitter %4 ms, loss %5%)! ###")
+               .arg(session->getName())
+               .arg(LINK_HEALTH_NAMES[health])
+               .arg(linkMonitor.getSmoothedRtt(), 0, 'f', 0)
+               .arg(linkMonitor.getJitter(), 0, 'f', 0)
+               .arg(linkMonitor.getLossRate() * 100.0, 0, 'f', 0));
+
+    // Stage 1: reduce the FPV to the minimum, to free the link.
+    if(health >= LINK_DEGRADED && previousHealth < LINK_DEGRADED)
+    {
+        session->getFpvController().setMinimum();
+        sendFpvRate(session);
+    }
+
+    // Stage 2: stop the FPV, and hold the altitude.
+    if(health >= LINK_CRITICAL && previousHealth < LINK_CRITICAL)
+    {
+        if(isCurrent)
+        {
+            ui->fpvCombo->setCurrentIndex(0);
+
+            if(ui->regulatorsOnCheckBox->isChecked())
+                ui->altitudeLockCheckbox->setChecked(true);
+        }
+        else
+            session->sendMessage("fpv stop");
+    }
+
+    // Stage 3: stop the vehicle, as when the gamepad is disconnected.
+    if(health == LINK_LOST)
+    {
+        session->sendMessage("emergency_stop");
+
+        if(isCurrent)
+        {
+            currentThrust = 0.0;
+            ui->regulatorsOnCheckBox->setChecked(false);
+        }
+    }
+}
+
+void MainWindow::refreshDisplay()
+{
+    DiskWriterStats diskStats = diskWriter.getStats();
+    labels.setValue(DISK_QUEUE_LABEL, diskStats.queuedBytes / 1024.0, diskStats.droppedCount);
+
+    labels.update();
+
+    if(currentSession == 0)
+        return;
+
+    // Redraw the charts only if new telemetry arrived.
+    qint64 telemetryCount = currentSession->getTelemetry().totalCount();
+
+    if(telemetryCount != displayedTelemetryCount)
+    {
+        displayedTelemetryCount = telemetryCount;
+
+        ui->yawGraphic->refresh();
+        ui->pitchGraphic->refresh();
+        ui->rollGraphic->refresh();
+        ui->altitudeGraphic->refresh();
+    }
+}
+
 void MainWindow::setAltitudeLock()
 {
     if(ui->altitudeLockCheckbox->isChecked())
@@ -677,3 +1736,121 @@ void MainWindow::setAltitudeLock()
         sendMessage("altitude_lock off");
     }
 }
+
+void MainWindow::setPositionHold()
+{
+    if(!ui->positionHoldCheckbox->isChecked())
+        return;
+
+    if(!isPositionEstimateValid())
+    {
+        logMessage(LOG_WARNING, "No position estimate, can't hold the position!");
+        ui->positionHoldCheckbox->setChecked(false);
+        return;
+    }
+
+    // Hold the current position, starting from the current thrust.
+    targetX = positionX;
+    targetY = positionY;
+    targetZ = positionZ;
+
+    xPid.reset();
+    yPid.reset();
+    zPid.reset();
+    zPid.setAPriori(currentThrust);
+}
+
+void MainWindow::setPositionSimulation()
+{
+    // Leave the position hold mode, because the estimate source changes.
+    ui->positionHoldCheckbox->setChecked(false);
+
+    if(ui->positionSimulationCheckbox->isChecked())
+    {
+        positionSimulator.reset(0.0, 0.0, 0.0);
+        logMessage(LOG_WARNING, "The position estimates are now simulated.");
+    }
+    else
+        positionEstimateTime = QTime();
+}
+
+void MainWindow::computePositionHoldCommands(double &pitchAngle, double &rollAngle,
+                                             double climbStick)
+{
+    // Never control with an outdated position estimate.
+    if(!isPositionEstimateValid())
+    {
+        logMessage(LOG_ALARM, "### Position estimate lost, position hold aborted! ###");
+        ui->positionHoldCheckbox->setChecked(false);
+        return;
+    }
+
+    double cosYaw = cos(positionYaw * PI / 180.0);
+    double sinYaw = sin(positionYaw * PI / 180.0);
+
+    // The pitch and roll sticks move the target, in the quadcopter frame.
+    double forwardMove = pitchAngle / PITCH_AMPLITUDE * POSITION_TARGET_VARSPEED * UPDATE_PERIOD_S;
+    double rightMove = rollAngle / ROLL_AMPLITUDE * POSITION_TARGET_VARSPEED * UPDATE_PERIOD_S;
+
+    targetX += forwardMove * cosYaw - rightMove * sinYaw;
+    targetY += forwardMove * sinYaw + rightMove * cosYaw;
+
+    // The thrust stick moves the altitude target, as it moves the thrust in
+    // the manual mode.
+    targetZ += climbStick * ALTITUDE_TARGET_VARSPEED * UPDATE_PERIOD_S;
+
+    // Compute the horizontal commands in the ground frame, then rotate them
+    // to the quadcopter frame.
+    double xCommand = xPid.computeCommand(positionX, targetX, UPDATE_PERIOD_S);
+    double yCommand = yPid.computeCommand(positionY, targetY, UPDATE_PERIOD_S);
+
+    pitchAngle = xCommand * cosYaw + yCommand * sinYaw;
+    rollAngle = -xCommand * sinYaw + yCommand * cosYaw;
+
+    if(pitchAngle > MAX_PITCH_ROLL_TARGET_ANGLE)
+        pitchAngle = MAX_PITCH_ROLL_TARGET_ANGLE;
+    else if(pitchAngle < -MAX_PITCH_ROLL_TARGET_ANGLE)
+        pitchAngle = -MAX_PITCH_ROLL_TARGET_ANGLE;
+
+    if(rollAngle > MAX_PITCH_ROLL_TARGET_ANGLE)
+        rollAngle = MAX_PITCH_ROLL_TARGET_ANGLE;
+    else if(rollAngle < -MAX_PITCH_ROLL_TARGET_ANGLE)
+        rollAngle = -MAX_PITCH_ROLL_TARGET_ANGLE;
+
+    // The phone expects an integer thrust.
+    currentThrust = floor(zPid.computeCommand(positionZ, targetZ, UPDATE_PERIOD_S) + 0.5);
+}
+
+bool MainWindow::isPositionEstimateValid() const
+{
+    return positionEstimateTime.isValid() &&
+           positionEstimateTime.elapsed() < POSITION_ESTIMATE_TIMEOUT_MS;
+}
+
+void MainWindow::updateStateEstimate()
+{
+    EstimatedState state;
+
+    if(currentSession == 0 ||
+       !currentSession->getStateEstimator().predict(groundClock.elapsed(), state))
+    {
+        return;
+    }
+
+    // The position hold regulates the altitude and turns the position errors
+    // with the predicted state, rather than with the telemetry, which is late
+    // by the link delay. The horizontal position comes from the phone only.
+    if(!ui->positionSimulationCheckbox->isChecked() && isPositionEstimateValid())
+    {
+        positionZ = state.values[EST_ALTITUDE];
+        positionYaw = state.values[EST_YAW];
+    }
+
+    if(estimatedStateDisplay)
+    {
+        labels.setValue(CURRENT_YAW_LABEL, state.values[EST_YAW]);
+        labels.setValue(CURRENT_PITCH_LABEL, state.values[EST_PITCH]);
+        labels.setValue(CURRENT_ROLL_LABEL, state.values[EST_ROLL]);
+        labels.setValue(CURRENT_ALTITUDE_LABEL, state.values[EST_ALTITUDE]);
+    }
+}
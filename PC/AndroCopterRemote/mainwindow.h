@@ -10,8 +10,6 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QHostAddress>
 #include <QNetworkInterface>
 #include <QDebug>
@@ -23,16 +21,52 @@
 #include <QDateTime>
 #include <QKeyEvent>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QMap>
 
 #include "gamepad.h"
 #include "constants.h"
 #include "pid.h"
+#include "positionsimulator.h"
+#include "telemetrystore.h"
+#include "labelrefresher.h"
+#include "groundserver.h"
+#include "discoverybeacon.h"
+#include "gamepadpoller.h"
+#include "telemetryhandoff.h"
+#include "bufferpool.h"
+#include "vehiclesession.h"
+#include "diskwriter.h"
+#include "messagelogmodel.h"
+#include "flightarchive.h"
 
 namespace Ui
 {
     class MainWindow;
 }
 
+/// Enum for the values labels, in the order they are registered to the
+/// LabelRefresher.
+enum DisplayedLabel
+{
+    CURRENT_YAW_LABEL=0,
+    CURRENT_PITCH_LABEL,
+    CURRENT_ROLL_LABEL,
+    CURRENT_ALTITUDE_LABEL,
+    YAW_COMMAND_LABEL,
+    PITCH_COMMAND_LABEL,
+    ROLL_COMMAND_LABEL,
+    ALTITUDE_COMMAND_LABEL,
+    BATTERY_LABEL,
+    TEMPERATURE_LABEL,
+    REGULATOR_STATE_LABEL,
+    THRUST_TARGET_LABEL,
+    YAW_TARGET_LABEL,
+    PITCH_TARGET_LABEL,
+    ROLL_TARGET_LABEL,
+    DISK_QUEUE_LABEL
+};
+
 /// Enum for the messages types.
 enum MessageType
 {
@@ -40,7 +74,12 @@ enum MessageType
     VIDEO_FRAME, ///< Image to display to the user.
     LOG, ///< Logfile, to save.
     CURRENT_STATE, ///< Current state, to display to the user.
-    PHOTO ///< HD photo to save on the disk.
+    PHOTO, ///< HD photo to save on the disk.
+    PONG, ///< Answer to a ping, to measure the link health.
+    SESSION, ///< Session token of the phone, first message of a connection.
+    TELEMETRY_BACKLOG, ///< Past CURRENT_STATE messages, one per line.
+    CHUNK, ///< Piece of a large PHOTO or LOG message (see ChunkReceiver).
+    COMPACT_STATE ///< Current state, binary and delta-encoded (see TelemetryDecoder).
 };
 
 /// Main window of the GUI, and main loop.
@@ -55,14 +94,34 @@ public:
     ~MainWindow();
 
 public slots:
-    /// Updates the UI to show that the phone is connected.
-    void acceptConnection();
-
-    /// Processes the data received from the phone.
-    void onDataReceived();
-
-    /// Updates the UI to show that the phone is disconnected.
-    void onClientDisconnected();
+    /// Prepares a newly connected phone. Its session is opened by its first
+    /// message (see openSession()).
+    /// \param link the connection with the phone.
+    void onNewLink(VehicleLink *link);
+
+    /// Remembers the address of a newly connected phone.
+    /// \param vehicleId identifier of the link.
+    /// \param peerName address and port of the phone.
+    void onLinkStarted(int vehicleId, QString peerName);
+
+    /// Processes a message received from a phone.
+    /// \param vehicleId identifier of the link.
+    /// \param type type of the message (see MessageType).
+    /// \param data useful content of the message.
+    void onMessageReceived(int vehicleId, int type, QByteArray data);
+
+    /// Processes all the telemetry messages waiting in telemetryHandoff.
+    void drainTelemetry();
+
+    /// Suspends the session of a disconnected phone, so it can resume it, and
+    /// updates the UI. A session without token is closed immediately.
+    /// \param vehicleId identifier of the link.
+    void onLinkDisconnected(int vehicleId);
+
+    /// Selects the vehicle controlled by the gamepad and displayed, from the
+    /// vehicleCombo.
+    /// \param index index of the vehicle in vehicleCombo.
+    void selectVehicle(int index);
 
     /// Gets the command values and sends them to the phone, at fixed interval.
     void computeAndSendCommands();
@@ -82,18 +141,24 @@ public slots:
     /// will send the log to this application, and it will be saved to a file.
     void togglePhoneLogging();
 
-    /// Clears the messages frame.
+    /// Clears the messages frame. The messages are still in the file of the
+    /// session.
     void clearMessagesLog();
 
-    /// Saves the content of the message frame.
+    /// Saves the messages kept in memory, whatever the severity filter.
     void saveMessagesLog();
 
+    /// Sets the minimum severity of the displayed messages.
+    /// \param index index of logSeverityCombo, which matches LogSeverity.
+    void setLogSeverity(int index);
+
     /// Sets the current yaw as the zero point.
     /// This useful to have the quadcopter looking at the same direction of the
     /// pilot.
     void resetDeviceOrientation();
 
-    /// Set the FPV state to the value indicated by fpvCombo.
+    /// Set the FPV state to the value indicated by fpvCombo. The quality and
+    /// the frame rate restart from their default values.
     void setFpvState();
 
     /// Depending on the value of fpvSaveFramesCheckbox, ask the phone to start
@@ -104,19 +169,76 @@ public slots:
     /// Take a picture with the phone's camera.
     void takePicture();
 
+    /// Asks the user for a recording (telemetry and/or FPV video) and opens
+    /// it. The charts and the FPV label then display the recording.
+    void openArchive();
+
+    /// Closes the recording opened by openArchive().
+    void closeArchive();
+
+    /// Displays the recorded telemetry and FPV frame at a time.
+    /// \param position time since the beginning of the recording [ms], from
+    /// archiveSlider.
+    void showArchiveTime(int position);
+
+    /// Displays that a file has been written by the disk writer.
+    /// \param filename the name of the file.
+    void onFileWritten(QString filename);
+
+    /// Displays that a file could not be written by the disk writer.
+    /// \param filename the name of the file.
+    void onWriteFailed(QString filename);
+
+    /// Sends a ping to each phone, and updates the health of the links.
+    /// Called regularly by linkTimer.
+    void checkLinks();
+
+    /// Updates the values labels and the charts, if needed. Called at a low,
+    /// fixed rate by displayTimer.
+    void refreshDisplay();
+
     /// Enable or disable the "altitude lock" state.
     void setAltitudeLock();
 
+    /// Enable or disable the "position hold" mode, depending on the state of
+    /// positionHoldCheckbox. When enabled, the current position estimate
+    /// becomes the target.
+    void setPositionHold();
+
+    /// Enable or disable the position simulator, depending on the state of
+    /// positionSimulationCheckbox.
+    void setPositionSimulation();
+
 protected:
     /// Function called when a key is pressed. This is used for the emergency
     /// stop, if the spacebar is pressed.
     void keyPressEvent(QKeyEvent *event);
     
 private:
-    /// Sends a message to the phone.
+    /// Sends a message to the phone of the selected vehicle.
     /// \arg text Useful content of the message.
     void sendMessage(QString text);
 
+    /// Updates the status label and the controls, depending on the connected
+    /// vehicles.
+    void updateConnectionStatus();
+
+    /// Opens the session of a new link, or resumes the suspended session with
+    /// the same token.
+    /// \arg linkId identifier of the link, in pendingLinks.
+    /// \arg token session token of the phone, empty if none.
+    /// \return the session.
+    VehicleSession* openSession(int linkId, const QByteArray &token);
+
+    /// Deletes a session, and updates the UI.
+    /// \arg session the session, disconnected or suspended.
+    void closeSession(VehicleSession *session);
+
+    /// Get the regulators coefficients from the spinboxes.
+    /// \return the 12 coefficients, in the order of the "regulator_coefs"
+    /// message.
+    QList<double> getRegulatorCoefficients() const;
+
     /// Get the list of all candidates IP addresses, as strings.
     /// The OS often gives several addresses, this is why this function first
     /// filter out the irrelevant addresses (empty, loopback...).
@@ -124,33 +246,136 @@ private:
     /// choose the good one for his application.
     QStringList getIpAddresses() const;
 
+    /// Adds a message to the messages log, and to the messages file of the
+    /// session.
+    /// \arg severity the severity of the message.
+    /// \arg text the message, without timestamp.
+    void logMessage(LogSeverity severity, QString text);
+
+    /// Adds the counters of the telemetry export of a vehicle to the messages
+    /// log: size of the files, and throughput of the export.
+    /// \arg session the vehicle.
+    void logExportStats(VehicleSession *session);
+
+    /// Adds to the messages log how long a large message sent in one piece
+    /// (by a phone which does not split them in chunks) delayed the
+    /// telemetry: the time since the last telemetry message.
+    /// \arg session the vehicle.
+    /// \arg what the kind of message, for the log.
+    /// \arg size the size of the message [bytes].
+    void logUnchunkedDelay(VehicleSession *session, const QString &what, int size);
+
+    /// Adds the counters of the pools of the message buffers and of the FPV
+    /// frames to the messages log.
+    void logPoolStats();
+
+    /// Adds the counters of the values labels to the messages log: number of
+    /// value changes, of label updates actually done, and the time spent
+    /// updating them. Without the LabelRefresher, each change would be a
+    /// label update.
+    void logLabelStats();
+
+    /// Adds the counters of the commands sent to a vehicle to the messages
+    /// log: number of replaced and late commands, and their age.
+    /// \arg session the vehicle.
+    void logCommandStats(VehicleSession *session);
+
+    /// Adds the counters of the other messages sent to a vehicle to the
+    /// messages log: per priority class, number of sent, replaced and
+    /// dropped messages, and their latency in the queue.
+    /// \arg session the vehicle.
+    void logOutboundStats(VehicleSession *session);
+
+    /// Reads the shaping of a gamepad axis from the settings, and saves it
+    /// back, so it can be edited.
+    /// \arg key the settings key: dead zone, expo, minimum cutoff frequency,
+    /// beta and maximum rate (see AxisShaping).
+    /// \arg defaults the shaping used if the key does not exist.
+    /// \return the shaping.
+    AxisShaping loadAxisShaping(const QString &key, const AxisShaping &defaults);
+
     /// Display a text message into the messages frame.
     /// Called when a message of type TEXT comes from the phone.
+    /// \arg session the vehicle which sent the message.
     /// \arg data Byte array representing characters to be displayed.
-    void displayTextMessage(QByteArray data);
+    void displayTextMessage(VehicleSession *session, QByteArray data);
 
     /// Display a picture.
     /// Called when a message of type VIDEO_FRAME comes from the phone.
     /// Useful for displaying a first-person-view (FPV) images.
+    /// \arg session the vehicle which sent the message.
     /// \arg data Byte array representing an image to be displayed.
-    void displayImage(QByteArray data);
+    void displayImage(VehicleSession *session, QByteArray data);
+
+    /// Writes a chunk of a large message to its file, and asks the phone to
+    /// resend the missing data, if any.
+    /// \arg session the vehicle which sent the chunk.
+    /// \arg data the content of the CHUNK message.
+    void receiveChunk(VehicleSession *session, QByteArray data);
 
     /// Saves the given logfile to a text file.
     /// Called when a message of type LOG comes from the phone.
+    /// \arg session the vehicle which sent the message.
     /// \arg data Byte array representing characters to be saved.
-    void savePhoneLog(QByteArray data);
+    void savePhoneLog(VehicleSession *session, QByteArray data);
 
     /// Displays the current state into the charts.
-    /// Called when a message of type CURRENT_STATE comes from the phone.
-    /// \arg data Byte array representing characters to be interpreted as the
-    /// current states.
-    void displayCurrentState(QByteArray data);
+    /// Called when a message of type CURRENT_STATE or COMPACT_STATE comes from
+    /// the phone.
+    /// \arg session the vehicle which sent the message.
+    /// \arg type the type of the message.
+    /// \arg data the current states, as text (CURRENT_STATE) or binary
+    /// (COMPACT_STATE).
+    void displayCurrentState(VehicleSession *session, int type, QByteArray data);
 
     /// Save a photograph.
     /// Called when a message of type PHOTO comes from the phone.
     /// Useful to save an aerial photograph on the disk.
+    /// \arg session the vehicle which sent the message.
     /// \arg data Byte array representing an image to be saved.
-    void savePhoto(QByteArray data);
+    void savePhoto(VehicleSession *session, QByteArray data);
+
+    /// Lets the FPV controller of the vehicle adjust the quality and the frame
+    /// rate of the video, and sends them to the phone if they changed. Does
+    /// nothing if the adaptive FPV is disabled.
+    /// \arg session the vehicle which sent the latest frame or telemetry.
+    void adjustFpvRate(VehicleSession *session);
+
+    /// Sends the FPV quality and frame rate given by the FPV controller of a
+    /// vehicle.
+    /// \arg session the vehicle.
+    void sendFpvRate(VehicleSession *session);
+
+    /// Applies the failsafe stages of a vehicle, when the health of its link
+    /// changed. The stages are cumulative: degraded reduces the FPV, critical
+    /// also stops the FPV and locks the altitude, lost also stops the
+    /// vehicle.
+    /// \arg session the vehicle.
+    /// \arg previousHealth the previous health of the link.
+    /// \arg health the new health of the link.
+    void applyLinkFailsafe(VehicleSession *session, LinkHealth previousHealth,
+                           LinkHealth health);
+
+    /// Computes the pitch, roll and thrust commands with the position PIDs,
+    /// from the latest position estimate. Called at each control step when
+    /// the "position hold" mode is enabled.
+    /// \arg pitchAngle pitch stick value [deg], which moves the target. It is
+    /// replaced by the pitch command.
+    /// \arg rollAngle roll stick value [deg], which moves the target. It is
+    /// replaced by the roll command.
+    /// \arg climbStick thrust stick value, in [-1;1] (positive upwards),
+    /// which moves the altitude target.
+    void computePositionHoldCommands(double &pitchAngle, double &rollAngle,
+                                     double climbStick);
+
+    /// Get if the latest position estimate is recent enough to be used.
+    /// \return true if the estimate can be used, false otherwise.
+    bool isPositionEstimateValid() const;
+
+    /// Predicts the state of the current vehicle at the current time (see
+    /// StateEstimator), for the altitude and heading of the position hold,
+    /// and for the labels. Called at each control step.
+    void updateStateEstimate();
 
     /// Pointer to the GUI elements, placed using the Qt designer.
     Ui::MainWindow *ui;
@@ -159,15 +384,59 @@ private:
     /// the application has been closed.
     QSettings settings;
 
+    /// Telemetry messages received by the I/O threads.
+    TelemetryHandoff telemetryHandoff;
+
+    /// Buffers of the received messages, given back after their processing.
+    BufferPool messageBuffers;
+
     /// TCP server.
-    /// Manages the incomming connections.
-    QTcpServer server;
+    /// Manages the incomming connections, in its I/O threads.
+    /// Declared after telemetryHandoff and messageBuffers, which the links
+    /// use from the I/O threads: the members are destroyed in the reverse
+    /// order, so the server stops its threads (and deletes the links) before
+    /// they are freed.
+    GroundServer server;
+
+    /// Answers the discovery queries of the phones, and announces the server
+    /// on the LAN.
+    DiscoveryBeacon discoveryBeacon;
+
+    /// Sessions of the connected and suspended vehicles, by identifier.
+    QMap<int, VehicleSession*> sessions;
 
-    /// TCP socket. Sends and receives messages.
-    QTcpSocket* clientSocket;
+    /// Sessions of the connected vehicles, by identifier of their current
+    /// link.
+    QMap<int, VehicleSession*> linkSessions;
 
-    /// Size (in bytes) of the currently incomming message.
-    unsigned int inMessageSize;
+    /// A connected phone which has not sent its session token yet.
+    struct PendingLink
+    {
+        VehicleLink *link;
+        QString peerName;
+    };
+
+    /// Connected phones without session yet, by identifier of their link.
+    QMap<int, PendingLink> pendingLinks;
+
+    /// Session of the vehicle controlled by the gamepad and displayed. Null
+    /// if no vehicle is connected.
+    VehicleSession *currentSession;
+
+    /// Writes all the files, in a background thread.
+    DiskWriter diskWriter;
+
+    /// Latest messages, displayed by logView.
+    MessageLogModel messagesLog;
+
+    /// Identifier of the diskWriter stream of the messages file.
+    int messagesLogStream;
+
+    /// Recording opened by the user, to browse it.
+    FlightArchive archive;
+
+    /// Rows of the recording displayed by the charts.
+    TelemetryStore archiveTelemetry;
 
     /// Timer which will call the computeAndSendCommands() method regularly.
     QTimer updateTimer;
@@ -175,6 +444,10 @@ private:
     /// Gets the data from the selected gamepad.
     Gamepad gamepad;
 
+    /// Reads the gamepad in its own thread. Once started, the gamepad is only
+    /// read through it.
+    GamepadPoller gamepadPoller;
+
     /// Current mean thrust. It has to be stored, because as it is only
     /// incremented or decremented by the stick value.
     double currentThrust;
@@ -201,20 +474,66 @@ private:
     /// PID of the Z axis.
     Pid zPid;
 
-    /// Timer to measure the FPS of the video frames.
-    QTime time;
+    /// Latest position estimate, in meters, and yaw angle at the time of the
+    /// estimate, in degrees. They come from the telemetry, or from the
+    /// simulator.
+    double positionX, positionY, positionZ, positionYaw;
+
+    /// Time of the latest position estimate. Null if there is no estimate.
+    QTime positionEstimateTime;
+
+    /// Target of the "position hold" mode, in meters.
+    double targetX, targetY, targetZ;
+
+    /// Stands in for the telemetry position estimates, if enabled.
+    PositionSimulator positionSimulator;
 
-    /// Filename of the folder used for storing the FPV frames.
-    QString fpvSaveFolder;
+    /// Pitch and roll angles of the last command sent, in degrees. Used to
+    /// drive the simulator.
+    double sentPitchAngle, sentRollAngle;
 
-    /// FPV frame number, used to name the frames, if they are stored.
-    int fpvFrameNumber;
+    /// Clock of the ground station, used to timestamp the telemetry. Started
+    /// with the application.
+    QElapsedTimer groundClock;
+
+    /// Updates the values labels, at the display rate.
+    LabelRefresher labels;
+
+    /// Timer which will call the refreshDisplay() method regularly.
+    QTimer displayTimer;
+
+    /// Number of telemetry rows when the charts were last redrawn.
+    qint64 displayedTelemetryCount;
+
+    /// Timer to measure the FPS of the video frames.
+    QTime time;
 
     /// Reception rate of the FPV frames, in bytes per second.
     double fpvBitrate;
 
     /// Reception rate of the FPV frames, in frames per second.
     double fpvFramerate;
+
+    /// Maximum queuing delay of the link allowed by the adaptive FPV, in
+    /// milliseconds.
+    int fpvLatencyBudget;
+
+    /// Timer which will call the checkLinks() method regularly.
+    QTimer linkTimer;
+
+    /// Thresholds of the link health, in milliseconds (see
+    /// LinkMonitor::setThresholds()).
+    int linkDegradedRtt, linkCriticalRtt, linkLostTimeout;
+
+    /// Maximum age of the commands, from the gamepad sample to the socket, in
+    /// milliseconds.
+    int commandAgeBudget;
+
+    /// Asks the phones for the compact telemetry (COMPACT_STATE).
+    bool compactTelemetry;
+
+    /// Displays the predicted state instead of the latest telemetry.
+    bool estimatedStateDisplay;
 };
 
 #endif // MAINWINDOW_H
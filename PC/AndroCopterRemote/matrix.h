@@ -0,0 +1,254 @@
+/*!
+* \file matrix.h
+* \brief Small matrices of fixed size, for the state estimator.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* This file does not depend on Qt, so the benchmark (StateEstimatorBench) can
+* be built without it.
+*/
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cmath>
+#include <utility>
+
+/// Matrix of doubles, with its dimensions fixed at compile time.
+/// The coefficients are stored in the object itself (on the stack for a local
+/// variable), so no operation allocates memory, and the compiler can unroll
+/// the loops. Intended for small matrices (up to about 16x16): the products
+/// are naive.
+/// \param R number of rows.
+/// \param C number of columns.
+template<int R, int C> class Matrix
+{
+public:
+    /// Constructor. All the coefficients are zero.
+    Matrix()
+    {
+        fill(0.0);
+    }
+
+    /// Get the identity matrix.
+    /// \return the identity matrix (square matrices only).
+    static Matrix identity()
+    {
+        static_assert(R == C, "The identity matrix is square.");
+
+        Matrix m;
+
+        for(int i=0; i<R; i++)
+            m(i, i) = 1.0;
+
+        return m;
+    }
+
+    /// Sets all the coefficients.
+    /// \param value the value of the coefficients.
+    void fill(double value)
+    {
+        for(int r=0; r<R; r++)
+        {
+            for(int c=0; c<C; c++)
+                data[r][c] = value;
+        }
+    }
+
+    /// Get a coefficient.
+    /// \param r row of the coefficient.
+    /// \param c column of the coefficient.
+    /// \return a reference to the coefficient.
+    double& operator()(int r, int c)
+    {
+        return data[r][c];
+    }
+
+    /// Get a coefficient.
+    /// \param r row of the coefficient.
+    /// \param c column of the coefficient.
+    /// \return the coefficient.
+    double operator()(int r, int c) const
+    {
+        return data[r][c];
+    }
+
+    /// Get a coefficient of a vector.
+    /// \param i index of the coefficient.
+    /// \return a reference to the coefficient (column vectors only).
+    double& operator[](int i)
+    {
+        static_assert(C == 1, "Only the vectors can be indexed by a single number.");
+        return data[i][0];
+    }
+
+    /// Get a coefficient of a vector.
+    /// \param i index of the coefficient.
+    /// \return the coefficient (column vectors only).
+    double operator[](int i) const
+    {
+        static_assert(C == 1, "Only the vectors can be indexed by a single number.");
+        return data[i][0];
+    }
+
+    /// Sum of two matrices.
+    Matrix operator+(const Matrix &other) const
+    {
+        Matrix result;
+
+        for(int r=0; r<R; r++)
+        {
+            for(int c=0; c<C; c++)
+                result.data[r][c] = data[r][c] + other.data[r][c];
+        }
+
+        return result;
+    }
+
+    /// Difference of two matrices.
+    Matrix operator-(const Matrix &other) const
+    {
+        Matrix result;
+
+        for(int r=0; r<R; r++)
+        {
+            for(int c=0; c<C; c++)
+                result.data[r][c] = data[r][c] - other.data[r][c];
+        }
+
+        return result;
+    }
+
+    /// Product by a scalar.
+    Matrix operator*(double factor) const
+    {
+        Matrix result;
+
+        for(int r=0; r<R; r++)
+        {
+            for(int c=0; c<C; c++)
+                result.data[r][c] = data[r][c] * factor;
+        }
+
+        return result;
+    }
+
+    /// Matrix product.
+    template<int K> Matrix<R, K> operator*(const Matrix<C, K> &other) const
+    {
+        Matrix<R, K> result;
+
+        for(int r=0; r<R; r++)
+        {
+            for(int k=0; k<K; k++)
+            {
+                double sum = 0.0;
+
+                for(int c=0; c<C; c++)
+                    sum += data[r][c] * other(c, k);
+
+                result(r, k) = sum;
+            }
+        }
+
+        return result;
+    }
+
+    /// Get the transpose of the matrix.
+    /// \return the transpose.
+    Matrix<C, R> transposed() const
+    {
+        Matrix<C, R> result;
+
+        for(int r=0; r<R; r++)
+        {
+            for(int c=0; c<C; c++)
+                result(c, r) = data[r][c];
+        }
+
+        return result;
+    }
+
+    /// Makes a square matrix exactly symmetric, by averaging it with its
+    /// transpose. Keeps the rounding errors from accumulating in a covariance
+    /// matrix.
+    void symmetrize()
+    {
+        static_assert(R == C, "Only a square matrix can be symmetric.");
+
+        for(int r=0; r<R; r++)
+        {
+            for(int c=r+1; c<C; c++)
+            {
+                double mean = (data[r][c] + data[c][r]) / 2.0;
+                data[r][c] = mean;
+                data[c][r] = mean;
+            }
+        }
+    }
+
+private:
+    double data[R][C];
+};
+
+/// Inverts a square matrix, by Gauss-Jordan elimination with partial
+/// pivoting.
+/// \param m the matrix to invert.
+/// \param inverse set to the inverse of m, if it is invertible.
+/// \return false if the matrix is singular (or nearly).
+template<int N> bool invert(const Matrix<N, N> &m, Matrix<N, N> &inverse)
+{
+    Matrix<N, N> a = m;
+    inverse = Matrix<N, N>::identity();
+
+    for(int col=0; col<N; col++)
+    {
+        // Take the largest pivot, for the numerical stability.
+        int pivot = col;
+
+        for(int r=col+1; r<N; r++)
+        {
+            if(std::fabs(a(r, col)) > std::fabs(a(pivot, col)))
+                pivot = r;
+        }
+
+        if(std::fabs(a(pivot, col)) < 1e-12)
+            return false;
+
+        if(pivot != col)
+        {
+            for(int c=0; c<N; c++)
+            {
+                std::swap(a(pivot, c), a(col, c));
+                std::swap(inverse(pivot, c), inverse(col, c));
+            }
+        }
+
+        double scale = 1.0 / a(col, col);
+
+        for(int c=0; c<N; c++)
+        {
+            a(col, c) *= scale;
+            inverse(col, c) *= scale;
+        }
+
+        for(int r=0; r<N; r++)
+        {
+            if(r == col || a(r, col) == 0.0)
+                continue;
+
+            double factor = a(r, col);
+
+            for(int c=0; c<N; c++)
+            {
+                a(r, c) -= factor * a(col, c);
+                inverse(r, c) -= factor * inverse(col, c);
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif // MATRIX_H
@@ -0,0 +1,157 @@
+#include "messagelogmodel.h"
+
+#include <QColor>
+
+static const char* SEVERITY_TAGS[] = { "", "[warning] ", "[ALARM] " };
+
+MessageLogModel::MessageLogModel(int capacity, QObject *parent) :
+    QAbstractListModel(parent)
+{
+    this->capacity = capacity;
+
+    entries.resize(capacity);
+    firstEntry = 0;
+    entriesCount = 0;
+
+    rows.resize(capacity);
+    firstRow = 0;
+    rowsCount = 0;
+    firstEntryNumber = 0;
+
+    minimumSeverity = LOG_INFO;
+}
+
+void MessageLogModel::append(const QDateTime &time, LogSeverity severity,
+                             const QString &text)
+{
+    // Remove the oldest message if the log is full. If it is displayed, it is
+    // necessarily the first row.
+    if(entriesCount == capacity)
+    {
+        if(rowsCount > 0 && rows[firstRow] == firstEntryNumber)
+        {
+            beginRemoveRows(QModelIndex(), 0, 0);
+            firstRow = (firstRow + 1) % capacity;
+            rowsCount--;
+            endRemoveRows();
+        }
+
+        entries[firstEntry].text.clear();
+        firstEntry = (firstEntry + 1) % capacity;
+        entriesCount--;
+        firstEntryNumber++;
+    }
+
+    Entry &entry = entries[(firstEntry + entriesCount) % capacity];
+    entry.time = time;
+    entry.severity = severity;
+    entry.text = text;
+    entriesCount++;
+
+    if(severity >= minimumSeverity)
+    {
+        beginInsertRows(QModelIndex(), rowsCount, rowsCount);
+        rows[(firstRow + rowsCount) % capacity] = firstEntryNumber + entriesCount - 1;
+        rowsCount++;
+        endInsertRows();
+    }
+}
+
+void MessageLogModel::clear()
+{
+    beginResetModel();
+
+    for(int i=0; i<capacity; i++)
+        entries[i].text.clear();
+
+    firstEntryNumber += entriesCount;
+    firstEntry = 0;
+    entriesCount = 0;
+    firstRow = 0;
+    rowsCount = 0;
+
+    endResetModel();
+}
+
+void MessageLogModel::setMinimumSeverity(LogSeverity severity)
+{
+    if(severity == minimumSeverity)
+        return;
+
+    beginResetModel();
+    minimumSeverity = severity;
+    rebuildRows();
+    endResetModel();
+}
+
+QString MessageLogModel::toText() const
+{
+    QString text;
+
+    for(int i=0; i<entriesCount; i++)
+    {
+        const Entry &entry = entries[(firstEntry + i) % capacity];
+        text += formatLine(entry.time, entry.severity, entry.text) + "\n";
+    }
+
+    return text;
+}
+
+QString MessageLogModel::formatLine(const QDateTime &time, LogSeverity severity,
+                                    const QString &text)
+{
+    return time.toString("(yyyy.MM.dd hh.mm.ss.zzz) ") + SEVERITY_TAGS[severity] + text;
+}
+
+int MessageLogModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid())
+        return 0;
+
+    return rowsCount;
+}
+
+QVariant MessageLogModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() < 0 || index.row() >= rowsCount)
+        return QVariant();
+
+    const Entry &entry = entryAt(index.row());
+
+    if(role == Qt::DisplayRole)
+        return formatLine(entry.time, entry.severity, entry.text);
+    else if(role == Qt::ForegroundRole)
+    {
+        if(entry.severity == LOG_ALARM)
+            return QColor(Qt::red);
+        else if(entry.severity == LOG_WARNING)
+            return QColor(Qt::darkYellow);
+        else
+            return QVariant();
+    }
+    else if(role == SeverityRole)
+        return (int)entry.severity;
+    else
+        return QVariant();
+}
+
+void MessageLogModel::rebuildRows()
+{
+    firstRow = 0;
+    rowsCount = 0;
+
+    for(int i=0; i<entriesCount; i++)
+    {
+        if(entries[(firstEntry + i) % capacity].severity >= minimumSeverity)
+        {
+            rows[rowsCount] = firstEntryNumber + i;
+            rowsCount++;
+        }
+    }
+}
+
+const MessageLogModel::Entry& MessageLogModel::entryAt(int row) const
+{
+    qint64 offset = rows[(firstRow + row) % capacity] - firstEntryNumber;
+    return entries[(firstEntry + (int)offset) % capacity];
+}
@@ -0,0 +1,106 @@
+/*!
+* \file messagelogmodel.h
+* \brief Bounded model of the messages log, displayed by a list view.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef MESSAGELOGMODEL_H
+#define MESSAGELOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QString>
+#include <QDateTime>
+
+/// Severity of a message of the log, from the least to the most important.
+enum LogSeverity
+{
+    LOG_INFO=0, ///< Normal operation (connections, files saved...).
+    LOG_WARNING, ///< Something did not work, but the flight is not affected.
+    LOG_ALARM ///< The flight is affected (emergency stop, link lost...).
+};
+
+/// Bounded model of the messages log.
+/// The messages are stored in a ring buffer: once it is full, each new
+/// message replaces the oldest one, so the memory and the cost of an append
+/// stay constant, however long the session. The text of the lines is only
+/// formatted when the view asks for it, i.e. for the visible lines.
+///
+/// The model only exposes the messages at or above a minimum severity. The
+/// rows are indices into the ring, kept in a second ring, so the filter does
+/// not change the cost of an append either.
+class MessageLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    /// Role to get the LogSeverity of a row.
+    static const int SeverityRole = Qt::UserRole;
+
+    /// Constructor.
+    /// \param capacity maximum number of messages kept.
+    /// \param parent the parent object.
+    explicit MessageLogModel(int capacity, QObject *parent = 0);
+
+    /// Adds a message at the end of the log. If the log is full, the oldest
+    /// message is removed.
+    /// \param time the time of the message.
+    /// \param severity the severity of the message.
+    /// \param text the message.
+    void append(const QDateTime &time, LogSeverity severity, const QString &text);
+
+    /// Removes all the messages.
+    void clear();
+
+    /// Set the minimum severity of the displayed messages.
+    /// \param severity the minimum severity.
+    void setMinimumSeverity(LogSeverity severity);
+
+    /// Get the log as text, one message per line, regardless of the severity
+    /// filter.
+    /// \return the text of the log.
+    QString toText() const;
+
+    /// Formats a message as a line of text.
+    /// \param time the time of the message.
+    /// \param severity the severity of the message.
+    /// \param text the message.
+    /// \return the line, without the end of line.
+    static QString formatLine(const QDateTime &time, LogSeverity severity,
+                              const QString &text);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+private:
+    /// A message of the log.
+    struct Entry
+    {
+        QDateTime time;
+        LogSeverity severity;
+        QString text;
+    };
+
+    /// Rebuilds the rows from the stored messages, after a filter change.
+    void rebuildRows();
+
+    /// Get the message displayed at a row.
+    const Entry& entryAt(int row) const;
+
+    int capacity;
+
+    // Ring of the messages: entries[firstEntry] is the oldest one.
+    QVector<Entry> entries;
+    int firstEntry, entriesCount;
+
+    // Ring of the displayed messages, as numbers of the messages since the
+    // start: firstEntryNumber is the number of the oldest stored message.
+    QVector<qint64> rows;
+    int firstRow, rowsCount;
+    qint64 firstEntryNumber;
+
+    LogSeverity minimumSeverity;
+};
+
+#endif // MESSAGELOGMODEL_H
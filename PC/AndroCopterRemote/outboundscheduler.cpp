@@ -0,0 +1,248 @@
+#include "outboundscheduler.h"
+
+#include <cmath>
+#include <cstring>
+
+/// Priority and coalescing of a kind of message.
+struct OutboundRule
+{
+    const char *prefix; ///< First words of the message.
+    MessagePriority priority;
+    int keyWords; ///< Number of words identifying the changed setting, 0 if the message is never superseded.
+};
+
+/// Rules of the messages, the most specific prefixes first. The other
+/// messages are settings, never superseded.
+static const OutboundRule OUTBOUND_RULES[] =
+{
+    {"emergency_stop", PRIORITY_SAFETY, 0},
+    {"regulator_state off", PRIORITY_SAFETY, 1},
+    {"regulator_state", PRIORITY_COMMAND, 1},
+    {"altitude_lock", PRIORITY_COMMAND, 1},
+    {"orientation_reset", PRIORITY_COMMAND, 0},
+    {"ping", PRIORITY_COMMAND, 0},
+    {"regulator_coefs", PRIORITY_CONFIG, 1},
+    {"fpv quality", PRIORITY_CONFIG, 2},
+    {"fpv rate", PRIORITY_CONFIG, 2},
+    {"fpv", PRIORITY_CONFIG, 1},
+    {"telemetry_format", PRIORITY_CONFIG, 1},
+    {"telemetry_keyframe", PRIORITY_CONFIG, 1},
+    {"log", PRIORITY_CONFIG, 1},
+    {"take_picture", PRIORITY_BULK, 0},
+    {"telemetry_backlog", PRIORITY_BULK, 1},
+    {"chunk_resume", PRIORITY_BULK, 2},
+    {"chunk_done", PRIORITY_BULK, 0}
+};
+
+/// Rate limits, indexed by MessagePriority [messages/s]. 0 if not limited.
+static const double RATE_LIMITS[PRIORITIES_COUNT] =
+{
+    0.0, OUTBOUND_COMMAND_RATE_LIMIT, OUTBOUND_CONFIG_RATE_LIMIT, OUTBOUND_BULK_RATE_LIMIT
+};
+
+/// Sizes of the token buckets, indexed by MessagePriority.
+static const int BURST_SIZES[PRIORITIES_COUNT] =
+{
+    0, OUTBOUND_COMMAND_BURST, OUTBOUND_CONFIG_BURST, OUTBOUND_BULK_BURST
+};
+
+OutboundScheduler::OutboundScheduler()
+{
+    for(int p=0; p<PRIORITIES_COUNT; p++)
+    {
+        tokens[p] = BURST_SIZES[p];
+        refillTimes[p] = 0;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+}
+
+MessagePriority OutboundScheduler::classify(const QString &text, QString *coalescingKey)
+{
+    const int rulesCount = sizeof(OUTBOUND_RULES) / sizeof(OUTBOUND_RULES[0]);
+
+    for(int i=0; i<rulesCount; i++)
+    {
+        const OutboundRule &rule = OUTBOUND_RULES[i];
+        QString prefix = QString::fromLatin1(rule.prefix);
+
+        // Whole words only ("log" is not "logs").
+        if(!text.startsWith(prefix) ||
+           (text.size() > prefix.size() && text[prefix.size()] != ' '))
+        {
+            continue;
+        }
+
+        if(coalescingKey != 0)
+        {
+            if(rule.keyWords > 0)
+                *coalescingKey = text.section(' ', 0, rule.keyWords-1);
+            else
+                coalescingKey->clear();
+        }
+
+        return rule.priority;
+    }
+
+    if(coalescingKey != 0)
+        coalescingKey->clear();
+
+    return PRIORITY_CONFIG;
+}
+
+MessagePriority OutboundScheduler::enqueue(const QString &text, qint64 now)
+{
+    QueuedMessage message;
+    message.text = text;
+    message.queueTime = now;
+    MessagePriority priority = classify(text, &message.key);
+    bool replaced = false;
+
+    // The queued pilot actions are cancelled by a safety message (the pings
+    // are kept, they are not actions).
+    if(priority == PRIORITY_SAFETY)
+    {
+        QList<QueuedMessage> &commands = queues[PRIORITY_COMMAND];
+
+        for(int i=0; i<commands.size(); i++)
+        {
+            if(!commands[i].text.startsWith("ping "))
+            {
+                commands.removeAt(i);
+                i--;
+                stats.classes[PRIORITY_COMMAND].droppedCount++;
+            }
+        }
+    }
+
+    // Supersede the queued message of the same setting. In the same class, the
+    // new message takes its place; in another one (e.g. "regulator_state on"
+    // then "off"), it is removed.
+    if(!message.key.isEmpty())
+    {
+        for(int p=0; p<PRIORITIES_COUNT; p++)
+        {
+            QList<QueuedMessage> &queue = queues[p];
+
+            for(int i=0; i<queue.size(); i++)
+            {
+                if(queue[i].key != message.key)
+                    continue;
+
+                stats.classes[p].supersededCount++;
+
+                if(p == priority && !replaced)
+                {
+                    queue[i].text = message.text;
+                    replaced = true;
+                }
+                else
+                {
+                    queue.removeAt(i);
+                    i--;
+                }
+            }
+        }
+    }
+
+    QList<QueuedMessage> &queue = queues[priority];
+
+    if(!replaced)
+    {
+        if(queue.size() >= OUTBOUND_MAX_QUEUE_SIZE)
+        {
+            queue.removeFirst();
+            stats.classes[priority].droppedCount++;
+        }
+
+        queue.append(message);
+    }
+
+    for(int p=0; p<PRIORITIES_COUNT; p++)
+        stats.classes[p].queuedCount = queues[p].size();
+
+    OutboundClassStats &classStats = stats.classes[priority];
+    classStats.maxQueuedCount = qMax(classStats.maxQueuedCount, classStats.queuedCount);
+
+    return priority;
+}
+
+bool OutboundScheduler::takeNext(qint64 now, MessagePriority lowestPriority, QString &text)
+{
+    for(int p=0; p<=lowestPriority; p++)
+    {
+        QList<QueuedMessage> &queue = queues[p];
+
+        if(queue.isEmpty())
+            continue;
+
+        double available = getTokens(p, now);
+
+        if(available < 1.0)
+            continue;
+
+        if(RATE_LIMITS[p] > 0.0)
+        {
+            tokens[p] = available - 1.0;
+            refillTimes[p] = now;
+        }
+
+        QueuedMessage message = queue.takeFirst();
+        text = message.text;
+
+        OutboundClassStats &classStats = stats.classes[p];
+        qint64 latency = now - message.queueTime;
+
+        if(classStats.sentCount == 0)
+            classStats.smoothedLatencyMs = latency;
+        else
+            classStats.smoothedLatencyMs = OUTBOUND_LATENCY_LPF * classStats.smoothedLatencyMs
+                                           + (1.0 - OUTBOUND_LATENCY_LPF) * latency;
+
+        classStats.sentCount++;
+        classStats.maxLatencyMs = qMax(classStats.maxLatencyMs, latency);
+        classStats.queuedCount = queue.size();
+
+        return true;
+    }
+
+    return false;
+}
+
+qint64 OutboundScheduler::getNextTime(qint64 now) const
+{
+    qint64 nextTime = -1;
+
+    for(int p=0; p<PRIORITIES_COUNT; p++)
+    {
+        if(queues[p].isEmpty())
+            continue;
+
+        double available = getTokens(p, now);
+        qint64 time = now;
+
+        // Time for the bucket to get a whole token back.
+        if(available < 1.0)
+            time = now + (qint64)std::ceil((1.0 - available) * 1000.0 / RATE_LIMITS[p]);
+
+        if(nextTime < 0 || time < nextTime)
+            nextTime = time;
+    }
+
+    return nextTime;
+}
+
+const OutboundStats& OutboundScheduler::getStats() const
+{
+    return stats;
+}
+
+double OutboundScheduler::getTokens(int priority, qint64 now) const
+{
+    if(RATE_LIMITS[priority] <= 0.0)
+        return INFINITY;
+
+    double refilled = tokens[priority] + (now - refillTimes[priority]) * RATE_LIMITS[priority] / 1000.0;
+
+    return qMin(refilled, (double)BURST_SIZES[priority]);
+}
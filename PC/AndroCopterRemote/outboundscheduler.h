@@ -0,0 +1,125 @@
+/*!
+* \file outboundscheduler.h
+* \brief Priority scheduling of the messages sent to a phone.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef OUTBOUNDSCHEDULER_H
+#define OUTBOUNDSCHEDULER_H
+
+#include <QString>
+#include <QList>
+
+#include "constants.h"
+
+/// Priority classes of the messages sent to a phone, from the most urgent.
+enum MessagePriority
+{
+    PRIORITY_SAFETY=0, ///< Emergency stop, regulators off: written at once, even on a congested link.
+    PRIORITY_COMMAND, ///< Pilot actions (altitude lock, regulators on...) and pings.
+    PRIORITY_CONFIG, ///< Settings: regulators coefficients, FPV, telemetry format...
+    PRIORITY_BULK, ///< Data transfers: pictures, telemetry backlog, chunks.
+    PRIORITIES_COUNT
+};
+
+/// Counters of the messages of a priority class.
+struct OutboundClassStats
+{
+    int queuedCount; ///< Messages waiting to be written (queue depth).
+    int maxQueuedCount; ///< Maximum depth of the queue.
+    qint64 sentCount; ///< Messages written to the socket.
+    qint64 supersededCount; ///< Messages replaced by a newer one before being written.
+    qint64 droppedCount; ///< Messages discarded: queue full, or cancelled by an emergency stop.
+    double smoothedLatencyMs; ///< Time from the queuing to the writing, low-pass filtered [ms].
+    qint64 maxLatencyMs; ///< Maximum time from the queuing to the writing [ms].
+};
+
+/// Counters of the messages sent to a phone, per priority class.
+struct OutboundStats
+{
+    OutboundClassStats classes[PRIORITIES_COUNT]; ///< Indexed by MessagePriority.
+};
+
+/// Queues of the messages sent to a phone (except the flight commands, see
+/// VehicleLink::queueCommand()), one per priority class.
+///
+/// The messages are classified by their first words (see classify()). They
+/// are written by priority, and each class but the safety one is limited to
+/// a rate (token bucket), so a burst of settings or pictures requests can't
+/// hold the pilot actions. Within a class, the order is kept.
+///
+/// A message changing a setting (e.g. "regulator_coefs", "fpv quality")
+/// supersedes the queued message of the same setting: it takes its place in
+/// the queue, and the outdated value is never sent. A safety message also
+/// cancels the queued pilot actions, which could undo it (e.g.
+/// "regulator_state on" after an emergency stop).
+///
+/// This class does not write to the socket: VehicleLink takes the messages
+/// when the socket is not congested.
+class OutboundScheduler
+{
+public:
+    /// Constructor.
+    OutboundScheduler();
+
+    /// Get the priority class of a message.
+    /// \param text the message.
+    /// \param coalescingKey if not null, set to the words identifying the
+    /// setting changed by the message, or to an empty string if the message
+    /// is never superseded.
+    /// \return the priority class.
+    static MessagePriority classify(const QString &text, QString *coalescingKey = 0);
+
+    /// Queues a message.
+    /// \param text the message.
+    /// \param now current time [ms].
+    /// \return the priority class of the message.
+    MessagePriority enqueue(const QString &text, qint64 now);
+
+    /// Takes the next message to write: the oldest one of the most urgent
+    /// class that is not limited by its rate.
+    /// \param now current time [ms].
+    /// \param lowestPriority least urgent class that can be taken, e.g.
+    /// PRIORITY_SAFETY for a congested socket.
+    /// \param text set to the message, if any.
+    /// \return true if a message was taken.
+    bool takeNext(qint64 now, MessagePriority lowestPriority, QString &text);
+
+    /// Get the time at which the next message can be taken.
+    /// \param now current time [ms].
+    /// \return now if a message can be taken, a later time if all the
+    /// waiting messages are limited by their rate, -1 if no message is
+    /// waiting [ms].
+    qint64 getNextTime(qint64 now) const;
+
+    /// Get the counters of the messages.
+    /// \return the counters.
+    const OutboundStats& getStats() const;
+
+private:
+    /// A message waiting to be written.
+    struct QueuedMessage
+    {
+        QString text;
+        QString key; ///< Coalescing key, empty if never superseded.
+        qint64 queueTime; ///< Time of the queuing [ms].
+    };
+
+    /// Get the tokens of a class (number of messages that can be written).
+    /// \param priority the class.
+    /// \param now current time [ms].
+    /// \return the tokens, infinite if the class is not limited.
+    double getTokens(int priority, qint64 now) const;
+
+    QList<QueuedMessage> queues[PRIORITIES_COUNT];
+
+    // Token buckets.
+    double tokens[PRIORITIES_COUNT];
+    qint64 refillTimes[PRIORITIES_COUNT];
+
+    OutboundStats stats;
+};
+
+#endif // OUTBOUNDSCHEDULER_H
@@ -61,6 +61,11 @@ void Pid::setCoefficients(double kp, double ki, double kd)
     this->kd = kd;
 }
 
+void Pid::setAPriori(double aPriori)
+{
+    this->aPriori = aPriori;
+}
+
 void Pid::reset()
 {
     integrator = 0.0;
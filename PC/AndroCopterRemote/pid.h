@@ -42,6 +42,10 @@ public:
 	/// \param ki the Ki coefficent.
 	/// \param kd the Kd coefficent.
     void setCoefficients(double kp, double ki, double kd);
+
+	/// Set the a-priori value added to the linear PID command.
+	/// \param aPriori the new a-priori value.
+    void setAPriori(double aPriori);
 	
 	/// Reset the integrator and the derivator's last stored value.
     void reset();
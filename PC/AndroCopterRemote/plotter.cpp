@@ -1,8 +1,16 @@
 #include "plotter.h"
 
+#include <cmath>
+
 Plotter::Plotter(QWidget *parent) : QGraphicsView(parent)
 {
     axisItem = 0;
+    store = 0;
+    currentChannel = 0;
+    targetChannel = 0;
+    commandChannel = 0;
+    firstDisplayedSequence = 0;
+    nStepsMax = 0;
 
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -25,19 +33,36 @@ void Plotter::setup(int nPointsPerCurveMax, double angleAmpl, double commandAmpl
     clearGraph();
 }
 
-void Plotter::nextStep(int time, double currentAngle, double targetAngle, double command)
+void Plotter::setSource(const TelemetryStore *store, int currentChannel,
+                        int targetChannel, int commandChannel)
 {
-    steps.append(Step(time, currentAngle, targetAngle, command));
+    this->store = store;
+    this->currentChannel = currentChannel;
+    this->targetChannel = targetChannel;
+    this->commandChannel = commandChannel;
 
-    if(steps.size() > nStepsMax)
-        steps.removeFirst();
+    clearGraph();
+}
 
+void Plotter::refresh()
+{
     drawAll();
 }
 
 void Plotter::drawAll()
 {
-    if(steps.size() > 0)
+    if(store == 0)
+        return;
+
+    // Find the rows to display: the nStepsMax last ones, but not the ones
+    // added before the last call to clearGraph(), nor the ones not in memory
+    // anymore.
+    qint64 firstSequence = qMax(store->totalCount() - nStepsMax,
+                                qMax(firstDisplayedSequence, store->firstSequence()));
+    int first = (int)(firstSequence - store->firstSequence());
+    int last = store->size() - 1;
+
+    if(last - first + 1 > 0)
     {
         double h = (double)height();
         double w = (double)width();
@@ -49,10 +74,16 @@ void Plotter::drawAll()
 
         axisItem = scene.addLine(0.0, h/2.0, w, h/2.0);
 
-        // Draw the curves.
-        int firstTime = steps.first().time;
-        int lastTime = steps.last().time;
-        double timeSpan = (double)(lastTime-firstTime);
+        // Draw the curves. The creation times are only used once all the
+        // displayed rows have one.
+        bool synchronized = true;
+
+        for(int i=first; i<=last && synchronized; i++)
+            synchronized = !std::isnan(store->value(i, TM_SYNC_TIME));
+
+        double firstTime = sampleTime(first, synchronized);
+        double lastTime = sampleTime(last, synchronized);
+        double timeSpan = qMax(lastTime-firstTime, 1.0);
 
         scene.removeItem(currentAngleItem);
         scene.removeItem(targetAngleItem);
@@ -60,16 +91,16 @@ void Plotter::drawAll()
 
         QPainterPath currentAnglePath, targetAnglePath, commandPath;
 
-        currentAnglePath.moveTo(0.0, (-steps.first().currentAngle/angleAmplitude+1.0)*h/2.0);
-        targetAnglePath.moveTo(0.0, (-steps.first().targetAngle/angleAmplitude+1.0)*h/2.0);
-        commandPath.moveTo(0.0, (-steps.first().command/commandAmplitude+1.0)*h/2.0);
+        currentAnglePath.moveTo(0.0, (-store->value(first, currentChannel)/angleAmplitude+1.0)*h/2.0);
+        targetAnglePath.moveTo(0.0, (-store->value(first, targetChannel)/angleAmplitude+1.0)*h/2.0);
+        commandPath.moveTo(0.0, (-store->value(first, commandChannel)/commandAmplitude+1.0)*h/2.0);
 
-        for(QLinkedList<Step>::iterator i = ++steps.begin(); i != steps.end(); ++i)
+        for(int i=first+1; i<=last; i++)
         {
-            double xPos = ((double)(i->time-firstTime)) / timeSpan * w;
-            currentAnglePath.lineTo(xPos, (-i->currentAngle/angleAmplitude+1.0)*h/2.0);
-            targetAnglePath.lineTo(xPos, (-i->targetAngle/angleAmplitude+1.0)*h/2.0);
-            commandPath.lineTo(xPos, (-i->command/commandAmplitude+1.0)*h/2.0);
+            double xPos = (sampleTime(i, synchronized)-firstTime) / timeSpan * w;
+            currentAnglePath.lineTo(xPos, (-store->value(i, currentChannel)/angleAmplitude+1.0)*h/2.0);
+            targetAnglePath.lineTo(xPos, (-store->value(i, targetChannel)/angleAmplitude+1.0)*h/2.0);
+            commandPath.lineTo(xPos, (-store->value(i, commandChannel)/commandAmplitude+1.0)*h/2.0);
         }
 
         currentAngleItem = scene.addPath(currentAnglePath, QPen(Qt::blue));
@@ -87,5 +118,14 @@ void Plotter::resizeEvent(QResizeEvent *event)
 
 void Plotter::clearGraph()
 {
-    steps.clear();
+    if(store != 0)
+        firstDisplayedSequence = store->totalCount();
+}
+
+double Plotter::sampleTime(int index, bool synchronized) const
+{
+    if(synchronized)
+        return store->value(index, TM_SYNC_TIME);
+    else
+        return (double)store->time(index);
 }
@@ -12,29 +12,14 @@
 #include <QGraphicsView>
 #include <QGraphicsItem>
 #include <QList>
-#include <QLinkedList>
 #include <QPen>
 
-/// Internal class used by the Plotter class to represent a point on the
-/// chart. This chart displays the nStepsMax last given points.
-/// It is designed for displaying data of PID controllers, current value,
-/// target and command.
-class Step
-{
-public:
-    Step(int time, double currentAngle, double targetAngle, double command)
-    {
-        this->time = time;
-        this->currentAngle = currentAngle;
-        this->targetAngle = targetAngle;
-        this->command = command;
-    }
-
-    int time;
-    double currentAngle, targetAngle, command;
-};
+#include "telemetrystore.h"
 
 /// Qt widget for a live chart.
+/// The chart displays the nStepsMax last rows of a telemetry store. It is
+/// designed for displaying data of PID controllers: current value, target and
+/// command.
 class Plotter : public QGraphicsView
 {
     Q_OBJECT
@@ -44,22 +29,28 @@ public:
     explicit Plotter(QWidget *parent = 0);
 
 	/// Setup the chart. It is necessary to call this function before trying to
-	/// call the nextStep() method.
+	/// call the refresh() method.
 	/// \param nStepsMax max number of timesteps displayed.
 	/// \param angleAmp- determines the -ylim and ylim of the chart, for the
 	/// angle.
 	/// \param commandAmpl determines the -ylim and ylim of the chart, for the
 	/// commande.
     void setup(int nStepsMax, double angleAmpl, double commandAmpl);
+
+	/// Set the telemetry store and the channels to display.
+	/// \param store the store to read the points from.
+	/// \param currentChannel channel of the current value given to the PID.
+	/// \param targetChannel channel of the target value given to the PID.
+	/// \param commandChannel channel of the command computed by the PID.
+    void setSource(const TelemetryStore *store, int currentChannel,
+                   int targetChannel, int commandChannel);
+
+	/// Redraws the chart with the latest rows of the store. Should be called
+	/// when new rows have been added to the store.
+    void refresh();
 	
-	/// Add a new point to the graph.
-	/// \param time time of the point.
-	/// \param currentAngle the current angle given to the PID.
-	/// \param targetAngle the target angle given to the PID.
-	/// \param command the command computed by the PID.
-    void nextStep(int time, double currentAngle, double targetAngle, double command);
-	
-	/// Removes all the points from the chart.
+	/// Removes all the points from the chart. Only the rows added to the
+	/// store after this call will be displayed.
     void clearGraph();
 
 	/// Method called by Qt when the widget is resized.
@@ -69,7 +60,18 @@ private:
 	/// Draws the lines on the chart.
     void drawAll();
 
-    QLinkedList<Step> steps;
+	/// Get the time of a row on the displayed timeline.
+	/// \param index index of the row in the store.
+	/// \param synchronized true for its creation time in the ground clock
+	/// (TM_SYNC_TIME), false for its reception time. All the displayed rows
+	/// must use the same timeline: the reception time is later by the
+	/// downlink delay, so mixing them would make the time go backwards.
+	/// \return the time [ms].
+    double sampleTime(int index, bool synchronized) const;
+
+    const TelemetryStore *store;
+    int currentChannel, targetChannel, commandChannel;
+    qint64 firstDisplayedSequence;
     int nStepsMax;
     QGraphicsScene scene;
     QGraphicsItem *axisItem, *currentAngleItem, *targetAngleItem, *commandItem;
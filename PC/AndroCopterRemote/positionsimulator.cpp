@@ -0,0 +1,73 @@
+#include "positionsimulator.h"
+#include "constants.h"
+
+#include <cmath>
+
+const double GRAVITY = 9.81; // [m/s^2].
+const double DEG_TO_RAD = 3.14159265 / 180.0;
+
+PositionSimulator::PositionSimulator()
+{
+    reset(0.0, 0.0, 0.0);
+}
+
+void PositionSimulator::reset(double x, double y, double z)
+{
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    vx = 0.0;
+    vy = 0.0;
+    vz = 0.0;
+}
+
+void PositionSimulator::step(double thrust, double yaw, double pitch,
+                             double roll, double dt)
+{
+    // Horizontal acceleration in the quadcopter frame, then in the ground
+    // frame.
+    double forwardAcc = GRAVITY * tan(pitch * DEG_TO_RAD);
+    double rightAcc = GRAVITY * tan(roll * DEG_TO_RAD);
+    double cosYaw = cos(yaw * DEG_TO_RAD);
+    double sinYaw = sin(yaw * DEG_TO_RAD);
+
+    double ax = forwardAcc * cosYaw - rightAcc * sinYaw - SIMULATOR_DRAG * vx;
+    double ay = forwardAcc * sinYaw + rightAcc * cosYaw - SIMULATOR_DRAG * vy;
+
+    // Vertical acceleration. The thrust is supposed proportional to the
+    // command.
+    double az = GRAVITY * (thrust / SIMULATOR_HOVER_THRUST - 1.0)
+                - SIMULATOR_DRAG * vz;
+
+    vx += ax * dt;
+    vy += ay * dt;
+    vz += az * dt;
+
+    x += vx * dt;
+    y += vy * dt;
+    z += vz * dt;
+
+    // The quadcopter can not go through the ground.
+    if(z < 0.0)
+    {
+        z = 0.0;
+        vx = 0.0;
+        vy = 0.0;
+        vz = 0.0;
+    }
+}
+
+double PositionSimulator::getX() const
+{
+    return x;
+}
+
+double PositionSimulator::getY() const
+{
+    return y;
+}
+
+double PositionSimulator::getZ() const
+{
+    return z;
+}
@@ -0,0 +1,55 @@
+/*!
+* \file positionsimulator.h
+* \brief Crude simulation of the quadcopter position, to stand in for the
+* position estimates of the telemetry.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef POSITIONSIMULATOR_H
+#define POSITIONSIMULATOR_H
+
+/// Point-mass model of the quadcopter, driven by the commands sent to the
+/// phone. The attitude regulators of the phone are supposed perfect, so the
+/// target angles are directly used as the current angles.
+/// The position is expressed in the ground frame: x is forward and y is on
+/// the right when the yaw is zero, z is the altitude. A positive pitch moves
+/// the quadcopter forward, and a positive roll moves it to the right.
+class PositionSimulator
+{
+public:
+    /// Constructor. The quadcopter starts at rest, at the origin.
+    PositionSimulator();
+
+    /// Put the quadcopter at rest, at the given position.
+    /// \param x the x position [m].
+    /// \param y the y position [m].
+    /// \param z the altitude [m].
+    void reset(double x, double y, double z);
+
+    /// Advances the simulation by one timestep.
+    /// \param thrust the mean thrust command (0-MAX_THRUST).
+    /// \param yaw the yaw angle [deg].
+    /// \param pitch the pitch angle [deg].
+    /// \param roll the roll angle [deg].
+    /// \param dt the timestep [s].
+    void step(double thrust, double yaw, double pitch, double roll, double dt);
+
+    /// Get the x position.
+    /// \return the x position [m].
+    double getX() const;
+
+    /// Get the y position.
+    /// \return the y position [m].
+    double getY() const;
+
+    /// Get the altitude.
+    /// \return the altitude [m].
+    double getZ() const;
+
+private:
+    double x, y, z, vx, vy, vz;
+};
+
+#endif // POSITIONSIMULATOR_H
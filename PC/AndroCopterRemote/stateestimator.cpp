@@ -0,0 +1,294 @@
+#include "stateestimator.h"
+
+#include <cmath>
+
+const double GRAVITY = 9.81; // [m/s^2].
+const double DEG_TO_RAD = 3.14159265 / 180.0;
+
+/// Wraps an angle to [-180;180[.
+/// \param angle the angle [deg].
+/// \return the same angle, in [-180;180[ [deg].
+static double wrapAngle(double angle)
+{
+    return angle - 360.0 * std::floor((angle + 180.0) / 360.0);
+}
+
+/// Measurement matrix: the measured variables.
+static Matrix<ESTIMATOR_MEASUREMENTS_COUNT, EST_VARIABLES_COUNT> makeMeasurementMatrix()
+{
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, EST_VARIABLES_COUNT> h;
+    h(0, EST_YAW) = 1.0;
+    h(1, EST_PITCH) = 1.0;
+    h(2, EST_ROLL) = 1.0;
+    h(3, EST_ALTITUDE) = 1.0;
+
+    return h;
+}
+
+/// Covariance of the measurement noise.
+static Matrix<ESTIMATOR_MEASUREMENTS_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> makeMeasurementNoise()
+{
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> r;
+
+    for(int i=0; i<3; i++)
+        r(i, i) = ESTIMATOR_ANGLE_NOISE * ESTIMATOR_ANGLE_NOISE;
+
+    r(3, 3) = ESTIMATOR_ALTITUDE_NOISE * ESTIMATOR_ALTITUDE_NOISE;
+
+    return r;
+}
+
+StateEstimator::StateEstimator()
+{
+    reset();
+}
+
+void StateEstimator::reset()
+{
+    initialized = false;
+    measurementTime = 0.0;
+    rejectedCount = 0;
+    commandsCount = 0;
+    newestCommand = -1;
+}
+
+void StateEstimator::addCommand(double time, double thrust, double yaw, double pitch, double roll)
+{
+    newestCommand = (newestCommand + 1) % ESTIMATOR_COMMANDS_COUNT;
+
+    if(commandsCount < ESTIMATOR_COMMANDS_COUNT)
+        commandsCount++;
+
+    Command &command = commands[newestCommand];
+    command.time = time;
+    command.thrust = thrust;
+    command.yaw = yaw;
+    command.pitch = pitch;
+    command.roll = roll;
+}
+
+bool StateEstimator::addMeasurement(double time, double yaw, double pitch, double roll, double altitude)
+{
+    if(!std::isfinite(time) || !std::isfinite(yaw) || !std::isfinite(pitch) ||
+       !std::isfinite(roll) || !std::isfinite(altitude))
+    {
+        return false;
+    }
+
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, 1> measurement;
+    measurement[0] = wrapAngle(yaw);
+    measurement[1] = pitch;
+    measurement[2] = roll;
+    measurement[3] = altitude;
+
+    // Start again after a long gap, or if the estimate diverged.
+    if(!initialized || time - measurementTime > ESTIMATOR_RESET_GAP_MS ||
+       rejectedCount >= ESTIMATOR_MAX_REJECTED_COUNT)
+    {
+        initialize(time, measurement);
+        return true;
+    }
+
+    if(time < measurementTime)
+        return false;
+
+    // Replay the commands received by the vehicle since the previous
+    // measurement.
+    StateVector x = state;
+    StateMatrix p = covariance;
+    propagate(x, p, measurementTime, time);
+
+    // Innovation, and its covariance.
+    static const Matrix<ESTIMATOR_MEASUREMENTS_COUNT, EST_VARIABLES_COUNT> h = makeMeasurementMatrix();
+    static const Matrix<ESTIMATOR_MEASUREMENTS_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> r = makeMeasurementNoise();
+
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, 1> innovation = measurement - h * x;
+    innovation[0] = wrapAngle(innovation[0]);
+
+    Matrix<EST_VARIABLES_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> pht = p * h.transposed();
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> s = h * pht + r;
+    Matrix<ESTIMATOR_MEASUREMENTS_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> sInverse;
+
+    if(!invert(s, sInverse))
+        return false;
+
+    // Reject the outliers (e.g. a barometer glitch).
+    double distance = (innovation.transposed() * sInverse * innovation)(0, 0);
+
+    if(distance > ESTIMATOR_OUTLIER_THRESHOLD)
+    {
+        rejectedCount++;
+        return false;
+    }
+
+    // Correct the state. The covariance is updated in the Joseph form, which
+    // keeps it positive.
+    Matrix<EST_VARIABLES_COUNT, ESTIMATOR_MEASUREMENTS_COUNT> gain = pht * sInverse;
+    x = x + gain * innovation;
+    x[EST_YAW] = wrapAngle(x[EST_YAW]);
+
+    if(x[EST_HOVER_THRUST] < ESTIMATOR_MIN_HOVER_THRUST)
+        x[EST_HOVER_THRUST] = ESTIMATOR_MIN_HOVER_THRUST;
+    else if(x[EST_HOVER_THRUST] > ESTIMATOR_MAX_HOVER_THRUST)
+        x[EST_HOVER_THRUST] = ESTIMATOR_MAX_HOVER_THRUST;
+
+    StateMatrix a = StateMatrix::identity() - gain * h;
+    p = a * p * a.transposed() + gain * r * gain.transposed();
+    p.symmetrize();
+
+    state = x;
+    covariance = p;
+    measurementTime = time;
+    rejectedCount = 0;
+
+    return true;
+}
+
+bool StateEstimator::isInitialized() const
+{
+    return initialized;
+}
+
+double StateEstimator::getMeasurementTime() const
+{
+    return measurementTime;
+}
+
+bool StateEstimator::predict(double time, EstimatedState &predicted) const
+{
+    if(!initialized || time - measurementTime > ESTIMATOR_MAX_EXTRAPOLATION_MS)
+        return false;
+
+    StateVector x = state;
+    StateMatrix p = covariance;
+
+    if(time > measurementTime)
+        propagate(x, p, measurementTime, time);
+
+    predicted.time = time;
+    predicted.extrapolation = time - measurementTime;
+
+    for(int i=0; i<EST_VARIABLES_COUNT; i++)
+    {
+        predicted.values[i] = x[i];
+        predicted.deviations[i] = std::sqrt(p(i, i));
+    }
+
+    return true;
+}
+
+void StateEstimator::initialize(double time, const Matrix<ESTIMATOR_MEASUREMENTS_COUNT, 1> &measurement)
+{
+    state = StateVector();
+    state[EST_YAW] = measurement[0];
+    state[EST_PITCH] = measurement[1];
+    state[EST_ROLL] = measurement[2];
+    state[EST_ALTITUDE] = measurement[3];
+    state[EST_HOVER_THRUST] = ESTIMATOR_INITIAL_HOVER_THRUST;
+
+    // The measured variables are known to the measurement noise, the others
+    // are guessed.
+    covariance = StateMatrix();
+
+    for(int i=EST_YAW; i<=EST_ROLL; i++)
+        covariance(i, i) = ESTIMATOR_ANGLE_NOISE * ESTIMATOR_ANGLE_NOISE;
+
+    for(int i=EST_YAW_RATE; i<=EST_ROLL_RATE; i++)
+        covariance(i, i) = 50.0 * 50.0; // [deg/s].
+
+    covariance(EST_ALTITUDE, EST_ALTITUDE) = ESTIMATOR_ALTITUDE_NOISE * ESTIMATOR_ALTITUDE_NOISE;
+    covariance(EST_VERTICAL_SPEED, EST_VERTICAL_SPEED) = 1.0; // [m/s].
+    covariance(EST_HOVER_THRUST, EST_HOVER_THRUST) = 40.0 * 40.0;
+
+    measurementTime = time;
+    rejectedCount = 0;
+    initialized = true;
+}
+
+const StateEstimator::Command* StateEstimator::getCommand(double time) const
+{
+    // The latest command received before this time, if not too old.
+    for(int i=0; i<commandsCount; i++)
+    {
+        const Command &command = commands[(newestCommand - i + ESTIMATOR_COMMANDS_COUNT) % ESTIMATOR_COMMANDS_COUNT];
+
+        if(command.time <= time)
+            return (time - command.time <= ESTIMATOR_COMMAND_TIMEOUT_MS) ? &command : 0;
+    }
+
+    return 0;
+}
+
+void StateEstimator::propagate(StateVector &x, StateMatrix &p, double from, double to) const
+{
+    const double pulsation = ESTIMATOR_ATTITUDE_PULSATION;
+    const double damping = ESTIMATOR_ATTITUDE_DAMPING;
+
+    for(double time=from; time<to; time+=ESTIMATOR_STEP_MS)
+    {
+        double dt = std::fmin(ESTIMATOR_STEP_MS, to - time) / 1000.0;
+        const Command *command = getCommand(time);
+
+        // Derivative of the state, and its jacobian.
+        StateVector derivative;
+        StateMatrix jacobian;
+
+        // Attitude: each angle follows its target. Without a command (e.g.
+        // the regulators are off), it stays still.
+        for(int axis=0; axis<3; axis++)
+        {
+            int angle = EST_YAW + axis;
+            int rate = EST_YAW_RATE + axis;
+            double error = 0.0;
+
+            if(command != 0)
+            {
+                double targets[3] = {command->yaw, command->pitch, command->roll};
+                error = targets[axis] - x[angle];
+
+                if(angle == EST_YAW)
+                    error = wrapAngle(error);
+
+                jacobian(rate, angle) = -pulsation * pulsation;
+            }
+
+            derivative[angle] = x[rate];
+            derivative[rate] = pulsation * pulsation * error - 2.0 * damping * pulsation * x[rate];
+            jacobian(angle, rate) = 1.0;
+            jacobian(rate, rate) = -2.0 * damping * pulsation;
+        }
+
+        // Vertical motion. Without a command, the vehicle does not fly.
+        derivative[EST_ALTITUDE] = x[EST_VERTICAL_SPEED];
+        derivative[EST_VERTICAL_SPEED] = -ESTIMATOR_VERTICAL_DRAG * x[EST_VERTICAL_SPEED];
+        jacobian(EST_ALTITUDE, EST_VERTICAL_SPEED) = 1.0;
+        jacobian(EST_VERTICAL_SPEED, EST_VERTICAL_SPEED) = -ESTIMATOR_VERTICAL_DRAG;
+
+        if(command != 0)
+        {
+            double pitch = x[EST_PITCH] * DEG_TO_RAD;
+            double roll = x[EST_ROLL] * DEG_TO_RAD;
+            double hoverThrust = x[EST_HOVER_THRUST];
+            double lift = GRAVITY * command->thrust / hoverThrust;
+
+            derivative[EST_VERTICAL_SPEED] += lift * std::cos(pitch) * std::cos(roll) - GRAVITY;
+            jacobian(EST_VERTICAL_SPEED, EST_PITCH) = -lift * std::sin(pitch) * std::cos(roll) * DEG_TO_RAD;
+            jacobian(EST_VERTICAL_SPEED, EST_ROLL) = -lift * std::cos(pitch) * std::sin(roll) * DEG_TO_RAD;
+            jacobian(EST_VERTICAL_SPEED, EST_HOVER_THRUST) = -lift * std::cos(pitch) * std::cos(roll) / hoverThrust;
+        }
+
+        // Euler step of the state, and of its covariance.
+        x = x + derivative * dt;
+        x[EST_YAW] = wrapAngle(x[EST_YAW]);
+
+        StateMatrix transition = StateMatrix::identity() + jacobian * dt;
+        p = transition * p * transition.transposed();
+
+        for(int i=EST_YAW_RATE; i<=EST_ROLL_RATE; i++)
+            p(i, i) += ESTIMATOR_ANGULAR_ACCELERATION_NOISE * ESTIMATOR_ANGULAR_ACCELERATION_NOISE * dt;
+
+        p(EST_VERTICAL_SPEED, EST_VERTICAL_SPEED) += ESTIMATOR_VERTICAL_ACCELERATION_NOISE * ESTIMATOR_VERTICAL_ACCELERATION_NOISE * dt;
+        p(EST_HOVER_THRUST, EST_HOVER_THRUST) += ESTIMATOR_HOVER_THRUST_NOISE * ESTIMATOR_HOVER_THRUST_NOISE * dt;
+        p.symmetrize();
+    }
+}
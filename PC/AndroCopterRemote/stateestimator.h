@@ -0,0 +1,201 @@
+/*!
+* \file stateestimator.h
+* \brief Estimation of the vehicle state from the telemetry and the commands
+* (extended Kalman filter).
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* This file does not depend on Qt, so the benchmark (StateEstimatorBench) can
+* be built without it.
+*/
+
+#ifndef STATEESTIMATOR_H
+#define STATEESTIMATOR_H
+
+#include "matrix.h"
+
+/// Variables of the estimated state.
+enum EstimatorVariable
+{
+    EST_YAW=0, ///< Yaw angle [deg], in [-180;180[.
+    EST_PITCH, ///< Pitch angle [deg].
+    EST_ROLL, ///< Roll angle [deg].
+    EST_YAW_RATE, ///< Yaw angular speed [deg/s].
+    EST_PITCH_RATE, ///< Pitch angular speed [deg/s].
+    EST_ROLL_RATE, ///< Roll angular speed [deg/s].
+    EST_ALTITUDE, ///< Altitude [m].
+    EST_VERTICAL_SPEED, ///< Vertical speed [m/s].
+    EST_HOVER_THRUST, ///< Thrust command that holds the altitude (0-255).
+    EST_VARIABLES_COUNT ///< Number of variables, not a variable.
+};
+
+/// Number of measured variables: the yaw, pitch and roll angles, and the
+/// altitude of a CURRENT_STATE.
+const int ESTIMATOR_MEASUREMENTS_COUNT = 4;
+
+/// Integration step of the model [ms].
+const double ESTIMATOR_STEP_MS = 5.0;
+
+/// Number of commands kept, to replay them between two measurements. At the
+/// commands rate (UPDATE_PERIOD_MS), covers about 2.5 s.
+const int ESTIMATOR_COMMANDS_COUNT = 128;
+
+/// Time after which a command is no longer applied by the model, e.g. when
+/// the regulators are off [ms].
+const double ESTIMATOR_COMMAND_TIMEOUT_MS = 200.0;
+
+/// Maximum time of extrapolation after the last measurement [ms]. Beyond,
+/// the prediction is not given.
+const double ESTIMATOR_MAX_EXTRAPOLATION_MS = 1000.0;
+
+/// Time without measurement after which the filter starts again from the
+/// next measurement [ms].
+const double ESTIMATOR_RESET_GAP_MS = 3000.0;
+
+/// Response of the attitude regulators of the phone, modelled as a second
+/// order system: natural pulsation [rad/s] and damping ratio.
+const double ESTIMATOR_ATTITUDE_PULSATION = 8.0;
+const double ESTIMATOR_ATTITUDE_DAMPING = 0.8;
+
+/// Initial estimate of the hover thrust, as SIMULATOR_HOVER_THRUST.
+const double ESTIMATOR_INITIAL_HOVER_THRUST = 130.0;
+
+/// Bounds of the hover thrust estimate.
+const double ESTIMATOR_MIN_HOVER_THRUST = 30.0;
+const double ESTIMATOR_MAX_HOVER_THRUST = 255.0;
+
+/// Linear drag coefficient of the vertical motion [1/s], as SIMULATOR_DRAG.
+const double ESTIMATOR_VERTICAL_DRAG = 0.5;
+
+/// Standard deviations of the measurement noise: angles [deg], and altitude
+/// [m].
+const double ESTIMATOR_ANGLE_NOISE = 1.0;
+const double ESTIMATOR_ALTITUDE_NOISE = 0.3;
+
+/// Spectral densities of the process noise, as standard deviations over one
+/// second: angular acceleration [deg/s^2], vertical acceleration [m/s^2],
+/// and hover thrust drift (battery discharge) [1/s].
+const double ESTIMATOR_ANGULAR_ACCELERATION_NOISE = 300.0;
+const double ESTIMATOR_VERTICAL_ACCELERATION_NOISE = 3.0;
+const double ESTIMATOR_HOVER_THRUST_NOISE = 2.0;
+
+/// Threshold of the normalized innovation (squared Mahalanobis distance)
+/// above which a measurement is rejected as an outlier. 99.9% of the chi-2
+/// distribution with 4 degrees of freedom.
+const double ESTIMATOR_OUTLIER_THRESHOLD = 18.5;
+
+/// Number of consecutive rejected measurements after which the filter starts
+/// again from the next measurement: the estimate is lost, not the
+/// measurements.
+const int ESTIMATOR_MAX_REJECTED_COUNT = 5;
+
+/// State predicted by the StateEstimator.
+struct EstimatedState
+{
+    double time; ///< Time of the prediction [ms].
+    double values[EST_VARIABLES_COUNT]; ///< Variables, indexed by EstimatorVariable.
+    double deviations[EST_VARIABLES_COUNT]; ///< Standard deviations of the variables.
+    double extrapolation; ///< Time since the last measurement [ms].
+};
+
+/// Extended Kalman filter estimating the attitude and the vertical motion of
+/// a vehicle, from its telemetry and the commands sent to it.
+///
+/// The model is the one of PositionSimulator, with the attitude regulators
+/// of the phone as second order systems following the target angles of the
+/// commands, and with the hover thrust as an unknown to estimate (it depends
+/// on the battery and on the payload). The vertical acceleration is
+/// G*(thrust*cos(pitch)*cos(roll)/hoverThrust - 1) - drag*verticalSpeed: it is
+/// not linear in the state, hence the extended filter.
+///
+/// The telemetry arrives late (link delay) and irregularly (link jitter,
+/// congestion). Each measurement is fused at the time it was taken, after
+/// replaying the commands the vehicle received since the previous one; then
+/// predict() extrapolates to the current time, e.g. at the rate of the
+/// commands, for the outer control loops and the displays. All the times are
+/// in the ground station clock (see ClockSync).
+///
+/// The matrices have fixed sizes (Matrix): nothing is allocated.
+class StateEstimator
+{
+public:
+    /// Constructor. The filter starts with the first measurement.
+    StateEstimator();
+
+    /// Forgets the estimate and the commands, e.g. for a new connection.
+    void reset();
+
+    /// Stores a command sent to the vehicle.
+    /// \param time time at which the vehicle applies the command, i.e. the
+    /// sending time plus the uplink delay [ms]. Must not decrease.
+    /// \param thrust mean thrust command (0-MAX_THRUST).
+    /// \param yaw target yaw angle [deg].
+    /// \param pitch target pitch angle [deg].
+    /// \param roll target roll angle [deg].
+    void addCommand(double time, double thrust, double yaw, double pitch, double roll);
+
+    /// Fuses a measurement of the telemetry.
+    /// \param time time at which the measurement was taken [ms].
+    /// \param yaw measured yaw angle [deg].
+    /// \param pitch measured pitch angle [deg].
+    /// \param roll measured roll angle [deg].
+    /// \param altitude measured altitude [m].
+    /// \return false if the measurement was ignored: not finite, older than
+    /// the previous one, or rejected as an outlier.
+    bool addMeasurement(double time, double yaw, double pitch, double roll, double altitude);
+
+    /// Get if the filter has started.
+    /// \return true once a measurement has been fused.
+    bool isInitialized() const;
+
+    /// Get the time of the last fused measurement.
+    /// \return the time [ms].
+    double getMeasurementTime() const;
+
+    /// Predicts the state at the given time, from the last fused
+    /// measurement and the commands sent since.
+    /// \param time time of the prediction [ms], usually the current time.
+    /// \param predicted set to the predicted state.
+    /// \return false if the filter has not started, or if the last
+    /// measurement is older than ESTIMATOR_MAX_EXTRAPOLATION_MS.
+    bool predict(double time, EstimatedState &predicted) const;
+
+private:
+    typedef Matrix<EST_VARIABLES_COUNT, 1> StateVector;
+    typedef Matrix<EST_VARIABLES_COUNT, EST_VARIABLES_COUNT> StateMatrix;
+
+    /// A command sent to the vehicle.
+    struct Command
+    {
+        double time; ///< Time at which the vehicle applies it [ms].
+        double thrust, yaw, pitch, roll;
+    };
+
+    /// Starts the filter from a measurement.
+    void initialize(double time, const Matrix<ESTIMATOR_MEASUREMENTS_COUNT, 1> &measurement);
+
+    /// Get the command applied by the vehicle at the given time.
+    /// \param time the time [ms].
+    /// \return the command, or null if none is applied.
+    const Command* getCommand(double time) const;
+
+    /// Propagates a state and its covariance through the model.
+    /// \param x the state, at the time from.
+    /// \param p the covariance of the state.
+    /// \param from start time [ms].
+    /// \param to end time [ms].
+    void propagate(StateVector &x, StateMatrix &p, double from, double to) const;
+
+    bool initialized;
+    double measurementTime;
+    int rejectedCount;
+    StateVector state;
+    StateMatrix covariance;
+
+    // Commands, in a ring buffer.
+    Command commands[ESTIMATOR_COMMANDS_COUNT];
+    int commandsCount, newestCommand;
+};
+
+#endif // STATEESTIMATOR_H
@@ -0,0 +1,200 @@
+#include "telemetrycodec.h"
+
+#include <cmath>
+
+const double CODEC_CHANNEL_SCALES[CODEC_CHANNELS_COUNT] =
+{
+    1.0, // Phone time [ms].
+    100.0, 100.0, 100.0, // Yaw, target and regulator output [1/100 deg].
+    100.0, 100.0, 100.0, // Pitch.
+    100.0, 100.0, 100.0, // Roll.
+    1000.0, // Battery voltage [mV].
+    10.0, // Temperature [1/10 deg C].
+    1.0, // Regulators state.
+    100.0, 100.0, 100.0, // Altitude, target and regulator output [cm].
+    100.0, 100.0 // Position estimates [cm].
+};
+
+/// Largest quantized value, so the differences can't overflow.
+static const double MAX_QUANTIZED_VALUE = 1e15;
+
+/// Converts a value to fixed-point.
+static int64_t quantize(double value, int channel)
+{
+    double scaled = value * CODEC_CHANNEL_SCALES[channel];
+
+    if(std::isnan(scaled))
+        return 0;
+    else if(scaled > MAX_QUANTIZED_VALUE)
+        return (int64_t)MAX_QUANTIZED_VALUE;
+    else if(scaled < -MAX_QUANTIZED_VALUE)
+        return -(int64_t)MAX_QUANTIZED_VALUE;
+    else
+        return (int64_t)std::floor(scaled + 0.5);
+}
+
+/// Writes a zigzag-encoded varint.
+/// \return the number of written bytes.
+static int writeVarint(int64_t value, uint8_t *buffer)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    int size = 0;
+
+    while(zigzag >= 0x80)
+    {
+        buffer[size++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+
+    buffer[size++] = (uint8_t)zigzag;
+
+    return size;
+}
+
+/// Reads a zigzag-encoded varint.
+/// \return the number of read bytes, or 0 if the varint is truncated or too
+/// long.
+static int readVarint(const uint8_t *buffer, int size, int64_t &value)
+{
+    uint64_t zigzag = 0;
+
+    for(int i=0; i<size && i<10; i++)
+    {
+        zigzag |= (uint64_t)(buffer[i] & 0x7f) << (7*i);
+
+        if((buffer[i] & 0x80) == 0)
+        {
+            value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+TelemetryEncoder::TelemetryEncoder()
+{
+    for(int i=0; i<CODEC_CHANNELS_COUNT; i++)
+        reference[i] = 0;
+
+    sequence = 0;
+    framesSinceKeyframe = 0;
+    keyframeRequested = true;
+}
+
+void TelemetryEncoder::requestKeyframe()
+{
+    keyframeRequested = true;
+}
+
+int TelemetryEncoder::encode(const double *values, bool hasPosition, uint8_t *frame)
+{
+    bool keyframe = keyframeRequested || framesSinceKeyframe >= CODEC_KEYFRAME_INTERVAL;
+    int channelsCount = hasPosition ? CODEC_CHANNELS_COUNT : CODEC_MANDATORY_CHANNELS_COUNT;
+
+    if(keyframe)
+    {
+        keyframeRequested = false;
+        framesSinceKeyframe = 0;
+
+        // A keyframe without the position resets its reference, as the
+        // decoder.
+        if(!hasPosition)
+        {
+            for(int i=CODEC_MANDATORY_CHANNELS_COUNT; i<CODEC_CHANNELS_COUNT; i++)
+                reference[i] = 0;
+        }
+    }
+
+    frame[0] = (keyframe ? CODEC_FLAG_KEYFRAME : 0) | (hasPosition ? CODEC_FLAG_POSITION : 0);
+    frame[1] = ++sequence;
+    int size = 2;
+
+    for(int i=0; i<channelsCount; i++)
+    {
+        int64_t quantized = quantize(values[i], i);
+        size += writeVarint(keyframe ? quantized : quantized - reference[i], frame + size);
+        reference[i] = quantized;
+    }
+
+    framesSinceKeyframe++;
+
+    return size;
+}
+
+TelemetryDecoder::TelemetryDecoder()
+{
+    reset();
+}
+
+void TelemetryDecoder::reset()
+{
+    for(int i=0; i<CODEC_CHANNELS_COUNT; i++)
+        reference[i] = 0;
+
+    lastSequence = 0;
+    hasReference = false;
+}
+
+TelemetryDecoder::Result TelemetryDecoder::decode(const uint8_t *frame, int size, double *values)
+{
+    if(size < 2 || (frame[0] & ~(CODEC_FLAG_KEYFRAME | CODEC_FLAG_POSITION)) != 0)
+        return DECODE_INVALID;
+
+    bool keyframe = (frame[0] & CODEC_FLAG_KEYFRAME) != 0;
+    bool hasPosition = (frame[0] & CODEC_FLAG_POSITION) != 0;
+    uint8_t sequence = frame[1];
+
+    // The differences only apply to the previous frame.
+    if(!keyframe && (!hasReference || sequence != (uint8_t)(lastSequence + 1)))
+    {
+        hasReference = false;
+        return DECODE_NO_REFERENCE;
+    }
+
+    int channelsCount = hasPosition ? CODEC_CHANNELS_COUNT : CODEC_MANDATORY_CHANNELS_COUNT;
+    int64_t decoded[CODEC_CHANNELS_COUNT];
+    int offset = 2;
+
+    for(int i=0; i<CODEC_CHANNELS_COUNT; i++)
+    {
+        if(i >= channelsCount)
+        {
+            decoded[i] = keyframe ? 0 : reference[i];
+            continue;
+        }
+
+        int64_t value;
+        int varintSize = readVarint(frame + offset, size - offset, value);
+
+        if(varintSize == 0)
+        {
+            hasReference = false;
+            return DECODE_INVALID;
+        }
+
+        offset += varintSize;
+        decoded[i] = keyframe ? value : (int64_t)((uint64_t)reference[i] + (uint64_t)value);
+    }
+
+    if(offset != size)
+    {
+        hasReference = false;
+        return DECODE_INVALID;
+    }
+
+    for(int i=0; i<CODEC_CHANNELS_COUNT; i++)
+    {
+        reference[i] = decoded[i];
+
+        if(i < channelsCount)
+            values[i] = decoded[i] / CODEC_CHANNEL_SCALES[i];
+        else
+            values[i] = NAN;
+    }
+
+    lastSequence = sequence;
+    hasReference = true;
+
+    return DECODE_OK;
+}
@@ -0,0 +1,116 @@
+/*!
+* \file telemetrycodec.h
+* \brief Compact binary encoding of the telemetry states.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* This file does not depend on Qt, so the benchmark (TelemetryCodecBench) can
+* be built without it.
+*/
+
+#ifndef TELEMETRYCODEC_H
+#define TELEMETRYCODEC_H
+
+#include <stdint.h>
+
+/// Number of channels of a state, in the order of TelemetryChannel. The two
+/// last ones (position estimates) are optional.
+const int CODEC_CHANNELS_COUNT = 18;
+
+/// Number of channels always sent, before the position estimates.
+const int CODEC_MANDATORY_CHANNELS_COUNT = 16;
+
+/// Maximum size of an encoded state: the header, and a varint of at most 10
+/// bytes per channel [bytes].
+const int CODEC_MAX_FRAME_SIZE = 2 + CODEC_CHANNELS_COUNT*10;
+
+/// Number of states between two keyframes. A lost state costs at most this
+/// number of states, if the keyframe request is lost too.
+const int CODEC_KEYFRAME_INTERVAL = 50;
+
+/// Header flags of a frame.
+const uint8_t CODEC_FLAG_KEYFRAME = 0x01; ///< The values are absolute.
+const uint8_t CODEC_FLAG_POSITION = 0x02; ///< The position estimates are sent.
+
+/// Fixed-point scale of each channel: the value is sent as the nearest
+/// integer of value*scale. Must match TelemetryEncoder.java.
+extern const double CODEC_CHANNEL_SCALES[CODEC_CHANNELS_COUNT];
+
+/// Encoder of the COMPACT_STATE messages. The phone has its own
+/// (TelemetryEncoder.java), this one is the reference for the benchmark.
+///
+/// A frame is a header, then a varint per channel:
+/// - flags (uint8, CODEC_FLAG_*), then sequence number (uint8), incremented
+///   for each frame.
+/// - for a keyframe, each value is the quantized value (see
+///   CODEC_CHANNEL_SCALES). Otherwise, it is the difference with the
+///   quantized value of the previous frame. Both are zigzag-encoded (0, -1,
+///   1, -2... become 0, 1, 2, 3...), then written as varints (7 bits per
+///   byte, least significant first, the high bit set if more bytes follow).
+/// - the position channels are only present if CODEC_FLAG_POSITION is set.
+///   When absent, their reference value does not change.
+///
+/// Most channels move slowly between two states, so most differences fit in
+/// a single byte.
+class TelemetryEncoder
+{
+public:
+    /// Constructor. The first frame is a keyframe.
+    TelemetryEncoder();
+
+    /// Makes the next frame a keyframe, e.g. for a new connection.
+    void requestKeyframe();
+
+    /// Encodes a state.
+    /// \param values the CODEC_CHANNELS_COUNT values. NaN values are sent as 0.
+    /// \param hasPosition true to send the position estimates.
+    /// \param frame buffer of at least CODEC_MAX_FRAME_SIZE bytes, set to the
+    /// frame.
+    /// \return the size of the frame [bytes].
+    int encode(const double *values, bool hasPosition, uint8_t *frame);
+
+private:
+    int64_t reference[CODEC_CHANNELS_COUNT];
+    uint8_t sequence;
+    int framesSinceKeyframe;
+    bool keyframeRequested;
+};
+
+/// Decoder of the COMPACT_STATE messages of a phone.
+/// The frames must be decoded in order: a frame missing (replaced by a newer
+/// state on the phone, or lost with a previous link) breaks the sequence, and
+/// the following frames are rejected until the next keyframe.
+class TelemetryDecoder
+{
+public:
+    /// Outcome of a decoding.
+    enum Result
+    {
+        DECODE_OK=0, ///< The values are valid.
+        DECODE_INVALID, ///< Malformed frame.
+        DECODE_NO_REFERENCE ///< Difference frame after a missing frame: a keyframe is needed.
+    };
+
+    /// Constructor. A keyframe is needed first.
+    TelemetryDecoder();
+
+    /// Forgets the reference values, e.g. for a new connection. A keyframe is
+    /// needed.
+    void reset();
+
+    /// Decodes a frame.
+    /// \param frame the frame.
+    /// \param size the size of the frame [bytes].
+    /// \param values set to the CODEC_CHANNELS_COUNT values, if the frame is
+    /// valid. The position estimates are NaN if they were not sent.
+    /// \return the outcome.
+    Result decode(const uint8_t *frame, int size, double *values);
+
+private:
+    int64_t reference[CODEC_CHANNELS_COUNT];
+    uint8_t lastSequence;
+    bool hasReference;
+};
+
+#endif // TELEMETRYCODEC_H
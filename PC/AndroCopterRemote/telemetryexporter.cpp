@@ -0,0 +1,249 @@
+#include "telemetryexporter.h"
+#include "constants.h"
+
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstring>
+
+/// Names of the exported columns, after the ground time: the telemetry
+/// channels, in the order of TelemetryChannel, then the sent commands, in the
+/// order of SentCommand.
+static const char* COLUMN_NAMES[TM_CHANNELS_COUNT + CMD_COUNT] =
+{
+    "phone_time_ms", "yaw", "target_yaw", "yaw_command", "pitch",
+    "target_pitch", "pitch_command", "roll", "target_roll", "roll_command",
+    "battery_voltage", "temperature", "regulator_state", "altitude",
+    "target_altitude", "altitude_command", "position_x", "position_y",
+    "sync_time_ms", "link_delay_ms",
+    "sent_thrust", "sent_yaw", "sent_pitch", "sent_roll"
+};
+
+/// Name of the time column.
+static const char* TIME_COLUMN_NAME = "ground_time_ms";
+
+/// Appends a 32-bit integer to a buffer.
+static void appendInt32(QByteArray &buffer, qint32 value)
+{
+    buffer.append((const char*)&value, sizeof(value));
+}
+
+/// Appends a 64-bit integer to a buffer.
+static void appendInt64(QByteArray &buffer, qint64 value)
+{
+    buffer.append((const char*)&value, sizeof(value));
+}
+
+TelemetryExporter::TelemetryExporter(DiskWriter &diskWriter) :
+    diskWriter(diskWriter)
+{
+    opened = false;
+    csvStream = 0;
+    columnarStream = 0;
+    csvPendingRows = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    // Reserve the memory of a whole block of rows.
+    blockTimes.reserve(TELEMETRY_EXPORT_BLOCK_ROWS);
+
+    for(int c=0; c<TM_CHANNELS_COUNT + CMD_COUNT; c++)
+        blockColumns[c].reserve(TELEMETRY_EXPORT_BLOCK_ROWS);
+}
+
+TelemetryExporter::~TelemetryExporter()
+{
+    close();
+}
+
+void TelemetryExporter::open(const QString &baseFilename)
+{
+    close();
+
+    csvStream = diskWriter.openStream(baseFilename + ".csv", DiskWriter::STREAM_PREALLOCATE);
+    columnarStream = diskWriter.openStream(baseFilename + ".tmc", DiskWriter::STREAM_PREALLOCATE);
+    opened = true;
+
+    // Headers.
+    QByteArray csvHeader = TIME_COLUMN_NAME;
+    QByteArray columnarHeader(COLUMNAR_FILE_MAGIC, 4);
+    appendInt32(columnarHeader, COLUMNAR_FILE_VERSION);
+    appendInt32(columnarHeader, 1 + TM_CHANNELS_COUNT + CMD_COUNT);
+    appendInt32(columnarHeader, (qint32)strlen(TIME_COLUMN_NAME));
+    columnarHeader.append(TIME_COLUMN_NAME);
+
+    for(int c=0; c<TM_CHANNELS_COUNT + CMD_COUNT; c++)
+    {
+        csvHeader += ',';
+        csvHeader += COLUMN_NAMES[c];
+
+        appendInt32(columnarHeader, (qint32)strlen(COLUMN_NAMES[c]));
+        columnarHeader.append(COLUMN_NAMES[c]);
+    }
+
+    csvHeader += '\n';
+
+    write(csvStream, csvHeader, stats.csvBytes);
+    write(columnarStream, columnarHeader, stats.columnarBytes);
+}
+
+void TelemetryExporter::close()
+{
+    if(!opened)
+        return;
+
+    flushCsv();
+    flushColumnarBlock();
+
+    diskWriter.closeStream(csvStream);
+    diskWriter.closeStream(columnarStream);
+    opened = false;
+}
+
+void TelemetryExporter::addRow(qint64 groundTime, const double *values,
+                               const double *commands)
+{
+    if(!opened)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // CSV line. The missing values (NaN) are left empty.
+    csvPending += QByteArray::number(groundTime);
+
+    for(int c=0; c<TM_CHANNELS_COUNT + CMD_COUNT; c++)
+    {
+        double value = (c < TM_CHANNELS_COUNT) ? values[c] : commands[c - TM_CHANNELS_COUNT];
+
+        csvPending += ',';
+
+        if(!std::isnan(value))
+            csvPending += QByteArray::number(value, 'g', 10);
+    }
+
+    csvPending += '\n';
+    csvPendingRows++;
+
+    qint64 csvNs = timer.nsecsElapsed();
+    stats.csvEncodingNs += csvNs;
+
+    // Columnar block.
+    blockTimes.append(groundTime);
+
+    for(int c=0; c<TM_CHANNELS_COUNT; c++)
+        blockColumns[c].append(values[c]);
+
+    for(int c=0; c<CMD_COUNT; c++)
+        blockColumns[TM_CHANNELS_COUNT + c].append(commands[c]);
+
+    stats.rowsCount++;
+    stats.columnarEncodingNs += timer.nsecsElapsed() - csvNs;
+
+    if(csvPendingRows >= TELEMETRY_EXPORT_CSV_FLUSH_ROWS)
+        flushCsv();
+
+    if(blockTimes.size() >= TELEMETRY_EXPORT_BLOCK_ROWS)
+        flushColumnarBlock();
+}
+
+TelemetryExportStats TelemetryExporter::getStats() const
+{
+    return stats;
+}
+
+void TelemetryExporter::flushCsv()
+{
+    if(csvPending.isEmpty())
+        return;
+
+    write(csvStream, csvPending, stats.csvBytes);
+    csvPending.clear();
+    csvPendingRows = 0;
+}
+
+void TelemetryExporter::flushColumnarBlock()
+{
+    int rows = blockTimes.size();
+
+    if(rows == 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The header is completed once the size of the columns is known.
+    QByteArray block(COLUMNAR_BLOCK_MAGIC, 4);
+    appendInt32(block, rows);
+    appendInt64(block, blockTimes.first());
+    appendInt64(block, blockTimes.last());
+    appendInt32(block, 0);
+
+    // Time column: the first time, then the differences.
+    QVector<quint64> words(rows);
+
+    for(int i=0; i<rows; i++)
+        words[i] = (quint64)(blockTimes[i] - (i > 0 ? blockTimes[i-1] : 0));
+
+    appendColumn(block, COLUMN_DELTA_INT64, words.constData(), rows, shuffleBuffer);
+
+    // Values columns: the first value, then the XOR with the previous one.
+    for(int c=0; c<TM_CHANNELS_COUNT + CMD_COUNT; c++)
+    {
+        quint64 previous = 0;
+
+        for(int i=0; i<rows; i++)
+        {
+            quint64 bits;
+            memcpy(&bits, &blockColumns[c][i], sizeof(bits));
+            words[i] = bits ^ previous;
+            previous = bits;
+        }
+
+        appendColumn(block, COLUMN_XOR_DOUBLE, words.constData(), rows, shuffleBuffer);
+    }
+
+    qint32 columnsSize = block.size() - COLUMNAR_BLOCK_HEADER_SIZE;
+    memcpy(block.data() + COLUMNAR_BLOCK_HEADER_SIZE - sizeof(qint32),
+           &columnsSize, sizeof(columnsSize));
+
+    stats.columnarEncodingNs += timer.nsecsElapsed();
+
+    write(columnarStream, block, stats.columnarBytes);
+
+    // Keep the reserved memory for the next block.
+    blockTimes.resize(0);
+
+    for(int c=0; c<TM_CHANNELS_COUNT + CMD_COUNT; c++)
+        blockColumns[c].resize(0);
+}
+
+void TelemetryExporter::appendColumn(QByteArray &block, ColumnEncoding encoding,
+                                     const quint64 *words, int count,
+                                     QVector<char> &shuffleBuffer)
+{
+    // Regroup the bytes by significance: the most significant bytes of the
+    // differences are mostly zeros, which compresses well.
+    int size = count * (int)sizeof(quint64);
+
+    if(shuffleBuffer.size() < size)
+        shuffleBuffer.resize(size);
+
+    for(int i=0; i<count; i++)
+    {
+        for(int b=0; b<(int)sizeof(quint64); b++)
+            shuffleBuffer[b * count + i] = (char)(words[i] >> (8 * b));
+    }
+
+    QByteArray compressed = qCompress((const uchar*)shuffleBuffer.constData(), size);
+
+    appendInt32(block, encoding);
+    appendInt32(block, compressed.size());
+    block.append(compressed);
+}
+
+void TelemetryExporter::write(int streamId, const QByteArray &data, qint64 &bytesCounter)
+{
+    if(diskWriter.appendStream(streamId, data))
+        bytesCounter += data.size();
+    else
+        stats.droppedCount++;
+}
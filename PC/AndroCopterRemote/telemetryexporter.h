@@ -0,0 +1,137 @@
+/*!
+* \file telemetryexporter.h
+* \brief Streaming export of the telemetry to CSV and columnar files.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef TELEMETRYEXPORTER_H
+#define TELEMETRYEXPORTER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "diskwriter.h"
+#include "telemetrystore.h"
+
+/// Identifies the columnar file, and a block of rows in it.
+const char COLUMNAR_FILE_MAGIC[4] = {'T', 'M', 'C', 'F'};
+const char COLUMNAR_BLOCK_MAGIC[4] = {'T', 'M', 'C', 'B'};
+
+/// Version of the columnar file layout. The version 2 did not have the
+/// channels derived by the ground station (TM_SYNC_TIME, TM_LINK_DELAY).
+const qint32 COLUMNAR_FILE_VERSION = 3;
+
+/// Size of a block header in the columnar file.
+const int COLUMNAR_BLOCK_HEADER_SIZE = 4 + 4 + 8 + 8 + 4;
+
+/// Commands sent to the phone, exported with each telemetry row.
+enum SentCommand
+{
+    CMD_THRUST=0, ///< Mean thrust.
+    CMD_YAW, ///< Target yaw angle [deg].
+    CMD_PITCH, ///< Target pitch angle [deg].
+    CMD_ROLL, ///< Target roll angle [deg].
+    CMD_COUNT ///< Number of commands, not a command.
+};
+
+/// Counters of an export, to measure its cost.
+struct TelemetryExportStats
+{
+    qint64 rowsCount; ///< Number of exported rows.
+    qint64 csvBytes; ///< Size of the CSV file.
+    qint64 columnarBytes; ///< Size of the columnar file.
+    qint64 csvEncodingNs; ///< Time spent formatting the CSV lines [ns].
+    qint64 columnarEncodingNs; ///< Time spent gathering and compressing the columnar blocks [ns].
+    qint64 droppedCount; ///< Pieces of file rejected by the disk writer.
+};
+
+/// Streaming export of the telemetry of a vehicle, for the analysis tools.
+/// Each row is the ground time, the telemetry channels (the values of the
+/// CURRENT_STATE message, then the derived ones), and the latest commands
+/// sent to the phone. The rows are written to two files,
+/// through the DiskWriter, so the GUI thread never waits for the disk:
+/// - a CSV file, with a header line, flushed every few rows.
+/// - a columnar binary file (.tmc), made of blocks of rows. In a block, each
+/// column is stored separately and compressed (zlib): the time is
+/// delta-encoded, and each value is XORed with the previous one of its
+/// column, then the bytes are regrouped by significance. Slowly varying
+/// values then give long runs of zeros.
+///
+/// Columnar file layout (native endianness):
+/// - "TMCF", version (int32), number of columns (int32), then for each
+/// column its name (int32 length, then Latin-1 characters).
+/// - blocks: "TMCB", number of rows (int32), times of the first and of the
+/// last rows (int64), size of the columns (int32), then for each column its
+/// encoding (int32, see ColumnEncoding), its size (int32) and its data, as
+/// produced by qCompress(). The blocks can be skipped without decoding them.
+class TelemetryExporter
+{
+public:
+    /// Encoding of a column of the columnar file.
+    enum ColumnEncoding
+    {
+        COLUMN_DELTA_INT64=1, ///< Differences of int64 values, shuffled.
+        COLUMN_XOR_DOUBLE ///< XOR of consecutive doubles, shuffled.
+    };
+
+    /// Constructor.
+    /// \param diskWriter the writer of the files. It must outlive the
+    /// exporter.
+    explicit TelemetryExporter(DiskWriter &diskWriter);
+
+    /// Destructor. Writes the pending rows and closes the files.
+    ~TelemetryExporter();
+
+    /// Starts the export. The files are replaced if they exist.
+    /// \param baseFilename name of the files, without the extension.
+    void open(const QString &baseFilename);
+
+    /// Writes the pending rows and closes the files.
+    void close();
+
+    /// Adds a row to the export. Does nothing if the export is not open.
+    /// \param groundTime time of the row, in the ground station clock [ms].
+    /// \param values the TM_CHANNELS_COUNT values of the telemetry.
+    /// \param commands the CMD_COUNT latest commands sent.
+    void addRow(qint64 groundTime, const double *values, const double *commands);
+
+    /// Get the counters of the export.
+    /// \return a copy of the counters.
+    TelemetryExportStats getStats() const;
+
+private:
+    /// Writes the pending CSV lines.
+    void flushCsv();
+
+    /// Encodes the pending rows as a block of the columnar file, and writes
+    /// it.
+    void flushColumnarBlock();
+
+    /// Encodes a column of 64-bit words, and appends it to the block.
+    static void appendColumn(QByteArray &block, ColumnEncoding encoding,
+                             const quint64 *words, int count,
+                             QVector<char> &shuffleBuffer);
+
+    /// Queues data to a stream of the disk writer, and counts it.
+    void write(int streamId, const QByteArray &data, qint64 &bytesCounter);
+
+    DiskWriter &diskWriter;
+    bool opened;
+    int csvStream, columnarStream;
+
+    // Pending CSV lines.
+    QByteArray csvPending;
+    int csvPendingRows;
+
+    // Pending rows of the columnar file, one vector per column.
+    QVector<qint64> blockTimes;
+    QVector<double> blockColumns[TM_CHANNELS_COUNT + CMD_COUNT];
+    QVector<char> shuffleBuffer;
+
+    TelemetryExportStats stats;
+};
+
+#endif // TELEMETRYEXPORTER_H
@@ -0,0 +1,35 @@
+#include "telemetryhandoff.h"
+
+TelemetryHandoff::TelemetryHandoff(int capacity, QObject *parent) :
+    QObject(parent), queue(capacity)
+{
+}
+
+bool TelemetryHandoff::push(int vehicleId, int type, const QByteArray &data)
+{
+    ReceivedTelemetry telemetry;
+    telemetry.vehicleId = vehicleId;
+    telemetry.type = type;
+    telemetry.data = data;
+
+    if(!queue.tryPush(telemetry))
+        return false;
+
+    // Notify the GUI thread, unless a notification is already pending. The
+    // flag is cleared before the queue is drained, so a message pushed during
+    // the drain is either popped, or notified again.
+    if(drainScheduled.testAndSetOrdered(0, 1))
+        emit available();
+
+    return true;
+}
+
+void TelemetryHandoff::startDrain()
+{
+    drainScheduled.fetchAndStoreOrdered(0);
+}
+
+bool TelemetryHandoff::pop(ReceivedTelemetry &telemetry)
+{
+    return queue.tryPop(telemetry);
+}
@@ -0,0 +1,68 @@
+/*!
+* \file telemetryhandoff.h
+* \brief Queue of the telemetry messages, from the I/O threads to the GUI.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef TELEMETRYHANDOFF_H
+#define TELEMETRYHANDOFF_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QByteArray>
+
+#include "lockfree.h"
+
+/// Telemetry message received from a vehicle.
+struct ReceivedTelemetry
+{
+    int vehicleId; ///< Identifier of the vehicle.
+    int type; ///< Type of the message (CURRENT_STATE or COMPACT_STATE).
+    QByteArray data; ///< Content of the message.
+};
+
+/// Hands the telemetry messages over from the I/O threads to the GUI thread.
+/// The messages are pushed in a lock-free queue (MpscQueue), instead of
+/// posting an event for each of them: available() is only emitted when the
+/// queue was drained, so a burst of messages costs a single event, and the
+/// GUI thread processes them all at once.
+///
+/// The GUI thread must call startDrain(), then pop() until it returns false.
+class TelemetryHandoff : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// \param capacity maximum number of messages waiting for the GUI thread.
+    /// \param parent parent object.
+    explicit TelemetryHandoff(int capacity, QObject *parent = 0);
+
+    /// Adds a message. Can be called from any thread.
+    /// \param vehicleId identifier of the vehicle.
+    /// \param type type of the message (see MessageType).
+    /// \param data content of the message.
+    /// \return true if it has been added, false if the queue is full.
+    bool push(int vehicleId, int type, const QByteArray &data);
+
+    /// Must be called by the GUI thread when available() is received, before
+    /// the calls to pop().
+    void startDrain();
+
+    /// Removes the oldest message. Only the GUI thread may call it.
+    /// \param telemetry set to the message.
+    /// \return true if there was a message, false otherwise.
+    bool pop(ReceivedTelemetry &telemetry);
+
+signals:
+    /// Emitted when messages are available, and the GUI thread has not been
+    /// notified yet.
+    void available();
+
+private:
+    MpscQueue<ReceivedTelemetry> queue;
+    QAtomicInt drainScheduled;
+};
+
+#endif // TELEMETRYHANDOFF_H
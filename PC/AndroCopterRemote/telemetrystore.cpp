@@ -0,0 +1,130 @@
+#include "telemetrystore.h"
+
+TelemetryStore::TelemetryStore(int capacity)
+{
+    this->capacity = capacity;
+    head = 0;
+    count = 0;
+    appendedCount = 0;
+
+    // Preallocate all the columns, so that append() never allocates.
+    times.resize(capacity);
+
+    for(int i=0; i<TM_CHANNELS_COUNT; i++)
+        columns[i].resize(capacity);
+}
+
+void TelemetryStore::append(qint64 time, const double *values)
+{
+    // Make room for the new row, if needed, by dropping the oldest one.
+    if(count == capacity)
+    {
+        head = (head + 1) % capacity;
+        count--;
+    }
+
+    int i = physicalIndex(count);
+    times[i] = time;
+
+    for(int c=0; c<TM_CHANNELS_COUNT; c++)
+        columns[c][i] = values[c];
+
+    count++;
+    appendedCount++;
+}
+
+void TelemetryStore::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+int TelemetryStore::size() const
+{
+    return count;
+}
+
+qint64 TelemetryStore::totalCount() const
+{
+    return appendedCount;
+}
+
+qint64 TelemetryStore::firstSequence() const
+{
+    return appendedCount - count;
+}
+
+qint64 TelemetryStore::time(int index) const
+{
+    return times[physicalIndex(index)];
+}
+
+double TelemetryStore::value(int index, int channel) const
+{
+    return columns[channel][physicalIndex(index)];
+}
+
+qint64 TelemetryStore::latestTime() const
+{
+    if(count == 0)
+        return 0;
+    else
+        return times[physicalIndex(count-1)];
+}
+
+double TelemetryStore::latest(int channel) const
+{
+    if(count == 0)
+        return 0.0;
+    else
+        return columns[channel][physicalIndex(count-1)];
+}
+
+int TelemetryStore::lowerBound(qint64 time) const
+{
+    int first = 0;
+    int last = count;
+
+    while(first < last)
+    {
+        int middle = first + (last - first) / 2;
+
+        if(this->time(middle) < time)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+void TelemetryStore::range(qint64 from, qint64 to, int &firstIndex, int &rowsCount) const
+{
+    firstIndex = lowerBound(from);
+    rowsCount = lowerBound(to + 1) - firstIndex;
+}
+
+qint64 TelemetryStore::longestGap(qint64 from, qint64 to) const
+{
+    int first = lowerBound(from);
+    qint64 previous = (first > 0) ? time(first - 1) : from;
+    qint64 longest = 0;
+
+    for(int i=first; i<count && time(i) <= to; i++)
+    {
+        longest = qMax(longest, time(i) - previous);
+        previous = time(i);
+    }
+
+    return qMax(longest, to - previous);
+}
+
+int TelemetryStore::physicalIndex(int index) const
+{
+    int i = head + index;
+
+    if(i >= capacity)
+        i -= capacity;
+
+    return i;
+}
@@ -0,0 +1,130 @@
+/*!
+* \file telemetrystore.h
+* \brief In-memory time-series store of the telemetry received from the phone.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef TELEMETRYSTORE_H
+#define TELEMETRYSTORE_H
+
+#include <QVector>
+
+/// Telemetry channels. The order of the first ones matches the order of the
+/// words of the CURRENT_STATE message, the last ones are derived by the
+/// ground station.
+enum TelemetryChannel
+{
+    TM_PHONE_TIME=0, ///< Time in the phone clock [ms].
+    TM_YAW, ///< Current yaw angle [deg].
+    TM_TARGET_YAW, ///< Target yaw angle [deg].
+    TM_YAW_COMMAND, ///< Yaw regulator output.
+    TM_PITCH, ///< Current pitch angle [deg].
+    TM_TARGET_PITCH, ///< Target pitch angle [deg].
+    TM_PITCH_COMMAND, ///< Pitch regulator output.
+    TM_ROLL, ///< Current roll angle [deg].
+    TM_TARGET_ROLL, ///< Target roll angle [deg].
+    TM_ROLL_COMMAND, ///< Roll regulator output.
+    TM_BATTERY_VOLTAGE, ///< Battery voltage [V].
+    TM_TEMPERATURE, ///< Temperature [deg C].
+    TM_REGULATOR_STATE, ///< 1 if the regulators are enabled, 0 otherwise.
+    TM_ALTITUDE, ///< Current altitude [m].
+    TM_TARGET_ALTITUDE, ///< Target altitude [m].
+    TM_ALTITUDE_COMMAND, ///< Altitude regulator output.
+    TM_POSITION_X, ///< X position estimate [m], NaN if not sent.
+    TM_POSITION_Y, ///< Y position estimate [m], NaN if not sent.
+    TM_SYNC_TIME, ///< Creation time in the ground clock (see ClockSync) [ms], NaN if the clocks are not synchronized.
+    TM_LINK_DELAY, ///< One-way delay, from the creation to the reception [ms], NaN if unknown.
+    TM_CHANNELS_COUNT ///< Number of channels, not a channel.
+};
+
+/// Columnar time-series store of the telemetry.
+/// Each row is a telemetry sample, made of a time (in the ground station
+/// clock, always increasing) and of one value per channel. Each column is a
+/// preallocated ring buffer, so the memory use is bounded and appending a row
+/// never allocates. When the buffers are full, the oldest row is dropped: the
+/// whole flight is kept by the TelemetryExporter files.
+/// The rows in memory are indexed from 0 (oldest) to size()-1 (newest).
+class TelemetryStore
+{
+public:
+    /// Constructor.
+    /// \param capacity maximum number of rows kept in memory.
+    explicit TelemetryStore(int capacity);
+
+    /// Add a row at the end of the store.
+    /// \param time time of the sample in the ground station clock [ms]. It
+    /// should not be lower than the time of the previous row.
+    /// \param values the TM_CHANNELS_COUNT values of the row.
+    void append(qint64 time, const double *values);
+
+    /// Removes all the rows.
+    void clear();
+
+    /// Get the number of rows in memory.
+    /// \return the number of rows.
+    int size() const;
+
+    /// Get the number of rows appended since the creation of the store. This
+    /// is also the sequence number the next row will get.
+    /// \return the number of rows.
+    qint64 totalCount() const;
+
+    /// Get the sequence number of the oldest row in memory (index 0).
+    /// \return the sequence number.
+    qint64 firstSequence() const;
+
+    /// Get the time of the given row.
+    /// \param index index of the row, between 0 and size()-1.
+    /// \return the time [ms].
+    qint64 time(int index) const;
+
+    /// Get a value of the given row.
+    /// \param index index of the row, between 0 and size()-1.
+    /// \param channel the channel.
+    /// \return the value.
+    double value(int index, int channel) const;
+
+    /// Get the time of the newest row.
+    /// \return the time [ms], or 0 if the store is empty.
+    qint64 latestTime() const;
+
+    /// Get the newest value of the given channel.
+    /// \param channel the channel.
+    /// \return the value, or 0 if the store is empty.
+    double latest(int channel) const;
+
+    /// Find the first row which is not older than the given time (binary
+    /// search).
+    /// \param time the time [ms].
+    /// \return the index of the row, or size() if all rows are older.
+    int lowerBound(qint64 time) const;
+
+    /// Find the rows whose time is in the given range.
+    /// \param from beginning of the range [ms].
+    /// \param to end of the range (included) [ms].
+    /// \param firstIndex set to the index of the first row of the range.
+    /// \param rowsCount set to the number of rows in the range.
+    void range(qint64 from, qint64 to, int &firstIndex, int &rowsCount) const;
+
+    /// Get the longest interval without any row, in the given range. The
+    /// intervals overlapping the beginning or the end of the range count.
+    /// Used to measure how long the telemetry was delayed (e.g. by a large
+    /// transfer).
+    /// \param from beginning of the range [ms].
+    /// \param to end of the range [ms], usually the current time.
+    /// \return the interval [ms].
+    qint64 longestGap(qint64 from, qint64 to) const;
+
+private:
+    /// Converts an index (0 is the oldest row) to a position in the buffers.
+    int physicalIndex(int index) const;
+
+    QVector<qint64> times;
+    QVector<double> columns[TM_CHANNELS_COUNT];
+    int capacity, head, count;
+    qint64 appendedCount;
+};
+
+#endif // TELEMETRYSTORE_H
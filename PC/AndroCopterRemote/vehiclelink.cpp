@@ -0,0 +1,298 @@
+#include "vehiclelink.h"
+#include "constants.h"
+
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QDebug>
+#include <cstring>
+
+VehicleLink::VehicleLink(int vehicleId)
+{
+    this->vehicleId = vehicleId;
+    socket = 0;
+    inMessageSize = 0;
+    telemetryHandoff = 0;
+    telemetryMessageTypes = 0;
+    bufferPool = 0;
+    outboundTimer = 0;
+
+    commandsCount = 0;
+    heldCommand.sampleTime = 0;
+    heldCommand.sequence = 0;
+    heldCommandDeferred = false;
+    lastSentSequence = 0;
+    commandAgeBudget = COMMAND_AGE_BUDGET_MS;
+    memset(&stats, 0, sizeof(stats));
+    outboundClock.start();
+    sharedOutboundStats.store(outbound.getStats());
+}
+
+int VehicleLink::getVehicleId() const
+{
+    return vehicleId;
+}
+
+void VehicleLink::setTelemetryHandoff(TelemetryHandoff *handoff, quint32 messageTypes)
+{
+    telemetryHandoff = handoff;
+    telemetryMessageTypes = messageTypes;
+}
+
+void VehicleLink::setBufferPool(BufferPool *pool)
+{
+    bufferPool = pool;
+}
+
+void VehicleLink::setCommandAgeBudget(int budgetMs)
+{
+    commandAgeBudget = budgetMs;
+}
+
+void VehicleLink::queueCommand(const QString &text, qint64 sampleTime)
+{
+    commandsCount++;
+
+    PendingCommand command;
+    command.text = text;
+    command.sampleTime = sampleTime;
+    command.sequence = commandsCount;
+    latestCommand.write(command);
+
+    // Wake up the I/O thread, unless it has not processed the previous
+    // notification yet: it will then take this command instead.
+    if(commandFlushScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "flushCommand", Qt::QueuedConnection);
+}
+
+CommandStats VehicleLink::getCommandStats() const
+{
+    return sharedStats.load();
+}
+
+OutboundStats VehicleLink::getOutboundStats() const
+{
+    return sharedOutboundStats.load();
+}
+
+void VehicleLink::start(qintptr socketDescriptor)
+{
+    socket = new QTcpSocket(this);
+
+    if(!socket->setSocketDescriptor(socketDescriptor))
+    {
+        qDebug() << "VehicleLink: can't open the socket of vehicle" << vehicleId;
+        emit disconnected(vehicleId);
+        return;
+    }
+
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(onDataReceived()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(flushMessages()));
+
+    outboundTimer = new QTimer(this);
+    outboundTimer->setSingleShot(true);
+    connect(outboundTimer, SIGNAL(timeout()), this, SLOT(flushMessages()));
+
+    emit started(vehicleId, socket->peerAddress().toString() + ":" +
+                            QString::number(socket->peerPort()));
+}
+
+void VehicleLink::sendMessage(QString text)
+{
+    if(socket == 0 || !socket->isOpen())
+        return;
+
+    MessagePriority priority = outbound.enqueue(text, outboundClock.elapsed());
+
+    // The command waiting to be written is older than the safety message: it
+    // is dropped, so it can't undo it (counted as replaced).
+    if(priority == PRIORITY_SAFETY)
+    {
+        bool isNew;
+        const PendingCommand &latest = latestCommand.read(&isNew);
+
+        if(isNew)
+        {
+            heldCommand = latest;
+            heldCommandDeferred = false;
+        }
+
+        lastSentSequence = qMax(lastSentSequence, heldCommand.sequence);
+    }
+
+    flushMessages();
+}
+
+void VehicleLink::close()
+{
+    if(socket != 0)
+        socket->disconnectFromHost();
+}
+
+void VehicleLink::onDataReceived()
+{
+    while(socket != 0)
+    {
+        // Get the size of the message, if not acquired yet.
+        // The size is given by the first 32 bits (4 bytes) of the message.
+        if(inMessageSize == 0)
+        {
+            if(socket->bytesAvailable() < MESSAGE_SIZE_SIZE)
+                return; // The size has not been received entirely.
+            else
+            {
+                const QByteArray ba = socket->read(MESSAGE_SIZE_SIZE);
+
+                // Convert the received bytes to an int.
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(ba.data());
+                inMessageSize = ((bytes[0]<<24)|(bytes[1]<<16)|(bytes[2]<<8)|(bytes[3]));
+            }
+        }
+
+        // If the whole message arrived, it is now possible to read it.
+        if(socket->bytesAvailable() >= inMessageSize)
+        {
+            // The first byte is the signification of the message.
+            char typeByte = 0;
+            socket->getChar(&typeByte);
+            int type = typeByte;
+
+            // Read the rest of the message, and forward it to the GUI thread.
+            // If the handoff is full, the message still goes through the
+            // event loop, to not lose it.
+            QByteArray data;
+
+            if(bufferPool != 0)
+            {
+                data = bufferPool->acquire(inMessageSize-1);
+                socket->read(data.data(), inMessageSize-1);
+            }
+            else
+                data = socket->read(inMessageSize-1);
+
+            bool isTelemetry = type >= 0 && type < 32 && (telemetryMessageTypes & (1u << type)) != 0;
+
+            if(telemetryHandoff == 0 || !isTelemetry ||
+               !telemetryHandoff->push(vehicleId, type, data))
+            {
+                emit messageReceived(vehicleId, type, data);
+            }
+
+            // Ready to receive a new message.
+            inMessageSize = 0;
+        }
+        else
+            break;
+    }
+}
+
+void VehicleLink::onDisconnected()
+{
+    emit disconnected(vehicleId);
+}
+
+void VehicleLink::flushCommand()
+{
+    // Cleared before reading the command, so a command queued meanwhile is
+    // either read now, or notified again.
+    commandFlushScheduled.fetchAndStoreOrdered(0);
+    writeCommand();
+}
+
+void VehicleLink::flushMessages()
+{
+    if(socket == 0 || !socket->isOpen())
+        return;
+
+    qint64 now = outboundClock.elapsed();
+    QString text;
+
+    // The safety messages do not wait for the socket.
+    while(outbound.takeNext(now, PRIORITY_SAFETY, text))
+        writeMessage(text);
+
+    // Then the latest command, and the other messages by priority.
+    writeCommand();
+
+    while(socket->bytesToWrite() <= OUTBOUND_MAX_SOCKET_BACKLOG &&
+          outbound.takeNext(now, PRIORITY_BULK, text))
+    {
+        writeMessage(text);
+    }
+
+    // If the waiting messages are held by their rate limit, come back when
+    // it ends. If they are held by the socket, bytesWritten() will.
+    qint64 nextTime = outbound.getNextTime(now);
+
+    if(nextTime > now)
+        outboundTimer->start((int)(nextTime - now));
+
+    sharedOutboundStats.store(outbound.getStats());
+}
+
+void VehicleLink::writeMessage(const QString &text)
+{
+    socket->write((text + "\n").toLatin1());
+}
+
+void VehicleLink::writeCommand()
+{
+    if(socket == 0 || !socket->isOpen())
+        return;
+
+    // Take the latest command, the previous one is dropped if it has not
+    // been written.
+    bool isNew;
+    const PendingCommand &latest = latestCommand.read(&isNew);
+
+    if(isNew)
+    {
+        heldCommand = latest;
+        heldCommandDeferred = false;
+    }
+
+    if(heldCommand.sequence <= lastSentSequence)
+        return; // Already written.
+
+    // If the previous messages are still waiting in the socket, the link is
+    // congested: wait for them to be written (bytesWritten()).
+    if(socket->bytesToWrite() > COMMAND_MAX_SOCKET_BACKLOG)
+    {
+        if(!heldCommandDeferred)
+        {
+            stats.deferredCount++;
+            heldCommandDeferred = true;
+            sharedStats.store(stats);
+        }
+
+        return;
+    }
+
+    writeMessage(heldCommand.text);
+    lastSentSequence = heldCommand.sequence;
+
+    // Age of the command. Once started, the reference of the timer is the
+    // current time.
+    QElapsedTimer now;
+    now.start();
+    qint64 age = now.msecsSinceReference() - heldCommand.sampleTime;
+
+    if(stats.sentCount == 0)
+        stats.smoothedAgeMs = age;
+    else
+        stats.smoothedAgeMs = COMMAND_AGE_LPF * stats.smoothedAgeMs + (1.0 - COMMAND_AGE_LPF) * age;
+
+    stats.sentCount++;
+    stats.maxAgeMs = qMax(stats.maxAgeMs, age);
+
+    // The commands before this one that were not written have been replaced.
+    stats.supersededCount = (qint64)heldCommand.sequence - stats.sentCount;
+
+    if(age > commandAgeBudget)
+        stats.overBudgetCount++;
+
+    sharedStats.store(stats);
+}
@@ -0,0 +1,199 @@
+/*!
+* \file vehiclelink.h
+* \brief Network connection with one phone, running in an I/O thread.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef VEHICLELINK_H
+#define VEHICLELINK_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QByteArray>
+#include <QString>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "telemetryhandoff.h"
+#include "bufferpool.h"
+#include "lockfree.h"
+#include "outboundscheduler.h"
+
+/// Counters of the flight commands sent to a phone, to check their age.
+/// The age of a command is the time from the gamepad sample it was computed
+/// from, to its writing to the socket.
+struct CommandStats
+{
+    qint64 sentCount; ///< Number of commands written to the socket.
+    qint64 supersededCount; ///< Commands replaced by a newer one before being written.
+    qint64 deferredCount; ///< Commands held because the socket was congested.
+    qint64 overBudgetCount; ///< Commands older than the budget when written.
+    double smoothedAgeMs; ///< Age of the written commands, low-pass filtered [ms].
+    qint64 maxAgeMs; ///< Maximum age of a written command [ms].
+};
+
+/// Network connection with one phone.
+/// This object lives in an I/O thread of the GroundServer: it reads the
+/// socket, splits the stream into messages, and forwards them to the GUI
+/// thread with the messageReceived() signal. Its slots should be called with
+/// queued connections (or QMetaObject::invokeMethod()), from the GUI thread.
+/// The telemetry messages can instead be handed over through a
+/// TelemetryHandoff, see setTelemetryHandoff().
+///
+/// The flight commands are not queued as the other messages: only the latest
+/// one is kept (TripleBuffer), and it is only written if the socket is not
+/// congested, otherwise it waits for the socket, and may be replaced by a
+/// newer one ("latest wins"). So a congested link does not pile up outdated
+/// commands.
+///
+/// The other messages go through an OutboundScheduler: they are queued by
+/// priority class, and only written when the socket is not congested, so the
+/// urgent ones are not stuck behind the others. The safety messages (e.g.
+/// emergency stop) are written at once, before the queued messages and the
+/// waiting command.
+class VehicleLink : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// \param vehicleId identifier of the vehicle, unique for the
+    /// application.
+    explicit VehicleLink(int vehicleId);
+
+    /// Get the identifier of the vehicle.
+    /// \return the identifier.
+    int getVehicleId() const;
+
+    /// Forwards the messages of the given types through a TelemetryHandoff
+    /// instead of messageReceived(). Must be called before start().
+    /// \param handoff the handoff, which must outlive the link. If null, all
+    /// the messages are forwarded by messageReceived().
+    /// \param messageTypes types of the forwarded messages (see
+    /// MessageType): the bit (1 << type) is set for each type.
+    void setTelemetryHandoff(TelemetryHandoff *handoff, quint32 messageTypes);
+
+    /// Takes the buffers of the received messages from a pool, instead of
+    /// allocating them. The receiver should give them back with
+    /// BufferPool::release(). Must be called before start().
+    /// \param pool the pool, which must outlive the link.
+    void setBufferPool(BufferPool *pool);
+
+    /// Set the maximum age of the commands, to count the late ones. Must be
+    /// called before start().
+    /// \param budgetMs the maximum age [ms].
+    void setCommandAgeBudget(int budgetMs);
+
+    /// Sends a flight command to the phone, replacing the previous one if it
+    /// has not been written yet. Can be called from the GUI thread.
+    /// \param text the command message.
+    /// \param sampleTime time of the gamepad sample the command was computed
+    /// from, in the clock of QElapsedTimer::msecsSinceReference() [ms].
+    void queueCommand(const QString &text, qint64 sampleTime);
+
+    /// Get the counters of the sent commands. Can be called from any thread.
+    /// \return a copy of the counters.
+    CommandStats getCommandStats() const;
+
+    /// Get the counters of the queued messages, per priority class. Can be
+    /// called from any thread.
+    /// \return a copy of the counters.
+    OutboundStats getOutboundStats() const;
+
+signals:
+    /// Emitted when the connection is ready.
+    /// \param vehicleId identifier of the vehicle.
+    /// \param peerName address and port of the phone.
+    void started(int vehicleId, QString peerName);
+
+    /// Emitted when a whole message has been received.
+    /// \param vehicleId identifier of the vehicle.
+    /// \param type type of the message (see MessageType).
+    /// \param data useful content of the message.
+    void messageReceived(int vehicleId, int type, QByteArray data);
+
+    /// Emitted when the phone disconnected. The link can then be deleted.
+    /// \param vehicleId identifier of the vehicle.
+    void disconnected(int vehicleId);
+
+public slots:
+    /// Creates the socket from a descriptor accepted by the server. Must be
+    /// run in the I/O thread.
+    /// \param socketDescriptor native descriptor of the accepted connection.
+    void start(qintptr socketDescriptor);
+
+    /// Sends a message to the phone. It is queued according to its priority
+    /// (see OutboundScheduler), and written when the socket is not
+    /// congested. A safety message cancels the command waiting to be written.
+    /// \param text useful content of the message.
+    void sendMessage(QString text);
+
+    /// Closes the connection.
+    void close();
+
+private slots:
+    /// Processes the data received from the phone.
+    void onDataReceived();
+
+    /// Forwards the disconnection.
+    void onDisconnected();
+
+    /// Writes the latest command, if the socket is not congested.
+    void flushCommand();
+
+    /// Writes the safety messages, then the latest command and the queued
+    /// messages by priority, as long as the socket is not congested and
+    /// their rate limits allow it.
+    void flushMessages();
+
+private:
+    /// A command waiting to be written.
+    struct PendingCommand
+    {
+        QString text;
+        qint64 sampleTime;
+        quint64 sequence; ///< Number of the command, from 1. 0 if none.
+    };
+
+    /// Writes the command waiting to be written, if any, and if the socket
+    /// is not congested.
+    void writeCommand();
+
+    /// Writes a message to the socket.
+    /// \param text useful content of the message.
+    void writeMessage(const QString &text);
+
+    int vehicleId;
+
+    /// TCP socket. Sends and receives messages. Created in the I/O thread.
+    QTcpSocket* socket;
+
+    /// Size (in bytes) of the currently incomming message.
+    unsigned int inMessageSize;
+
+    TelemetryHandoff *telemetryHandoff;
+    quint32 telemetryMessageTypes;
+
+    BufferPool *bufferPool;
+
+    // Written by the GUI thread.
+    TripleBuffer<PendingCommand> latestCommand;
+    QAtomicInt commandFlushScheduled;
+    quint64 commandsCount;
+
+    // Used by the I/O thread.
+    PendingCommand heldCommand;
+    bool heldCommandDeferred;
+    quint64 lastSentSequence;
+    int commandAgeBudget;
+    CommandStats stats;
+    SeqLock<CommandStats> sharedStats;
+    OutboundScheduler outbound;
+    QElapsedTimer outboundClock;
+    QTimer *outboundTimer; ///< Wakes up the link when a rate limit ends.
+    SeqLock<OutboundStats> sharedOutboundStats;
+};
+
+#endif // VEHICLELINK_H
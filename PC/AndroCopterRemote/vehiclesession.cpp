@@ -0,0 +1,485 @@
+#include "vehiclesession.h"
+#include "constants.h"
+
+#include <QMetaObject>
+#include <QDateTime>
+#include <QStringList>
+#include <cmath>
+#include <cstring>
+
+static_assert(CODEC_CHANNELS_COUNT == TM_SYNC_TIME,
+              "The compact states must have all the channels of the CURRENT_STATE message.");
+
+/// Closes a link, and deletes it in its I/O thread.
+static void closeLink(VehicleLink *link)
+{
+    QMetaObject::invokeMethod(link, "close", Qt::QueuedConnection);
+    link->deleteLater();
+}
+
+VehicleSession::VehicleSession(VehicleLink *link, const QByteArray &token,
+                               const QList<double> &regulatorCoefficients,
+                               DiskWriter &diskWriter) :
+    telemetry(TELEMETRY_STORE_CAPACITY), exporter(diskWriter), diskWriter(diskWriter),
+    chunkReceiver(diskWriter)
+{
+    this->link = link;
+    this->token = token;
+    this->regulatorCoefficients = regulatorCoefficients;
+    id = link->getVehicleId();
+    suspendTime = 0;
+    memset(&lastCommandStats, 0, sizeof(lastCommandStats));
+    memset(&lastOutboundStats, 0, sizeof(lastOutboundStats));
+    fpvStream = 0;
+    fpvWrittenSize = 0;
+    fpvLastTime = 0;
+    awaitingBacklog = false;
+    backlogRequestTime = 0;
+    keyframeRequested = false;
+    telemetryDelay = NAN;
+
+    for(int i=0; i<CMD_COUNT; i++)
+        sentCommands[i] = 0.0;
+
+    QString date = QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss");
+    exporter.open(QString("../logs/telemetry(%1)_%2").arg(date).arg(getFileTag()));
+}
+
+VehicleSession::~VehicleSession()
+{
+    stopFpvRecording();
+    releaseHeldTelemetry();
+
+    if(link != 0)
+        closeLink(link);
+}
+
+int VehicleSession::getId() const
+{
+    return id;
+}
+
+int VehicleSession::getLinkId() const
+{
+    return (link != 0) ? link->getVehicleId() : 0;
+}
+
+QByteArray VehicleSession::getToken() const
+{
+    return token;
+}
+
+bool VehicleSession::isConnected() const
+{
+    return link != 0;
+}
+
+void VehicleSession::suspend(qint64 groundTime)
+{
+    if(link == 0)
+        return;
+
+    lastCommandStats = link->getCommandStats();
+    lastOutboundStats = link->getOutboundStats();
+    closeLink(link);
+    link = 0;
+    suspendTime = groundTime;
+
+    // A backlog requested by the previous link will never come.
+    releaseHeldTelemetry();
+}
+
+void VehicleSession::resume(VehicleLink *link, qint64 groundTime)
+{
+    if(this->link != 0)
+        closeLink(this->link);
+
+    this->link = link;
+
+    // The measurements of the previous link are meaningless for the new one.
+    linkMonitor = LinkMonitor();
+    fpvController.reset();
+
+    // The phone starts the new link with a keyframe.
+    telemetryDecoder.reset();
+    keyframeRequested = false;
+
+    // The estimate has drifted during the gap, and the commands were lost.
+    stateEstimator.reset();
+
+    // The phone kept its coefficients: only send the changes.
+    if(regulatorCoefficients != phoneRegulatorCoefficients)
+        setRegulatorCoefficients(regulatorCoefficients);
+
+    // Ask for the telemetry produced after the last received sample.
+    if(telemetry.size() > 0)
+    {
+        awaitingBacklog = true;
+        backlogRequestTime = groundTime;
+        sendMessage("telemetry_backlog " + QString::number(telemetry.latest(TM_PHONE_TIME), 'f', 0));
+    }
+
+    // The phone keeps the transfers until they are acknowledged.
+    foreach(const ChunkReceiver::Transfer &transfer, chunkReceiver.getIncompleteTransfers())
+        sendMessage(QString("chunk_resume %1 %2").arg(transfer.streamId).arg(transfer.receivedSize));
+}
+
+qint64 VehicleSession::getSuspendedDuration(qint64 groundTime) const
+{
+    return (link != 0) ? 0 : groundTime - suspendTime;
+}
+
+bool VehicleSession::parseState(const QByteArray &data, double *values)
+{
+    QStringList words = QString(data).split(' ');
+
+    // The two last words (x and y position estimates) are optional.
+    if(words.size() != 16 && words.size() != 18)
+        return false;
+
+    // The words are in the order of the channels.
+    for(int i=0; i<TM_CHANNELS_COUNT; i++)
+    {
+        if(i < words.size())
+            values[i] = words[i].toDouble();
+        else
+            values[i] = NAN;
+    }
+
+    return true;
+}
+
+TelemetryDecoder::Result VehicleSession::decodeCompactState(const QByteArray &data, double *values)
+{
+    TelemetryDecoder::Result result = telemetryDecoder.decode((const uint8_t*)data.constData(),
+                                                              data.size(), values);
+
+    // Ask once, the phone may also send one by itself.
+    if(result == TelemetryDecoder::DECODE_NO_REFERENCE && !keyframeRequested)
+    {
+        sendMessage("telemetry_keyframe");
+        keyframeRequested = true;
+    }
+    else if(result == TelemetryDecoder::DECODE_OK)
+        keyframeRequested = false;
+
+    for(int i=CODEC_CHANNELS_COUNT; i<TM_CHANNELS_COUNT; i++)
+        values[i] = NAN;
+
+    return result;
+}
+
+QString VehicleSession::getName() const
+{
+    QString name = QString("Vehicle %1").arg(getId());
+
+    if(!peerName.isEmpty())
+        name += QString(" (%1)").arg(peerName);
+
+    if(link == 0)
+        name += " - reconnecting";
+
+    return name;
+}
+
+void VehicleSession::setPeerName(const QString &peerName)
+{
+    this->peerName = peerName;
+}
+
+QString VehicleSession::getFileTag() const
+{
+    return QString("vehicle%1").arg(getId());
+}
+
+void VehicleSession::sendMessage(const QString &text)
+{
+    if(link == 0)
+        return;
+
+    QMetaObject::invokeMethod(link, "sendMessage", Qt::QueuedConnection,
+                              Q_ARG(QString, text));
+}
+
+void VehicleSession::sendCommand(double thrust, double yaw, double pitch, double roll,
+                                 qint64 sampleTime, qint64 groundTime)
+{
+    sentCommands[CMD_THRUST] = thrust;
+    sentCommands[CMD_YAW] = yaw;
+    sentCommands[CMD_PITCH] = pitch;
+    sentCommands[CMD_ROLL] = roll;
+
+    if(link == 0)
+        return;
+
+    link->queueCommand(QString("command ") + QString::number(thrust) + " "
+                       + QString::number(yaw) + " " + QString::number(pitch)
+                       + " " + QString::number(roll), sampleTime);
+
+    // The vehicle applies the command after the uplink delay. Until the
+    // clocks are synchronized, the delays are supposed symmetric.
+    double uplinkDelay = clockSync.getUplinkDelay();
+
+    if(std::isnan(uplinkDelay))
+        uplinkDelay = linkMonitor.hasRttEstimate() ? linkMonitor.getSmoothedRtt() / 2.0 : 0.0;
+
+    stateEstimator.addCommand(groundTime + uplinkDelay, thrust, yaw, pitch, roll);
+}
+
+CommandStats VehicleSession::getCommandStats() const
+{
+    return (link != 0) ? link->getCommandStats() : lastCommandStats;
+}
+
+OutboundStats VehicleSession::getOutboundStats() const
+{
+    return (link != 0) ? link->getOutboundStats() : lastOutboundStats;
+}
+
+void VehicleSession::addTelemetry(qint64 groundTime, const double *values)
+{
+    // Timestamp the sample in both clocks.
+    double row[TM_CHANNELS_COUNT];
+    memcpy(row, values, sizeof(row));
+
+    if(clockSync.isSynchronized())
+    {
+        row[TM_SYNC_TIME] = clockSync.phoneToGround(values[TM_PHONE_TIME]);
+        row[TM_LINK_DELAY] = (double)groundTime - row[TM_SYNC_TIME];
+
+        if(std::isnan(telemetryDelay))
+            telemetryDelay = row[TM_LINK_DELAY];
+        else
+            telemetryDelay = CLOCK_SYNC_DELAY_LPF * telemetryDelay + (1.0-CLOCK_SYNC_DELAY_LPF) * row[TM_LINK_DELAY];
+    }
+    else
+    {
+        row[TM_SYNC_TIME] = NAN;
+        row[TM_LINK_DELAY] = NAN;
+    }
+
+    values = row;
+
+    // The estimator needs the time the sample was taken.
+    double sampleTime = values[TM_SYNC_TIME];
+
+    if(std::isnan(sampleTime))
+        sampleTime = groundTime - (linkMonitor.hasRttEstimate() ? linkMonitor.getSmoothedRtt() / 2.0 : 0.0);
+
+    stateEstimator.addMeasurement(sampleTime, values[TM_YAW], values[TM_PITCH],
+                                  values[TM_ROLL], values[TM_ALTITUDE]);
+
+    // Give up the backlog if it does not come.
+    if(awaitingBacklog && groundTime - backlogRequestTime > SESSION_BACKLOG_TIMEOUT_MS)
+        releaseHeldTelemetry();
+
+    if(awaitingBacklog)
+    {
+        heldTimes.append(groundTime);
+
+        for(int c=0; c<TM_CHANNELS_COUNT; c++)
+            heldValues.append(values[c]);
+
+        // Export the commands as they were at the reception.
+        for(int c=0; c<CMD_COUNT; c++)
+            heldCommands.append(sentCommands[c]);
+
+        return;
+    }
+
+    telemetry.append(groundTime, values);
+    exporter.addRow(groundTime, values, sentCommands);
+}
+
+int VehicleSession::addTelemetryBacklog(const QByteArray &data, qint64 groundTime)
+{
+    if(!awaitingBacklog)
+        return 0;
+
+    // The missed samples are between the last stored sample and the first
+    // held one, both in the phone clock and in the ground clock.
+    double lastPhoneTime = telemetry.latest(TM_PHONE_TIME);
+    qint64 lastGroundTime = telemetry.latestTime();
+    double firstHeldPhoneTime = heldTimes.isEmpty() ? INFINITY : heldValues[TM_PHONE_TIME];
+    qint64 firstHeldGroundTime = heldTimes.isEmpty() ? groundTime : heldTimes.first();
+    double clockOffset = lastGroundTime - lastPhoneTime;
+
+    QList<QByteArray> lines = data.split('\n');
+    double values[TM_CHANNELS_COUNT];
+    int addedCount = 0;
+
+    // The commands received by the phone during the gap are unknown.
+    double unknownCommands[CMD_COUNT];
+
+    for(int c=0; c<CMD_COUNT; c++)
+        unknownCommands[c] = NAN;
+
+    foreach(const QByteArray &line, lines)
+    {
+        if(!parseState(line, values) || values[TM_PHONE_TIME] <= lastPhoneTime ||
+           values[TM_PHONE_TIME] >= firstHeldPhoneTime)
+        {
+            continue;
+        }
+
+        // Keep the rows in time order, even if the phone clock drifted.
+        qint64 time = (qint64)(values[TM_PHONE_TIME] + clockOffset);
+        time = qBound(lastGroundTime, time, firstHeldGroundTime);
+
+        if(clockSync.isSynchronized())
+            values[TM_SYNC_TIME] = clockSync.phoneToGround(values[TM_PHONE_TIME]);
+
+        telemetry.append(time, values);
+        exporter.addRow(time, values, unknownCommands);
+        lastPhoneTime = values[TM_PHONE_TIME];
+        lastGroundTime = time;
+        addedCount++;
+    }
+
+    releaseHeldTelemetry();
+
+    return addedCount;
+}
+
+void VehicleSession::addPong(const QByteArray &data, qint64 groundTime)
+{
+    PingTimes times;
+
+    if(linkMonitor.addPong(data, groundTime, &times) && !std::isnan(times.phoneTime))
+        clockSync.addPing(times.sentTime, times.phoneTime, times.receivedTime);
+}
+
+const ClockSync& VehicleSession::getClockSync() const
+{
+    return clockSync;
+}
+
+double VehicleSession::getTelemetryDelay() const
+{
+    return telemetryDelay;
+}
+
+const StateEstimator& VehicleSession::getStateEstimator() const
+{
+    return stateEstimator;
+}
+
+const TelemetryExporter& VehicleSession::getExporter() const
+{
+    return exporter;
+}
+
+TelemetryStore& VehicleSession::getTelemetry()
+{
+    return telemetry;
+}
+
+QList<double> VehicleSession::getRegulatorCoefficients() const
+{
+    return regulatorCoefficients;
+}
+
+void VehicleSession::setRegulatorCoefficients(const QList<double> &coefficients)
+{
+    regulatorCoefficients = coefficients;
+
+    if(link == 0)
+        return;
+
+    phoneRegulatorCoefficients = coefficients;
+
+    QString message = "regulator_coefs";
+
+    for(int i=0; i<regulatorCoefficients.size(); i++)
+        message += " " + QString::number(regulatorCoefficients[i]);
+
+    sendMessage(message);
+}
+
+FpvRateController& VehicleSession::getFpvController()
+{
+    return fpvController;
+}
+
+ChunkReceiver& VehicleSession::getChunkReceiver()
+{
+    return chunkReceiver;
+}
+
+LinkMonitor& VehicleSession::getLinkMonitor()
+{
+    return linkMonitor;
+}
+
+void VehicleSession::startFpvRecording(const QString &filename)
+{
+    stopFpvRecording();
+
+    fpvFilename = filename;
+    // A long recording, never read back while flying: keep it out of the page
+    // cache. The disk writer falls back to the normal writes if the file
+    // system does not support O_DIRECT.
+    fpvStream = diskWriter.openStream(filename, DiskWriter::STREAM_PREALLOCATE |
+                                                DiskWriter::STREAM_DIRECT);
+    fpvWrittenSize = 0;
+    fpvLastTime = 0;
+    fpvIndex.clear();
+}
+
+void VehicleSession::stopFpvRecording()
+{
+    if(fpvStream == 0)
+        return;
+
+    diskWriter.closeStream(fpvStream);
+    fpvStream = 0;
+
+    if(!fpvIndex.isEmpty())
+    {
+        diskWriter.writeFile(fpvFilename + ".idx",
+                             FlightArchive::makeIndexFile(fpvIndex, fpvWrittenSize, fpvLastTime));
+    }
+}
+
+void VehicleSession::recordFpvFrame(qint64 groundTime, const QByteArray &jpeg)
+{
+    if(fpvStream == 0)
+        return;
+
+    QByteArray frame = FlightArchive::tagVideoFrame(groundTime, jpeg);
+
+    // A frame rejected by the disk writer is simply missing from the file.
+    if(frame.isEmpty() || !diskWriter.appendStream(fpvStream, frame))
+        return;
+
+    // A point of the index every ARCHIVE_VIDEO_INDEX_STRIDE bytes.
+    if(fpvIndex.isEmpty() ||
+       fpvWrittenSize - fpvIndex.last().offset >= ARCHIVE_VIDEO_INDEX_STRIDE)
+    {
+        FlightArchive::IndexEntry entry;
+        entry.time = groundTime;
+        entry.offset = fpvWrittenSize;
+        fpvIndex.append(entry);
+    }
+
+    fpvWrittenSize += frame.size();
+    fpvLastTime = groundTime;
+}
+
+void VehicleSession::releaseHeldTelemetry()
+{
+    awaitingBacklog = false;
+
+    for(int i=0; i<heldTimes.size(); i++)
+    {
+        const double *values = heldValues.constData() + i * TM_CHANNELS_COUNT;
+        const double *commands = heldCommands.constData() + i * CMD_COUNT;
+
+        telemetry.append(heldTimes[i], values);
+        exporter.addRow(heldTimes[i], values, commands);
+    }
+
+    heldTimes.clear();
+    heldValues.clear();
+    heldCommands.clear();
+}
@@ -0,0 +1,279 @@
+/*!
+* \file vehiclesession.h
+* \brief State of the ground station for one connected quadcopter.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*/
+
+#ifndef VEHICLESESSION_H
+#define VEHICLESESSION_H
+
+#include <QString>
+#include <QList>
+
+#include "vehiclelink.h"
+#include "telemetrystore.h"
+#include "fpvratecontroller.h"
+#include "linkmonitor.h"
+#include "telemetryexporter.h"
+#include "diskwriter.h"
+#include "flightarchive.h"
+#include "chunkreceiver.h"
+#include "telemetrycodec.h"
+#include "clocksync.h"
+#include "stateestimator.h"
+
+/// State of the ground station for one connected quadcopter.
+/// The session lives in the GUI thread. It owns the telemetry store, the
+/// regulators coefficients, the FPV controller and recorder, and the link
+/// monitor of the vehicle, and sends the messages through the VehicleLink
+/// (which lives in an I/O thread). The telemetry and the sent commands are
+/// exported to files during the whole session, and the FPV frames can be
+/// recorded to an MJPEG file.
+///
+/// The phone identifies its session with a token, sent as the first message
+/// of each connection. When the link drops, the session is suspended instead
+/// of being deleted: if the phone reconnects with the same token, it resumes
+/// the session with the new link. The telemetry missed meanwhile is then
+/// requested from the backlog of the phone, and inserted before the live
+/// telemetry, which is held until the backlog arrives.
+class VehicleSession
+{
+public:
+    /// Constructor.
+    /// \param link the connection with the phone. It is closed and deleted
+    /// when the session is suspended or deleted.
+    /// \param token session token announced by the phone. Empty if the phone
+    /// did not announce one, then the session can't be resumed.
+    /// \param regulatorCoefficients the 12 initial regulators coefficients.
+    /// \param diskWriter the writer of the exported files. It must outlive
+    /// the session.
+    VehicleSession(VehicleLink *link, const QByteArray &token,
+                   const QList<double> &regulatorCoefficients, DiskWriter &diskWriter);
+
+    /// Destructor. Stops the FPV recording, closes and deletes the link.
+    ~VehicleSession();
+
+    /// Get the identifier of the vehicle.
+    /// \return the identifier, unique for the application. It is the
+    /// identifier of the first link of the session, and does not change when
+    /// the session is resumed.
+    int getId() const;
+
+    /// Get the identifier of the current link.
+    /// \return the identifier, or 0 if the session is suspended.
+    int getLinkId() const;
+
+    /// Get the session token announced by the phone.
+    /// \return the token, empty if none.
+    QByteArray getToken() const;
+
+    /// Get if the phone is connected.
+    /// \return false if the session is suspended.
+    bool isConnected() const;
+
+    /// Suspends the session, after a disconnection. The link is closed and
+    /// deleted; the telemetry and the recordings are kept.
+    /// \param groundTime current time, in the ground station clock [ms].
+    void suspend(qint64 groundTime);
+
+    /// Resumes a suspended session with a new link. The regulators
+    /// coefficients are sent only if they changed meanwhile, the missed
+    /// telemetry is requested (see addTelemetryBacklog()), the incomplete
+    /// chunked transfers are resumed, and the compact states are decoded
+    /// from the next keyframe.
+    /// \param link the new connection with the phone.
+    /// \param groundTime current time, in the ground station clock [ms].
+    void resume(VehicleLink *link, qint64 groundTime);
+
+    /// Get the time the session has been suspended.
+    /// \param groundTime current time, in the ground station clock [ms].
+    /// \return the duration [ms], or 0 if the phone is connected.
+    qint64 getSuspendedDuration(qint64 groundTime) const;
+
+    /// Reads a CURRENT_STATE message.
+    /// \param data the message.
+    /// \param values set to the TM_CHANNELS_COUNT values. The position
+    /// estimates are NaN if they were not sent, the channels derived by the
+    /// ground station (TM_SYNC_TIME, TM_LINK_DELAY) are NaN.
+    /// \return true if the message is valid, false otherwise.
+    static bool parseState(const QByteArray &data, double *values);
+
+    /// Reads a COMPACT_STATE message. If a message is missing, the following
+    /// ones can't be decoded until the next keyframe, which is requested from
+    /// the phone.
+    /// \param data the message.
+    /// \param values set to the TM_CHANNELS_COUNT values, as parseState().
+    /// \return the outcome of the decoding.
+    TelemetryDecoder::Result decodeCompactState(const QByteArray &data, double *values);
+
+    /// Get the name of the vehicle, to be displayed to the user.
+    /// \return the name.
+    QString getName() const;
+
+    /// Set the address of the phone, once the connection is ready.
+    /// \param peerName address and port of the phone.
+    void setPeerName(const QString &peerName);
+
+    /// Get a short tag identifying the vehicle, for the names of the files.
+    /// \return the tag (e.g. "vehicle3").
+    QString getFileTag() const;
+
+    /// Sends a message to the phone. Can be called from the GUI thread. Does
+    /// nothing if the session is suspended.
+    /// \param text useful content of the message.
+    void sendMessage(const QString &text);
+
+    /// Sends the flight commands to the phone, and remembers them for the
+    /// telemetry export and the state estimation. If the previous commands
+    /// have not been written yet, they are replaced (see
+    /// VehicleLink::queueCommand()).
+    /// \param thrust mean thrust.
+    /// \param yaw target yaw angle [deg].
+    /// \param pitch target pitch angle [deg].
+    /// \param roll target roll angle [deg].
+    /// \param sampleTime time of the gamepad sample the commands were
+    /// computed from, in the clock of QElapsedTimer::msecsSinceReference() [ms].
+    /// \param groundTime current time, in the ground station clock [ms].
+    void sendCommand(double thrust, double yaw, double pitch, double roll,
+                     qint64 sampleTime, qint64 groundTime);
+
+    /// Get the counters of the sent commands, and their age.
+    /// \return a copy of the counters.
+    CommandStats getCommandStats() const;
+
+    /// Get the counters of the other messages sent, per priority class:
+    /// queue depth, latency, replaced messages.
+    /// \return a copy of the counters.
+    OutboundStats getOutboundStats() const;
+
+    /// Stores a telemetry sample, exports it with the latest commands, and
+    /// fuses it in the state estimate. While the backlog of a resumed session
+    /// is awaited, the sample is held.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    /// \param values the TM_CHANNELS_COUNT values of the sample. The derived
+    /// channels are ignored: they are computed from the clock
+    /// synchronization.
+    void addTelemetry(qint64 groundTime, const double *values);
+
+    /// Processes the answer of the phone to a ping: updates the link health
+    /// estimates and the clock synchronization.
+    /// \param data content of the PONG message.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    void addPong(const QByteArray &data, qint64 groundTime);
+
+    /// Get the synchronization of the phone clock with the ground station
+    /// clock. It is kept when the session is resumed, as the phone clock is
+    /// the same.
+    /// \return the synchronization.
+    const ClockSync& getClockSync() const;
+
+    /// Get the one-way delay of the telemetry, from its creation on the phone
+    /// to its reception.
+    /// \return the smoothed delay [ms], NaN if the clocks are not
+    /// synchronized.
+    double getTelemetryDelay() const;
+
+    /// Get the estimator of the vehicle state, fed with the telemetry and
+    /// the commands. Its times are in the ground station clock.
+    /// \return the estimator.
+    const StateEstimator& getStateEstimator() const;
+
+    /// Inserts the telemetry missed while the session was suspended, then the
+    /// held samples. The ground time of each missed sample is estimated from
+    /// its phone time, with the clock offset of the last sample received
+    /// before the disconnection. Their creation time (TM_SYNC_TIME) is given
+    /// by the clock synchronization, their delay (TM_LINK_DELAY) is unknown.
+    /// \param data the TELEMETRY_BACKLOG message.
+    /// \param groundTime current time, in the ground station clock [ms].
+    /// \return the number of inserted missed samples.
+    int addTelemetryBacklog(const QByteArray &data, qint64 groundTime);
+
+    /// Get the exporter of the telemetry of this vehicle.
+    /// \return the exporter.
+    const TelemetryExporter& getExporter() const;
+
+    /// Get the telemetry received from this vehicle.
+    /// \return the telemetry store.
+    TelemetryStore& getTelemetry();
+
+    /// Get the regulators coefficients of this vehicle.
+    /// \return the 12 coefficients, in the order of the "regulator_coefs"
+    /// message.
+    QList<double> getRegulatorCoefficients() const;
+
+    /// Set the regulators coefficients of this vehicle, and send them to the
+    /// phone. If the session is suspended, they are sent when it resumes.
+    /// \param coefficients the 12 coefficients.
+    void setRegulatorCoefficients(const QList<double> &coefficients);
+
+    /// Get the controller of the FPV bitrate of this vehicle.
+    /// \return the controller.
+    FpvRateController& getFpvController();
+
+    /// Get the receiver of the large messages sent in chunks by this vehicle.
+    /// \return the receiver.
+    ChunkReceiver& getChunkReceiver();
+
+    /// Get the health monitor of the link with this vehicle.
+    /// \return the monitor.
+    LinkMonitor& getLinkMonitor();
+
+    /// Starts recording the FPV frames of this vehicle. The previous
+    /// recording is stopped.
+    /// \param filename the MJPEG file to record the frames into.
+    void startFpvRecording(const QString &filename);
+
+    /// Stops recording the FPV frames, and writes the index of the recording
+    /// (see FlightArchive).
+    void stopFpvRecording();
+
+    /// Records a FPV frame, if the recording is started.
+    /// \param groundTime reception time, in the ground station clock [ms].
+    /// \param jpeg the JPEG image.
+    void recordFpvFrame(qint64 groundTime, const QByteArray &jpeg);
+
+private:
+    /// Stores and exports the held samples, and stops holding the live
+    /// telemetry.
+    void releaseHeldTelemetry();
+
+    int id;
+    VehicleLink *link;
+    QByteArray token;
+    QString peerName;
+    qint64 suspendTime;
+    CommandStats lastCommandStats;
+    OutboundStats lastOutboundStats;
+    TelemetryStore telemetry;
+    TelemetryExporter exporter;
+    double sentCommands[CMD_COUNT];
+    QList<double> regulatorCoefficients;
+    QList<double> phoneRegulatorCoefficients; // Last sent to the phone.
+    FpvRateController fpvController;
+    LinkMonitor linkMonitor;
+    DiskWriter &diskWriter;
+    ChunkReceiver chunkReceiver;
+    TelemetryDecoder telemetryDecoder;
+    bool keyframeRequested;
+    ClockSync clockSync;
+    double telemetryDelay;
+    StateEstimator stateEstimator;
+
+    // FPV recording. The index is built while recording, so the recording
+    // can be opened instantly by FlightArchive.
+    int fpvStream;
+    QString fpvFilename;
+    qint64 fpvWrittenSize, fpvLastTime;
+    QVector<FlightArchive::IndexEntry> fpvIndex;
+
+    // Live telemetry held while the backlog is awaited.
+    bool awaitingBacklog;
+    qint64 backlogRequestTime;
+    QVector<qint64> heldTimes;
+    QVector<double> heldValues; // TM_CHANNELS_COUNT values per sample.
+    QVector<double> heldCommands; // CMD_COUNT commands sent, per sample.
+};
+
+#endif // VEHICLESESSION_H
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Measures the time for a phone to find the ground station and connect to it.
+#
+#-------------------------------------------------
+
+QT += core network
+QT -= gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = DiscoveryProbe
+TEMPLATE = app
+
+INCLUDEPATH += ../AndroCopterRemote
+
+SOURCES += main.cpp \
+    ../AndroCopterRemote/discoverybeacon.cpp
+
+HEADERS += ../AndroCopterRemote/discoverybeacon.h \
+    ../AndroCopterRemote/constants.h
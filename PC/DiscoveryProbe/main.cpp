@@ -0,0 +1,228 @@
+/*!
+* \file main.cpp
+* \brief Measures the time for a phone to find the ground station and to
+* connect to it.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* Stand-in for the phone: it sends the discovery query, reads the beacon, then
+* opens the TCP connection to the announced port, like TcpClient does, and
+* reports the time of each step.
+*
+* Usage: DiscoveryProbe [--lan] [attempts]
+* - by default, an in-process ground station (DiscoveryBeacon and TCP server)
+* is started on the loopback interface, on free ports, so the probe can run
+* next to a real ground station.
+* - with --lan, the query is broadcast on DISCOVERY_PORT, to measure a real
+* ground station of the network.
+*/
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QVector>
+#include <cstdio>
+
+#include "discoverybeacon.h"
+
+/// Time to wait for the beacon, then for the connection [ms].
+static const int ATTEMPT_TIMEOUT_MS = 1000;
+
+/// Time between two attempts [ms].
+static const int ATTEMPTS_INTERVAL_MS = 20;
+
+/// Plays the role of the phone, for a given number of attempts.
+class Probe : public QObject
+{
+    Q_OBJECT
+public:
+    /// Constructor.
+    /// \param target address to send the queries to.
+    /// \param discoveryPort UDP port of the ground station.
+    /// \param attempts number of discoveries and connections to measure.
+    /// \param localServer TCP server of the in-process ground station, whose
+    /// connections are closed as they come. 0 if none.
+    Probe(const QHostAddress &target, quint16 discoveryPort, int attempts,
+          QTcpServer *localServer) :
+        target(target), discoveryPort(discoveryPort), remainingAttempts(attempts),
+        localServer(localServer)
+    {
+        failuresCount = 0;
+        waitingBeacon = false;
+
+        udpSocket.bind(QHostAddress::AnyIPv4, 0);
+        timeoutTimer.setSingleShot(true);
+
+        connect(&udpSocket, SIGNAL(readyRead()), this, SLOT(readBeacon()));
+        connect(&tcpSocket, SIGNAL(connected()), this, SLOT(onConnected()));
+        connect(&timeoutTimer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+
+        if(localServer != 0)
+            connect(localServer, SIGNAL(newConnection()), this, SLOT(closeServerConnections()));
+    }
+
+public slots:
+    /// Starts an attempt: sends the query.
+    void sendQuery()
+    {
+        if(remainingAttempts <= 0)
+        {
+            report();
+            QCoreApplication::quit();
+            return;
+        }
+
+        remainingAttempts--;
+        waitingBeacon = true;
+        attemptTimer.start();
+        timeoutTimer.start(ATTEMPT_TIMEOUT_MS);
+
+        udpSocket.writeDatagram(DiscoveryBeacon::makeQuery(), target, discoveryPort);
+    }
+
+private slots:
+    /// Reads the beacon, and connects to the announced port.
+    void readBeacon()
+    {
+        while(udpSocket.hasPendingDatagrams())
+        {
+            QByteArray datagram((int)udpSocket.pendingDatagramSize(), 0);
+            QHostAddress sender;
+            udpSocket.readDatagram(datagram.data(), datagram.size(), &sender);
+
+            DiscoveryBeacon::Announce announce;
+
+            if(!waitingBeacon || !DiscoveryBeacon::parseBeacon(datagram, announce))
+                continue;
+
+            waitingBeacon = false;
+            discoveryTimes.append(attemptTimer.nsecsElapsed() / 1000);
+
+            if(discoveryTimes.size() == 1)
+            {
+                printf("Found \"%s\" at %s:%d, capabilities: %s.\n",
+                       announce.name.toLocal8Bit().constData(),
+                       sender.toString().toLocal8Bit().constData(), announce.port,
+                       announce.capabilities.join(",").toLocal8Bit().constData());
+            }
+
+            tcpSocket.connectToHost(sender, announce.port);
+        }
+    }
+
+    /// Records the time to connect, and starts the next attempt.
+    void onConnected()
+    {
+        timeoutTimer.stop();
+        connectionTimes.append(attemptTimer.nsecsElapsed() / 1000);
+        tcpSocket.abort();
+
+        QTimer::singleShot(ATTEMPTS_INTERVAL_MS, this, SLOT(sendQuery()));
+    }
+
+    /// Gives up the current attempt.
+    void onTimeout()
+    {
+        waitingBeacon = false;
+        tcpSocket.abort();
+        failuresCount++;
+
+        QTimer::singleShot(ATTEMPTS_INTERVAL_MS, this, SLOT(sendQuery()));
+    }
+
+    /// Closes the connections accepted by the in-process ground station.
+    void closeServerConnections()
+    {
+        while(localServer->hasPendingConnections())
+            delete localServer->nextPendingConnection();
+    }
+
+private:
+    /// Prints the minimum, mean and maximum of durations.
+    static void printDurations(const char *name, const QVector<qint64> &durations)
+    {
+        if(durations.isEmpty())
+        {
+            printf("%-18s no measure\n", name);
+            return;
+        }
+
+        qint64 minimum = durations.first(), maximum = durations.first(), sum = 0;
+
+        foreach(qint64 duration, durations)
+        {
+            minimum = qMin(minimum, duration);
+            maximum = qMax(maximum, duration);
+            sum += duration;
+        }
+
+        printf("%-18s min %7.3f ms, mean %7.3f ms, max %7.3f ms\n", name,
+               minimum / 1000.0, sum / 1000.0 / durations.size(), maximum / 1000.0);
+    }
+
+    /// Prints the results of all the attempts.
+    void report()
+    {
+        printf("%d attempt(s), %d connected, %d failed.\n",
+               connectionTimes.size() + failuresCount, connectionTimes.size(), failuresCount);
+        printDurations("Beacon received:", discoveryTimes);
+        printDurations("Time to connect:", connectionTimes);
+    }
+
+    QHostAddress target;
+    quint16 discoveryPort;
+    int remainingAttempts, failuresCount;
+    QTcpServer *localServer;
+    bool waitingBeacon;
+
+    QUdpSocket udpSocket;
+    QTcpSocket tcpSocket;
+    QTimer timeoutTimer;
+    QElapsedTimer attemptTimer;
+
+    // Durations since the query was sent [us].
+    QVector<qint64> discoveryTimes, connectionTimes;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QStringList arguments = application.arguments();
+    bool lan = arguments.removeAll("--lan") > 0;
+    int attempts = (arguments.size() > 1) ? arguments[1].toInt() : 100;
+
+    QTcpServer server;
+    DiscoveryBeacon beacon;
+    QHostAddress target;
+    quint16 discoveryPort;
+
+    if(lan)
+    {
+        target = QHostAddress::Broadcast;
+        discoveryPort = DISCOVERY_PORT;
+    }
+    else
+    {
+        if(!server.listen(QHostAddress::LocalHost, 0) || !beacon.start(server.serverPort(), 0))
+        {
+            printf("Can't start the loopback ground station.\n");
+            return 1;
+        }
+
+        target = QHostAddress::LocalHost;
+        discoveryPort = beacon.getDiscoveryPort();
+    }
+
+    Probe probe(target, discoveryPort, attempts, lan ? 0 : &server);
+    QTimer::singleShot(0, &probe, SLOT(sendQuery()));
+
+    return application.exec();
+}
+
+#include "main.moc"
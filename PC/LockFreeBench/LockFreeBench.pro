@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Checks the lock-free queues and shared values, and compares their speed
+# with a queue protected by a mutex.
+#
+#-------------------------------------------------
+
+QT = core
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = LockFreeBench
+TEMPLATE = app
+
+INCLUDEPATH += ../AndroCopterRemote
+
+SOURCES += main.cpp
+
+HEADERS += ../AndroCopterRemote/lockfree.h
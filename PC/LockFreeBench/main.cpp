@@ -0,0 +1,407 @@
+/*!
+* \file main.cpp
+* \brief Checks the lock-free queues and shared values, and compares their
+* speed with a queue protected by a mutex.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* Runs each primitive of lockfree.h with real threads, and reports:
+* - SpscQueue: one producer, one consumer. Every element is received once,
+* in order (checksum and sequence), at small capacities (so the indices wrap
+* around the cells many times) and at the capacity used by the application.
+* - MpscQueue: several producers, one consumer. Every element is received
+* once (checksum), and the elements of each producer are received in their
+* order.
+* - TripleBuffer: the values read are never torn (all the fields come from
+* the same write), and never go back in time.
+* - SeqLock: same checks, with several readers.
+* - The number of elements per second of SpscQueue and MpscQueue, against a
+* QQueue protected by a QMutex with the same capacity, as the queues of the
+* ground station were before.
+*
+* A check that fails prints the first error, and the program returns 1.
+* On a single processor, the threads only interleave at the preemptions, so
+* run it on a multi-core machine to exercise the races.
+*
+* Usage: LockFreeBench [elements]
+*
+* Without qmake, from this directory (Qt Core only):
+*   g++ -std=c++11 -O2 -Wall -fPIC -I../AndroCopterRemote $(pkg-config --cflags Qt5Core) main.cpp $(pkg-config --libs Qt5Core) -pthread -o lock-free-bench
+*/
+
+#include "lockfree.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/// Capacity of the queues for the throughput measures, as
+/// TELEMETRY_HANDOFF_CAPACITY.
+static const int BENCH_CAPACITY = 1024;
+
+/// Number of producers of the MPSC tests.
+static const int PRODUCERS_COUNT = 4;
+
+/// Number of fields of the values shared by TripleBuffer and SeqLock. Large
+/// enough for a copy to be interrupted.
+static const int SNAPSHOT_FIELDS_COUNT = 16;
+
+/// Number of readers of the SeqLock test.
+static const int SEQLOCK_READERS_COUNT = 3;
+
+/// Queue protected by a mutex, with the interface of SpscQueue and
+/// MpscQueue: the baseline of the throughput measures.
+template<class T> class LockedQueue
+{
+public:
+    explicit LockedQueue(int capacity) : capacity(capacity)
+    {
+    }
+
+    bool tryPush(const T &value)
+    {
+        QMutexLocker locker(&mutex);
+
+        if(queue.size() >= capacity)
+            return false;
+
+        queue.enqueue(value);
+        return true;
+    }
+
+    bool tryPop(T &value)
+    {
+        QMutexLocker locker(&mutex);
+
+        if(queue.isEmpty())
+            return false;
+
+        value = queue.dequeue();
+        return true;
+    }
+
+private:
+    QMutex mutex;
+    QQueue<T> queue;
+    int capacity;
+};
+
+/// Value shared by TripleBuffer and SeqLock: all its fields are equal, so a
+/// torn copy is detected.
+struct Snapshot
+{
+    quint64 fields[SNAPSHOT_FIELDS_COUNT];
+};
+
+/// Get the time elapsed since the start of the program.
+/// \return the time [s].
+static double getTime()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Prints the result of a check.
+/// \param name name of the check.
+/// \param error the first error, or null if the check passed.
+/// \return true if the check passed.
+static bool report(const char *name, const char *error)
+{
+    if(error == 0)
+        printf("%-44s OK\n", name);
+    else
+        printf("%-44s FAILED: %s\n", name, error);
+
+    return error == 0;
+}
+
+/// Element of the queues: producer in the high bits, sequence number in the
+/// low bits.
+static quint64 makeElement(int producer, quint64 sequence)
+{
+    return ((quint64)producer << 48) | sequence;
+}
+
+/// Sends elements from producers threads to the calling thread, through a
+/// queue, and checks that each one is received once, in the order of its
+/// producer.
+/// \param queue the queue, empty.
+/// \param producersCount number of producer threads.
+/// \param elementsCount number of elements per producer.
+/// \param elapsed set to the duration of the transfer [s].
+/// \return the first error, or null.
+template<class Queue> const char* transfer(Queue &queue, int producersCount, quint64 elementsCount, double &elapsed)
+{
+    std::atomic<bool> go(false);
+    std::vector<std::thread> producers;
+
+    for(int p=0; p<producersCount; p++)
+    {
+        producers.push_back(std::thread([&queue, &go, p, elementsCount]()
+        {
+            while(!go.load())
+                std::this_thread::yield();
+
+            for(quint64 s=1; s<=elementsCount; s++)
+            {
+                while(!queue.tryPush(makeElement(p, s)))
+                    std::this_thread::yield();
+            }
+        }));
+    }
+
+    std::vector<quint64> lastSequences(producersCount, 0);
+    quint64 expectedSum = (quint64)producersCount * elementsCount * (elementsCount + 1) / 2;
+    quint64 sum = 0, received = 0;
+    const char *error = 0;
+
+    double startTime = getTime();
+    go.store(true);
+
+    while(received < producersCount * elementsCount)
+    {
+        quint64 element;
+
+        if(!queue.tryPop(element))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int producer = (int)(element >> 48);
+        quint64 sequence = element & 0xffffffffffffull;
+
+        if(producer >= producersCount)
+        {
+            if(error == 0)
+                error = "element of an unknown producer";
+        }
+        else
+        {
+            if(sequence != lastSequences[producer] + 1 && error == 0)
+                error = "element lost, duplicated or reordered";
+
+            lastSequences[producer] = sequence;
+        }
+
+        sum += sequence;
+        received++;
+    }
+
+    elapsed = getTime() - startTime;
+
+    for(size_t p=0; p<producers.size(); p++)
+        producers[p].join();
+
+    quint64 extra;
+
+    if(error == 0 && queue.tryPop(extra))
+        error = "more elements than pushed";
+    if(error == 0 && sum != expectedSum)
+        error = "wrong checksum";
+
+    return error;
+}
+
+/// Writes increasing snapshots from a thread, and reads them from the
+/// calling thread, until the writer is done.
+/// \param write function publishing a snapshot.
+/// \param read function reading the latest snapshot.
+/// \param writesCount number of snapshots written.
+/// \param readsCount set to the number of snapshots read.
+/// \return the first error, or null.
+template<class Write, class Read> const char* checkSnapshots(Write write, Read read, quint64 writesCount, quint64 &readsCount)
+{
+    std::atomic<bool> done(false);
+
+    std::thread writer([&write, &done, writesCount]()
+    {
+        Snapshot snapshot;
+
+        for(quint64 v=1; v<=writesCount; v++)
+        {
+            for(int f=0; f<SNAPSHOT_FIELDS_COUNT; f++)
+                snapshot.fields[f] = v;
+
+            write(snapshot);
+        }
+
+        done.store(true);
+    });
+
+    const char *error = 0;
+    quint64 previous = 0;
+    readsCount = 0;
+
+    while(true)
+    {
+        bool last = done.load();
+        Snapshot snapshot = read();
+        readsCount++;
+
+        for(int f=1; f<SNAPSHOT_FIELDS_COUNT; f++)
+        {
+            if(snapshot.fields[f] != snapshot.fields[0] && error == 0)
+                error = "torn value";
+        }
+
+        if(snapshot.fields[0] < previous && error == 0)
+            error = "value older than the previous one";
+
+        previous = snapshot.fields[0];
+
+        // The last read, after the writer is done, gets the last value.
+        if(last)
+        {
+            if(previous != writesCount && error == 0)
+                error = "last value not read";
+
+            break;
+        }
+    }
+
+    writer.join();
+
+    return error;
+}
+
+int main(int argc, char *argv[])
+{
+    quint64 elementsCount = 2000000;
+
+    if(argc > 1)
+        elementsCount = strtoull(argv[1], 0, 10);
+
+    if(argc > 2 || elementsCount == 0)
+    {
+        printf("Usage: %s [elements]\n", argv[0]);
+        return 1;
+    }
+
+    bool passed = true;
+    double elapsed;
+    char name[64];
+
+    // SPSC: the small capacities make the indices wrap around the cells at
+    // almost every element, and keep the queue full or empty most of the
+    // time.
+    const int spscCapacities[] = {1, 2, 3, 16, BENCH_CAPACITY};
+
+    for(size_t i=0; i<sizeof(spscCapacities)/sizeof(spscCapacities[0]); i++)
+    {
+        SpscQueue<quint64> queue(spscCapacities[i]);
+        snprintf(name, sizeof(name), "SpscQueue, capacity %d", spscCapacities[i]);
+        passed &= report(name, transfer(queue, 1, elementsCount / 4, elapsed));
+    }
+
+    // MPSC.
+    const int mpscCapacities[] = {2, 4, 16, BENCH_CAPACITY};
+
+    for(size_t i=0; i<sizeof(mpscCapacities)/sizeof(mpscCapacities[0]); i++)
+    {
+        MpscQueue<quint64> queue(mpscCapacities[i]);
+        snprintf(name, sizeof(name), "MpscQueue, %d producers, capacity %d", PRODUCERS_COUNT, mpscCapacities[i]);
+        passed &= report(name, transfer(queue, PRODUCERS_COUNT, elementsCount / 4 / PRODUCERS_COUNT, elapsed));
+    }
+
+    // TripleBuffer.
+    {
+        TripleBuffer<Snapshot> buffer;
+        quint64 readsCount;
+        const char *error = checkSnapshots([&buffer](const Snapshot &s) { buffer.write(s); },
+                                           [&buffer]() { return buffer.read(); },
+                                           elementsCount, readsCount);
+        snprintf(name, sizeof(name), "TripleBuffer, %llu reads", (unsigned long long)readsCount);
+        passed &= report(name, error);
+    }
+
+    // SeqLock, with more readers in other threads.
+    {
+        SeqLock<Snapshot> shared;
+        std::atomic<bool> done(false);
+        std::atomic<int> readerErrors(0);
+        std::vector<std::thread> readers;
+
+        for(int r=1; r<SEQLOCK_READERS_COUNT; r++)
+        {
+            readers.push_back(std::thread([&shared, &done, &readerErrors]()
+            {
+                quint64 previous = 0;
+
+                while(!done.load())
+                {
+                    Snapshot snapshot = shared.load();
+
+                    for(int f=1; f<SNAPSHOT_FIELDS_COUNT; f++)
+                    {
+                        if(snapshot.fields[f] != snapshot.fields[0])
+                            readerErrors++;
+                    }
+
+                    if(snapshot.fields[0] < previous)
+                        readerErrors++;
+
+                    previous = snapshot.fields[0];
+                }
+            }));
+        }
+
+        quint64 readsCount;
+        const char *error = checkSnapshots([&shared](const Snapshot &s) { shared.store(s); },
+                                           [&shared]() { return shared.load(); },
+                                           elementsCount, readsCount);
+        done.store(true);
+
+        for(size_t r=0; r<readers.size(); r++)
+            readers[r].join();
+
+        if(error == 0 && readerErrors.load() != 0)
+            error = "torn or older value in another reader";
+
+        snprintf(name, sizeof(name), "SeqLock, %d readers", SEQLOCK_READERS_COUNT);
+        passed &= report(name, error);
+    }
+
+    // Throughput, against the mutex.
+    printf("\nThroughput, capacity %d [million elements/s]:\n", BENCH_CAPACITY);
+
+    for(int producersCount=1; producersCount<=PRODUCERS_COUNT; producersCount*=PRODUCERS_COUNT)
+    {
+        quint64 perProducer = elementsCount / producersCount;
+        double total = (double)(perProducer * producersCount) / 1e6;
+        double lockFreeTime, lockedTime;
+        const char *lockFreeName;
+
+        if(producersCount == 1)
+        {
+            SpscQueue<quint64> queue(BENCH_CAPACITY);
+            passed &= (transfer(queue, 1, perProducer, lockFreeTime) == 0);
+            lockFreeName = "SpscQueue";
+        }
+        else
+        {
+            MpscQueue<quint64> queue(BENCH_CAPACITY);
+            passed &= (transfer(queue, producersCount, perProducer, lockFreeTime) == 0);
+            lockFreeName = "MpscQueue";
+        }
+
+        LockedQueue<quint64> locked(BENCH_CAPACITY);
+        passed &= (transfer(locked, producersCount, perProducer, lockedTime) == 0);
+
+        printf("  %d producer(s): %s %6.2f, QMutex+QQueue %6.2f (x%.1f).\n",
+               producersCount, lockFreeName, total / lockFreeTime, total / lockedTime,
+               lockedTime / lockFreeTime);
+    }
+
+    printf("\n%s\n", passed ? "All the checks passed." : "Some checks FAILED.");
+
+    return passed ? 0 : 1;
+}
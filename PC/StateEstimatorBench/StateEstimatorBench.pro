@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Measures the speed and the accuracy of the state estimator.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+TARGET = StateEstimatorBench
+TEMPLATE = app
+
+INCLUDEPATH += ../AndroCopterRemote
+
+SOURCES += main.cpp \
+    ../AndroCopterRemote/stateestimator.cpp
+
+HEADERS += ../AndroCopterRemote/stateestimator.h \
+    ../AndroCopterRemote/matrix.h
@@ -0,0 +1,376 @@
+/*!
+* \file main.cpp
+* \brief Measures the speed and the accuracy of the state estimator.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* Simulates a flight (pilot steps on the sticks, regulated attitude, vertical
+* motion with an unknown hover thrust), the link (delayed commands, delayed
+* telemetry with jitter and stalls, as TCP delivers it), and runs the
+* StateEstimator as the ground station does. The simulated vehicle does not
+* match the model of the estimator exactly (response, hover thrust). Reports:
+* - the updates per second: fusion of a measurement, with the replay of the
+* commands since the previous one.
+* - the predictions per second: extrapolation to the current time, as done
+* at each command.
+* - at each command, the error of the latest received telemetry (what the
+* ground station displayed and used before) and of the prediction, against
+* the true current state.
+*
+* Usage: StateEstimatorBench [duration s]
+*
+* It does not need Qt. Without qmake, from this directory:
+*   g++ -std=c++11 -O2 -Wall -I../AndroCopterRemote ../AndroCopterRemote/stateestimator.cpp main.cpp -o state-estimator-bench
+*/
+
+#include "stateestimator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+/// Period of the commands (UPDATE_PERIOD_MS) [ms].
+static const int COMMAND_PERIOD_MS = 20;
+
+/// Period of the telemetry states of the phone [ms].
+static const int STATE_PERIOD_MS = 50;
+
+/// Mean one-way delays of the link, and jitter of the telemetry [ms].
+static const double UPLINK_DELAY_MS = 30.0;
+static const double DOWNLINK_DELAY_MS = 40.0;
+static const double DOWNLINK_JITTER_MS = 20.0;
+
+/// Probability that a state starts a stall of the link, and duration of the
+/// stall [ms]. The states are then delivered late, all at once.
+static const double STALL_PROBABILITY = 0.01;
+static const double STALL_DURATION_MS = 400.0;
+
+/// The simulated vehicle, which the estimator does not know exactly.
+static const double TRUE_HOVER_THRUST = 118.0;
+static const double TRUE_ATTITUDE_PULSATION = 7.0;
+static const double TRUE_ATTITUDE_DAMPING = 0.7;
+
+/// Noise of the sensors of the phone: angles [deg], altitude [m].
+static const double SENSOR_ANGLE_NOISE = 0.8;
+static const double SENSOR_ALTITUDE_NOISE = 0.25;
+
+/// Number of passes of the speed measures. The fastest pass is kept.
+static const int SPEED_PASSES = 5;
+
+static const double GRAVITY = 9.81;
+static const double DEG_TO_RAD = 3.14159265 / 180.0;
+
+/// A command, as sent by the ground station.
+struct Command
+{
+    double time; ///< Sending time [ms].
+    double applyTime; ///< Time at which the vehicle applies it [ms].
+    double thrust, yaw, pitch, roll;
+};
+
+/// A telemetry state, as received by the ground station.
+struct Measurement
+{
+    double time; ///< Time at which it was taken [ms].
+    double receptionTime; ///< Time at which it was received [ms].
+    double yaw, pitch, roll, altitude;
+};
+
+/// Something the ground station does, in the order it does it.
+struct Event
+{
+    enum Type { COMMAND, MEASUREMENT, PREDICTION } type;
+    int index; ///< Index of the command or of the measurement. For a prediction, of the command.
+};
+
+/// The simulated vehicle: the true state.
+struct Vehicle
+{
+    double angles[3], rates[3];
+    double altitude, verticalSpeed;
+
+    Vehicle()
+    {
+        for(int i=0; i<3; i++)
+        {
+            angles[i] = 0.0;
+            rates[i] = 0.0;
+        }
+
+        altitude = 1.0;
+        verticalSpeed = 0.0;
+    }
+
+    void step(const Command &command, double disturbance, double dt)
+    {
+        double targets[3] = {command.yaw, command.pitch, command.roll};
+
+        for(int i=0; i<3; i++)
+        {
+            double error = targets[i] - angles[i];
+
+            if(i == 0)
+                error -= 360.0 * std::floor((error + 180.0) / 360.0);
+
+            rates[i] += (TRUE_ATTITUDE_PULSATION * TRUE_ATTITUDE_PULSATION * error
+                         - 2.0 * TRUE_ATTITUDE_DAMPING * TRUE_ATTITUDE_PULSATION * rates[i]) * dt;
+            angles[i] += rates[i] * dt;
+        }
+
+        angles[0] -= 360.0 * std::floor((angles[0] + 180.0) / 360.0);
+
+        double tilt = std::cos(angles[1] * DEG_TO_RAD) * std::cos(angles[2] * DEG_TO_RAD);
+        verticalSpeed += (GRAVITY * (command.thrust * tilt / TRUE_HOVER_THRUST - 1.0)
+                          - ESTIMATOR_VERTICAL_DRAG * verticalSpeed + disturbance) * dt;
+        altitude += verticalSpeed * dt;
+    }
+};
+
+/// Accumulates a root mean square.
+struct RmsError
+{
+    double sum;
+    long long count;
+
+    RmsError() : sum(0.0), count(0) {}
+
+    void add(double error)
+    {
+        sum += error * error;
+        count++;
+    }
+
+    double get() const
+    {
+        return (count > 0) ? std::sqrt(sum / count) : 0.0;
+    }
+};
+
+/// Get the difference between two angles.
+static double angleError(double a, double b)
+{
+    double error = a - b;
+    return error - 360.0 * std::floor((error + 180.0) / 360.0);
+}
+
+int main(int argc, char *argv[])
+{
+    double duration = (argc > 1) ? atof(argv[1]) : 600.0;
+
+    if(duration <= 0.0)
+    {
+        printf("Usage: %s [duration s]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 random(42);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Simulate the flight and the link, by steps of 1 ms.
+    std::vector<Command> commands;
+    std::vector<Measurement> measurements;
+    std::vector<std::vector<double> > truths; // True yaw, pitch, roll, altitude at each command.
+    std::deque<Command> inFlight; // Commands not applied by the vehicle yet.
+    Vehicle vehicle;
+    Command applied = {0.0, 0.0, TRUE_HOVER_THRUST, 0.0, 0.0, 0.0};
+    Command pilot = applied;
+    double stallEnd = 0.0, lastReception = 0.0;
+    long long durationMs = (long long)(duration * 1000.0);
+
+    for(long long t=0; t<durationMs; t++)
+    {
+        double now = (double)t;
+
+        // The pilot moves the sticks from time to time.
+        if(t % COMMAND_PERIOD_MS == 0)
+        {
+            if(uniform(random) < 0.02)
+            {
+                pilot.pitch = noise(random) * 8.0;
+                pilot.roll = noise(random) * 8.0;
+                pilot.thrust = TRUE_HOVER_THRUST + noise(random) * 8.0;
+            }
+
+            pilot.yaw += 0.5;
+            pilot.yaw -= 360.0 * std::floor((pilot.yaw + 180.0) / 360.0);
+            pilot.time = now;
+            pilot.applyTime = now + UPLINK_DELAY_MS + std::fabs(noise(random)) * 5.0;
+            commands.push_back(pilot);
+            inFlight.push_back(pilot);
+
+            std::vector<double> truth(4);
+            truth[0] = vehicle.angles[0];
+            truth[1] = vehicle.angles[1];
+            truth[2] = vehicle.angles[2];
+            truth[3] = vehicle.altitude;
+            truths.push_back(truth);
+        }
+
+        while(!inFlight.empty() && inFlight.front().applyTime <= now)
+        {
+            applied = inFlight.front();
+            inFlight.pop_front();
+        }
+
+        // The phone sends its state. TCP keeps the order.
+        if(t % STATE_PERIOD_MS == 0)
+        {
+            if(uniform(random) < STALL_PROBABILITY)
+                stallEnd = now + STALL_DURATION_MS;
+
+            Measurement m;
+            m.time = now;
+            m.receptionTime = std::max(now + DOWNLINK_DELAY_MS + std::fabs(noise(random)) * DOWNLINK_JITTER_MS,
+                                       std::max(stallEnd, lastReception));
+            m.yaw = vehicle.angles[0] + noise(random) * SENSOR_ANGLE_NOISE;
+            m.pitch = vehicle.angles[1] + noise(random) * SENSOR_ANGLE_NOISE;
+            m.roll = vehicle.angles[2] + noise(random) * SENSOR_ANGLE_NOISE;
+            m.altitude = vehicle.altitude + noise(random) * SENSOR_ALTITUDE_NOISE;
+            measurements.push_back(m);
+            lastReception = m.receptionTime;
+        }
+
+        vehicle.step(applied, noise(random) * 1.0, 0.001);
+    }
+
+    // Sequence of the ground station: each command is stored and followed by
+    // a prediction; the measurements are fused when received.
+    std::vector<Event> events;
+    size_t nextMeasurement = 0;
+
+    for(size_t c=0; c<commands.size(); c++)
+    {
+        while(nextMeasurement < measurements.size() &&
+              measurements[nextMeasurement].receptionTime <= commands[c].time)
+        {
+            Event event = {Event::MEASUREMENT, (int)nextMeasurement++};
+            events.push_back(event);
+        }
+
+        Event prediction = {Event::PREDICTION, (int)c};
+        events.push_back(prediction);
+
+        Event command = {Event::COMMAND, (int)c};
+        events.push_back(command);
+    }
+
+    // Accuracy, against the true state at each command.
+    StateEstimator estimator;
+    RmsError rawErrors[4], predictedErrors[4];
+    int latestReceived = -1;
+    long long predictionsCount = 0, rejectedCount = 0;
+    double extrapolationSum = 0.0;
+    EstimatedState state;
+
+    for(size_t e=0; e<events.size(); e++)
+    {
+        const Event &event = events[e];
+
+        if(event.type == Event::MEASUREMENT)
+        {
+            const Measurement &m = measurements[event.index];
+
+            if(!estimator.addMeasurement(m.time, m.yaw, m.pitch, m.roll, m.altitude))
+                rejectedCount++;
+
+            latestReceived = event.index;
+        }
+        else if(event.type == Event::COMMAND)
+        {
+            const Command &c = commands[event.index];
+            estimator.addCommand(c.time + UPLINK_DELAY_MS, c.thrust, c.yaw, c.pitch, c.roll);
+        }
+        else if(latestReceived >= 0 && estimator.predict(commands[event.index].time, state))
+        {
+            const std::vector<double> &truth = truths[event.index];
+            const Measurement &raw = measurements[latestReceived];
+
+            // Skip the start, while the hover thrust converges.
+            if(commands[event.index].time < 10000.0)
+                continue;
+
+            rawErrors[0].add(angleError(raw.yaw, truth[0]));
+            rawErrors[1].add(raw.pitch - truth[1]);
+            rawErrors[2].add(raw.roll - truth[2]);
+            rawErrors[3].add(raw.altitude - truth[3]);
+
+            predictedErrors[0].add(angleError(state.values[EST_YAW], truth[0]));
+            predictedErrors[1].add(state.values[EST_PITCH] - truth[1]);
+            predictedErrors[2].add(state.values[EST_ROLL] - truth[2]);
+            predictedErrors[3].add(state.values[EST_ALTITUDE] - truth[3]);
+
+            extrapolationSum += state.extrapolation;
+            predictionsCount++;
+        }
+    }
+
+    double finalHoverThrust = state.values[EST_HOVER_THRUST];
+
+    // Speed of the updates (commands and measurements, as received) and of the
+    // predictions.
+    double bestUpdateNs = 1e100, bestPredictionNs = 1e100;
+    double sink = 0.0;
+
+    for(int pass=0; pass<SPEED_PASSES; pass++)
+    {
+        StateEstimator timedEstimator;
+        std::chrono::steady_clock::duration updateTime(0), predictionTime(0);
+
+        for(size_t e=0; e<events.size(); e++)
+        {
+            const Event &event = events[e];
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            if(event.type == Event::MEASUREMENT)
+            {
+                const Measurement &m = measurements[event.index];
+                timedEstimator.addMeasurement(m.time, m.yaw, m.pitch, m.roll, m.altitude);
+                updateTime += std::chrono::steady_clock::now() - start;
+            }
+            else if(event.type == Event::COMMAND)
+            {
+                const Command &c = commands[event.index];
+                timedEstimator.addCommand(c.time + UPLINK_DELAY_MS, c.thrust, c.yaw, c.pitch, c.roll);
+                updateTime += std::chrono::steady_clock::now() - start;
+            }
+            else
+            {
+                EstimatedState predicted;
+
+                if(timedEstimator.predict(commands[event.index].time, predicted))
+                    sink += predicted.values[EST_ALTITUDE];
+
+                predictionTime += std::chrono::steady_clock::now() - start;
+            }
+        }
+
+        bestUpdateNs = std::min(bestUpdateNs, std::chrono::duration<double, std::nano>(updateTime).count() / measurements.size());
+        bestPredictionNs = std::min(bestPredictionNs, std::chrono::duration<double, std::nano>(predictionTime).count() / commands.size());
+    }
+
+    // Report.
+    const char *names[4] = {"yaw [deg]", "pitch [deg]", "roll [deg]", "altitude [m]"};
+
+    printf("%.0f s of flight: %zu commands (every %d ms), %zu states (every %d ms), %lld rejected.\n",
+           duration, commands.size(), COMMAND_PERIOD_MS, measurements.size(), STATE_PERIOD_MS, rejectedCount);
+    printf("Updates:     %10.0f /s (%.2f us each, with the replay of the commands).\n",
+           1e9 / bestUpdateNs, bestUpdateNs / 1000.0);
+    printf("Predictions: %10.0f /s (%.2f us each, %.0f ms after the last measurement on average).\n",
+           1e9 / bestPredictionNs, bestPredictionNs / 1000.0,
+           (predictionsCount > 0) ? extrapolationSum / predictionsCount : 0.0);
+    printf("RMS error at each command, latest telemetry vs prediction:\n");
+
+    for(int i=0; i<4; i++)
+        printf("  %-13s %7.3f  %7.3f\n", names[i], rawErrors[i].get(), predictedErrors[i].get());
+
+    printf("Hover thrust: estimated %.1f, true %.1f (model guess %.1f).\n",
+           finalHoverThrust, TRUE_HOVER_THRUST, ESTIMATOR_INITIAL_HOVER_THRUST);
+
+    return (sink == 12345.0) ? 2 : 0; // Keeps the predictions from being optimized out.
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Compares the compact telemetry encoding with the text one.
+#
+#-------------------------------------------------
+
+QT -= core gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+TARGET = TelemetryCodecBench
+TEMPLATE = app
+
+INCLUDEPATH += ../AndroCopterRemote
+
+SOURCES += main.cpp \
+    ../AndroCopterRemote/telemetrycodec.cpp
+
+HEADERS += ../AndroCopterRemote/telemetrycodec.h
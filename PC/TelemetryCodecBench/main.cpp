@@ -0,0 +1,351 @@
+/*!
+* \file main.cpp
+* \brief Compares the compact telemetry encoding with the text one.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* Generates a synthetic flight (hovering with noisy sensors, gamepad steps,
+* slow battery discharge), formats each state as the phone does, as text
+* (CURRENT_STATE) and as compact frame (COMPACT_STATE), and reports:
+* - the size of a state on the link, message header included [bytes].
+* - the time to decode a state [ns]. The text is parsed as
+* VehicleSession::parseState() does (split on spaces, then convert each
+* word), but with strtod() instead of QString: the Qt parsing is slower, so
+* the measured gain is a lower bound.
+* - the quantization error of the compact encoding.
+* - the states rejected after a lost frame, until the keyframe requested by
+* the ground station. The phone sends a keyframe by itself after the states
+* it replaces (sendMessageNowOrSkip()), so this only covers the losses it
+* does not see.
+*
+* Usage: TelemetryCodecBench [states] [loss rate]
+*
+* It does not need Qt. Without qmake, from this directory:
+*   g++ -std=c++11 -O2 -Wall -I../AndroCopterRemote ../AndroCopterRemote/telemetrycodec.cpp main.cpp -o telemetry-codec-bench
+*/
+
+#include "telemetrycodec.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/// Size of the header of a message: size (uint32), then type (uint8) [bytes].
+static const int MESSAGE_HEADER_SIZE = 5;
+
+/// Period of the states sent by the phone (STATE_SEND_DIVIDER sensors
+/// measurements) [ms]. It only scales the bitrate.
+static const int STATE_PERIOD_MS = 50;
+
+/// Frames sent before a keyframe request of the ground station is served:
+/// the round-trip time, in states.
+static const int KEYFRAME_REQUEST_DELAY = 5;
+
+/// Number of passes of the decoding measures. The fastest pass is kept.
+static const int DECODE_PASSES = 5;
+
+/// Formats a float as Java's Float.toString() does: the shortest decimal
+/// representation that reads back as the same float, with at least one
+/// decimal.
+static std::string javaFloat(float value)
+{
+    char buffer[32];
+
+    for(int precision=1; precision<=9; precision++)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+
+        if((float)strtod(buffer, 0) == value)
+            break;
+    }
+
+    std::string text(buffer);
+
+    if(text.find_first_of(".en") == std::string::npos)
+        text += ".0";
+
+    return text;
+}
+
+/// Synthetic flight, with the variables of MainController.
+class FlightGenerator
+{
+public:
+    explicit FlightGenerator(unsigned int seed) : random(seed), noise(0.0, 1.0)
+    {
+        time = 1234567;
+        yaw = 0.0; pitch = 0.0; roll = 0.0; altitude = 2.0;
+        yawTarget = 0.0f; pitchTarget = 0.0f; rollTarget = 0.0f; altitudeTarget = 2.0f;
+        battery = 12.4;
+    }
+
+    /// Computes the next state.
+    /// \param values set to the CODEC_CHANNELS_COUNT values, as floats like
+    /// on the phone. The position estimates are NaN (not sent by the phone).
+    void next(double *values)
+    {
+        time += STATE_PERIOD_MS + (int)(noise(random) * 2.0);
+
+        // The pilot moves the sticks from time to time.
+        if(noise(random) > 2.5)
+        {
+            yawTarget += (float)(noise(random) * 20.0);
+            pitchTarget = (float)(noise(random) * 5.0);
+            rollTarget = (float)(noise(random) * 5.0);
+        }
+
+        // The vehicle follows the targets, with vibrations.
+        yaw += (yawTarget - yaw) * 0.1 + noise(random) * 0.2;
+        pitch += (pitchTarget - pitch) * 0.2 + noise(random) * 0.3;
+        roll += (rollTarget - roll) * 0.2 + noise(random) * 0.3;
+        altitude += (altitudeTarget - altitude) * 0.05 + noise(random) * 0.05;
+        battery -= 0.0002 + noise(random) * 0.005;
+
+        float currentAltitude = (float)(altitude + noise(random) * 0.2); // Barometer noise.
+
+        values[0] = (double)time;
+        values[1] = (float)yaw;
+        values[2] = yawTarget;
+        values[3] = (float)((yawTarget - yaw) * 1.5);
+        values[4] = (float)pitch;
+        values[5] = pitchTarget;
+        values[6] = (float)((pitchTarget - pitch) * 2.0);
+        values[7] = (float)roll;
+        values[8] = rollTarget;
+        values[9] = (float)((rollTarget - roll) * 2.0);
+        values[10] = (float)battery;
+        values[11] = 0.0;
+        values[12] = 1.0;
+        values[13] = currentAltitude;
+        values[14] = altitudeTarget;
+        values[15] = (float)((altitudeTarget - currentAltitude) * 20.0);
+        values[16] = NAN;
+        values[17] = NAN;
+    }
+
+private:
+    std::mt19937 random;
+    std::normal_distribution<double> noise;
+    long long time;
+    double yaw, pitch, roll, altitude, battery;
+    float yawTarget, pitchTarget, rollTarget, altitudeTarget;
+};
+
+/// Formats a state as the CURRENT_STATE message of the phone.
+static std::string formatText(const double *values)
+{
+    std::string text = std::to_string((long long)values[0]);
+
+    for(int i=1; i<CODEC_MANDATORY_CHANNELS_COUNT; i++)
+    {
+        text += ' ';
+
+        // The temperature and the regulators state are integers.
+        if(i == 11 || i == 12)
+            text += std::to_string((int)values[i]);
+        else
+            text += javaFloat((float)values[i]);
+    }
+
+    return text;
+}
+
+/// Parses a CURRENT_STATE message, as VehicleSession::parseState().
+static bool parseText(const std::string &text, double *values)
+{
+    std::vector<std::string> words;
+    size_t start = 0;
+
+    while(true)
+    {
+        size_t end = text.find(' ', start);
+        words.push_back(text.substr(start, end - start));
+
+        if(end == std::string::npos)
+            break;
+
+        start = end + 1;
+    }
+
+    if(words.size() != 16 && words.size() != 18)
+        return false;
+
+    for(int i=0; i<CODEC_CHANNELS_COUNT; i++)
+        values[i] = (i < (int)words.size()) ? strtod(words[i].c_str(), 0) : NAN;
+
+    return true;
+}
+
+/// Get the fastest of the passes of a decoding function.
+/// \return the time per state [ns].
+template<class F> static double measure(int statesCount, F decodeAll)
+{
+    double best = 1e100;
+
+    for(int pass=0; pass<DECODE_PASSES; pass++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        decodeAll();
+        double duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, duration / statesCount);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int statesCount = (argc > 1) ? atoi(argv[1]) : 100000;
+    double lossRate = (argc > 2) ? atof(argv[2]) : 0.01;
+
+    if(statesCount <= 0)
+    {
+        printf("Usage: %s [states] [loss rate]\n", argv[0]);
+        return 1;
+    }
+
+    // Generate and encode the flight.
+    FlightGenerator generator(42);
+    TelemetryEncoder encoder;
+    std::vector<double> states(statesCount * CODEC_CHANNELS_COUNT);
+    std::vector<std::string> texts(statesCount);
+    std::vector<std::vector<uint8_t> > frames(statesCount);
+    long long textBytes = 0, compactBytes = 0, keyframeBytes = 0, keyframesCount = 0;
+
+    for(int s=0; s<statesCount; s++)
+    {
+        double *values = &states[s * CODEC_CHANNELS_COUNT];
+        generator.next(values);
+
+        texts[s] = formatText(values);
+
+        uint8_t frame[CODEC_MAX_FRAME_SIZE];
+        int size = encoder.encode(values, false, frame);
+        frames[s].assign(frame, frame + size);
+
+        textBytes += MESSAGE_HEADER_SIZE + texts[s].size();
+        compactBytes += MESSAGE_HEADER_SIZE + size;
+
+        if(frame[0] & CODEC_FLAG_KEYFRAME)
+        {
+            keyframeBytes += MESSAGE_HEADER_SIZE + size;
+            keyframesCount++;
+        }
+    }
+
+    // Check the decoded values, and measure the quantization error.
+    double maxErrors[CODEC_CHANNELS_COUNT] = {0.0};
+    TelemetryDecoder checkDecoder;
+
+    for(int s=0; s<statesCount; s++)
+    {
+        double decoded[CODEC_CHANNELS_COUNT];
+
+        if(checkDecoder.decode(frames[s].data(), (int)frames[s].size(), decoded) != TelemetryDecoder::DECODE_OK)
+        {
+            printf("Frame %d not decoded!\n", s);
+            return 1;
+        }
+
+        for(int i=0; i<CODEC_MANDATORY_CHANNELS_COUNT; i++)
+        {
+            double error = std::fabs(decoded[i] - states[s * CODEC_CHANNELS_COUNT + i]);
+            maxErrors[i] = std::max(maxErrors[i], error);
+        }
+    }
+
+    // Measure the decoding times.
+    double sink = 0.0;
+
+    double textNs = measure(statesCount, [&]()
+    {
+        double values[CODEC_CHANNELS_COUNT];
+
+        for(int s=0; s<statesCount; s++)
+        {
+            parseText(texts[s], values);
+            sink += values[1];
+        }
+    });
+
+    double compactNs = measure(statesCount, [&]()
+    {
+        TelemetryDecoder decoder;
+        double values[CODEC_CHANNELS_COUNT];
+
+        for(int s=0; s<statesCount; s++)
+        {
+            decoder.decode(frames[s].data(), (int)frames[s].size(), values);
+            sink += values[1];
+        }
+    });
+
+    // Lose frames, and count the states rejected until the next keyframe. The
+    // encoder is replayed, so it can serve the keyframe requests.
+    std::mt19937 lossRandom(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    TelemetryEncoder lossyEncoder;
+    TelemetryDecoder lossyDecoder;
+    long long lostCount = 0, rejectedCount = 0;
+    int keyframeRequestCountdown = -1;
+
+    for(int s=0; s<statesCount; s++)
+    {
+        if(keyframeRequestCountdown == 0)
+            lossyEncoder.requestKeyframe();
+
+        if(keyframeRequestCountdown >= 0)
+            keyframeRequestCountdown--;
+
+        uint8_t frame[CODEC_MAX_FRAME_SIZE];
+        int size = lossyEncoder.encode(&states[s * CODEC_CHANNELS_COUNT], false, frame);
+
+        if(uniform(lossRandom) < lossRate)
+        {
+            lostCount++;
+            continue;
+        }
+
+        double values[CODEC_CHANNELS_COUNT];
+
+        if(lossyDecoder.decode(frame, size, values) == TelemetryDecoder::DECODE_NO_REFERENCE)
+        {
+            rejectedCount++;
+
+            // The ground station asks once for a keyframe.
+            if(keyframeRequestCountdown < 0)
+                keyframeRequestCountdown = KEYFRAME_REQUEST_DELAY;
+        }
+    }
+
+    // Report.
+    printf("%d states, one every %d ms.\n", statesCount, STATE_PERIOD_MS);
+    printf("Text:    %6.1f bytes/state, decoded in %7.1f ns/state.\n",
+           (double)textBytes / statesCount, textNs);
+    printf("Compact: %6.1f bytes/state, decoded in %7.1f ns/state (keyframes: %.1f bytes, 1 out of %d).\n",
+           (double)compactBytes / statesCount, compactNs,
+           (double)keyframeBytes / keyframesCount, CODEC_KEYFRAME_INTERVAL);
+    printf("Compact/text: %.1f%% of the bytes, %.1f%% of the decoding time.\n",
+           100.0 * compactBytes / textBytes, 100.0 * compactNs / textNs);
+    printf("Telemetry bitrate: text %.0f bit/s, compact %.0f bit/s.\n",
+           8.0 * textBytes / statesCount * 1000.0 / STATE_PERIOD_MS,
+           8.0 * compactBytes / statesCount * 1000.0 / STATE_PERIOD_MS);
+
+    printf("Max quantization error:");
+
+    for(int i=0; i<CODEC_MANDATORY_CHANNELS_COUNT; i++)
+        printf(" %.2g", maxErrors[i]);
+
+    printf("\n");
+    printf("Loss rate %.3f: %lld frames lost, %lld more rejected until a keyframe (%.1f per loss, request served after %d frames).\n",
+           lossRate, lostCount, rejectedCount,
+           (lostCount > 0) ? (double)rejectedCount / lostCount : 0.0, KEYFRAME_REQUEST_DELAY);
+
+    return (sink == 12345.0) ? 2 : 0; // Keeps the decoding from being optimized out.
+}
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Compares the CSV export of the telemetry with the columnar one.
+#
+#-------------------------------------------------
+
+QT = core
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = TelemetryExportBench
+TEMPLATE = app
+
+INCLUDEPATH += ../AndroCopterRemote
+
+SOURCES += main.cpp \
+    ../AndroCopterRemote/telemetryexporter.cpp \
+    ../AndroCopterRemote/diskwriter.cpp
+
+HEADERS += ../AndroCopterRemote/telemetryexporter.h \
+    ../AndroCopterRemote/telemetrystore.h \
+    ../AndroCopterRemote/diskwriter.h \
+    ../AndroCopterRemote/constants.h
@@ -0,0 +1,217 @@
+/*!
+* \file main.cpp
+* \brief Compares the CSV export of the telemetry with the columnar one.
+* \author Romain Baud
+* \version 0.1
+* \date 2026.10.18
+*
+* Generates a synthetic flight at 100 Hz (hovering with noisy sensors,
+* gamepad steps, slow battery discharge), exports it with the
+* TelemetryExporter and the DiskWriter of the ground station, and reports:
+* - the size of each file, and per row [bytes].
+* - the encoding throughput of each format, on the calling thread (the GUI
+* thread in the ground station) [rows/s, MB/s of output].
+* - the end-to-end throughput, until both files are on the disk.
+*
+* The rows are added as fast as the disk writer accepts them: above half of
+* its queue, the bench waits, so no part of the files is dropped.
+*
+* Usage: TelemetryExportBench [rows] [directory]
+* The files are written to the directory (the temporary directory by
+* default), then removed.
+*/
+
+#include "telemetryexporter.h"
+#include "diskwriter.h"
+#include "constants.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+/// Period of the telemetry rows [ms].
+static const int ROW_PERIOD_MS = 10;
+
+/// Synthetic flight: a phone hovering, with noisy sensors, following the
+/// gamepad steps of the pilot.
+class FlightGenerator
+{
+public:
+    explicit FlightGenerator(unsigned int seed) :
+        random(seed), noise(0.0, 1.0), uniform(0.0, 1.0)
+    {
+        groundTime = 1000000;
+        phoneTime = 5000;
+        yaw = 0.0;
+        targetYaw = 0.0;
+        targetPitch = 0.0;
+        targetRoll = 0.0;
+        altitude = 1.0;
+        battery = 12.6;
+        thrust = 130.0;
+    }
+
+    /// Generates the next row.
+    /// \param time set to the ground time [ms].
+    /// \param values set to the TM_CHANNELS_COUNT values.
+    /// \param commands set to the CMD_COUNT sent commands.
+    void next(qint64 &time, double *values, double *commands)
+    {
+        groundTime += ROW_PERIOD_MS;
+        phoneTime += ROW_PERIOD_MS + (uniform(random) < 0.1 ? 1 : 0);
+
+        // Gamepad steps, about every two seconds.
+        if(uniform(random) < 0.005)
+        {
+            targetYaw = std::fmod(targetYaw + 90.0 * (uniform(random) - 0.5), 180.0);
+            targetPitch = 20.0 * (uniform(random) - 0.5);
+            targetRoll = 20.0 * (uniform(random) - 0.5);
+            thrust = 120.0 + 20.0 * uniform(random);
+        }
+
+        yaw += 0.05 * (targetYaw - yaw);
+        altitude += 0.001 * (thrust - 130.0) + 0.002 * noise(random);
+        battery -= 0.00002;
+
+        double pitch = targetPitch + 0.5 * noise(random);
+        double roll = targetRoll + 0.5 * noise(random);
+        double measuredYaw = yaw + 0.3 * noise(random);
+
+        // The phone sends floats.
+        values[TM_PHONE_TIME] = (double)phoneTime;
+        values[TM_YAW] = (float)measuredYaw;
+        values[TM_TARGET_YAW] = (float)targetYaw;
+        values[TM_YAW_COMMAND] = (float)(0.8 * (targetYaw - measuredYaw));
+        values[TM_PITCH] = (float)pitch;
+        values[TM_TARGET_PITCH] = (float)targetPitch;
+        values[TM_PITCH_COMMAND] = (float)(1.2 * (targetPitch - pitch));
+        values[TM_ROLL] = (float)roll;
+        values[TM_TARGET_ROLL] = (float)targetRoll;
+        values[TM_ROLL_COMMAND] = (float)(1.2 * (targetRoll - roll));
+        values[TM_BATTERY_VOLTAGE] = (float)(battery + 0.02 * noise(random));
+        values[TM_TEMPERATURE] = (float)(31.0 + std::floor(uniform(random) * 2.0));
+        values[TM_REGULATOR_STATE] = 1.0;
+        values[TM_ALTITUDE] = (float)(altitude + 0.1 * noise(random));
+        values[TM_TARGET_ALTITUDE] = 1.0;
+        values[TM_ALTITUDE_COMMAND] = (float)(thrust + 5.0 * noise(random));
+        values[TM_POSITION_X] = NAN;
+        values[TM_POSITION_Y] = NAN;
+        values[TM_SYNC_TIME] = (double)(groundTime - 25 - (qint64)(5.0 * uniform(random)));
+        values[TM_LINK_DELAY] = 25.0 + std::floor(5.0 * uniform(random));
+
+        commands[CMD_THRUST] = std::floor(thrust);
+        commands[CMD_YAW] = targetYaw;
+        commands[CMD_PITCH] = targetPitch;
+        commands[CMD_ROLL] = targetRoll;
+
+        time = groundTime;
+    }
+
+private:
+    std::mt19937 random;
+    std::normal_distribution<double> noise;
+    std::uniform_real_distribution<double> uniform;
+    qint64 groundTime, phoneTime;
+    double yaw, targetYaw, targetPitch, targetRoll, altitude, battery, thrust;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    int rowsCount = (argc > 1) ? atoi(argv[1]) : 360000;
+    QString directory = (argc > 2) ? QString(argv[2]) : QDir::tempPath();
+
+    if(rowsCount <= 0 || argc > 3)
+    {
+        printf("Usage: %s [rows] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    // Generate the flight beforehand, so it is not measured.
+    const int columnsCount = TM_CHANNELS_COUNT + CMD_COUNT;
+    FlightGenerator generator(42);
+    QVector<qint64> times(rowsCount);
+    QVector<double> rows(rowsCount * columnsCount);
+
+    for(int r=0; r<rowsCount; r++)
+    {
+        double *row = rows.data() + r * columnsCount;
+        generator.next(times[r], row, row + TM_CHANNELS_COUNT);
+    }
+
+    QString baseFilename = QDir(directory).filePath("telemetry-export-bench");
+    TelemetryExportStats stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    {
+        DiskWriter diskWriter(DISK_WRITER_MAX_QUEUED_BYTES);
+        TelemetryExporter exporter(diskWriter);
+        exporter.open(baseFilename);
+
+        for(int r=0; r<rowsCount; r++)
+        {
+            const double *row = rows.constData() + r * columnsCount;
+            exporter.addRow(times[r], row, row + TM_CHANNELS_COUNT);
+
+            // Let the disk writer catch up.
+            if(r % TELEMETRY_EXPORT_BLOCK_ROWS == 0)
+            {
+                while(diskWriter.getStats().queuedBytes > DISK_WRITER_MAX_QUEUED_BYTES / 2)
+                    QThread::msleep(1);
+            }
+        }
+
+        exporter.close();
+        stats = exporter.getStats();
+
+        // The destructors write the queued data, and close the files.
+    }
+
+    double totalSeconds = timer.nsecsElapsed() * 1e-9;
+
+    QString csvFilename = baseFilename + ".csv";
+    QString columnarFilename = baseFilename + ".tmc";
+    qint64 csvSize = QFileInfo(csvFilename).size();
+    qint64 columnarSize = QFileInfo(columnarFilename).size();
+    QFile::remove(csvFilename);
+    QFile::remove(columnarFilename);
+
+    double csvSeconds = qMax(stats.csvEncodingNs, (qint64)1) * 1e-9;
+    double columnarSeconds = qMax(stats.columnarEncodingNs, (qint64)1) * 1e-9;
+    double rawBytes = (double)rowsCount * (1 + columnsCount) * sizeof(double);
+    const double MB = 1024.0 * 1024.0;
+
+    printf("%d rows, one every %d ms (%.1f min of flight), %d columns.\n",
+           rowsCount, ROW_PERIOD_MS, rowsCount * ROW_PERIOD_MS / 60000.0, 1 + columnsCount);
+    printf("CSV:      %8.2f MB, %6.1f bytes/row, encoded at %9.0f rows/s (%6.1f MB/s).\n",
+           csvSize / MB, (double)csvSize / rowsCount,
+           rowsCount / csvSeconds, stats.csvBytes / MB / csvSeconds);
+    printf("Columnar: %8.2f MB, %6.1f bytes/row, encoded at %9.0f rows/s (%6.1f MB/s).\n",
+           columnarSize / MB, (double)columnarSize / rowsCount,
+           rowsCount / columnarSeconds, stats.columnarBytes / MB / columnarSeconds);
+    printf("Columnar/CSV: %.1f%% of the size, %.1f%% of the encoding time. Raw/columnar: %.1fx.\n",
+           100.0 * columnarSize / qMax(csvSize, (qint64)1),
+           100.0 * columnarSeconds / csvSeconds,
+           rawBytes / qMax(columnarSize, (qint64)1));
+    printf("Both files on the disk in %.2f s: %.0f rows/s, %.1f MB/s written, %lld part(s) dropped.\n",
+           totalSeconds, rowsCount / totalSeconds, (csvSize + columnarSize) / MB / totalSeconds,
+           (long long)stats.droppedCount);
+
+    if(csvSize != stats.csvBytes || columnarSize != stats.columnarBytes)
+    {
+        printf("The sizes of the files do not match the exported bytes!\n");
+        return 1;
+    }
+
+    return 0;
+}